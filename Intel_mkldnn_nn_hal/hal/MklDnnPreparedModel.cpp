@@ -18,11 +18,28 @@
 
 #include <android-base/logging.h>
 #include <cutils/log.h>
+#include <cutils/properties.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <set>
 #include <thread>
 
 #include "MklDnnPreparedModel.h"
 
-#define DISABLE_ALL_QUANT
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//#define DISABLE_ALL_QUANT
 
 enum MklDnnDebugLevel {
     L0,
@@ -336,6 +353,7 @@ void MklDnnPreparedModel::initializeInput(RunTimeOperandInfo* input, memory::for
         VLOG(L2, "input buffer is null");
         input->pmem = new memory(primitive_desc_mem);
         input->buffer = input->pmem->get_data_handle();
+        mPrivatePmems.push_back(input->pmem);
     } else {
         VLOG(L2, "input buffer is %p", input->buffer);
         input->pmem = new memory(primitive_desc_mem, input->buffer);
@@ -363,13 +381,15 @@ void MklDnnPreparedModel::finalizeOutput(RunTimeOperandInfo* output, memory::for
                      format_src, type_src, format, output->type);
             //may scale f32 to u8
             float scale = output->scale ? 1 / output->scale : 0;
-            output->pmem = insertReorder(src_pmem, format, output->type, false, scale);
+            output->pmem = insertReorder(output, src_pmem, format, output->type, false, scale,
+                                         output->zero);
             if (output->pmem != src_pmem) {
                 VLOG(L2, "output new pmem is %p", output->pmem);
                 addStubPmem(output, src_pmem);
             }
         }
-    } else {
+    } else if (output->pmem->get_primitive_desc().desc().data.data_type !=
+               memory::data_type::u8) {
         //for temporary variabile, skip the quant. Do not dequant.
         VLOG(L2, "output is temporary variables");
         output->scale = 0;
@@ -434,7 +454,590 @@ void MklDnnPreparedModel::addStubPmem(RunTimeOperandInfo* operand, memory* pmem)
     operand->stub_pmems.push_back(pmem);
 }
 
-memory* MklDnnPreparedModel::insertActivation(memory* pmem, FusedActivationFunc activation)
+//memory of temporaries is not allocated here, it is bound to a slice of the
+//activation arena by planArena() once all operations are imported.
+memory* MklDnnPreparedModel::createPmem(RunTimeOperandInfo* operand,
+                                        const memory::primitive_desc& pd)
+{
+    if (operand->lifetime == OperandLifeTime::CONSTANT_COPY ||
+        operand->lifetime == OperandLifeTime::CONSTANT_REFERENCE) {
+        return new memory(pd);
+    }
+    if (operand->lifetime == OperandLifeTime::MODEL_OUTPUT) {
+        auto pmem = new memory(pd);
+        mPrivatePmems.push_back(pmem);
+        return pmem;
+    }
+
+    auto pmem = new memory(pd, nullptr);
+    uint32_t index = static_cast<uint32_t>(operand - mOperands.data());
+    ArenaBlock block;
+    block.pmem = pmem;
+    block.size = (pd.get_size() + kArenaAlignment - 1) / kArenaAlignment * kArenaAlignment;
+    block.first = mCurrentOperation;
+    block.last = std::max(mCurrentOperation, mLastUse[index]);
+    block.offset = 0;
+    mArenaBlocks.push_back(block);
+    VLOG(L2, "arena block %p of operand %u, size %zu, live [%u, %u]",
+             pmem, index, block.size, block.first, block.last);
+    return pmem;
+}
+
+//memory sharing the buffer of base, rebound with it when base lives in the arena,
+//is a model input or output, or is itself a view
+memory* MklDnnPreparedModel::createPmemView(const memory::primitive_desc& pd, memory* base)
+{
+    auto pmem = new memory(pd, base->get_data_handle());
+    bool rebound = std::any_of(mArenaBlocks.begin(), mArenaBlocks.end(),
+                               [base](const ArenaBlock& b) { return b.pmem == base; }) ||
+                   std::find(mPrivatePmems.begin(), mPrivatePmems.end(), base) !=
+                       mPrivatePmems.end() ||
+                   std::any_of(mPmemViews.begin(), mPmemViews.end(),
+                               [base](const std::pair<memory*, memory*>& v) {
+                                   return v.first == base; });
+    if (rebound) {
+        mPmemViews.push_back(std::make_pair(pmem, base));
+    }
+    return pmem;
+}
+
+void MklDnnPreparedModel::addPrimitive(const PrimitiveFactory& factory)
+{
+    mPrimitiveFactories.push_back(factory);
+}
+
+//the first context runs on the memories created at import, every other one
+//gets its own arena, model inputs and outputs, and shares the constants.
+ExecutionContext* MklDnnPreparedModel::createContext()
+{
+    auto context = new ExecutionContext();
+    context->arena = nullptr;
+
+    //workers create their contexts while others run, mContexts is guarded by
+    //the queue lock
+    bool first;
+    {
+        std::lock_guard<std::mutex> lock(mQueueLock);
+        first = mContexts.empty();
+    }
+    if (!first) {
+        if (mArenaSize > 0 && posix_memalign(&context->arena, 4096, mArenaSize) != 0) {
+            ALOGE("failed to allocate execution context arena of %zu bytes", mArenaSize);
+            delete context;
+            return nullptr;
+        }
+        for (const auto& block : mArenaBlocks) {
+            context->pmems[block.pmem] = new memory(block.pmem->get_primitive_desc(),
+                    static_cast<uint8_t*>(context->arena) + block.offset);
+        }
+        for (auto pmem : mPrivatePmems) {
+            context->pmems[pmem] = new memory(pmem->get_primitive_desc());
+        }
+        for (const auto& view : mPmemViews) {
+            context->pmems[view.first] = new memory(view.first->get_primitive_desc(),
+                    context->pmems[view.second]->get_data_handle());
+        }
+    }
+
+    PmemMap map = [context](memory* pmem) -> memory& {
+        auto it = context->pmems.find(pmem);
+        return it == context->pmems.end() ? *pmem : *it->second;
+    };
+    for (const auto& factory : mPrimitiveFactories) {
+        context->net.push_back(factory(map));
+    }
+
+    std::lock_guard<std::mutex> lock(mQueueLock);
+    mContexts.emplace_back(context);
+    VLOG(L1, "created execution context %zu", mContexts.size());
+    return context;
+}
+
+//byte range of a memory primitive the net was created on
+struct MemoryRange {
+    uintptr_t begin;
+    uintptr_t end;
+};
+
+static MemoryRange getMemoryRange(const_mkldnn_primitive_t pmem)
+{
+    void* handle = nullptr;
+    const_mkldnn_primitive_desc_t pd = nullptr;
+    mkldnn_memory_get_data_handle(pmem, &handle);
+    mkldnn_primitive_get_primitive_desc(pmem, &pd);
+    auto begin = reinterpret_cast<uintptr_t>(handle);
+    return {begin, begin + mkldnn_memory_primitive_desc_get_size(pd)};
+}
+
+static bool overlap(const std::vector<MemoryRange>& a, const std::vector<MemoryRange>& b)
+{
+    for (const auto& x : a)
+        for (const auto& y : b)
+            if (x.begin < y.end && y.begin < x.end)
+                return true;
+    return false;
+}
+
+//orders every primitive after those whose memories it reads or writes, and that
+//read or write what it writes. Arena blocks reused by liveness alias through
+//their buffers, so dependencies are found on byte ranges, not on operands.
+void MklDnnPreparedModel::buildDependencies(const ExecutionContext& context)
+{
+    size_t count = context.net.size();
+    std::vector<std::vector<MemoryRange>> reads(count), writes(count);
+    for (size_t i = 0; i < count; i++) {
+        auto prim = context.net[i].get();
+        const_mkldnn_primitive_desc_t pd = nullptr;
+        mkldnn_primitive_get_primitive_desc(prim, &pd);
+        int inputs = mkldnn_primitive_desc_query_s32(pd, mkldnn_query_num_of_inputs_s32, 0);
+        int outputs = mkldnn_primitive_desc_query_s32(pd, mkldnn_query_num_of_outputs_s32, 0);
+        for (int j = 0; j < inputs; j++) {
+            mkldnn_primitive_at_t at;
+            if (mkldnn_primitive_get_input_at(prim, j, &at) == mkldnn_success)
+                reads[i].push_back(getMemoryRange(at.primitive));
+        }
+        for (int j = 0; j < outputs; j++) {
+            const_mkldnn_primitive_t out = nullptr;
+            if (mkldnn_primitive_get_output(prim, j, &out) == mkldnn_success)
+                writes[i].push_back(getMemoryRange(out));
+        }
+    }
+
+    mDependents.assign(count, {});
+    mDependencyCounts.assign(count, 0);
+    //longest chain of dependencies to every primitive, primitives of a same
+    //depth never depend on each other
+    std::vector<uint32_t> depth(count, 0);
+    std::vector<uint32_t> width(count, 0);
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = 0; j < i; j++) {
+            if (overlap(writes[i], reads[j]) || overlap(writes[i], writes[j]) ||
+                overlap(reads[i], writes[j])) {
+                mDependents[j].push_back(i);
+                mDependencyCounts[i]++;
+                depth[i] = std::max(depth[i], depth[j] + 1);
+            }
+        }
+        width[depth[i]]++;
+    }
+    mBranchWidth = count > 0 ? *std::max_element(width.begin(), width.end()) : 0;
+    VLOG(L1, "%zu primitives, up to %zu independent", count, mBranchWidth);
+}
+
+//runs the net of a context on the calling thread and the lanes of the context:
+//each takes a primitive whose dependencies are done, with the mkldnn threads of
+//the worker shared by the primitives running and ready at that time
+void MklDnnPreparedModel::runBranches(ExecutionContext* context, bool caller)
+{
+    auto& lanes = *context->lanes;
+    std::unique_lock<std::mutex> lock(lanes.lock);
+    for (;;) {
+        lanes.wake.wait(lock, [&] {
+            return lanes.stopping || !lanes.ready.empty() || (caller && lanes.left == 0);
+        });
+        if (lanes.stopping || (caller && lanes.ready.empty()))
+            return;
+        auto index = lanes.ready.front();
+        lanes.ready.pop_front();
+        lanes.running++;
+        size_t sharing = std::min(mLanes, lanes.running + lanes.ready.size());
+        lock.unlock();
+
+#ifdef _OPENMP
+        omp_set_num_threads(std::max<size_t>(1, mThreadsPerWorker / sharing));
+#endif
+        std::vector<primitive> net = {context->net[index]};
+        mkldnn::stream(mkldnn::stream::kind::eager).submit(net).wait();
+
+        lock.lock();
+        lanes.running--;
+        lanes.left--;
+        for (auto dependent : mDependents[index]) {
+            if (--lanes.pending[dependent] == 0)
+                lanes.ready.push_back(dependent);
+        }
+        lanes.wake.notify_all();
+    }
+}
+
+void MklDnnPreparedModel::runNet(ExecutionContext* context)
+{
+    if (!context->lanes) {
+        mkldnn::stream(mkldnn::stream::kind::eager).submit(context->net).wait();
+        return;
+    }
+    auto& lanes = *context->lanes;
+    {
+        std::lock_guard<std::mutex> lock(lanes.lock);
+        lanes.pending = mDependencyCounts;
+        lanes.left = context->net.size();
+        lanes.running = 0;
+        for (uint32_t i = 0; i < mDependencyCounts.size(); i++) {
+            if (mDependencyCounts[i] == 0)
+                lanes.ready.push_back(i);
+        }
+    }
+    lanes.wake.notify_all();
+    runBranches(context, true);
+}
+
+void MklDnnPreparedModel::startLanes(ExecutionContext* context)
+{
+    context->lanes.reset(new BranchLanes());
+    context->lanes->left = 0;
+    context->lanes->running = 0;
+    context->lanes->stopping = false;
+    //the worker is the first lane, threads created here inherit its affinity
+    for (size_t i = 1; i < mLanes; i++)
+        context->lanes->threads.emplace_back(&MklDnnPreparedModel::runBranches, this, context,
+                                             false);
+}
+
+//requests are split over mMaxContexts workers, each running mkldnn on
+//mThreadsPerWorker threads so that all of them together fit the core budget
+void MklDnnPreparedModel::startWorkers()
+{
+    char value[PROPERTY_VALUE_MAX];
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    mCoreBudget = online > 0 ? online : 1;
+    if (property_get("nn.hal.mkldnn.cores", value, "") > 0 && atoi(value) > 0)
+        mCoreBudget = std::min<size_t>(atoi(value), mCoreBudget);
+    mMaxContexts = std::min(static_cast<size_t>(kDefaultMaxContexts), mCoreBudget);
+    if (property_get("nn.hal.mkldnn.contexts", value, "") > 0 && atoi(value) > 0)
+        mMaxContexts = atoi(value);
+    mThreadsPerWorker = std::max<size_t>(1, mCoreBudget / mMaxContexts);
+    if (property_get("nn.hal.mkldnn.threads", value, "") > 0 && atoi(value) > 0)
+        mThreadsPerWorker = atoi(value);
+    mAffinity = property_get("nn.hal.mkldnn.affinity", value, "") > 0 && atoi(value) != 0;
+    //independent branches run on up to kMaxLanes threads of every worker
+    mLanes = std::min({mBranchWidth, mThreadsPerWorker, static_cast<size_t>(kMaxLanes)});
+    if (property_get("nn.hal.mkldnn.branches", value, "") > 0 && atoi(value) > 0)
+        mLanes = std::min<size_t>(atoi(value), std::max<size_t>(mBranchWidth, 1));
+
+#ifndef _OPENMP
+    VLOG(L1, "mkldnn without OpenMP, every worker runs its primitives alone");
+#endif
+    ALOGI("%zu workers of %zu threads, core budget %zu, affinity %d",
+          mMaxContexts, mThreadsPerWorker, mCoreBudget, mAffinity);
+    ALOGI("up to %zu independent primitives, %zu lanes per worker", mBranchWidth, mLanes);
+    mStopping = false;
+    for (size_t slot = 0; slot < mMaxContexts; slot++)
+        mWorkers.emplace_back(&MklDnnPreparedModel::runWorker, this, slot);
+}
+
+//mkldnn threads of the calling worker, pinned to cores
+//[slot * threads, (slot + 1) * threads) of the budget when affinity is on
+void MklDnnPreparedModel::applyThreadPolicy(size_t slot)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(mThreadsPerWorker);
+#endif
+    if (!mAffinity)
+        return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t i = 0; i < mThreadsPerWorker; i++)
+        CPU_SET((slot * mThreadsPerWorker + i) % mCoreBudget, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        ALOGE("failed to pin worker %zu: %s", slot, strerror(errno));
+}
+
+//worker 0 runs on the context created at prepare time, the others create
+//their own on their first request
+void MklDnnPreparedModel::runWorker(size_t slot)
+{
+    applyThreadPolicy(slot);
+    ExecutionContext* context = nullptr;
+    for (;;) {
+        std::unique_lock<std::mutex> lock(mQueueLock);
+        mQueueReady.wait(lock, [this] { return mStopping || !mRequests.empty(); });
+        if (mRequests.empty())
+            return;
+        auto pending = mRequests.front();
+        mRequests.pop_front();
+        if (context == nullptr && slot == 0)
+            context = mContexts[0].get();
+        lock.unlock();
+
+        if (context == nullptr) {
+            //allocating the arena and building the net takes a while, the other
+            //workers keep dequeuing meanwhile
+            context = createContext();
+            if (context == nullptr) {
+                //out of memory for another context, leave the requests to the others
+                ALOGE("worker %zu has no execution context, stopping it", slot);
+                lock.lock();
+                mRequests.push_front(pending);
+                lock.unlock();
+                mQueueReady.notify_one();
+                return;
+            }
+        }
+        if (mLanes > 1 && !context->lanes)
+            startLanes(context);
+
+        auto start = std::chrono::steady_clock::now();
+        asyncExecute(pending.request, pending.callback, context);
+        auto end = std::chrono::steady_clock::now();
+
+        lock.lock();
+        mExecutions++;
+        mBusyTime += end - start;
+        if (mExecutions == 1)
+            mFirstExecution = start;
+        mLastExecution = end;
+    }
+}
+
+memory* MklDnnPreparedModel::getContextPmem(const ExecutionContext& context, memory* pmem)
+{
+    auto it = context.pmems.find(pmem);
+    return it == context.pmems.end() ? pmem : it->second;
+}
+
+//point pmem of context, and every view sharing its buffer, at handle
+void MklDnnPreparedModel::setContextHandle(const ExecutionContext& context, memory* pmem,
+                                           void* handle)
+{
+    getContextPmem(context, pmem)->set_data_handle(handle);
+    for (const auto& view : mPmemViews) {
+        if (view.second == pmem)
+            setContextHandle(context, view.first, handle);
+    }
+}
+
+//layouts whose bytes are the request buffer as is
+static bool isPlainFormat(memory::format format)
+{
+    return format == memory::format::nchw || format == memory::format::nhwc ||
+           format == memory::format::nc || format == memory::format::x;
+}
+
+//channel blocked layout of an activation memory, format_undef for other layouts
+static memory::format getBlockedFormat(const memory* pmem)
+{
+    if (pmem == nullptr)
+        return memory::format::format_undef;
+    auto format = static_cast<memory::format>(pmem->get_primitive_desc().desc().data.format);
+    if (format == memory::format::nChw8c || format == memory::format::nChw16c)
+        return format;
+    return memory::format::format_undef;
+}
+
+//layout of an NNAPI tensor of the given rank, its elements in NNAPI order
+static memory::format getPlainFormat(size_t rank)
+{
+    switch (rank) {
+        case 1:
+            return memory::format::x;
+        case 2:
+            return memory::format::nc;
+        case 4:
+            return memory::format::nhwc;
+        default:
+            return memory::format::format_undef;
+    }
+}
+
+static int32_t getBlockSize(memory::format format)
+{
+    return format == memory::format::nChw16c ? 16 : 8;
+}
+
+//last operation reading each operand, in mModel.operations order
+void MklDnnPreparedModel::computeOperandLiveness()
+{
+    mLastUse.assign(mModel.operands.size(), 0);
+    for (uint32_t i = 0; i < mModel.operations.size(); i++) {
+        for (auto index : mModel.operations[i].inputs) {
+            mLastUse[index] = i;
+        }
+    }
+}
+
+//find ADDs of a float conv output with no activation and a temporary computed
+//before the conv, the conv then accumulates into the addend with a sum post-op.
+void MklDnnPreparedModel::planSumFusion()
+{
+    mSumFusions.clear();
+    mFusedAdds.clear();
+    const size_t none = mModel.operations.size();
+    std::vector<size_t> producer(mModel.operands.size(), none);
+    std::vector<uint32_t> readers(mModel.operands.size(), 0);
+    for (uint32_t i = 0; i < mModel.operations.size(); i++) {
+        for (auto index : mModel.operations[i].outputs)
+            producer[index] = i;
+        for (auto index : mModel.operations[i].inputs)
+            readers[index]++;
+    }
+
+    for (uint32_t i = 0; i < mModel.operations.size(); i++) {
+        const auto& add = mModel.operations[i];
+        if (add.type != OperationType::ADD || add.inputs.size() != 3)
+            continue;
+        for (uint32_t k = 0; k < 2; k++) {
+            uint32_t sum = add.inputs[k];
+            uint32_t addend = add.inputs[1 - k];
+            size_t conv = producer[sum];
+            if (conv == none || sum == addend || producer[addend] == none ||
+                producer[addend] >= conv)
+                continue;
+            const auto& op = mModel.operations[conv];
+            if (op.type != OperationType::CONV_2D &&
+                op.type != OperationType::DEPTHWISE_CONV_2D)
+                continue;
+            const auto& operand_sum = mModel.operands[sum];
+            const auto& operand_addend = mModel.operands[addend];
+            if (operand_sum.lifetime != OperandLifeTime::TEMPORARY_VARIABLE ||
+                readers[sum] != 1 ||
+                operand_sum.type != OperandType::TENSOR_FLOAT32 ||
+                operand_addend.type != OperandType::TENSOR_FLOAT32 ||
+                operand_sum.dimensions != operand_addend.dimensions ||
+                mSumFusions.count(conv) != 0)
+                continue;
+            auto conv_activation = getScalarData<FusedActivationFunc>(
+                    mOperands[op.inputs[op.inputs.size() - 1]]);
+            if (conv_activation != FusedActivationFunc::NONE)
+                continue;
+
+            SumFusion fusion;
+            fusion.add = i;
+            fusion.addend = addend;
+            fusion.activation = getScalarData<FusedActivationFunc>(mOperands[add.inputs[2]]);
+            //the conv may write over the addend if nothing reads it after the conv,
+            //neither directly nor through a RESHAPE view sharing its memory
+            std::vector<uint32_t> aliases = {addend};
+            for (bool grown = true; grown;) {
+                grown = false;
+                for (const auto& reshape : mModel.operations) {
+                    if (reshape.type != OperationType::RESHAPE)
+                        continue;
+                    bool in = std::find(aliases.begin(), aliases.end(),
+                                        reshape.inputs[0]) != aliases.end();
+                    bool out = std::find(aliases.begin(), aliases.end(),
+                                         reshape.outputs[0]) != aliases.end();
+                    if (in != out) {
+                        aliases.push_back(in ? reshape.outputs[0] : reshape.inputs[0]);
+                        grown = true;
+                    }
+                }
+            }
+            fusion.inPlace = true;
+            for (auto alias : aliases) {
+                if (mModel.operands[alias].lifetime != OperandLifeTime::TEMPORARY_VARIABLE)
+                    fusion.inPlace = false;
+            }
+            for (uint32_t j = conv; j < mModel.operations.size() && fusion.inPlace; j++) {
+                if (j == i)
+                    continue;
+                for (auto index : mModel.operations[j].inputs) {
+                    if (std::find(aliases.begin(), aliases.end(), index) != aliases.end())
+                        fusion.inPlace = false;
+                }
+            }
+            mSumFusions[conv] = fusion;
+            VLOG(L1, "ADD %u planned into conv %zu, addend %u, in place %d",
+                     i, conv, addend, fusion.inPlace);
+            break;
+        }
+    }
+}
+
+//keep the arena block of pmem, or of the memory pmem is a view of, alive until
+//operation last
+void MklDnnPreparedModel::extendArenaBlock(memory* pmem, uint32_t last)
+{
+    for (bool base = true; base;) {
+        base = false;
+        for (const auto& view : mPmemViews) {
+            if (view.first == pmem) {
+                pmem = view.second;
+                base = true;
+                break;
+            }
+        }
+    }
+    for (auto& block : mArenaBlocks) {
+        if (block.pmem == pmem)
+            block.last = std::max(block.last, last);
+    }
+}
+
+//assign every temporary memory an offset in one arena so that memories with
+//overlapping live ranges never overlap, largest blocks are placed first.
+bool MklDnnPreparedModel::planArena()
+{
+    std::vector<size_t> order(mArenaBlocks.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return mArenaBlocks[a].size > mArenaBlocks[b].size;
+    });
+
+    size_t total = 0;
+    mArenaSize = 0;
+    std::vector<size_t> placed;
+    for (auto index : order) {
+        ArenaBlock& block = mArenaBlocks[index];
+        std::vector<std::pair<size_t, size_t>> busy;
+        for (auto p : placed) {
+            const ArenaBlock& other = mArenaBlocks[p];
+            if (other.first <= block.last && block.first <= other.last)
+                busy.push_back(std::make_pair(other.offset, other.offset + other.size));
+        }
+        std::sort(busy.begin(), busy.end());
+
+        size_t offset = 0;
+        for (const auto& range : busy) {
+            if (offset + block.size <= range.first)
+                break;
+            offset = std::max(offset, range.second);
+        }
+        block.offset = offset;
+        mArenaSize = std::max(mArenaSize, offset + block.size);
+        total += block.size;
+        placed.push_back(index);
+    }
+
+    if (mArenaSize > 0 && posix_memalign(&mArena, 4096, mArenaSize) != 0) {
+        ALOGE("failed to allocate activation arena of %zu bytes", mArenaSize);
+        mArena = nullptr;
+        return false;
+    }
+
+    for (const auto& block : mArenaBlocks) {
+        block.pmem->set_data_handle(static_cast<uint8_t*>(mArena) + block.offset);
+    }
+    for (const auto& view : mPmemViews) {
+        view.first->set_data_handle(view.second->get_data_handle());
+    }
+    for (auto& operand : mOperands) {
+        if (operand.lifetime == OperandLifeTime::TEMPORARY_VARIABLE && operand.pmem)
+            operand.buffer = operand.pmem->get_data_handle();
+    }
+
+    ALOGI("activation arena: %zu memories, %zu bytes without reuse, %zu bytes planned",
+          mArenaBlocks.size(), total, mArenaSize);
+    return true;
+}
+
+//eltwise post-op of activation, false if there is none
+static bool appendActivation(mkldnn::post_ops* ops, FusedActivationFunc activation)
+{
+    switch(activation) {
+        case FusedActivationFunc::RELU:
+            ops->append_eltwise(1.0f, mkldnn::algorithm::eltwise_relu, 0, 0);
+            return true;
+        case FusedActivationFunc::RELU6:
+            ops->append_eltwise(1.0f, mkldnn::algorithm::eltwise_bounded_relu, 6, 0);
+            return true;
+        default:
+            return false;
+    }
+}
+
+//the activation runs in place on pmem, it is the only reader of the operation output
+memory* MklDnnPreparedModel::insertActivation(RunTimeOperandInfo* operand, memory* pmem,
+                                              FusedActivationFunc activation)
 {
     VLOG(L2, "insert activation of %d to pmem %p", activation, pmem);
     mkldnn::algorithm alg;
@@ -452,21 +1055,43 @@ memory* MklDnnPreparedModel::insertActivation(memory* pmem, FusedActivationFunc
             return nullptr;
     }
 
-    auto pmem_output = new memory(pmem->get_primitive_desc());
     auto desc_relu = mkldnn::eltwise_forward::desc(mkldnn::prop_kind::forward,
                         alg, pmem->get_primitive_desc().desc(), alpha);
     auto primitive_desc_relu = mkldnn::eltwise_forward::primitive_desc(desc_relu,
                         *cpu_engine);
 
-    mNet.push_back(mkldnn::eltwise_forward(primitive_desc_relu, *pmem,
-                        *pmem_output));
+    addPrimitive([=](const PmemMap& m) -> primitive {
+        return mkldnn::eltwise_forward(primitive_desc_relu, m(pmem), m(pmem));
+    });
 
-    return pmem_output;
+    return pmem;
+}
+
+//dst = alpha * src + beta, both f32 of the same layout, may be the same memory
+void MklDnnPreparedModel::insertLinear(memory* src_mem, memory* dst_mem, float alpha, float beta,
+                                       bool execute)
+{
+    VLOG(L2, "insert linear %f * x + %f, src %p, dst %p", alpha, beta, src_mem, dst_mem);
+    auto desc_linear = mkldnn::eltwise_forward::desc(mkldnn::prop_kind::forward_inference,
+                        mkldnn::algorithm::eltwise_linear,
+                        src_mem->get_primitive_desc().desc(), alpha, beta);
+    auto primitive_desc_linear = mkldnn::eltwise_forward::primitive_desc(desc_linear,
+                        *cpu_engine);
+    if (execute) {
+        std::vector<primitive> net;
+        net.push_back(mkldnn::eltwise_forward(primitive_desc_linear, *src_mem, *dst_mem));
+        mkldnn::stream(mkldnn::stream::kind::eager).submit(net).wait();
+    } else {
+        addPrimitive([=](const PmemMap& m) -> primitive {
+            return mkldnn::eltwise_forward(primitive_desc_linear, m(src_mem), m(dst_mem));
+        });
+    }
 }
 
 //insert reorder depends on mem_pd, if not return src_mem
-memory* MklDnnPreparedModel::insertReorder(memory* src_mem, memory::format format,
-                                           memory::data_type type, bool execute, float scale, uint8_t zero)
+memory* MklDnnPreparedModel::insertReorder(RunTimeOperandInfo* operand, memory* src_mem,
+                                           memory::format format, memory::data_type type,
+                                           bool execute, float scale, uint8_t zero)
 {
     VLOG(L2, "insert reorder for format %d, type %d, scale %f, zero %d", format, type, scale, zero);
     auto desc_src = src_mem->get_primitive_desc().desc();
@@ -477,13 +1102,35 @@ memory* MklDnnPreparedModel::insertReorder(memory* src_mem, memory::format forma
     if (format_src == format && type_src == type) {
         return src_mem;
     }
+    //a layout change keeps the quantization of the values
+    if (type_src == type) {
+        scale = 0;
+        zero = 0;
+    }
 
     memory::dims shape;
     shape.resize(desc_src.data.ndims);
     for (int i = 0; i < desc_src.data.ndims; i++) {
         shape[i] = desc_src.data.dims[i];
     }
-    memory* dst_mem = new memory({{shape, type, format}, *cpu_engine});
+    //reorders run at import time need their memory now, others go to the arena
+    auto pd_dst = memory::primitive_desc({shape, type, format}, *cpu_engine);
+    if (execute) {
+        auto cached = getCachedWeights(pd_dst);
+        if (cached)
+            return cached;
+    }
+    memory* dst_mem = execute ? new memory(pd_dst) : createPmem(operand, pd_dst);
+    //quantizing to u8 adds the zero point in f32 first: q = f * scale + zero
+    if (zero != 0 && type == memory::data_type::u8 && type_src == memory::data_type::f32) {
+        auto pd_src = src_mem->get_primitive_desc();
+        auto shifted = execute ? new memory(pd_src) : createPmem(operand, pd_src);
+        if (execute)
+            mConstPmems.push_back(shifted);
+        insertLinear(src_mem, shifted, scale != 0 ? scale : 1, zero, execute);
+        src_mem = shifted;
+        scale = 0;
+    }
     if (scale != 0) {
         VLOG(L2, "reorder need scale");
         mkldnn::primitive_attr attr;
@@ -496,7 +1143,10 @@ memory* MklDnnPreparedModel::insertReorder(memory* src_mem, memory::format forma
             net.push_back(mkldnn::reorder(pd_reorder, *src_mem, *dst_mem));
             mkldnn::stream(mkldnn::stream::kind::eager).submit(net).wait();
         } else {
-            mNet.push_back(mkldnn::reorder(pd_reorder, *src_mem, *dst_mem));
+            addPrimitive([=](const PmemMap& m) -> primitive {
+                return mkldnn::reorder(pd_reorder, m(src_mem), m(dst_mem));
+            });
+            mRuntimeReorders++;
         }
     } else {
         if (execute) {
@@ -504,10 +1154,18 @@ memory* MklDnnPreparedModel::insertReorder(memory* src_mem, memory::format forma
             net.push_back(mkldnn::reorder(*src_mem, *dst_mem));
             mkldnn::stream(mkldnn::stream::kind::eager).submit(net).wait();
         } else {
-            mNet.push_back(mkldnn::reorder(*src_mem, *dst_mem));
+            addPrimitive([=](const PmemMap& m) -> primitive {
+                return mkldnn::reorder(m(src_mem), m(dst_mem));
+            });
+            mRuntimeReorders++;
         }
     }
 
+    //dequantizing u8 removes the zero point after scaling: f = q * scale - zero * scale
+    if (zero != 0 && type == memory::data_type::f32 && type_src == memory::data_type::u8) {
+        insertLinear(dst_mem, dst_mem, 1, -zero * (scale != 0 ? scale : 1), execute);
+    }
+
 #ifdef MKLDNN_DEBUG
     {
         auto logDesc = [&](const memory *pmem, std::string header) {
@@ -521,16 +1179,19 @@ memory* MklDnnPreparedModel::insertReorder(memory* src_mem, memory::format forma
     }
 #endif
 
+    if (execute)
+        mCachedWeights.push_back(dst_mem);
     return dst_mem;
 }
 
 //insert reorder depends on mem_pd, if not return src_mem
-memory* MklDnnPreparedModel::insertReorder(memory* src_mem, const memory::desc& desc,
-                                           bool execute, float scale, uint8_t zero)
+memory* MklDnnPreparedModel::insertReorder(RunTimeOperandInfo* operand, memory* src_mem,
+                                           const memory::desc& desc, bool execute, float scale,
+                                           uint8_t zero)
 {
     auto format = static_cast<memory::format>(desc.data.format);
     auto type = static_cast<memory::data_type>(desc.data.data_type);
-    return insertReorder(src_mem, format, type, execute, scale, zero);
+    return insertReorder(operand, src_mem, format, type, execute, scale, zero);
 }
 
 //query {format, type} primitive, if not, allocate one, and order to it
@@ -549,7 +1210,8 @@ memory* MklDnnPreparedModel::insertReorderIfNeed(RunTimeOperandInfo* operand,
         || operand->lifetime == OperandLifeTime::CONSTANT_REFERENCE)
         execute = true;
 
-    pmem = insertReorder(operand->pmem, format, type, execute, operand->scale, operand->zero);
+    pmem = insertReorder(operand, operand->pmem, format, type, execute, operand->scale,
+                         operand->zero);
     addStubPmem(operand, pmem);
 
     return pmem;
@@ -570,12 +1232,399 @@ memory* MklDnnPreparedModel::insertReorderIfNeed(RunTimeOperandInfo* operand,
         || operand->lifetime == OperandLifeTime::CONSTANT_REFERENCE)
         execute = true;
 
-    pmem =  insertReorder(operand->pmem, desc, execute, operand->scale, operand->zero);
+    pmem =  insertReorder(operand, operand->pmem, desc, execute, operand->scale, operand->zero);
     addStubPmem(operand, pmem);
 
     return pmem;
 }
 
+static bool isConstant(const RunTimeOperandInfo& operand)
+{
+    return operand.lifetime == OperandLifeTime::CONSTANT_COPY ||
+           operand.lifetime == OperandLifeTime::CONSTANT_REFERENCE;
+}
+
+//weight cache file: a header, then one entry per constant reordered at import,
+//in import order, then the reordered data of every entry at kArenaAlignment
+struct WeightCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct WeightCacheEntry {
+    mkldnn_memory_desc_t desc;
+    uint64_t offset;
+    uint64_t size;
+};
+
+static constexpr uint32_t kWeightCacheMagic = 0x574b4c4d; //"MLKW"
+//bump whenever the bytes a cached constant holds change for the same memory
+//descriptor, e.g. in insertReorder(), quantizeWeights() or the bias folding
+static constexpr uint32_t kWeightCacheVersion = 2;
+
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ULL;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    return hash;
+}
+
+//blocked layouts mkldnn picks for weights depend on the instruction set
+static const char* getCpuIsa()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return "avx512";
+    if (__builtin_cpu_supports("avx2"))
+        return "avx2";
+    if (__builtin_cpu_supports("avx"))
+        return "avx";
+    if (__builtin_cpu_supports("sse4.2"))
+        return "sse42";
+#endif
+    return "generic";
+}
+
+//maps the cache file of this model, keyed by its constants, its graph, the cpu,
+//the int8 setting and the build of the HAL and mkldnn. "nn.hal.mkldnn.cache" set
+//to 0 disables the cache, "nn.hal.mkldnn.cache_dir" moves it.
+void MklDnnPreparedModel::openWeightCache()
+{
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("nn.hal.mkldnn.cache", value, "") > 0 && atoi(value) == 0)
+        return;
+    property_get("nn.hal.mkldnn.cache_dir", value, kDefaultWeightCacheDir);
+
+    const char* isa = getCpuIsa();
+    uint64_t key = hashBytes(0xcbf29ce484222325ULL, isa, strlen(isa));
+    key = hashBytes(key, &kWeightCacheVersion, sizeof(kWeightCacheVersion));
+    //the vendor image carries the HAL and libmkldnn, files of an older build are
+    //never mapped even if kWeightCacheVersion was not bumped
+    char build[PROPERTY_VALUE_MAX];
+    if (property_get("ro.vendor.build.fingerprint", build, "") <= 0)
+        property_get("ro.build.fingerprint", build, "");
+    key = hashBytes(key, build, strlen(build));
+#ifdef MKLDNN_VERSION_MAJOR
+    const int mkldnn_version[] = {MKLDNN_VERSION_MAJOR, MKLDNN_VERSION_MINOR,
+                                  MKLDNN_VERSION_PATCH};
+    key = hashBytes(key, mkldnn_version, sizeof(mkldnn_version));
+    key = hashBytes(key, MKLDNN_VERSION_HASH, strlen(MKLDNN_VERSION_HASH));
+#endif
+    key = hashBytes(key, &mInt8Enabled, sizeof(mInt8Enabled));
+    for (const auto& operation : mModel.operations) {
+        key = hashBytes(key, &operation.type, sizeof(operation.type));
+        key = hashBytes(key, operation.inputs.data(), operation.inputs.size() * sizeof(uint32_t));
+        key = hashBytes(key, operation.outputs.data(), operation.outputs.size() * sizeof(uint32_t));
+    }
+    for (size_t i = 0; i < mOperands.size(); i++) {
+        const auto& operand = mOperands[i];
+        key = hashBytes(key, &operand.type, sizeof(operand.type));
+        key = hashBytes(key, operand.dims.data(), operand.dims.size() * sizeof(uint32_t));
+        //quantization parameters change the requantized weights and biases
+        key = hashBytes(key, &mModel.operands[i].scale, sizeof(mModel.operands[i].scale));
+        key = hashBytes(key, &mModel.operands[i].zeroPoint, sizeof(mModel.operands[i].zeroPoint));
+        if (isConstant(operand))
+            key = hashBytes(key, operand.buffer, operand.length);
+    }
+    mWeightCacheKey = key;
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.mkldnn", static_cast<unsigned long long>(key));
+    mWeightCachePath = std::string(value) + name;
+
+    int fd = open(mWeightCachePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        VLOG(L1, "no weight cache %s", mWeightCachePath.c_str());
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(WeightCacheHeader))) {
+        //private and writable so that primitives may treat weights as any other memory
+        void* map = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            mWeightCache = map;
+            mWeightCacheSize = st.st_size;
+        }
+    }
+    close(fd);
+    if (mWeightCache == nullptr)
+        return;
+
+    auto header = static_cast<const WeightCacheHeader*>(mWeightCache);
+    if (header->magic != kWeightCacheMagic || header->version != kWeightCacheVersion ||
+        header->key != mWeightCacheKey ||
+        sizeof(WeightCacheHeader) + header->count * sizeof(WeightCacheEntry) > mWeightCacheSize) {
+        ALOGE("ignoring invalid weight cache %s", mWeightCachePath.c_str());
+        munmap(mWeightCache, mWeightCacheSize);
+        mWeightCache = nullptr;
+        mWeightCacheSize = 0;
+    }
+}
+
+//the next constant of the cache if it has the layout the reorder would produce,
+//the cache is dropped at the first mismatch
+memory* MklDnnPreparedModel::getCachedWeights(const memory::primitive_desc& pd)
+{
+    if (mWeightCache == nullptr || mWeightCacheMissed)
+        return nullptr;
+
+    auto header = static_cast<const WeightCacheHeader*>(mWeightCache);
+    auto entries = reinterpret_cast<const WeightCacheEntry*>(header + 1);
+    uint32_t index = mCachedWeights.size();
+    if (index < header->count) {
+        const auto& entry = entries[index];
+        if (entry.size == pd.get_size() && entry.offset % kArenaAlignment == 0 &&
+            entry.offset + entry.size <= mWeightCacheSize) {
+            memory::desc desc(entry.desc);
+            if (memory::primitive_desc(desc, *cpu_engine) == pd) {
+                auto pmem = new memory(pd, static_cast<uint8_t*>(mWeightCache) + entry.offset);
+                mCachedWeights.push_back(pmem);
+                return pmem;
+            }
+        }
+    }
+    VLOG(L1, "weight cache miss at constant %u", index);
+    mWeightCacheMissed = true;
+    return nullptr;
+}
+
+//writes the constants reordered at import when the cache did not hold all of them
+void MklDnnPreparedModel::saveWeightCache()
+{
+    if (mWeightCachePath.empty() || mCachedWeights.empty())
+        return;
+    if (mWeightCache != nullptr && !mWeightCacheMissed &&
+        static_cast<const WeightCacheHeader*>(mWeightCache)->count == mCachedWeights.size()) {
+        ALOGI("%zu constants loaded from %s", mCachedWeights.size(), mWeightCachePath.c_str());
+        return;
+    }
+
+    WeightCacheHeader header = {kWeightCacheMagic, kWeightCacheVersion, mWeightCacheKey,
+                                static_cast<uint32_t>(mCachedWeights.size()), 0};
+    std::vector<WeightCacheEntry> entries(mCachedWeights.size());
+    uint64_t offset = sizeof(header) + entries.size() * sizeof(WeightCacheEntry);
+    for (size_t i = 0; i < entries.size(); i++) {
+        auto pd = mCachedWeights[i]->get_primitive_desc();
+        memset(&entries[i], 0, sizeof(WeightCacheEntry));
+        entries[i].desc = pd.desc().data;
+        offset = (offset + kArenaAlignment - 1) / kArenaAlignment * kArenaAlignment;
+        entries[i].offset = offset;
+        entries[i].size = pd.get_size();
+        offset += entries[i].size;
+    }
+
+    //written aside and renamed, so that no reader maps a partial file
+    std::string temp = mWeightCachePath + ".tmp" + std::to_string(getpid());
+    FILE* file = fopen(temp.c_str(), "we");
+    if (file == nullptr) {
+        ALOGE("failed to create weight cache %s: %s", temp.c_str(), strerror(errno));
+        return;
+    }
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(entries.data(), sizeof(WeightCacheEntry), entries.size(), file) ==
+                       entries.size();
+    for (size_t i = 0; success && i < entries.size(); i++) {
+        success = fseek(file, entries[i].offset, SEEK_SET) == 0 &&
+                  fwrite(mCachedWeights[i]->get_data_handle(), 1, entries[i].size, file) ==
+                      entries[i].size;
+    }
+    success = fclose(file) == 0 && success;
+    if (!success || rename(temp.c_str(), mWeightCachePath.c_str()) != 0) {
+        ALOGE("failed to write weight cache %s: %s", mWeightCachePath.c_str(), strerror(errno));
+        unlink(temp.c_str());
+        return;
+    }
+    ALOGI("%zu constants saved to %s", mCachedWeights.size(), mWeightCachePath.c_str());
+}
+
+//requantize asymmetric u8 weights to symmetric s8, one scale per output channel:
+//scale * (q - zero) ~= scales[c] * s8. Element k of channel c is at c * size + k,
+//or at k * channels + c when channels_last. sums[c] is the sum of the s8 weights.
+static void quantizeWeights(const uint8_t* src, size_t count, size_t channels,
+                            bool channels_last, float scale, int32_t zero,
+                            std::vector<int8_t>* dst, std::vector<float>* scales,
+                            std::vector<int32_t>* sums)
+{
+    size_t size = count / channels;
+    auto at = [=](size_t c, size_t k) { return channels_last ? k * channels + c : c * size + k; };
+    dst->resize(count);
+    scales->resize(channels);
+    sums->assign(channels, 0);
+    for (size_t c = 0; c < channels; c++) {
+        int32_t max = 0;
+        for (size_t k = 0; k < size; k++)
+            max = std::max(max, std::abs(src[at(c, k)] - zero));
+        float ratio = max > 0 ? max / 127.0f : 1.0f;
+        (*scales)[c] = scale * ratio;
+        for (size_t k = 0; k < size; k++) {
+            auto value = static_cast<int8_t>(std::lround((src[at(c, k)] - zero) / ratio));
+            (*dst)[at(c, k)] = value;
+            (*sums)[c] += value;
+        }
+    }
+}
+
+//s32 bias of every output channel in accumulator units, input_scale * weight_scales[c].
+//With u8 input q, (q - input_zero) * w = q * w - input_zero * sum(w), and the output
+//zero point is added before output_scales[c] maps accumulators to the output.
+static void compensateBias(const int32_t* bias, float bias_scale, float input_scale,
+                           int32_t input_zero, float output_scale, int32_t output_zero,
+                           const std::vector<float>& weight_scales,
+                           const std::vector<int32_t>& weight_sums,
+                           std::vector<int32_t>* dst, std::vector<float>* output_scales)
+{
+    size_t channels = weight_scales.size();
+    dst->resize(channels);
+    output_scales->resize(channels);
+    for (size_t c = 0; c < channels; c++) {
+        float unit = input_scale * weight_scales[c];
+        float value = bias[c] * bias_scale / unit - input_zero * weight_sums[c] +
+                      output_zero * output_scale / unit;
+        (*dst)[c] = static_cast<int32_t>(std::lround(value));
+        (*output_scales)[c] = unit / output_scale;
+    }
+}
+
+//int8 needs u8 data in and a quantized output, whose u8 range is the only
+//activation applied: RELU is only free when the output zero point is 0
+bool MklDnnPreparedModel::canRunInt8(const RunTimeOperandInfo& input, uint32_t outputIndex,
+                                     FusedActivationFunc activation)
+{
+    const RunTimeOperandInfo& output = mOperands[outputIndex];
+    return mInt8Enabled &&
+           input.type == memory::data_type::u8 && input.scale != 0 &&
+           output.type == memory::data_type::u8 && output.scale != 0 &&
+           (activation == FusedActivationFunc::NONE ||
+            (activation == FusedActivationFunc::RELU && output.zero == 0));
+}
+
+memory* MklDnnPreparedModel::createConstPmem(const memory::primitive_desc& pd, const void* data)
+{
+    auto pmem = new memory(pd);
+    memcpy(pmem->get_data_handle(), data, pd.get_size());
+    mConstPmems.push_back(pmem);
+    return pmem;
+}
+
+//u8 x s8 convolution with s32 bias and per output channel scales to u8, false
+//when the weights are not constant or mkldnn has no implementation
+bool MklDnnPreparedModel::importConvInt8(RunTimeOperandInfo* input, RunTimeOperandInfo* filter,
+                                         RunTimeOperandInfo* bias, RunTimeOperandInfo* output,
+                                         const memory::dims& strides,
+                                         const memory::dims& paddings_l,
+                                         const memory::dims& paddings_r, bool group)
+{
+    if (!isConstant(*filter) || !isConstant(*bias))
+        return false;
+
+    //filter shape is oihw, for depthwise {channels_out, 1, h, w} of layout ihwo
+    int32_t channels_out = filter->shape[0];
+    int32_t channels_in = input->shape[1];
+    int32_t filter_height = filter->shape[2];
+    int32_t filter_width = filter->shape[3];
+    size_t count = channels_out * filter->shape[1] * filter_height * filter_width;
+
+    std::vector<int8_t> weights;
+    std::vector<float> weight_scales;
+    std::vector<int32_t> weight_sums;
+    quantizeWeights(static_cast<const uint8_t*>(filter->buffer), count, channels_out, group,
+                    filter->scale, filter->zero, &weights, &weight_scales, &weight_sums);
+    std::vector<int32_t> biases;
+    std::vector<float> output_scales;
+    compensateBias(static_cast<const int32_t*>(bias->buffer), bias->scale, input->scale,
+                   input->zero, output->scale, output->zero, weight_scales, weight_sums,
+                   &biases, &output_scales);
+
+    memory* pmem_weights;
+    memory::dims shape_weights;
+    if (group) {
+        auto pmem_ihwo = createConstPmem({{filter->shape, memory::data_type::s8,
+                                           memory::format::ihwo}, *cpu_engine}, weights.data());
+        auto pmem_oihw = insertReorder(filter, pmem_ihwo, memory::format::oihw,
+                                       memory::data_type::s8, true, 0);
+        mConstPmems.push_back(pmem_oihw);
+        shape_weights = {channels_in, channels_out / channels_in, 1, filter_height, filter_width};
+        pmem_weights = new memory({{shape_weights, memory::data_type::s8, memory::format::goihw},
+                                   *cpu_engine}, pmem_oihw->get_data_handle());
+        mConstPmems.push_back(pmem_weights);
+    } else {
+        shape_weights = filter->shape;
+        pmem_weights = createConstPmem({{shape_weights, memory::data_type::s8,
+                                         memory::format::nhwc}, *cpu_engine}, weights.data());
+    }
+    auto pmem_conv_bias = createConstPmem({{{channels_out}, memory::data_type::s32,
+                                            memory::format::x}, *cpu_engine}, biases.data());
+
+    auto desc_conv = mkldnn::convolution_forward::desc(mkldnn::prop_kind::forward,
+            mkldnn::convolution_direct,
+            {input->shape, memory::data_type::u8, memory::format::any},
+            {shape_weights, memory::data_type::s8, memory::format::any},
+            pmem_conv_bias->get_primitive_desc().desc(),
+            {output->shape, memory::data_type::u8, memory::format::any},
+            strides, paddings_l, paddings_r, mkldnn::padding_kind::zero);
+    mkldnn::primitive_attr attr;
+    attr.set_output_scales(1 << 1, output_scales);
+    attr.set_int_output_round_mode(mkldnn::round_nearest);
+    std::shared_ptr<mkldnn::convolution_forward::primitive_desc> pd_conv;
+    try {
+        pd_conv = std::make_shared<mkldnn::convolution_forward::primitive_desc>(desc_conv, attr,
+                                                                               *cpu_engine);
+    } catch (const mkldnn::error& e) {
+        VLOG(L1, "int8 conv not supported: %s", e.message.c_str());
+        return false;
+    }
+    auto primitive_desc_conv = *pd_conv;
+
+    auto pmem_conv_input = insertReorderIfNeed(input,
+                                               primitive_desc_conv.src_primitive_desc().desc());
+    auto pmem_conv_filter = insertReorder(filter, pmem_weights,
+                                          primitive_desc_conv.weights_primitive_desc().desc(),
+                                          true, 0);
+    if (pmem_conv_filter != pmem_weights)
+        mConstPmems.push_back(pmem_conv_filter);
+
+    output->pmem = createPmem(output, primitive_desc_conv.dst_primitive_desc());
+    auto pmem_conv_output = output->pmem;
+    addPrimitive([=](const PmemMap& m) -> primitive {
+        return mkldnn::convolution_forward(primitive_desc_conv, m(pmem_conv_input),
+                                           m(pmem_conv_filter), m(pmem_conv_bias),
+                                           m(pmem_conv_output));
+    });
+    VLOG(L2, "conv in int8, output pmem %p", pmem_conv_output);
+    return true;
+}
+
+//conv primitive_desc with post-ops, null when no implementation supports them
+static std::shared_ptr<mkldnn::convolution_forward::primitive_desc> createConvPd(
+        const mkldnn::convolution_forward::desc& desc, const engine& cpu_engine, bool sum,
+        FusedActivationFunc activation)
+{
+    mkldnn::post_ops ops;
+    if (sum)
+        ops.append_sum(1.0f);
+    appendActivation(&ops, activation);
+    mkldnn::primitive_attr attr;
+    attr.set_post_ops(ops);
+    try {
+        return std::make_shared<mkldnn::convolution_forward::primitive_desc>(desc, attr,
+                                                                             cpu_engine);
+    } catch (const mkldnn::error& e) {
+        VLOG(L1, "conv post-ops sum %d, activation %d not supported: %s", sum, activation,
+                 e.message.c_str());
+        return nullptr;
+    }
+}
+
 bool MklDnnPreparedModel::importOperationConv2D(const Operation& operation)
 {
     const hidl_vec<uint32_t>& ins = operation.inputs;
@@ -682,6 +1731,17 @@ bool MklDnnPreparedModel::importOperationConv2D(const Operation& operation)
     //get output shape, mkldnn define shape as nchw
     output.shape = {batches, filter_out, output_height, output_width};
 
+    //mkldnn pads u8 data with 0, not with the input zero point
+    bool zero_padding = padding_left == 0 && padding_right == 0 &&
+                        padding_top == 0 && padding_bottom == 0;
+    if (canRunInt8(input, outs[0], activation) && (input.zero == 0 || zero_padding) &&
+        importConvInt8(&input, &filter, &bias, &output, {stride_height, stride_width},
+                       {padding_top, padding_left}, {padding_bottom, padding_right}, group)) {
+        mInt8Operations++;
+        finalizeOutput(&output, memory::format::nhwc);
+        return true;
+    }
+
     auto type_conv_input = getOperandNeedType(input);
     auto type_conv_filter = getOperandNeedType(filter);
     auto type_conv_bias = getOperandNeedType(bias);
@@ -726,8 +1786,26 @@ bool MklDnnPreparedModel::importOperationConv2D(const Operation& operation)
     auto desc_conv = mkldnn::convolution_forward::desc(mkldnn::prop_kind::forward,
             mkldnn::convolution_direct, md_conv_input, md_conv_filter, md_conv_bias,
             md_conv_output, strides, paddings_l, paddings_r, mkldnn::padding_kind::zero);
-    auto primitive_desc_conv =
-            mkldnn::convolution_forward::primitive_desc(desc_conv, *cpu_engine);
+
+    //fold the activation, or the ADD planned by planSumFusion() followed by its
+    //activation, into the conv as post-ops. Fall back to separate primitives.
+    auto fusion = mSumFusions.find(mCurrentOperation);
+    std::shared_ptr<mkldnn::convolution_forward::primitive_desc> pd_conv;
+    bool fused_sum = false;
+    bool fused_activation = false;
+    if (fusion != mSumFusions.end()) {
+        pd_conv = createConvPd(desc_conv, *cpu_engine, true, fusion->second.activation);
+        fused_sum = (pd_conv != nullptr);
+    }
+    if (pd_conv == nullptr && activation != FusedActivationFunc::NONE) {
+        pd_conv = createConvPd(desc_conv, *cpu_engine, false, activation);
+        fused_activation = (pd_conv != nullptr);
+    }
+    if (pd_conv == nullptr)
+        pd_conv = createConvPd(desc_conv, *cpu_engine, false, FusedActivationFunc::NONE);
+    if (pd_conv == nullptr)
+        return false;
+    auto primitive_desc_conv = *pd_conv;
 
 
     //reorder for input?
@@ -749,7 +1827,8 @@ bool MklDnnPreparedModel::importOperationConv2D(const Operation& operation)
             auto format_filter_group = memory::format::goihw;
             auto pmem_group_filter = getOperandPmemOfFormatType(filter, format_filter_group,
                                                             type_conv_filter);
-            pmem_conv_filter = insertReorder(pmem_group_filter, conv_filter_desc, true, filter.scale, filter.zero);
+            pmem_conv_filter = insertReorder(&filter, pmem_group_filter, conv_filter_desc, true,
+                                             filter.scale, filter.zero);
         }
     } else {
         pmem_conv_filter = insertReorderIfNeed(&filter, conv_filter_desc);
@@ -762,14 +1841,44 @@ bool MklDnnPreparedModel::importOperationConv2D(const Operation& operation)
         pmem_conv_bias = insertReorder(&bias, bias.pmem, conv_bias_desc, bias.scale);*/
     auto pmem_conv_bias = insertReorderIfNeed(&bias, conv_bias_desc);
 
-    output.pmem = new memory(primitive_desc_conv.dst_primitive_desc());
+    auto pd_conv_output = primitive_desc_conv.dst_primitive_desc();
+    memory* pmem_conv_output = nullptr;
+    if (fused_sum) {
+        //the sum post-op accumulates into dst: write over the addend when nothing
+        //else reads it any more, otherwise start from a copy of it
+        RunTimeOperandInfo& addend = mOperands[fusion->second.addend];
+        bool in_arena = std::any_of(mArenaBlocks.begin(), mArenaBlocks.end(),
+                                    [&addend](const ArenaBlock& b) {
+                                        return b.pmem == addend.pmem; });
+        if (fusion->second.inPlace && in_arena &&
+            addend.pmem->get_primitive_desc() == pd_conv_output) {
+            pmem_conv_output = addend.pmem;
+        } else {
+            pmem_conv_output = createPmem(&output, pd_conv_output);
+            auto pmem_addend = getOperandPmemOfDesc(addend, pd_conv_output.desc());
+            if (pmem_addend == nullptr)
+                pmem_addend = addend.pmem;
+            addPrimitive([=](const PmemMap& m) -> primitive {
+                return mkldnn::reorder(m(pmem_addend), m(pmem_conv_output));
+            });
+        }
+        const auto& add_output = mModel.operations[fusion->second.add].outputs[0];
+        extendArenaBlock(pmem_conv_output, std::max(fusion->second.add, mLastUse[add_output]));
+        mFusedAdds[fusion->second.add] = outs[0];
+        VLOG(L1, "ADD %u fused, conv output pmem %p", fusion->second.add, pmem_conv_output);
+    } else {
+        pmem_conv_output = createPmem(&output, pd_conv_output);
+    }
+    output.pmem = pmem_conv_output;
 
-    mNet.push_back(mkldnn::convolution_forward(primitive_desc_conv,
-                       *pmem_conv_input, *pmem_conv_filter, *pmem_conv_bias, *output.pmem));
+    addPrimitive([=](const PmemMap& m) -> primitive {
+        return mkldnn::convolution_forward(primitive_desc_conv, m(pmem_conv_input),
+                                           m(pmem_conv_filter), m(pmem_conv_bias),
+                                           m(pmem_conv_output));
+    });
 
-    //TODO: combine relu with conv, conv_relu does not provides src/dst/bias/weights_primitive_get
-    if (activation != FusedActivationFunc::NONE) {
-        output.pmem =  insertActivation(output.pmem, activation);
+    if (!fused_activation && activation != FusedActivationFunc::NONE) {
+        output.pmem =  insertActivation(&output, output.pmem, activation);
     }
     //pass the format that NN think this opertion output format.
     finalizeOutput(&output, memory::format::nhwc);
@@ -851,15 +1960,30 @@ bool MklDnnPreparedModel::importOperationPool(const Operation& operation)
     //get output shape, mkldnn define shape as nchw
     output.shape = {batches, channels, output_height, output_width};
 
+    //max and average commute with the affine u8 quantization shared by input and output
+    bool int8 = canRunInt8(input, outs[0], activation) &&
+                input.scale == output.scale && input.zero == output.zero;
+    if (int8) {
+        VLOG(L2, "pooling in int8");
+        mInt8Operations++;
+    }
+
     //pooling acccept only nchw
-    auto type_pool_input = getOperandNeedType(input);
+    auto type_pool_input = int8 ? memory::data_type::u8 : getOperandNeedType(input);
     /*auto pmem_pool_input = getOperandPmemOfFormatType(input, memory::format::nchw,
                                                       type_pool_input);
     if (pmem_pool_input == nullptr) {
         pmem_pool_input = insertReorder(&input, input.pmem, memory::format::nchw,
                                         type_pool_input, input.scale);
     }*/
-    auto pmem_pool_input = insertReorderIfNeed(&input, memory::format::nchw, type_pool_input);
+    //keep the blocked layout of the producer
+    auto format_pool = getBlockedFormat(input.pmem);
+    if (format_pool != memory::format::format_undef && !int8) {
+        mReordersAvoided++;
+    } else {
+        format_pool = int8 ? memory::format::nhwc : memory::format::nchw;
+    }
+    auto pmem_pool_input = insertReorderIfNeed(&input, format_pool, type_pool_input);
 
     //output has same type as input
     auto md_pool_output = memory::desc(output.shape, type_pool_input, memory::format::any);
@@ -879,13 +2003,17 @@ bool MklDnnPreparedModel::importOperationPool(const Operation& operation)
     auto primitive_desc_pool =
                 mkldnn::pooling_forward::primitive_desc(desc_pool, *cpu_engine);
 
-    output.pmem = new memory(primitive_desc_pool.dst_primitive_desc());
+    output.pmem = createPmem(&output, primitive_desc_pool.dst_primitive_desc());
     /* create pooling primitive an add it to net */
-    mNet.push_back(mkldnn::pooling_forward(primitive_desc_pool, *pmem_pool_input,
-                     *output.pmem));
+    auto pmem_pool_output = output.pmem;
+    addPrimitive([=](const PmemMap& m) -> primitive {
+        return mkldnn::pooling_forward(primitive_desc_pool, m(pmem_pool_input),
+                                       m(pmem_pool_output));
+    });
 
-    if (activation != FusedActivationFunc::NONE) {
-        output.pmem = insertActivation(output.pmem, activation);
+    //in int8 the u8 range already is the activation
+    if (!int8 && activation != FusedActivationFunc::NONE) {
+        output.pmem = insertActivation(&output, output.pmem, activation);
     }
 
     finalizeOutput(&output, memory::format::nhwc);
@@ -940,8 +2068,8 @@ bool MklDnnPreparedModel::importOperationActivation(const Operation& operation)
 
     //get output shape, mkldnn define shape as nchw
     //output has same type as input
-    output.pmem = new memory({{output.shape, type_activation_input, input.format},
-                                      *cpu_engine});
+    output.pmem = createPmem(&output, {{output.shape, type_activation_input, input.format},
+                                       *cpu_engine});
 
     /* create relu primitive and add it to net */
     auto desc_activation = mkldnn::eltwise_forward::desc(mkldnn::prop_kind::forward,
@@ -949,8 +2077,11 @@ bool MklDnnPreparedModel::importOperationActivation(const Operation& operation)
     auto primitive_desc_activation = mkldnn::eltwise_forward::primitive_desc(desc_activation,
                         *cpu_engine);
 
-    mNet.push_back(mkldnn::eltwise_forward(primitive_desc_activation, *pmem_activation_input,
-                        *output.pmem));
+    auto pmem_activation_output = output.pmem;
+    addPrimitive([=](const PmemMap& m) -> primitive {
+        return mkldnn::eltwise_forward(primitive_desc_activation, m(pmem_activation_input),
+                                       m(pmem_activation_output));
+    });
 
     //output format same as input, and do not need reorder.
     finalizeOutput(&output, input.format);
@@ -990,8 +2121,8 @@ bool MklDnnPreparedModel::importOperationConcat(const Operation& operation)
             break;
         case 4:
             format_concat = memory::format::nchw;
-            format_input = memory::format::nchw;
-            format_output = memory::format::nchw;
+            format_input = memory::format::nhwc;
+            format_output = memory::format::nhwc;
             shape_output = {0, 0, 0, 0};
             axis = (axis == 0) ? 0 : (axis % 3) + 1;
             break;
@@ -999,13 +2130,46 @@ bool MklDnnPreparedModel::importOperationConcat(const Operation& operation)
             ALOGE("unsupported dims size %d", dims_size);
             return false;
     }
+    for (uint32_t i = 0; i < in_counts - 1; i++) {
+        initializeInput(&mOperands[ins[i]], format_input);
+    }
+
+    //concatenation of u8 inputs sharing the quantization of the output stays in int8
+    const RunTimeOperandInfo& output_concat = mOperands[outs[0]];
+    bool int8 = mInt8Enabled && output_concat.type == memory::data_type::u8 &&
+                output_concat.scale != 0;
+    for (uint32_t i = 0; i < in_counts - 1 && int8; i++) {
+        const RunTimeOperandInfo& input = mOperands[ins[i]];
+        int8 = input.type == memory::data_type::u8 && input.scale == output_concat.scale &&
+               input.zero == output_concat.zero;
+    }
+    if (int8) {
+        VLOG(L2, "concat in int8");
+        mInt8Operations++;
+    }
+    auto type_concat_input = int8 ? memory::data_type::u8 : getOperandNeedType(input0);
+
+    //concatenate in the blocked layout all inputs share, whole blocks along channels
+    if (dims_size == 4) {
+        auto format_blocked = getBlockedFormat(input0.pmem);
+        for (uint32_t i = 0; i < in_counts - 1; i++) {
+            const RunTimeOperandInfo& input = mOperands[ins[i]];
+            if (getBlockedFormat(input.pmem) != format_blocked || int8 ||
+                (axis == 1 && input.shape[1] % getBlockSize(format_blocked) != 0))
+                format_blocked = memory::format::format_undef;
+        }
+        if (format_blocked != memory::format::format_undef) {
+            format_concat = format_blocked;
+            mReordersAvoided += in_counts - 1;
+        } else if (int8) {
+            format_concat = memory::format::nhwc;
+        }
+    }
 
-    auto type_concat_input = getOperandNeedType(input0);
     std::vector<memory::primitive_desc> primitive_desc_inputs;
-    std::vector<primitive::at> primitive_inputs;
+    std::vector<memory*> pmem_inputs;
     for (uint32_t i = 0; i < in_counts - 1; i++) {
         RunTimeOperandInfo& input = mOperands[ins[i]];
-        initializeInput(&input, format_input);
 
         //based on nchw
         /*auto pmem_input = getOperandPmemOfFormatType(input, format_concat, type_concat_input);
@@ -1013,7 +2177,7 @@ bool MklDnnPreparedModel::importOperationConcat(const Operation& operation)
             pmem_input = insertReorder(&input, input.pmem, format_concat, type_concat_input, input.scale);
         }*/
         auto pmem_input = insertReorderIfNeed(&input, format_concat, type_concat_input);
-        primitive_inputs.push_back(*pmem_input);
+        pmem_inputs.push_back(pmem_input);
         primitive_desc_inputs.push_back(pmem_input->get_primitive_desc());
 
         //axis is already nchw, then use input.shape
@@ -1037,9 +2201,15 @@ bool MklDnnPreparedModel::importOperationConcat(const Operation& operation)
     auto primitive_desc_concat = mkldnn::concat::primitive_desc(desc_output,
                                           static_cast<int>(axis),
                                           primitive_desc_inputs);
-    output.pmem = new memory(primitive_desc_concat.dst_primitive_desc());
+    output.pmem = createPmem(&output, primitive_desc_concat.dst_primitive_desc());
 
-    mNet.push_back(mkldnn::concat(primitive_desc_concat, primitive_inputs, *output.pmem));
+    auto pmem_concat_output = output.pmem;
+    addPrimitive([=](const PmemMap& m) -> primitive {
+        std::vector<primitive::at> primitive_inputs;
+        for (auto pmem : pmem_inputs)
+            primitive_inputs.push_back(m(pmem));
+        return mkldnn::concat(primitive_desc_concat, primitive_inputs, m(pmem_concat_output));
+    });
 
     finalizeOutput(&output, format_output);
     return true;
@@ -1093,13 +2263,16 @@ bool MklDnnPreparedModel::importOperationSoftmax(const Operation& operation)
 
     RunTimeOperandInfo& output = mOperands[outs[0]];
     output.shape = input.shape;
-    output.pmem = new memory({{output.shape, type_softmax_input, format_output}, *cpu_engine});
+    output.pmem = createPmem(&output, {{output.shape, type_softmax_input, format_output}, *cpu_engine});
 
     auto desc_softmax = mkldnn::softmax_forward::desc(mkldnn::prop_kind::forward_inference,
                                   pmem_softmax_input->get_primitive_desc().desc(), dims_size - 1);
     auto primitive_desc_softmax = mkldnn::softmax_forward::primitive_desc(desc_softmax, *cpu_engine);
-    mNet.push_back(mkldnn::softmax_forward(primitive_desc_softmax,
-                                  *pmem_softmax_input, *output.pmem));
+    auto pmem_softmax_output = output.pmem;
+    addPrimitive([=](const PmemMap& m) -> primitive {
+        return mkldnn::softmax_forward(primitive_desc_softmax, m(pmem_softmax_input),
+                                       m(pmem_softmax_output));
+    });
 
     finalizeOutput(&output, format_output);
     return true;
@@ -1117,9 +2290,14 @@ bool MklDnnPreparedModel::importOperationLRN(const Operation& operation)
 
     RunTimeOperandInfo& input = mOperands[ins[0]];
     initializeInput(&input, memory::format::nhwc);
-    //mkldnn accept nchw;
-    auto format_lrn = memory::format::nchw;
-    auto format_output = memory::format::nchw;
+    //mkldnn accept nchw, or the blocked layout of the producer
+    auto format_lrn = getBlockedFormat(input.pmem);
+    if (format_lrn != memory::format::format_undef) {
+        mReordersAvoided++;
+    } else {
+        format_lrn = memory::format::nchw;
+    }
+    auto format_output = format_lrn;
     auto type_lrn_input = getOperandNeedType(input);
     /*auto pmem_lrn_input = getOperandPmemOfFormatType(input, softmax_format);
     if (pmem_lrn_input == nullptr) {
@@ -1134,7 +2312,7 @@ bool MklDnnPreparedModel::importOperationLRN(const Operation& operation)
 
     RunTimeOperandInfo& output = mOperands[outs[0]];
     output.shape = input.shape;
-    output.pmem = new memory({{output.shape, type_lrn_input, format_output}, *cpu_engine});
+    output.pmem = createPmem(&output, {{output.shape, type_lrn_input, format_output}, *cpu_engine});
 
     //NN pass the depth as (d - depth, d + depth)
     radius = radius * 2 + 1;
@@ -1146,7 +2324,10 @@ bool MklDnnPreparedModel::importOperationLRN(const Operation& operation)
                                               pmem_lrn_input->get_primitive_desc().desc(),
                                               radius, alpha, beta, bias);
     auto primitive_desc_lrn = mkldnn::lrn_forward::primitive_desc(desc_lrn, *cpu_engine);
-    mNet.push_back(mkldnn::lrn_forward(primitive_desc_lrn, *pmem_lrn_input, *output.pmem));
+    auto pmem_lrn_output = output.pmem;
+    addPrimitive([=](const PmemMap& m) -> primitive {
+        return mkldnn::lrn_forward(primitive_desc_lrn, m(pmem_lrn_input), m(pmem_lrn_output));
+    });
 
     finalizeOutput(&output, memory::format::nhwc);
     return true;
@@ -1194,6 +2375,11 @@ bool MklDnnPreparedModel::importOperationFC(const Operation& operation)
         memory::dims shape;
         //for nc
         shape.resize(2);
+        if (type_src != type) {
+            //(de)quantize in the source layout, the result may still be shrunk
+            src_pmem = insertReorderIfNeed(operand, format_src, type);
+            type_src = type;
+        }
         if (format_src == format && type_src == type) {
             return src_pmem;
         } else if (format_src != format && type_src == type) {
@@ -1211,22 +2397,87 @@ bool MklDnnPreparedModel::importOperationFC(const Operation& operation)
             can_shrink = false;
         }
         if (can_shrink) {
-            void *buf = src_pmem->get_data_handle();
-            pmem_fc = new memory({{shape, type, format}, *cpu_engine}, buf);
+            pmem_fc = createPmemView({{shape, type, format}, *cpu_engine}, src_pmem);
         } else {
             pmem_fc = insertReorderIfNeed(operand, format, type);
         }
         return pmem_fc;
     };
 
+    RunTimeOperandInfo& output = mOperands[outs[0]];
+
+    //inner product of mkldnn v0.14 takes no output scales, accumulate to s32 and
+    //requantize per output channel with a reorder
+    if (canRunInt8(input, outs[0], activation) && isConstant(weights) && isConstant(bias)) {
+        int32_t units = weights.shape[0];
+        std::vector<int8_t> weights_s8;
+        std::vector<float> weight_scales;
+        std::vector<int32_t> weight_sums;
+        quantizeWeights(static_cast<const uint8_t*>(weights.buffer), units * weights.shape[1],
+                        units, false, weights.scale, weights.zero,
+                        &weights_s8, &weight_scales, &weight_sums);
+        std::vector<int32_t> bias_s32;
+        std::vector<float> output_scales;
+        compensateBias(static_cast<const int32_t*>(bias.buffer), bias.scale, input.scale,
+                       input.zero, output.scale, output.zero, weight_scales, weight_sums,
+                       &bias_s32, &output_scales);
+
+        memory::dims shape_output = {input.shape[0], units};
+        auto desc_fc = mkldnn::inner_product_forward::desc(mkldnn::prop_kind::forward,
+                {{input.shape[0], input.shape[1]}, memory::data_type::u8, memory::format::nc},
+                {weights.shape, memory::data_type::s8, memory::format::nc},
+                {{units}, memory::data_type::s32, memory::format::x},
+                {shape_output, memory::data_type::s32, memory::format::nc});
+        std::shared_ptr<mkldnn::inner_product_forward::primitive_desc> pd_fc;
+        try {
+            pd_fc = std::make_shared<mkldnn::inner_product_forward::primitive_desc>(desc_fc,
+                                                                                  *cpu_engine);
+        } catch (const mkldnn::error& e) {
+            VLOG(L1, "int8 inner product not supported: %s", e.message.c_str());
+        }
+        if (pd_fc) {
+            auto primitive_desc_fc = *pd_fc;
+            auto pmem_fc_input = getCompatiblePmem(&input, memory::format::nc,
+                                                   memory::data_type::u8);
+            auto pmem_fc_weights = createConstPmem(
+                    {{weights.shape, memory::data_type::s8, memory::format::nc}, *cpu_engine},
+                    weights_s8.data());
+            auto pmem_fc_bias = createConstPmem(
+                    {{{units}, memory::data_type::s32, memory::format::x}, *cpu_engine},
+                    bias_s32.data());
+            auto pmem_fc_acc = createPmem(&output, primitive_desc_fc.dst_primitive_desc());
+            output.shape = shape_output;
+            output.pmem = createPmem(&output, {{shape_output, memory::data_type::u8,
+                                                memory::format::nc}, *cpu_engine});
+
+            mkldnn::primitive_attr attr;
+            attr.set_output_scales(1 << 1, output_scales);
+            attr.set_int_output_round_mode(mkldnn::round_nearest);
+            auto pd_requantize = mkldnn::reorder::primitive_desc(
+                    pmem_fc_acc->get_primitive_desc(), output.pmem->get_primitive_desc(), attr);
+            auto pmem_fc_output = output.pmem;
+            addPrimitive([=](const PmemMap& m) -> primitive {
+                return mkldnn::inner_product_forward(primitive_desc_fc, m(pmem_fc_input),
+                                                     m(pmem_fc_weights), m(pmem_fc_bias),
+                                                     m(pmem_fc_acc));
+            });
+            addPrimitive([=](const PmemMap& m) -> primitive {
+                return mkldnn::reorder(pd_requantize, m(pmem_fc_acc), m(pmem_fc_output));
+            });
+            mInt8Operations++;
+
+            finalizeOutput(&output, memory::format::nc);
+            return true;
+        }
+    }
+
     auto pmem_fc_input = getCompatiblePmem(&input, memory::format::nc, type_fc_input);
     auto pmem_fc_weights = getCompatiblePmem(&weights, memory::format::nc, type_fc_weights);
     auto pmem_fc_bias = getCompatiblePmem(&bias, memory::format::x, type_fc_bias);
 
-    RunTimeOperandInfo& output = mOperands[outs[0]];
     output.shape = {input.shape[0], weights.shape[0]};
     //output has same type as input
-    output.pmem = new memory({{output.shape, type_fc_input, memory::format::nc}, *cpu_engine});
+    output.pmem = createPmem(&output, {{output.shape, type_fc_input, memory::format::nc}, *cpu_engine});
 
     auto desc_fc = mkldnn::inner_product_forward::desc(mkldnn::prop_kind::forward,
                                pmem_fc_input->get_primitive_desc().desc(),
@@ -1234,11 +2485,16 @@ bool MklDnnPreparedModel::importOperationFC(const Operation& operation)
                                pmem_fc_bias->get_primitive_desc().desc(),
                                output.pmem->get_primitive_desc().desc());
     auto primitive_desc_fc = mkldnn::inner_product_forward::primitive_desc(desc_fc, *cpu_engine);
-    mNet.push_back(mkldnn::inner_product_forward(primitive_desc_fc, *pmem_fc_input,
-                                                       *pmem_fc_weights, *pmem_fc_bias, *output.pmem));
+    //inner product of mkldnn v0.14 takes no post-ops, the activation runs after it
+    auto pmem_fc_output = output.pmem;
+    addPrimitive([=](const PmemMap& m) -> primitive {
+        return mkldnn::inner_product_forward(primitive_desc_fc, m(pmem_fc_input),
+                                             m(pmem_fc_weights), m(pmem_fc_bias),
+                                             m(pmem_fc_output));
+    });
 
     if (activation != FusedActivationFunc::NONE) {
-        output.pmem = insertActivation(output.pmem, activation);
+        output.pmem = insertActivation(&output, output.pmem, activation);
     }
 
     finalizeOutput(&output, memory::format::nc);
@@ -1259,47 +2515,113 @@ bool MklDnnPreparedModel::importOperationAdd(const Operation& operation)
     RunTimeOperandInfo& input0 = mOperands[ins[0]];
     memory::format format_input;
 
+    auto fused = mFusedAdds.find(mCurrentOperation);
+    if (fused != mFusedAdds.end()) {
+        //the conv producing one input already added the other one and activated
+        RunTimeOperandInfo& output = mOperands[outs[0]];
+        const RunTimeOperandInfo& conv_output = mOperands[fused->second];
+        VLOG(L2, "ADD fused into conv, output pmem %p", conv_output.pmem);
+        output.pmem = conv_output.pmem;
+        output.shape = conv_output.shape;
+        finalizeOutput(&output, memory::format::nhwc);
+        return true;
+    }
+
     //TODO: workaround 3-D
     int dims_size = input0.dims.size();
+    memory::format format_add;
     switch(dims_size) {
         case 2:
             format_input = memory::format::nc;
+            format_add = memory::format::nc;
             break;
         case 4:
-            format_input = memory::format::nchw;
+            format_input = memory::format::nhwc;
+            format_add = memory::format::nchw;
             break;
         case 1:
             format_input = memory::format::x;
+            format_add = memory::format::x;
             break;
         default:
             ALOGE("unsupported dims size %d", dims_size);
             return false;
     }
+    for (uint32_t i = 0; i < in_counts - 1; i++) {
+        initializeInput(&mOperands[ins[i]], format_input);
+    }
 
     std::vector<float> scales = {1, 1, 1, 1};
 
     std::vector<mkldnn::memory::primitive_desc> md_inputs;
-    std::vector<primitive::at> inputs;
-    for (uint32_t i = 0; i < in_counts - 1; i++) {
-        RunTimeOperandInfo& input = mOperands[ins[i]];
-        initializeInput(&input, format_input);
-        auto type_input = getOperandNeedType(input);
-        auto pmem_input = insertReorderIfNeed(&input, format_input, type_input);
-        md_inputs.push_back(pmem_input->get_primitive_desc());
-        inputs.push_back(*pmem_input);
-    }
-
-    auto pd_add = mkldnn::sum::primitive_desc(scales, md_inputs);
+    std::vector<memory*> pmem_inputs;
+    auto importInputs = [&](bool int8) {
+        md_inputs.clear();
+        pmem_inputs.clear();
+        for (uint32_t i = 0; i < in_counts - 1; i++) {
+            RunTimeOperandInfo& input = mOperands[ins[i]];
+            auto type_input = int8 ? memory::data_type::u8 : getOperandNeedType(input);
+            auto pmem_input = insertReorderIfNeed(&input, format_add, type_input);
+            md_inputs.push_back(pmem_input->get_primitive_desc());
+            pmem_inputs.push_back(pmem_input);
+        }
+    };
 
+    //without zero points the quantized sum is q0 * s0 / s + q1 * s1 / s
     RunTimeOperandInfo& output = mOperands[outs[0]];
-    output.pmem = new memory(pd_add.dst_primitive_desc());
+    const RunTimeOperandInfo& input1 = mOperands[ins[1]];
+    bool int8 = canRunInt8(input0, outs[0], activation) &&
+                input1.type == memory::data_type::u8 && input1.scale != 0 &&
+                input0.zero == 0 && input1.zero == 0 && output.zero == 0;
+
+    //add in the blocked layout of a producer, the other input is reordered to it
+    if (dims_size == 4) {
+        auto format_blocked = getBlockedFormat(input0.pmem);
+        if (format_blocked == memory::format::format_undef)
+            format_blocked = getBlockedFormat(input1.pmem);
+        if (format_blocked != memory::format::format_undef && !int8) {
+            format_add = format_blocked;
+            for (uint32_t i = 0; i < in_counts - 1; i++) {
+                if (getBlockedFormat(mOperands[ins[i]].pmem) == format_blocked)
+                    mReordersAvoided++;
+            }
+        } else if (int8) {
+            format_add = memory::format::nhwc;
+        }
+    }
+    std::shared_ptr<mkldnn::sum::primitive_desc> pd_sum;
+    if (int8) {
+        importInputs(true);
+        try {
+            pd_sum = std::make_shared<mkldnn::sum::primitive_desc>(
+                    std::vector<float>{input0.scale / output.scale, input1.scale / output.scale},
+                    md_inputs);
+            mInt8Operations++;
+        } catch (const mkldnn::error& e) {
+            VLOG(L1, "int8 sum not supported: %s", e.message.c_str());
+            int8 = false;
+        }
+    }
+    if (!int8) {
+        importInputs(false);
+        pd_sum = std::make_shared<mkldnn::sum::primitive_desc>(scales, md_inputs);
+    }
+    auto pd_add = *pd_sum;
+
+    output.pmem = createPmem(&output, pd_add.dst_primitive_desc());
     //output shape same as input
     output.shape = input0.shape;
 
-    mNet.push_back(mkldnn::sum(pd_add, inputs, *output.pmem));
+    auto pmem_add_output = output.pmem;
+    addPrimitive([=](const PmemMap& m) -> primitive {
+        std::vector<primitive::at> inputs;
+        for (auto pmem : pmem_inputs)
+            inputs.push_back(m(pmem));
+        return mkldnn::sum(pd_add, inputs, m(pmem_add_output));
+    });
 
-    if (activation != FusedActivationFunc::NONE) {
-        output.pmem = insertActivation(output.pmem, activation);
+    if (!int8 && activation != FusedActivationFunc::NONE) {
+        output.pmem = insertActivation(&output, output.pmem, activation);
     }
 
     finalizeOutput(&output, format_input);
@@ -1307,6 +2629,179 @@ bool MklDnnPreparedModel::importOperationAdd(const Operation& operation)
     return true;
 }
 
+//the output is a view of the input in the plain layout, which holds the
+//elements in NNAPI order; model outputs get their own copy
+bool MklDnnPreparedModel::importOperationReshape(const Operation& operation)
+{
+    const hidl_vec<uint32_t>& ins = operation.inputs;
+    const hidl_vec<uint32_t>& outs = operation.outputs;
+    const size_t in_counts = ins.size();
+
+    VLOG(L1, "import RESHAPE has inputs %zu", in_counts);
+
+    nnAssert(in_counts == 2);
+
+    RunTimeOperandInfo& input = mOperands[ins[0]];
+    RunTimeOperandInfo& output = mOperands[outs[0]];
+    auto format_input = getPlainFormat(input.dims.size());
+    auto format_output = getPlainFormat(output.dims.size());
+    if (format_input == memory::format::format_undef ||
+        format_output == memory::format::format_undef) {
+        ALOGE("unsupported reshape from %zu-D to %zu-D", input.dims.size(), output.dims.size());
+        return false;
+    }
+
+    initializeInput(&input, format_input);
+    auto type = static_cast<memory::data_type>(
+            input.pmem->get_primitive_desc().desc().data.data_type);
+    auto pmem_input = insertReorderIfNeed(&input, format_input, type);
+
+    nnAssert(dimsToShape(output.dims, format_output, &output.shape));
+    auto pd_output = memory::primitive_desc({output.shape, type, format_output}, *cpu_engine);
+    nnAssert(pd_output.get_size() == pmem_input->get_primitive_desc().get_size());
+
+    auto pmem_view = createPmemView(pd_output, pmem_input);
+    if (output.lifetime == OperandLifeTime::MODEL_OUTPUT) {
+        output.pmem = createPmem(&output, pd_output);
+        auto pmem_reshape_output = output.pmem;
+        addPrimitive([=](const PmemMap& m) -> primitive {
+            return mkldnn::reorder(m(pmem_view), m(pmem_reshape_output));
+        });
+    } else {
+        output.pmem = pmem_view;
+        extendArenaBlock(pmem_view, std::max(mCurrentOperation, mLastUse[outs[0]]));
+    }
+
+    finalizeOutput(&output, format_output);
+    return true;
+}
+
+//mkldnn v0.14 has no l2 normalization, it is an LRN whose window spans all
+//channels: x / (k + alpha / n * sum(x^2))^beta with alpha = n and beta = 0.5
+bool MklDnnPreparedModel::importOperationL2Normalization(const Operation& operation)
+{
+    const hidl_vec<uint32_t>& ins = operation.inputs;
+    const hidl_vec<uint32_t>& outs = operation.outputs;
+    const size_t in_counts = ins.size();
+
+    VLOG(L1, "import L2_NORMALIZATION has inputs %zu", in_counts);
+
+    nnAssert(in_counts == 1);
+
+    RunTimeOperandInfo& input = mOperands[ins[0]];
+    initializeInput(&input, memory::format::nhwc);
+
+    auto format_l2 = getBlockedFormat(input.pmem);
+    if (format_l2 == memory::format::format_undef)
+        format_l2 = memory::format::nchw;
+    auto type_l2_input = getOperandNeedType(input);
+    auto pmem_l2_input = insertReorderIfNeed(&input, format_l2, type_l2_input);
+
+    RunTimeOperandInfo& output = mOperands[outs[0]];
+    output.shape = input.shape;
+    output.pmem = createPmem(&output, {{output.shape, type_l2_input, format_l2}, *cpu_engine});
+
+    //k only keeps an all zero vector from dividing by zero
+    int32_t size = 2 * input.shape[1] - 1;
+    auto desc_l2 = mkldnn::lrn_forward::desc(mkldnn::prop_kind::forward_scoring,
+                                             mkldnn::algorithm::lrn_across_channels,
+                                             pmem_l2_input->get_primitive_desc().desc(),
+                                             size, static_cast<float>(size), 0.5f, 1e-12f);
+    auto primitive_desc_l2 = mkldnn::lrn_forward::primitive_desc(desc_l2, *cpu_engine);
+    auto pmem_l2_output = output.pmem;
+    addPrimitive([=](const PmemMap& m) -> primitive {
+        return mkldnn::lrn_forward(primitive_desc_l2, m(pmem_l2_input), m(pmem_l2_output));
+    });
+
+    finalizeOutput(&output, memory::format::nhwc);
+    return true;
+}
+
+//one input must be constant: a scalar becomes eltwise linear, a per channel
+//vector a batch normalization with scale, zero mean and unit variance
+bool MklDnnPreparedModel::importOperationMul(const Operation& operation)
+{
+    const hidl_vec<uint32_t>& ins = operation.inputs;
+    const hidl_vec<uint32_t>& outs = operation.outputs;
+    const size_t in_counts = ins.size();
+
+    VLOG(L1, "import MUL has inputs %zu", in_counts);
+
+    nnAssert(in_counts == 3);
+
+    auto activation = getScalarData<FusedActivationFunc>(mOperands[ins[2]]);
+    RunTimeOperandInfo* input = &mOperands[ins[0]];
+    RunTimeOperandInfo* factor = &mOperands[ins[1]];
+    if (isConstant(*input))
+        std::swap(input, factor);
+    if (!isConstant(*factor)) {
+        ALOGE("MUL needs a constant input");
+        return false;
+    }
+
+    size_t count = 1;
+    for (auto d : factor->dims)
+        count *= d;
+    std::vector<float> factors(count);
+    for (size_t i = 0; i < count; i++) {
+        if (factor->type == memory::data_type::u8) {
+            auto q = static_cast<const uint8_t*>(factor->buffer)[i];
+            factors[i] = factor->scale * (q - factor->zero);
+        } else {
+            factors[i] = static_cast<const float*>(factor->buffer)[i];
+        }
+    }
+
+    auto format_output = getPlainFormat(input->dims.size());
+    initializeInput(input, format_output);
+    auto type_mul_input = getOperandNeedType(*input);
+    RunTimeOperandInfo& output = mOperands[outs[0]];
+    output.shape = input->shape;
+
+    if (count == 1) {
+        auto pmem_mul_input = insertReorderIfNeed(input, input->format, type_mul_input);
+        output.pmem = createPmem(&output, pmem_mul_input->get_primitive_desc());
+        insertLinear(pmem_mul_input, output.pmem, factors[0], 0, false);
+    } else {
+        nnAssert(input->shape.size() == 4 && input->shape[1] == static_cast<int32_t>(count));
+        auto format_mul = getBlockedFormat(input->pmem);
+        if (format_mul == memory::format::format_undef)
+            format_mul = memory::format::nchw;
+        auto pmem_mul_input = insertReorderIfNeed(input, format_mul, type_mul_input);
+
+        auto desc_mul = mkldnn::batch_normalization_forward::desc(
+                mkldnn::prop_kind::forward_scoring, pmem_mul_input->get_primitive_desc().desc(),
+                0.0f, mkldnn::use_global_stats | mkldnn::use_scale_shift);
+        auto primitive_desc_mul = mkldnn::batch_normalization_forward::primitive_desc(desc_mul,
+                *cpu_engine);
+
+        std::vector<float> zeros(count, 0.0f);
+        std::vector<float> ones(count, 1.0f);
+        //scale_shift is {scale[C], shift[C]}
+        std::vector<float> scale_shift(factors);
+        scale_shift.insert(scale_shift.end(), zeros.begin(), zeros.end());
+        auto pmem_mean = createConstPmem(primitive_desc_mul.mean_primitive_desc(), zeros.data());
+        auto pmem_variance = createConstPmem(primitive_desc_mul.variance_primitive_desc(),
+                                             ones.data());
+        auto pmem_scale_shift = createConstPmem(primitive_desc_mul.weights_primitive_desc(),
+                                                scale_shift.data());
+
+        output.pmem = createPmem(&output, primitive_desc_mul.dst_primitive_desc());
+        auto pmem_mul_output = output.pmem;
+        addPrimitive([=](const PmemMap& m) -> primitive {
+            return mkldnn::batch_normalization_forward(primitive_desc_mul, m(pmem_mul_input),
+                    m(pmem_mean), m(pmem_variance), m(pmem_scale_shift), m(pmem_mul_output));
+        });
+    }
+
+    if (activation != FusedActivationFunc::NONE) {
+        output.pmem = insertActivation(&output, output.pmem, activation);
+    }
+
+    finalizeOutput(&output, format_output);
+    return true;
+}
+
 // TODO doublecheck
 bool MklDnnPreparedModel::validateRequest(const Request& request, const Model& model)
 {
@@ -1458,7 +2953,7 @@ bool MklDnnPreparedModel::initializeRunTimeOperandInfo() {
             to.dims[j] = from.dimensions[j];
         }
         to.scale = from.scale;
-        nnAssert(from.zeroPoint == 0);
+        to.zero = 0;
         switch(from.type) {
             case OperandType::TENSOR_FLOAT32:
             case OperandType::FLOAT32:
@@ -1475,6 +2970,7 @@ bool MklDnnPreparedModel::initializeRunTimeOperandInfo() {
             case OperandType::TENSOR_QUANT8_ASYMM:
                 nnAssert(to.scale != 0);
                 to.type = memory::data_type::u8;
+                to.zero = static_cast<uint8_t>(from.zeroPoint);
                 break;
             default:
                 ALOGE("wrong operand type %d", from.type);;
@@ -1546,7 +3042,20 @@ bool MklDnnPreparedModel::initialize()
         return false;
     }
 
-    for (const auto& operation : mModel.operations) {
+    computeOperandLiveness();
+    planSumFusion();
+
+    //"nn.hal.mkldnn.int8" set to 0 runs quantized models in f32, to compare both paths
+    char value[PROPERTY_VALUE_MAX];
+    mInt8Enabled = !(property_get("nn.hal.mkldnn.int8", value, "") > 0 && atoi(value) == 0);
+    mInt8Operations = 0;
+    mRuntimeReorders = 0;
+    mReordersAvoided = 0;
+    openWeightCache();
+
+    for (uint32_t i = 0; i < mModel.operations.size(); i++) {
+        const auto& operation = mModel.operations[i];
+        mCurrentOperation = i;
         VLOG(L1, "get operation %d ready to import", operation.type);
        switch (operation.type) {
             case OperationType::CONV_2D:
@@ -1578,6 +3087,15 @@ bool MklDnnPreparedModel::initialize()
             case OperationType::ADD:
                 success = importOperationAdd(operation);
                 break;
+            case OperationType::RESHAPE:
+                success = importOperationReshape(operation);
+                break;
+            case OperationType::L2_NORMALIZATION:
+                success = importOperationL2Normalization(operation);
+                break;
+            case OperationType::MUL:
+                success = importOperationMul(operation);
+                break;
             default:
                 ALOGE("unsupported operation %d", operation.type);
                 return false;
@@ -1589,21 +3107,88 @@ bool MklDnnPreparedModel::initialize()
         VLOG(L1, "import %d success", operation.type);
     }
 
+    saveWeightCache();
+
+    ALOGI("%u of %zu operations run in int8", mInt8Operations, mModel.operations.size());
+    ALOGI("%u reorders at run time, %u avoided by keeping blocked layouts",
+          mRuntimeReorders, mReordersAvoided);
+
+    success = planArena();
+    if (!success) {
+        ALOGE("planArena failed.");
+        return false;
+    }
+
+    auto context = createContext();
+    if (context == nullptr) {
+        ALOGE("createContext failed.");
+        return false;
+    }
+    buildDependencies(*context);
+    startWorkers();
+
     return true;
 }
 
 void MklDnnPreparedModel::deinitialize()
 {
     VLOG(L1,  "deinitialize");
+    {
+        std::lock_guard<std::mutex> lock(mQueueLock);
+        mStopping = true;
+    }
+    mQueueReady.notify_all();
+    for (auto& worker : mWorkers)
+        worker.join();
+    mWorkers.clear();
+    if (mExecutions > 1) {
+        double wall = std::chrono::duration<double>(mLastExecution - mFirstExecution).count();
+        double busy = std::chrono::duration<double>(mBusyTime).count();
+        ALOGI("%llu executions on %zu workers: %.1f per second, %.1f ms average latency",
+              static_cast<unsigned long long>(mExecutions), mMaxContexts,
+              wall > 0 ? mExecutions / wall : 0.0, busy * 1000 / mExecutions);
+    }
+
+    for (auto& context : mContexts) {
+        if (context->lanes) {
+            {
+                std::lock_guard<std::mutex> lock(context->lanes->lock);
+                context->lanes->stopping = true;
+            }
+            context->lanes->wake.notify_all();
+            for (auto& thread : context->lanes->threads)
+                thread.join();
+        }
+        context->net.clear();
+        for (auto& pmem : context->pmems)
+            delete pmem.second;
+        free(context->arena);
+    }
+    mContexts.clear();
+
+    //arena memories may also be operand pmems or stubs, free each once
+    std::set<memory*> pmems;
     for (const auto& operand : mOperands) {
         for (const auto& pmem : operand.stub_pmems) {
             VLOG(L1, "free stub pmems %p of operand %p", pmem, &operand);
-            delete pmem;
+            pmems.insert(pmem);
         }
         VLOG(L1, "free pmems %p of operand %p", operand.pmem, &operand);
         if (operand.pmem)
-            delete operand.pmem;
-    }
+            pmems.insert(operand.pmem);
+    }
+    for (const auto& block : mArenaBlocks)
+        pmems.insert(block.pmem);
+    for (const auto& view : mPmemViews)
+        pmems.insert(view.first);
+    for (auto pmem : mConstPmems)
+        pmems.insert(pmem);
+    for (auto pmem : pmems)
+        delete pmem;
+    VLOG(L1, "free activation arena %p", mArena);
+    free(mArena);
+    if (mWeightCache)
+        munmap(mWeightCache, mWeightCacheSize);
     VLOG(L1, "free cpu engine");
     if (cpu_engine)
         delete cpu_engine;
@@ -1655,7 +3240,8 @@ void printOperandPmem(int level, const memory *pmem, int limit = 0)
 #endif
 
 void MklDnnPreparedModel::asyncExecute(const Request& request,
-                                       const sp<IExecutionCallback>& callback)
+                                       const sp<IExecutionCallback>& callback,
+                                       ExecutionContext* context)
 {
     std::vector<RunTimePoolInfo> requestPoolInfos;
     if (!setRunTimePoolInfosFromHidlMemories(&requestPoolInfos, request.pools)) {
@@ -1663,33 +3249,60 @@ void MklDnnPreparedModel::asyncExecute(const Request& request,
         return;
     }
 
-    auto copyData = [this, &requestPoolInfos](const std::vector<uint32_t>& indexes,
-                       const hidl_vec<RequestArgument>& arguments, bool copyFromRequest) {
-        //do memcpy for input data
-        for (size_t i = 0; i < indexes.size(); i++) {
-            RunTimeOperandInfo& operand = mOperands[indexes[i]];
-            const RequestArgument& arg = arguments[i];
-            auto poolIndex = arg.location.poolIndex;
-            nnAssert(poolIndex < requestPoolInfos.size());
-            auto& r = requestPoolInfos[poolIndex];
-            if (copyFromRequest)
-                memcpy(operand.buffer, r.buffer + arg.location.offset, operand.length);
-            else
-                memcpy(r.buffer + arg.location.offset, operand.buffer, operand.length);
-        }
+    auto getRequestData = [&requestPoolInfos](const RequestArgument& arg) {
+        auto poolIndex = arg.location.poolIndex;
+        nnAssert(poolIndex < requestPoolInfos.size());
+        return requestPoolInfos[poolIndex].buffer + arg.location.offset;
+    };
+
+    //run directly on the request buffer when it has the layout and size of the
+    //model input/output memory, the original handles are restored after the run
+    std::vector<std::pair<memory*, void*>> boundPmems;
+    auto bindData = [this, context, &boundPmems](const RunTimeOperandInfo& operand,
+                                                  uint8_t* data) {
+        auto pmem = getContextPmem(*context, operand.pmem);
+        auto pd = pmem->get_primitive_desc();
+        auto format = static_cast<memory::format>(pd.desc().data.format);
+        if (!isPlainFormat(format) || pd.get_size() != operand.length ||
+            reinterpret_cast<uintptr_t>(data) % kRequestAlignment != 0)
+            return false;
+        boundPmems.push_back(std::make_pair(operand.pmem, pmem->get_data_handle()));
+        setContextHandle(*context, operand.pmem, data);
+        return true;
     };
 
-    VLOG(L1, "copy request inputs to model inputs");
+    VLOG(L1, "bind or copy request inputs to model inputs");
+    for (size_t i = 0; i < mModel.inputIndexes.size(); i++) {
+        const RunTimeOperandInfo& operand = mOperands[mModel.inputIndexes[i]];
+        uint8_t* data = getRequestData(request.inputs[i]);
+        if (!bindData(operand, data))
+            memcpy(getContextPmem(*context, operand.pmem)->get_data_handle(), data,
+                   operand.length);
+    }
 
-    copyData(mModel.inputIndexes, request.inputs, true);
+    std::vector<bool> outputBound(mModel.outputIndexes.size());
+    for (size_t i = 0; i < mModel.outputIndexes.size(); i++) {
+        const RunTimeOperandInfo& operand = mOperands[mModel.outputIndexes[i]];
+        outputBound[i] = bindData(operand, getRequestData(request.outputs[i]));
+    }
+    VLOG(L1, "%zu of %zu request buffers bound", boundPmems.size(),
+             mModel.inputIndexes.size() + mModel.outputIndexes.size());
 
     VLOG(L1, "Run");
     //run
-    mkldnn::stream(mkldnn::stream::kind::eager).submit(mNet).wait();
+    runNet(context);
 
     VLOG(L1, "copy model output to request output");
+    for (size_t i = 0; i < mModel.outputIndexes.size(); i++) {
+        if (outputBound[i])
+            continue;
+        const RunTimeOperandInfo& operand = mOperands[mModel.outputIndexes[i]];
+        memcpy(getRequestData(request.outputs[i]),
+               getContextPmem(*context, operand.pmem)->get_data_handle(), operand.length);
+    }
 
-    copyData(mModel.outputIndexes, request.outputs, false);
+    for (const auto& bound : boundPmems)
+        setContextHandle(*context, bound.first, bound.second);
 
     VLOG(L1, "update shared memories");
     for (auto runtimeInfo : requestPoolInfos) {
@@ -1723,7 +3336,7 @@ Return<ErrorStatus> MklDnnPreparedModel::execute(const Request& request,
 {
     VLOG(L1, "Begin to execute");
 
-    if (mNet.size() == 0) {
+    if (mPrimitiveFactories.size() == 0) {
         ALOGE("No primitive to execute");
         callback->notify(ErrorStatus::INVALID_ARGUMENT);
         return ErrorStatus::INVALID_ARGUMENT;
@@ -1739,11 +3352,13 @@ Return<ErrorStatus> MklDnnPreparedModel::execute(const Request& request,
         return ErrorStatus::INVALID_ARGUMENT;
     }
 
-    // This thread is intentionally detached because the sample driver service
-    // is expected to live forever.
-    std::thread([this, request, callback]{ asyncExecute(request, callback); }).detach();
+    {
+        std::lock_guard<std::mutex> lock(mQueueLock);
+        mRequests.push_back({request, callback});
+    }
+    mQueueReady.notify_one();
 
-    VLOG(L1, "Start execute thread done");
+    VLOG(L1, "Queue request done");
     return ErrorStatus::NONE;
 }
 
@@ -1775,23 +3390,6 @@ bool MklDnnPreparedModel::isOperationSupported(const Operation& operation, const
             return false;
         }
     }
-#else
-    for (auto i : operation.inputs) {
-        const auto input = model.operands[i];
-        if (input.type == OperandType::TENSOR_QUANT8_ASYMM &&
-            input.zeroPoint != 0) {
-            VLOG_CHECKFAIL("input quant");
-            return false;
-        }
-    }
-    for (auto i : operation.outputs) {
-        const auto output = model.operands[i];
-        if (output.type == OperandType::TENSOR_QUANT8_ASYMM &&
-            output.zeroPoint != 0) {
-            VLOG_CHECKFAIL("output quant");
-            return false;
-        }
-    }
 #endif
 
     const auto input0 = model.operands[operation.inputs[0]];
@@ -1872,6 +3470,58 @@ bool MklDnnPreparedModel::isOperationSupported(const Operation& operation, const
             }
             break;
         }
+        case OperationType::RESHAPE:
+        {
+            const auto& output = model.operands[operation.outputs[0]];
+            auto plainRank = [](size_t rank) { return rank == 1 || rank == 2 || rank == 4; };
+            if (!plainRank(input0.dimensions.size()) || !plainRank(output.dimensions.size())) {
+                VLOG_CHECKFAIL("reshape rank");
+                return false;
+            }
+            break;
+        }
+        case OperationType::L2_NORMALIZATION:
+        {
+            if (input0.dimensions.size() != 4) {
+                VLOG_CHECKFAIL("l2 normalization not 4-D");
+                return false;
+            }
+            break;
+        }
+        case OperationType::MUL:
+        {
+            auto isConst = [](const Operand& operand) {
+                return operand.lifetime == OperandLifeTime::CONSTANT_COPY ||
+                       operand.lifetime == OperandLifeTime::CONSTANT_REFERENCE;
+            };
+            const auto& input1 = model.operands[operation.inputs[1]];
+            const auto& tensor = isConst(input0) ? input1 : input0;
+            const auto& factor = isConst(input0) ? input0 : input1;
+            if (isConst(tensor) || !isConst(factor)) {
+                VLOG_CHECKFAIL("mul needs one constant input");
+                return false;
+            }
+            size_t rank = tensor.dimensions.size();
+            if (rank != 1 && rank != 2 && rank != 4) {
+                VLOG_CHECKFAIL("mul rank");
+                return false;
+            }
+            uint32_t count = 1;
+            for (auto d : factor.dimensions)
+                count *= d;
+            //broadcast of a scalar, or of a vector along channels
+            bool per_channel = tensor.dimensions.size() == 4 &&
+                               count == tensor.dimensions[3] &&
+                               factor.dimensions.size() > 0 && factor.dimensions.back() == count;
+            if (count != 1 && !per_channel) {
+                VLOG_CHECKFAIL("mul broadcast");
+                return false;
+            }
+            if (inputn.lifetime != OperandLifeTime::CONSTANT_COPY || activationPass(inputn) == false) {
+                return false;
+            }
+            break;
+        }
         case OperationType::RELU:
         case OperationType::RELU6:
         case OperationType::LOGISTIC:
@@ -25,7 +25,15 @@
 #include <mkldnn.hpp>
 
 #include <sys/mman.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 
 using ::android::hidl::memory::V1_0::IMemory;
 
@@ -66,6 +74,49 @@ struct RunTimeOperandInfo {
     std::vector<memory *> stub_pmems;
 };
 
+// A memory primitive of a temporary, bound to a slice of the activation arena
+// after all operations are imported. first/last are operation indexes.
+struct ArenaBlock {
+    memory *pmem;
+    size_t size;
+    uint32_t first;
+    uint32_t last;
+    size_t offset;
+};
+
+// An ADD whose input produced by a conv is summed by the conv itself.
+struct SumFusion {
+    uint32_t add;
+    uint32_t addend;
+    FusedActivationFunc activation;
+    //the conv may accumulate straight into the memory of the addend
+    bool inPlace;
+};
+
+// Threads running the independent primitives of an execution context together.
+struct BranchLanes {
+    std::vector<std::thread> threads;
+    std::mutex lock;
+    std::condition_variable wake;
+    //dependencies left of every primitive, and primitives with none left
+    std::vector<uint32_t> pending;
+    std::deque<uint32_t> ready;
+    size_t left;
+    size_t running;
+    bool stopping;
+};
+
+// Per execution state: the primitives and the memories of temporaries, model
+// inputs and outputs they are bound to. Constants are shared by all contexts.
+struct ExecutionContext {
+    std::vector<primitive> net;
+    //memory created at import -> memory of this context, empty for the first context
+    std::unordered_map<memory*, memory*> pmems;
+    void *arena;
+    //null when the net runs as a single stream
+    std::unique_ptr<BranchLanes> lanes;
+};
+
 // Used to keep a pointer to each of the memory pools.
 struct RunTimePoolInfo {
     sp<IMemory> memory;
@@ -81,7 +132,12 @@ class MklDnnPreparedModel : public IPreparedModel {
 public:
     MklDnnPreparedModel(const Model& model)
           : // Make a copy of the model, as we need to preserve it.
-            mModel(model), cpu_engine(nullptr) {}
+            mModel(model), cpu_engine(nullptr), mCurrentOperation(0), mArena(nullptr),
+            mArenaSize(0), mWeightCacheKey(0), mWeightCache(nullptr), mWeightCacheSize(0),
+            mWeightCacheMissed(false), mInt8Enabled(true), mInt8Operations(0),
+            mRuntimeReorders(0), mReordersAvoided(0), mStopping(false),
+            mMaxContexts(kDefaultMaxContexts), mCoreBudget(1), mThreadsPerWorker(1),
+            mAffinity(false), mBranchWidth(0), mLanes(1), mExecutions(0), mBusyTime(0) {}
     ~MklDnnPreparedModel() override {deinitialize();}
     bool initialize();
     Return<ErrorStatus> execute(const Request& request,
@@ -93,7 +149,15 @@ public:
 private:
     void deinitialize();
     bool initializeRunTimeOperandInfo();
-    void asyncExecute(const Request& request, const sp<IExecutionCallback>& callback);
+    void asyncExecute(const Request& request, const sp<IExecutionCallback>& callback,
+                      ExecutionContext* context);
+    void startWorkers();
+    void applyThreadPolicy(size_t slot);
+    void runWorker(size_t slot);
+    void buildDependencies(const ExecutionContext& context);
+    void startLanes(ExecutionContext* context);
+    void runBranches(ExecutionContext* context, bool caller);
+    void runNet(ExecutionContext* context);
 
     bool importOperationConv2D(const Operation& operation);
     bool importOperationPool(const Operation& operation);
@@ -103,14 +167,42 @@ private:
     bool importOperationLRN(const Operation& operation);
     bool importOperationFC(const Operation& operation);
     bool importOperationAdd(const Operation& operation);
+    bool importOperationReshape(const Operation& operation);
+    bool importOperationL2Normalization(const Operation& operation);
+    bool importOperationMul(const Operation& operation);
+    bool importConvInt8(RunTimeOperandInfo* input, RunTimeOperandInfo* filter,
+                        RunTimeOperandInfo* bias, RunTimeOperandInfo* output,
+                        const memory::dims& strides, const memory::dims& paddings_l,
+                        const memory::dims& paddings_r, bool group);
+    bool canRunInt8(const RunTimeOperandInfo& input, uint32_t outputIndex,
+                    FusedActivationFunc activation);
 
     void initializeInput(RunTimeOperandInfo* input, memory::format format);
     void finalizeOutput(RunTimeOperandInfo* output, memory::format format);
+    //builds a primitive on the memories of an execution context
+    using PmemMap = std::function<memory&(memory*)>;
+    using PrimitiveFactory = std::function<primitive(const PmemMap&)>;
+    void addPrimitive(const PrimitiveFactory& factory);
+    ExecutionContext* createContext();
+    memory* getContextPmem(const ExecutionContext& context, memory* pmem);
+    void setContextHandle(const ExecutionContext& context, memory* pmem, void* handle);
+
     void addStubPmem(RunTimeOperandInfo* operand, memory* pmem);
-    memory* insertReorder(memory* src_mem, memory::format format, memory::data_type type,
+    memory* createPmem(RunTimeOperandInfo* operand, const memory::primitive_desc& pd);
+    memory* createPmemView(const memory::primitive_desc& pd, memory* base);
+    memory* createConstPmem(const memory::primitive_desc& pd, const void* data);
+    void openWeightCache();
+    memory* getCachedWeights(const memory::primitive_desc& pd);
+    void saveWeightCache();
+    void computeOperandLiveness();
+    void planSumFusion();
+    void extendArenaBlock(memory* pmem, uint32_t last);
+    bool planArena();
+    void insertLinear(memory* src_mem, memory* dst_mem, float alpha, float beta, bool execute);
+    memory* insertReorder(RunTimeOperandInfo* operand, memory* src_mem, memory::format format,
+                          memory::data_type type, bool execute, float scale, uint8_t zero = 0);
+    memory* insertReorder(RunTimeOperandInfo* operand, memory* src_mem, const memory::desc& desc,
                           bool execute, float scale, uint8_t zero = 0);
-    memory* insertReorder(memory* src_mem, const memory::desc& desc, bool execute, float scale,
-                          uint8_t zero = 0);
     memory* getOperandPmemOfFormatType(const RunTimeOperandInfo& operand, memory::format format,
                                        memory::data_type type);
     memory* getOperandPmemOfDesc(const RunTimeOperandInfo& operand, const memory::desc& desc);
@@ -118,13 +210,85 @@ private:
                                 memory::data_type type);
     memory* insertReorderIfNeed(RunTimeOperandInfo* operand, memory::desc desc);
     memory::data_type getOperandNeedType(const RunTimeOperandInfo& operand);
-    memory* insertActivation(memory* pmem, FusedActivationFunc activation);
+    memory* insertActivation(RunTimeOperandInfo* operand, memory* pmem,
+                             FusedActivationFunc activation);
 
     Model mModel;
     std::vector<RunTimeOperandInfo> mOperands;
     std::vector<RunTimePoolInfo> mPoolInfos;
-    std::vector<primitive> mNet;
+    std::vector<PrimitiveFactory> mPrimitiveFactories;
     engine *cpu_engine;
+
+    static constexpr size_t kArenaAlignment = 64;
+    //operation being imported, and the last operation reading each operand
+    uint32_t mCurrentOperation;
+    std::vector<uint32_t> mLastUse;
+    std::vector<ArenaBlock> mArenaBlocks;
+    //conv operation -> ADD it may absorb, and absorbed ADD -> conv output operand
+    std::unordered_map<uint32_t, SumFusion> mSumFusions;
+    std::unordered_map<uint32_t, uint32_t> mFusedAdds;
+    //{view, base} pairs sharing the buffer of an arena block, model input or output
+    std::vector<std::pair<memory*, memory*>> mPmemViews;
+    void *mArena;
+    size_t mArenaSize;
+    //memories copied to/from requests, every execution context has its own
+    std::vector<memory*> mPrivatePmems;
+    //weights and biases built at import, owned by no operand
+    std::vector<memory*> mConstPmems;
+
+    //constants reordered at import, in import order, mapped from or saved to
+    //mWeightCachePath so that the next prepare of the model skips the reorders
+    static constexpr const char* kDefaultWeightCacheDir = "/data/vendor/mkldnn";
+    std::string mWeightCachePath;
+    uint64_t mWeightCacheKey;
+    void* mWeightCache;
+    size_t mWeightCacheSize;
+    bool mWeightCacheMissed;
+    std::vector<memory*> mCachedWeights;
+
+    //quantized operations run on u8/s8 unless "nn.hal.mkldnn.int8" is 0
+    bool mInt8Enabled;
+    uint32_t mInt8Operations;
+    //reorders run by every execution, and those layout propagation did without
+    uint32_t mRuntimeReorders;
+    uint32_t mReordersAvoided;
+
+    //requests queue up for mMaxContexts workers, each with its own execution
+    //context, running mkldnn on mThreadsPerWorker threads of a budget of
+    //mCoreBudget cores ("nn.hal.mkldnn.contexts", ".threads", ".cores" and
+    //".affinity" override the defaults)
+    static constexpr size_t kDefaultMaxContexts = 4;
+    //request buffers bound in place of model input/output memories
+    static constexpr size_t kRequestAlignment = 16;
+    struct PendingRequest {
+        Request request;
+        sp<IExecutionCallback> callback;
+    };
+    std::vector<std::unique_ptr<ExecutionContext>> mContexts;
+    std::deque<PendingRequest> mRequests;
+    std::vector<std::thread> mWorkers;
+    std::mutex mQueueLock;
+    std::condition_variable mQueueReady;
+    bool mStopping;
+    size_t mMaxContexts;
+    size_t mCoreBudget;
+    size_t mThreadsPerWorker;
+    bool mAffinity;
+
+    //primitives depending on each one, and the number each depends on. Up to
+    //mBranchWidth of them may run at once, on mLanes threads of a worker
+    //("nn.hal.mkldnn.branches" overrides, 1 runs the net as a single stream)
+    static constexpr size_t kMaxLanes = 4;
+    std::vector<std::vector<uint32_t>> mDependents;
+    std::vector<uint32_t> mDependencyCounts;
+    size_t mBranchWidth;
+    size_t mLanes;
+
+    //throughput of the model, logged when it is released
+    uint64_t mExecutions;
+    std::chrono::steady_clock::duration mBusyTime;
+    std::chrono::steady_clock::time_point mFirstExecution;
+    std::chrono::steady_clock::time_point mLastExecution;
 };
 
 }  // namespace mkldnn_driver
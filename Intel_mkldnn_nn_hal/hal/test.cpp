@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs a conv whose output is added to a tensor that a RESHAPE also reads,
+// and whose reshaped view is read again after the conv:
+//
+//   a = RELU(input)          r = RESHAPE(a)
+//   sum = CONV_2D(input) + a
+//   view = RESHAPE(r)        read after the conv
+//
+// The ADD is fused into the conv, which must not accumulate into the memory
+// of a while the view still reads it. Then runs L2_NORMALIZATION and a MUL
+// by a constant per channel vector on the same input. All outputs are
+// checked against values computed here, for a channel count the HAL keeps
+// plain and one it blocks.
+//
+// The request pools are mmap_fd memory, so no allocator service is needed
+// and the test also runs on a Linux host, see Makefile.
+//
+// usage: mkldnn_hal_test
+
+#define LOG_TAG "neuralnetworks-mkldnn-test"
+
+#include <cutils/native_handle.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <vector>
+#include "MklDnnPreparedModel.h"
+
+using namespace ::android::hardware::neuralnetworks::V1_0;
+using namespace ::android::hardware::neuralnetworks::V1_0::mkldnn_driver;
+
+class ExecutionCallback : public IExecutionCallback {
+public:
+    Return<void> notify(ErrorStatus status) override {
+        mStatus.set_value(status);
+        return Void();
+    }
+    ErrorStatus wait() { return mStatus.get_future().get(); }
+
+private:
+    std::promise<ErrorStatus> mStatus;
+};
+
+struct ModelBuilder {
+    Model model;
+    std::vector<uint8_t> values;
+
+    uint32_t operand(OperandType type, std::vector<uint32_t> dims, OperandLifeTime lifetime) {
+        uint32_t index = model.operands.size();
+        model.operands.resize(index + 1);
+        Operand& operand = model.operands[index];
+        operand.type = type;
+        operand.dimensions = dims;
+        operand.lifetime = lifetime;
+        return index;
+    }
+
+    template <typename T>
+    uint32_t constant(OperandType type, std::vector<uint32_t> dims, const std::vector<T>& data) {
+        uint32_t index = operand(type, dims, OperandLifeTime::CONSTANT_COPY);
+        size_t length = data.size() * sizeof(T);
+        model.operands[index].location = {0, static_cast<uint32_t>(values.size()),
+                                          static_cast<uint32_t>(length)};
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+        values.insert(values.end(), bytes, bytes + length);
+        return index;
+    }
+
+    void operation(OperationType type, std::vector<uint32_t> inputs, uint32_t output) {
+        uint32_t index = model.operations.size();
+        model.operations.resize(index + 1);
+        model.operations[index] = {type, inputs, {output}};
+        for (auto input : inputs)
+            model.operands[input].numberOfConsumers++;
+    }
+};
+
+//runs the model on one input and returns its outputs, all of the input size
+static bool runModel(const Model& model, const std::vector<float>& in,
+                     std::vector<std::vector<float>>* outputs) {
+    sp<MklDnnPreparedModel> prepared = new MklDnnPreparedModel(model);
+    if (!prepared->initialize()) {
+        printf("initialize failed\n");
+        return false;
+    }
+
+    const uint32_t bytes = in.size() * sizeof(float);
+    const uint32_t count = model.outputIndexes.size();
+    const size_t length = (1 + count) * bytes;
+    FILE* file = tmpfile();
+    if (file == nullptr || ftruncate(fileno(file), length) != 0) {
+        printf("can't create the request pool\n");
+        if (file != nullptr)
+            fclose(file);
+        return false;
+    }
+    void* mapped = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(file), 0);
+    if (mapped == MAP_FAILED) {
+        printf("can't map the request pool\n");
+        fclose(file);
+        return false;
+    }
+    float* buffer = static_cast<float*>(mapped);
+    memcpy(buffer, in.data(), bytes);
+
+    //fd, prot and the two halves of the offset, as RunTimePoolInfo reads them
+    native_handle_t* handle = native_handle_create(1, 3);
+    handle->data[0] = fileno(file);
+    handle->data[1] = PROT_READ | PROT_WRITE;
+    handle->data[2] = 0;
+    handle->data[3] = 0;
+
+    Request request;
+    request.inputs = std::vector<RequestArgument>{{false, {0, 0, bytes}, {}}};
+    request.outputs.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+        request.outputs[i] = {false, {0, (1 + i) * bytes, bytes}, {}};
+    request.pools = std::vector<hidl_memory>{hidl_memory("mmap_fd", handle, length)};
+
+    sp<ExecutionCallback> callback = new ExecutionCallback();
+    bool ok = prepared->execute(request, callback) == ErrorStatus::NONE &&
+              callback->wait() == ErrorStatus::NONE;
+    if (ok) {
+        outputs->resize(count);
+        for (uint32_t i = 0; i < count; i++)
+            (*outputs)[i].assign(buffer + (1 + i) * in.size(), buffer + (2 + i) * in.size());
+    } else {
+        printf("execute failed\n");
+    }
+
+    munmap(mapped, length);
+    native_handle_delete(handle);
+    fclose(file);
+    return ok;
+}
+
+static bool check(const char* name, const std::vector<float>& data,
+                  const std::vector<float>& reference) {
+    for (size_t i = 0; i < reference.size(); i++) {
+        if (std::fabs(data[i] - reference[i]) > 1e-4f) {
+            printf("%s: element %zu is %f, expected %f\n", name, i, data[i], reference[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::vector<float> makeInput(uint32_t size) {
+    std::vector<float> in(size);
+    for (uint32_t i = 0; i < size; i++)
+        in[i] = 0.125f * i - 1.0f;
+    return in;
+}
+
+static bool runSum(uint32_t channels) {
+    const uint32_t h = 2, w = 2, size = h * w * channels;
+    std::vector<uint32_t> dims = {1, h, w, channels};
+
+    ModelBuilder b;
+    uint32_t input = b.operand(OperandType::TENSOR_FLOAT32, dims, OperandLifeTime::MODEL_INPUT);
+    uint32_t a = b.operand(OperandType::TENSOR_FLOAT32, dims, OperandLifeTime::TEMPORARY_VARIABLE);
+    uint32_t flat_shape = b.constant<int32_t>(OperandType::TENSOR_INT32, {2},
+                                              {1, static_cast<int32_t>(size)});
+    uint32_t r = b.operand(OperandType::TENSOR_FLOAT32, {1, size},
+                           OperandLifeTime::TEMPORARY_VARIABLE);
+
+    std::vector<float> filter(channels * channels), bias(channels);
+    for (uint32_t o = 0; o < channels; o++) {
+        for (uint32_t i = 0; i < channels; i++)
+            filter[o * channels + i] = (o == i) ? 1.0f : 0.25f;
+        bias[o] = 0.5f * o;
+    }
+    uint32_t filter_index = b.constant(OperandType::TENSOR_FLOAT32, {channels, 1, 1, channels},
+                                       filter);
+    uint32_t bias_index = b.constant(OperandType::TENSOR_FLOAT32, {channels}, bias);
+    uint32_t zero = b.constant<int32_t>(OperandType::INT32, {}, {0});
+    uint32_t one = b.constant<int32_t>(OperandType::INT32, {}, {1});
+    uint32_t conv = b.operand(OperandType::TENSOR_FLOAT32, dims,
+                              OperandLifeTime::TEMPORARY_VARIABLE);
+    uint32_t sum = b.operand(OperandType::TENSOR_FLOAT32, dims, OperandLifeTime::MODEL_OUTPUT);
+    std::vector<int32_t> shape(dims.begin(), dims.end());
+    uint32_t view_shape = b.constant(OperandType::TENSOR_INT32, {4}, shape);
+    uint32_t view = b.operand(OperandType::TENSOR_FLOAT32, dims, OperandLifeTime::MODEL_OUTPUT);
+
+    b.operation(OperationType::RELU, {input}, a);
+    b.operation(OperationType::RESHAPE, {a, flat_shape}, r);
+    b.operation(OperationType::CONV_2D,
+                {input, filter_index, bias_index, zero, zero, zero, zero, one, one, zero}, conv);
+    b.operation(OperationType::ADD, {conv, a, zero}, sum);
+    b.operation(OperationType::RESHAPE, {r, view_shape}, view);
+    b.model.inputIndexes = std::vector<uint32_t>{input};
+    b.model.outputIndexes = std::vector<uint32_t>{sum, view};
+    b.model.operandValues = b.values;
+
+    std::vector<float> in = makeInput(size), relu(size), reference(size);
+    for (uint32_t i = 0; i < size; i++)
+        relu[i] = std::max(in[i], 0.0f);
+    for (uint32_t p = 0; p < h * w; p++) {
+        for (uint32_t o = 0; o < channels; o++) {
+            float acc = bias[o];
+            for (uint32_t i = 0; i < channels; i++)
+                acc += in[p * channels + i] * filter[o * channels + i];
+            reference[p * channels + o] = acc + relu[p * channels + o];
+        }
+    }
+
+    std::vector<std::vector<float>> out;
+    bool ok = runModel(b.model, in, &out) && check("sum", out[0], reference) &&
+              check("view", out[1], relu);
+    printf("sum, %u channels: %s\n", channels, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+//l2 = L2_NORMALIZATION(input), scaled = MUL(input, factors[channels])
+static bool runNormalizeScale(uint32_t channels) {
+    const uint32_t h = 2, w = 2, size = h * w * channels;
+    std::vector<uint32_t> dims = {1, h, w, channels};
+
+    ModelBuilder b;
+    uint32_t input = b.operand(OperandType::TENSOR_FLOAT32, dims, OperandLifeTime::MODEL_INPUT);
+    std::vector<float> factors(channels);
+    for (uint32_t c = 0; c < channels; c++)
+        factors[c] = 0.5f * c - 1.0f;
+    uint32_t factor_index = b.constant(OperandType::TENSOR_FLOAT32, {channels}, factors);
+    uint32_t none = b.constant<int32_t>(OperandType::INT32, {}, {0});
+    uint32_t l2 = b.operand(OperandType::TENSOR_FLOAT32, dims, OperandLifeTime::MODEL_OUTPUT);
+    uint32_t scaled = b.operand(OperandType::TENSOR_FLOAT32, dims,
+                                OperandLifeTime::MODEL_OUTPUT);
+
+    b.operation(OperationType::L2_NORMALIZATION, {input}, l2);
+    b.operation(OperationType::MUL, {input, factor_index, none}, scaled);
+    b.model.inputIndexes = std::vector<uint32_t>{input};
+    b.model.outputIndexes = std::vector<uint32_t>{l2, scaled};
+    b.model.operandValues = b.values;
+
+    std::vector<float> in = makeInput(size), normalized(size), product(size);
+    for (uint32_t p = 0; p < h * w; p++) {
+        float squares = 0.0f;
+        for (uint32_t c = 0; c < channels; c++)
+            squares += in[p * channels + c] * in[p * channels + c];
+        for (uint32_t c = 0; c < channels; c++) {
+            normalized[p * channels + c] = in[p * channels + c] / std::sqrt(squares);
+            product[p * channels + c] = in[p * channels + c] * factors[c];
+        }
+    }
+
+    std::vector<std::vector<float>> out;
+    bool ok = runModel(b.model, in, &out) && check("l2", out[0], normalized) &&
+              check("mul", out[1], product);
+    printf("l2 and mul, %u channels: %s\n", channels, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main() {
+    bool ok = true;
+    for (uint32_t channels : {3u, 8u, 16u}) {
+        ok = runSum(channels) && ok;
+        ok = runNormalizeScale(channels) && ok;
+    }
+    return ok ? 0 : 1;
+}
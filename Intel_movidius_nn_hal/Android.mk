@@ -15,4 +15,12 @@
 # limitations under the License.
 #
 LOCAL_PATH := $(my-dir)
+
+#NCS_SIMULATOR=true links the simulated sticks of ncs_simulator instead of the NCSDK
+ifeq ($(NCS_SIMULATOR),true)
+NCS_MVNC_LIBRARY := libncsdk_sim
+else
+NCS_MVNC_LIBRARY := libncsdk
+endif
+
 include $(call all-subdir-makefiles, $(LOCAL_PATH))
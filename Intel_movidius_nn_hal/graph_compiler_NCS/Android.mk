@@ -27,12 +27,14 @@ LOCAL_SRC_FILES := Blob.cpp \
 									 stage_pooling.cpp \
 									 stage_softmax.cpp \
 									 stage_reshape.cpp \
+									 stage_eltwise.cpp \
+									 network_optimizer.cpp \
 									 stage_tanh.cpp
 
 LOCAL_C_INCLUDES += $(LOCAL_PATH) \
 										$(LOCAL_PATH)/../ncs_lib_operations
 
-LOCAL_SHARED_LIBRARIES := libncsdk libncs_nn_operation liblog libutils
+LOCAL_SHARED_LIBRARIES := $(NCS_MVNC_LIBRARY) libncs_nn_operation liblog libutils
 LOCAL_CPPFLAGS := -fexceptions
 LOCAL_MODULE := libncs_graph_compiler
 
@@ -20,6 +20,11 @@
 #include<stdint.h>
 #include <log/log.h>
 #include <string>
+#include <algorithm>
+#include <mutex>
+#include <unistd.h>
+#include <errno.h>
+#include <map>
 #include "fp.h"
 
 //#include "VpuPreparemodel.h" //TODO add it later
@@ -27,9 +32,9 @@
 //#include "stage_header.h"
 #define LOG_TAG "BLOB"
 
+//debug exports are the only state shared by compilations
 std::vector<std::string> graph_file_names_vector;
-std::string graph_filename;
-//#define dump_blob_to_file true
+std::mutex graph_file_names_lock;
 /*
 
 count_network_stages_count()
@@ -45,171 +50,171 @@ generate_graph()
 get_header_buffer()
 
 */
-network_operations_vector nw_vector_global;
-Blob_Stage_data input_stage_data;
-
-Network_Vector_Stageinfo nwk_vector_stages_info;
-unsigned int stage_count=1;
-
-
-uint32_t zero_data_offset_g = 0;
-uint16_t buffer_index_g = 0;
-
-uint32_t data_Pointer_g = 0;
-uint16_t data_Index_g = 1;
+#define RADIX_MAX 5
 
-uint32_t taps_Pointer_g = 0;
-uint16_t taps_Index_g = 3;
+void init_compile_context(Compile_context *ctx){
+  ctx->network.clear();
+  ctx->stages_info.clear();
+  ctx->stage_count = 1;
+  ctx->inputs.clear();
+  ctx->outputs.clear();
 
-uint32_t bias_Pointer_g = 0;
-uint16_t bias_Index_g = 3;
+  ctx->zero_data_offset = 0;
+  ctx->buffer_index = 0;
 
-uint32_t opPrarams_Pointer_g = 0;
-uint16_t opPrarams_Index_g = 0;
+  ctx->data_Pointer = 0;
+  ctx->data_Index = 1;
 
-uint32_t output_Pointer_g = 0;
-uint16_t output_Index_g = 3;
+  ctx->taps_Pointer = 0;
+  ctx->taps_Index = 3;
 
-uint32_t global_buffer_index =0;
+  ctx->bias_Pointer = 0;
+  ctx->bias_Index = 3;
 
-#define RADIX_MAX 5
+  ctx->opPrarams_Pointer = 0;
+  ctx->opPrarams_Index = 0;
 
-float *post_data_buffer;
+  ctx->output_Pointer = 0;
+  ctx->output_Index = 3;
 
+  ctx->global_buffer_index = 0;
+  ctx->post_data_buffer = NULL;
 
+  ctx->optimize = true;
+}
 
-bool update_post_data_buffer(uint32_t size, float *buf){
+bool update_post_data_buffer(Compile_context *ctx, uint32_t size, float *buf){
   if(buf == NULL)
   ALOGD("buf is null inside update_post_data_buffer");
-  if(post_data_buffer+get_global_buffer_index() == NULL)
+  if(ctx->post_data_buffer+get_global_buffer_index(ctx) == NULL)
   ALOGE("post_data_buffer+get_global_buffer_index() buffer is null");
 
-  memcpy(post_data_buffer+get_global_buffer_index(),buf,size);
+  memcpy(ctx->post_data_buffer+get_global_buffer_index(ctx),buf,size);
   ALOGD("Copied %lu bytes data",size);
   return true;
 }
 
-bool update_global_buffer_index(uint32_t value){
-  global_buffer_index += value;
-  ALOGD("updated global_buffer_index is : %lu",global_buffer_index);
+bool update_global_buffer_index(Compile_context *ctx, uint32_t value){
+  ctx->global_buffer_index += value;
+  ALOGD("updated global_buffer_index is : %lu",ctx->global_buffer_index);
   return true;
 }
 
-uint32_t get_global_buffer_index(){
-  return global_buffer_index;
+uint32_t get_global_buffer_index(Compile_context *ctx){
+  return ctx->global_buffer_index;
 }
 
-bool update_zero_data_offset_g(uint32_t value){
-  zero_data_offset_g = value;
+bool update_zero_data_offset_g(Compile_context *ctx, uint32_t value){
+  ctx->zero_data_offset = value;
   return true;
 }
 
-uint32_t get_zero_data_offset_global(){
-  return zero_data_offset_g;
+uint32_t get_zero_data_offset_global(Compile_context *ctx){
+  return ctx->zero_data_offset;
 }
 
-bool update_buffer_index_g(uint16_t value){
-  buffer_index_g = value;
+bool update_buffer_index_g(Compile_context *ctx, uint16_t value){
+  ctx->buffer_index = value;
   return true;
 }
 
-uint16_t get_buffer_index_global(){
-  return buffer_index_g;
+uint16_t get_buffer_index_global(Compile_context *ctx){
+  return ctx->buffer_index;
 }
 
 
-bool update_data_Pointer_g(uint32_t value){
-  data_Pointer_g = value;
+bool update_data_Pointer_g(Compile_context *ctx, uint32_t value){
+  ctx->data_Pointer = value;
   return true;
 }
 
-uint32_t get_data_Pointer_global(){
-  return data_Pointer_g;
+uint32_t get_data_Pointer_global(Compile_context *ctx){
+  return ctx->data_Pointer;
 }
 
-bool update_data_Index_g(uint16_t value){
-  data_Index_g = value;
+bool update_data_Index_g(Compile_context *ctx, uint16_t value){
+  ctx->data_Index = value;
   return true;
 }
 
-uint16_t get_data_Index_global(){
-  return data_Index_g;
+uint16_t get_data_Index_global(Compile_context *ctx){
+  return ctx->data_Index;
 }
 
-bool update_taps_Pointer_g(uint32_t value){
-  taps_Pointer_g = value;
+bool update_taps_Pointer_g(Compile_context *ctx, uint32_t value){
+  ctx->taps_Pointer = value;
   return true;
 }
 
-uint32_t get_taps_Pointer_global(){
-  return taps_Pointer_g;
+uint32_t get_taps_Pointer_global(Compile_context *ctx){
+  return ctx->taps_Pointer;
 }
 
-bool update_taps_Index_g(uint16_t value){
-  taps_Index_g = value;
+bool update_taps_Index_g(Compile_context *ctx, uint16_t value){
+  ctx->taps_Index = value;
   return true;
 }
 
-uint16_t get_taps_Index_global(){
-  return taps_Index_g;
+uint16_t get_taps_Index_global(Compile_context *ctx){
+  return ctx->taps_Index;
 }
 
-bool update_bias_Pointer_g(uint32_t value){
-  bias_Pointer_g = value;
+bool update_bias_Pointer_g(Compile_context *ctx, uint32_t value){
+  ctx->bias_Pointer = value;
   return true;
 }
 
-uint32_t get_bias_Pointer_global(){
-  return bias_Pointer_g;
+uint32_t get_bias_Pointer_global(Compile_context *ctx){
+  return ctx->bias_Pointer;
 }
 
-bool update_bias_Index_g(uint16_t value){
-  bias_Index_g = value;
+bool update_bias_Index_g(Compile_context *ctx, uint16_t value){
+  ctx->bias_Index = value;
   return true;
 }
 
-uint16_t get_bias_Index_global(){
-  return bias_Index_g;
+uint16_t get_bias_Index_global(Compile_context *ctx){
+  return ctx->bias_Index;
 }
 
-bool update_opPrarams_Pointer_g(uint32_t value){
-  opPrarams_Pointer_g = value;
+bool update_opPrarams_Pointer_g(Compile_context *ctx, uint32_t value){
+  ctx->opPrarams_Pointer = value;
   return true;
 }
 
-uint32_t get_opPrarams_Pointer_global(){
-  return opPrarams_Pointer_g;
+uint32_t get_opPrarams_Pointer_global(Compile_context *ctx){
+  return ctx->opPrarams_Pointer;
 }
 
-bool update_opPrarams_Index_g(uint16_t value){
-  opPrarams_Index_g = value;
+bool update_opPrarams_Index_g(Compile_context *ctx, uint16_t value){
+  ctx->opPrarams_Index = value;
   return true;
 }
 
-uint16_t get_opPrarams_Index_global(){
-  return opPrarams_Index_g;
+uint16_t get_opPrarams_Index_global(Compile_context *ctx){
+  return ctx->opPrarams_Index;
 }
 
-bool update_output_Pointer_g(uint32_t value){
-  output_Pointer_g = value;
+bool update_output_Pointer_g(Compile_context *ctx, uint32_t value){
+  ctx->output_Pointer = value;
   return true;
 }
 
-uint32_t get_output_Pointer_global(){
-  return output_Pointer_g;
+uint32_t get_output_Pointer_global(Compile_context *ctx){
+  return ctx->output_Pointer;
 }
 
-bool update_output_Index_g(uint16_t value){
-  output_Index_g = value;
+bool update_output_Index_g(Compile_context *ctx, uint16_t value){
+  ctx->output_Index = value;
   return true;
 }
 
-uint16_t get_output_Index_global(){
-  return output_Index_g;
+uint16_t get_output_Index_global(Compile_context *ctx){
+  return ctx->output_Index;
 }
 
 
-uint32_t calculate_output_pointer(uint32_t X, uint32_t Y, uint32_t Z){
+uint32_t calculate_output_pointer(Compile_context *ctx, uint32_t X, uint32_t Y, uint32_t Z){
   uint32_t output_pointer,buffer_size,zero_data_offset,pad;
   uint16_t buffer_index;
   uint8_t dtype = 2; //TODO fix later with proper code (dype is fp16)
@@ -220,14 +225,14 @@ uint32_t calculate_output_pointer(uint32_t X, uint32_t Y, uint32_t Z){
   //align buffer size to 64
   buffer_size += align_size(buffer_size,64);
   if(DEBUG_get_input_stage_buffer) ALOGD("align_buffer_size : %u",buffer_size);
-  zero_data_offset = buffer_size+get_zero_data_offset_global();
+  zero_data_offset = buffer_size+get_zero_data_offset_global(ctx);
   if(DEBUG_get_input_stage_buffer) ALOGD("zero_data_offset : %u",zero_data_offset);
-  if(update_zero_data_offset_g(zero_data_offset)!=true)
+  if(update_zero_data_offset_g(ctx, zero_data_offset)!=true)
     ALOGE("unable to update zero_data_offset_g");
 
-  buffer_index= get_buffer_index_global()+1;
+  buffer_index= get_buffer_index_global(ctx)+1;
 
-  if(update_buffer_index_g(buffer_index)!=true)
+  if(update_buffer_index_g(ctx, buffer_index)!=true)
     ALOGE("unable to update buffer_index_g");
 
   output_pointer = zero_data_offset - buffer_size + pad;
@@ -252,957 +257,158 @@ uint32_t calculate_bias_Pointer(uint32_t X){
 }
 
 // Network section begin
-bool get_nn_network_from_android(network_operations_vector nw_vector1){
-  nw_vector_global = nw_vector1;
-  return true;
-}
-
-std::vector<NCSoperations> get_network_operations_details(){
-  //update the global variable for network_operations_vector(nw_vector_global)
-  return nw_vector_global;
-}
-
-bool display(Operation_inputs_info cur_stage_android, int count){
-
-  //ALOGD("Stage Count  : %d",count);
-  ALOGD("cur_stage_android.main_operation : %d",cur_stage_android.main_operation);
-  ALOGD("cur_stage_android.num_inputs : %d",cur_stage_android.num_inputs);
-  ALOGD("cur_stage_android.input_shape : (%d, %d, %d, %d)",cur_stage_android.input_shape[0],cur_stage_android.input_shape[1],cur_stage_android.input_shape[2],cur_stage_android.input_shape[3]);
-
-  //if(cur_stage_android.main_operation == CONV_2D || cur_stage_android.main_operation ==  DEPTHWISE_CONV_2D || cur_stage_android.main_operation == AVERAGE_POOL_2D || cur_stage_android.main_operation == MAX_POOL_2D){
-  if(cur_stage_android.main_operation == CONV_2D || DEPTHWISE_CONV_2D ){
-    ALOGD("cur_stage_android.kernel_shape : (%d, %d, %d, %d) ",cur_stage_android.kernel_shape[0],cur_stage_android.kernel_shape[1],cur_stage_android.kernel_shape[2],cur_stage_android.kernel_shape[3]);
-
-    uint32_t num_of_kernel_elements = cur_stage_android.kernel_shape[0] * cur_stage_android.kernel_shape[1] *
-                                      cur_stage_android.kernel_shape[2] * cur_stage_android.kernel_shape[3];
-    ALOGD("cur_stage_android.kernel_num of elements : %d",num_of_kernel_elements);
-
-    if(cur_stage_android.main_operation == CONV_2D || cur_stage_android.main_operation ==  DEPTHWISE_CONV_2D){
-      ALOGD("cur_stage_android.bias_shape : (%d, %d, %d, %d) ",cur_stage_android.bias_shape[0],cur_stage_android.bias_shape[1],cur_stage_android.bias_shape[2],cur_stage_android.bias_shape[3]);
-    }
-    if(cur_stage_android.main_operation == DEPTHWISE_CONV_2D )
-    ALOGD("cur_stage_android.depth_multiplier : %d",cur_stage_android.depth_multiplier);
-
-    ALOGD("cur_stage_android.output_shape : (%d, %d, %d, %d) ",cur_stage_android.output_shape[0],cur_stage_android.output_shape[1],cur_stage_android.output_shape[2],cur_stage_android.output_shape[3]);
-
-
-    ALOGD("cur_stage_android.padding_left : %d",cur_stage_android.padding_left);
-    ALOGD("cur_stage_android.padding_right : %d",cur_stage_android.padding_right);
-    ALOGD("cur_stage_android.padding_top : %d",cur_stage_android.padding_top);
-    ALOGD("cur_stage_android.padding_bottom : %d",cur_stage_android.padding_bottom);
-
-    ALOGD("cur_stage_android.stride_width : %d",cur_stage_android.stride_width);
-    ALOGD("cur_stage_android.stride_height : %d",cur_stage_android.stride_height);
-  }
-  ALOGD("cur_stage_android.post_operation : %d",cur_stage_android.post_operation);
+bool get_nn_network_from_android(Compile_context *ctx, network_operations_vector nw_vector1){
+  ctx->network = nw_vector1;
   return true;
 }
 
-// Network Stage section begin
-bool parse_stage_from_android(Operation_inputs_info cur_stage_android){
-  bool success;
-  nwk_vector_stages_info.push_back(cur_stage_android);
-  //TODO Fix me comment the debug
-
-  bool enable_debug = false;
-  if(nwk_vector_stages_info.size() == nw_vector_global.size() && enable_debug){
-    ALOGD("Stage Count  : %d",stage_count);
-    for(int i=0;i<nwk_vector_stages_info.size();i++){
-    success = display(nwk_vector_stages_info.at(i), stage_count);
-    }
-
-  }
-  stage_count = stage_count+1;
+bool get_nn_network_io_from_android(Compile_context *ctx, Network_Vector_Tensorinfo inputs, Network_Vector_Tensorinfo outputs){
+  ctx->inputs = inputs;
+  ctx->outputs = outputs;
   return true;
 }
 
+uint32_t shape_elements(const VpuShape shape){
+  uint32_t elements = 1;
+  for(int i=0;i<SIZE;i++)
+    elements *= (shape[i] == 0) ? 1 : shape[i];
+  return elements;
+}
 
-//Handles only Input Stage
-
-void get_input_stage_buffer(char *stage_buffer, unsigned int stage_size, Operation_inputs_info curr_stage_info){
-
-  unsigned int index = 0;
-
-  memset(stage_buffer,0,STAGE_SIZE);
-  Blob_Stage_data current_stage_data;
-
-
-  current_stage_data = get_input_stage_layer(curr_stage_info);
-
-  //TODO create the stage_buffer from current_stage_data variable;
-  //copy the stagename;
-  memset((stage_buffer+index),0,SIZE_OF_STAGE_NAME);
-  memcpy((stage_buffer+index),current_stage_data.stage_name.c_str(),current_stage_data.stage_name.length());
-  index += SIZE_OF_STAGE_NAME; // move the index pointer by SIZE_OF_STAGE_NAME
-
-  *(stage_buffer+index) = current_stage_data.op_val;
-  index += sizeof(current_stage_data.op_val);
-
-  //  uint32_t opt_mask
-  *(stage_buffer+index++) = current_stage_data.opt_mask;
-  *(stage_buffer+index++) = current_stage_data.opt_mask >> 8;
-  *(stage_buffer+index++) = current_stage_data.opt_mask >> 16;
-  *(stage_buffer+index++) = current_stage_data.opt_mask >> 24;
-
-  *(stage_buffer+index) = current_stage_data.radixX;
-  index += sizeof(current_stage_data.radixX);
-  *(stage_buffer+index) = current_stage_data.radixY;
-  index += sizeof(current_stage_data.radixY);
-
-  *(stage_buffer+index) = current_stage_data.strideX;
-  index += sizeof(current_stage_data.strideX);
-  *(stage_buffer+index) = current_stage_data.strideY;
-  index += sizeof(current_stage_data.strideY);
-
-  *(stage_buffer+index) = current_stage_data.padX;
-  index += sizeof(current_stage_data.padX);
-  *(stage_buffer+index) = current_stage_data.padY;
-  index += sizeof(current_stage_data.padY);
-  *(stage_buffer+index) = current_stage_data.padStyle_value;
-  index += sizeof(current_stage_data.padStyle_value);
-
-  //  uint32_t inputDimX
-  *(stage_buffer+index++) = current_stage_data.inputDimX;
-  *(stage_buffer+index++) = current_stage_data.inputDimX >> 8;
-  *(stage_buffer+index++) = current_stage_data.inputDimX >> 16;
-  *(stage_buffer+index++) = current_stage_data.inputDimX >> 24;
-
-  //  uint32_t inputDimY
-  *(stage_buffer+index++) = current_stage_data.inputDimY;
-  *(stage_buffer+index++) = current_stage_data.inputDimY >> 8;
-  *(stage_buffer+index++) = current_stage_data.inputDimY >> 16;
-  *(stage_buffer+index++) = current_stage_data.inputDimY >> 24;
-
-  // uint32_t inputDimZ
-  *(stage_buffer+index++) = current_stage_data.inputDimZ;
-  *(stage_buffer+index++) = current_stage_data.inputDimZ >> 8;
-  *(stage_buffer+index++) = current_stage_data.inputDimZ >> 16;
-  *(stage_buffer+index++) = current_stage_data.inputDimZ >> 24;
-
-  //  uint32_t tapDimX
-  *(stage_buffer+index++) = current_stage_data.tapDimX;
-  *(stage_buffer+index++) = current_stage_data.tapDimX >> 8;
-  *(stage_buffer+index++) = current_stage_data.tapDimX >> 16;
-  *(stage_buffer+index++) = current_stage_data.tapDimX >> 24;
-
-  //  uint32_t tapDimY
-  *(stage_buffer+index++) = current_stage_data.tapDimY;
-  *(stage_buffer+index++) = current_stage_data.tapDimY >> 8;
-  *(stage_buffer+index++) = current_stage_data.tapDimY >> 16;
-  *(stage_buffer+index++) = current_stage_data.tapDimY >> 24;
-
-  //  uint32_t tapDimZ
-  *(stage_buffer+index++) = current_stage_data.tapDimZ;
-  *(stage_buffer+index++) = current_stage_data.tapDimZ >> 8;
-  *(stage_buffer+index++) = current_stage_data.tapDimZ >> 16;
-  *(stage_buffer+index++) = current_stage_data.tapDimZ >> 24;
-
-  //  uint32_t outputDimX
-  *(stage_buffer+index++) = current_stage_data.outputDimX;
-  *(stage_buffer+index++) = current_stage_data.outputDimX >> 8;
-  *(stage_buffer+index++) = current_stage_data.outputDimX >> 16;
-  *(stage_buffer+index++) = current_stage_data.outputDimX >> 24;
-
-  //  uint32_t outputDimY
-  *(stage_buffer+index++) = current_stage_data.outputDimY;
-  *(stage_buffer+index++) = current_stage_data.outputDimY >> 8;
-  *(stage_buffer+index++) = current_stage_data.outputDimY >> 16;
-  *(stage_buffer+index++) = current_stage_data.outputDimY >> 24;
-
-  //  uint32_t outputDimZ
-  *(stage_buffer+index++) = current_stage_data.outputDimZ;
-  *(stage_buffer+index++) = current_stage_data.outputDimZ >> 8;
-  *(stage_buffer+index++) = current_stage_data.outputDimZ >> 16;
-  *(stage_buffer+index++) = current_stage_data.outputDimZ >> 24;
-
-  //  uint32_t inputStrideX
-  *(stage_buffer+index++) = current_stage_data.inputStrideX;
-  *(stage_buffer+index++) = current_stage_data.inputStrideX >> 8;
-  *(stage_buffer+index++) = current_stage_data.inputStrideX >> 16;
-  *(stage_buffer+index++) = current_stage_data.inputStrideX >> 24;
-
-  //  uint32_t inputStrideY
-  *(stage_buffer+index++) = current_stage_data.inputStrideY;
-  *(stage_buffer+index++) = current_stage_data.inputStrideY >> 8;
-  *(stage_buffer+index++) = current_stage_data.inputStrideY >> 16;
-  *(stage_buffer+index++) = current_stage_data.inputStrideY >> 24;
-
-  //  uint32_t inputStrideZ
-  *(stage_buffer+index++) = current_stage_data.inputStrideZ;
-  *(stage_buffer+index++) = current_stage_data.inputStrideZ >> 8;
-  *(stage_buffer+index++) = current_stage_data.inputStrideZ >> 16;
-  *(stage_buffer+index++) = current_stage_data.inputStrideZ >> 24;
-
-  //  uint32_t tapStrideX
-  *(stage_buffer+index++) = current_stage_data.tapStrideX;
-  *(stage_buffer+index++) = current_stage_data.tapStrideX >> 8;
-  *(stage_buffer+index++) = current_stage_data.tapStrideX >> 16;
-  *(stage_buffer+index++) = current_stage_data.tapStrideX >> 24;
-
-  //  uint32_t tapStrideY
-  *(stage_buffer+index++) = current_stage_data.tapStrideY;
-  *(stage_buffer+index++) = current_stage_data.tapStrideY >> 8;
-  *(stage_buffer+index++) = current_stage_data.tapStrideY >> 16;
-  *(stage_buffer+index++) = current_stage_data.tapStrideY >> 24;
-
-  //  uint32_t tapStrideZ
-  *(stage_buffer+index++) = current_stage_data.tapStrideZ;
-  *(stage_buffer+index++) = current_stage_data.tapStrideZ >> 8;
-  *(stage_buffer+index++) = current_stage_data.tapStrideZ >> 16;
-  *(stage_buffer+index++) = current_stage_data.tapStrideZ >> 24;
-
-  //  uint32_t outputStrideX
-  *(stage_buffer+index++) = current_stage_data.outputStrideX;
-  *(stage_buffer+index++) = current_stage_data.outputStrideX >> 8;
-  *(stage_buffer+index++) = current_stage_data.outputStrideX >> 16;
-  *(stage_buffer+index++) = current_stage_data.outputStrideX >> 24;
-
-  //  uint32_t outputStrideY
-  *(stage_buffer+index++) = current_stage_data.outputStrideY;
-  *(stage_buffer+index++) = current_stage_data.outputStrideY >> 8;
-  *(stage_buffer+index++) = current_stage_data.outputStrideY >> 16;
-  *(stage_buffer+index++) = current_stage_data.outputStrideY >> 24;
-
-  //  uint32_t outputStrideZ
-  *(stage_buffer+index++) = current_stage_data.outputStrideZ;
-  *(stage_buffer+index++) = current_stage_data.outputStrideZ >> 8;
-  *(stage_buffer+index++) = current_stage_data.outputStrideZ >> 16;
-  *(stage_buffer+index++) = current_stage_data.outputStrideZ >> 24;
-
-  *(stage_buffer+index) = current_stage_data.datatype_value;
-  index += sizeof(current_stage_data.datatype_value);
-  *(stage_buffer+index) = current_stage_data.precision_value;
-  index += sizeof(current_stage_data.precision_value);
-  *(stage_buffer+index) = current_stage_data.storageOrder_value;
-  index += sizeof(current_stage_data.storageOrder_value);
-
-  *(stage_buffer+index++) = current_stage_data.data_Pointer;
-  *(stage_buffer+index++) = current_stage_data.data_Pointer >> 8;
-  *(stage_buffer+index++) = current_stage_data.data_Pointer >> 16;
-  *(stage_buffer+index++) = current_stage_data.data_Pointer >> 24;
-
-  *(stage_buffer+index++) = current_stage_data.data_Index;
-  *(stage_buffer+index++) = current_stage_data.data_Index >> 8;
-
-  *(stage_buffer+index++) = current_stage_data.taps_Pointer;
-  *(stage_buffer+index++) = current_stage_data.taps_Pointer >> 8;
-  *(stage_buffer+index++) = current_stage_data.taps_Pointer >> 16;
-  *(stage_buffer+index++) = current_stage_data.taps_Pointer >> 24;
-
-  *(stage_buffer+index++) = current_stage_data.taps_Index;
-  *(stage_buffer+index++) = current_stage_data.taps_Index >> 8;
-
-
-  *(stage_buffer+index++) = current_stage_data.bias_Pointer;
-  *(stage_buffer+index++) = current_stage_data.bias_Pointer >> 8;
-  *(stage_buffer+index++) = current_stage_data.bias_Pointer >> 16;
-  *(stage_buffer+index++) = current_stage_data.bias_Pointer >> 24;
-
-  *(stage_buffer+index++) = current_stage_data.bias_Index;
-  *(stage_buffer+index++) = current_stage_data.bias_Index >> 8;
-
-  *(stage_buffer+index++) = current_stage_data.opPrarams_Pointer;
-  *(stage_buffer+index++) = current_stage_data.opPrarams_Pointer >> 8;
-  *(stage_buffer+index++) = current_stage_data.opPrarams_Pointer >> 16;
-  *(stage_buffer+index++) = current_stage_data.opPrarams_Pointer >> 24;
-
-  *(stage_buffer+index++) = current_stage_data.opPrarams_Index;
-  *(stage_buffer+index++) = current_stage_data.opPrarams_Index >> 8;
-
-  *(stage_buffer+index++) = current_stage_data.output_Pointer;
-  *(stage_buffer+index++) = current_stage_data.output_Pointer >> 8;
-  *(stage_buffer+index++) = current_stage_data.output_Pointer >> 16;
-  *(stage_buffer+index++) = current_stage_data.output_Pointer >> 24;
-
-  *(stage_buffer+index++) = current_stage_data.output_Index;
-  *(stage_buffer+index++) = current_stage_data.output_Index >> 8;
-
-  *(stage_buffer+index) = current_stage_data.preOp_value;
-  index += sizeof(current_stage_data.preOp_value);
-  *(stage_buffer+index) = current_stage_data.postOp_value;
-  index += sizeof(current_stage_data.postOp_value);
-
-  *(stage_buffer+index++) = current_stage_data.post_param1[0];
-  *(stage_buffer+index++) = current_stage_data.post_param1[1];
-  *(stage_buffer+index++) = current_stage_data.post_param1[2];
-  *(stage_buffer+index++) = current_stage_data.post_param1[3];
-
-
-  *(stage_buffer+index) = current_stage_data.post_strideX;
-  index += sizeof(current_stage_data.post_strideX);
-  *(stage_buffer+index) = current_stage_data.post_strideY;
-  index += sizeof(current_stage_data.post_strideY);
-
-  if(DEBUG_get_input_stage_buffer){
-    ALOGD("current_stage_data.stage_name: %s",current_stage_data.stage_name.c_str());
-    ALOGD("current_stage_data.op_val: %d",current_stage_data.op_val);
-    ALOGD("current_stage_data.opt_mask: %u",current_stage_data.opt_mask);
-    ALOGD("current_stage_data.radixX: %d",current_stage_data.radixX);
-    ALOGD("current_stage_data.radixY: %d",current_stage_data.radixY);
-    ALOGD("current_stage_data.strideX: %d",current_stage_data.strideX);
-    ALOGD("current_stage_data.strideY: %d",current_stage_data.strideY);
-    ALOGD("current_stage_data.padX: %d",current_stage_data.padX);
-    ALOGD("current_stage_data.padY: %d",current_stage_data.padY);
-    ALOGD("current_stage_data.padStyle_value: %d",current_stage_data.padStyle_value);
-
-    ALOGD("current_stage_data.inputDimX: %u",current_stage_data.inputDimX);
-    ALOGD("current_stage_data.inputDimY: %u",current_stage_data.inputDimY);
-    ALOGD("current_stage_data.inputDimZ: %u",current_stage_data.inputDimZ);
-    ALOGD("current_stage_data.tapDimX: %u",current_stage_data.tapDimX);
-    ALOGD("current_stage_data.tapDimY: %u",current_stage_data.tapDimY);
-    ALOGD("current_stage_data.tapDimZ: %u",current_stage_data.tapDimZ);
-    ALOGD("current_stage_data.outputDimX: %u",current_stage_data.outputDimX);
-    ALOGD("current_stage_data.outputDimY: %u",current_stage_data.outputDimY);
-    ALOGD("current_stage_data.outputDimZ: %u",current_stage_data.outputDimZ);
-
-    ALOGD("current_stage_data.inputStrideX: %u",current_stage_data.inputStrideX);
-    ALOGD("current_stage_data.inputStrideY: %u",current_stage_data.inputStrideY);
-    ALOGD("current_stage_data.inputStrideZ: %u",current_stage_data.inputStrideZ);
-    ALOGD("current_stage_data.tapStrideX: %u",current_stage_data.tapStrideX);
-    ALOGD("current_stage_data.tapStrideY: %u",current_stage_data.tapStrideY);
-    ALOGD("current_stage_data.tapStrideZ: %u",current_stage_data.tapStrideZ);
-    ALOGD("current_stage_data.outputStrideX: %u",current_stage_data.outputStrideX);
-    ALOGD("current_stage_data.outputStrideY: %u",current_stage_data.outputStrideY);
-    ALOGD("current_stage_data.outputStrideZ: %u",current_stage_data.outputStrideZ);
-
-    ALOGD("current_stage_data.datatype_value: %d",current_stage_data.datatype_value);
-    ALOGD("current_stage_data.precision_value: %d",current_stage_data.precision_value);
-    ALOGD("current_stage_data.storageOrder_value: %d",current_stage_data.storageOrder_value);
-
-    ALOGD("current_stage_data.data_Pointer: %u",current_stage_data.data_Pointer);
-    ALOGD("current_stage_data.data_Index: %u",current_stage_data.data_Index);
-
-    ALOGD("current_stage_data.taps_Pointer: %u",current_stage_data.taps_Pointer);
-    ALOGD("current_stage_data.taps_Index: %u",current_stage_data.taps_Index);
-
-    ALOGD("current_stage_data.bias_Pointer: %u",current_stage_data.bias_Pointer);
-    ALOGD("current_stage_data.bias_Index: %u",current_stage_data.bias_Index);
-
-    ALOGD("current_stage_data.opPrarams_Pointer: %u",current_stage_data.opPrarams_Pointer);
-    ALOGD("current_stage_data.opPrarams_Index: %u",current_stage_data.opPrarams_Index);
-
-    ALOGD("current_stage_data.output_Pointer: %u",current_stage_data.output_Pointer);
-    ALOGD("current_stage_data.output_Index: %u",current_stage_data.output_Index);
-
-    ALOGD("current_stage_data.preOp_value: %d",current_stage_data.preOp_value);
-    ALOGD("current_stage_data.postOp_value: %d",current_stage_data.postOp_value);
-
-    ALOGD("current_stage_data.post_param1[0]: %d",current_stage_data.post_param1[0]);
-    ALOGD("current_stage_data.post_param1[1]: %d",current_stage_data.post_param1[1]);
-    ALOGD("current_stage_data.post_param1[2]: %d",current_stage_data.post_param1[2]);
-    ALOGD("current_stage_data.post_param1[3]: %d",current_stage_data.post_param1[3]);
-
-    ALOGD("current_stage_data.post_strideX: %d",current_stage_data.post_strideX);
-    ALOGD("current_stage_data.post_strideY: %d",current_stage_data.post_strideY);
-  }
-}
-
-
-
-void get_stage_buffer(char *stage_buffer, NCSoperations curr_operation, unsigned int stage_size, Operation_inputs_info curr_stage_info){
-
-  unsigned int index = 0;
-  Blob_Stage_data current_stage_data;
-
-  ALOGD("Opertion Index is : %d", curr_operation);
-
-  switch (curr_operation) {
-    case LOGISTIC:  current_stage_data = get_LOGISTIC_stage_data(curr_stage_info); break;
-    case TANH : current_stage_data = get_TANH_stage_data(curr_stage_info); break;
-    case RELU : current_stage_data = get_RELU_stage_data(curr_stage_info); break;
-    case RELU1 : current_stage_data = get_RELU1_stage_data(curr_stage_info); break;
-    case RELU6 : current_stage_data = get_RELU6_stage_data(curr_stage_info); break;
-    case CONV_2D : current_stage_data = get_CONV_2D_stage_data(curr_stage_info); break;
-    case DEPTHWISE_CONV_2D : current_stage_data = get_DEPTHWISE_CONV_2D_stage_data(curr_stage_info); break;
-    case AVERAGE_POOL_2D : current_stage_data = get_AVG_POOL_stage_data(curr_stage_info); break;
-	case MAX_POOL_2D : current_stage_data = get_MAX_POOL_stage_data(curr_stage_info); break;
-    case RESHAPE : current_stage_data = get_Reshape_stage_data(curr_stage_info); break;
-    case SOFTMAX : current_stage_data = get_Softmax_stage_data(curr_stage_info); break;
-    default: break;
-  }
-  //TODO create the stage_buffer from current_stage_data variable;
-  //copy the stagename;
-  memset((stage_buffer+index),0,SIZE_OF_STAGE_NAME);
-  memcpy((stage_buffer+index),current_stage_data.stage_name.c_str(),current_stage_data.stage_name.length());
-  index += SIZE_OF_STAGE_NAME; // move the index pointer by SIZE_OF_STAGE_NAME
-
-  *(stage_buffer+index) = current_stage_data.op_val;
-  index += sizeof(current_stage_data.op_val);
-
-  //  uint32_t opt_mask
-  *(stage_buffer+index++) = current_stage_data.opt_mask;
-  *(stage_buffer+index++) = current_stage_data.opt_mask >> 8;
-  *(stage_buffer+index++) = current_stage_data.opt_mask >> 16;
-  *(stage_buffer+index++) = current_stage_data.opt_mask >> 24;
-
-  *(stage_buffer+index) = current_stage_data.radixX;
-  index += sizeof(current_stage_data.radixX);
-  *(stage_buffer+index) = current_stage_data.radixY;
-  index += sizeof(current_stage_data.radixY);
-
-  *(stage_buffer+index) = current_stage_data.strideX;
-  index += sizeof(current_stage_data.strideX);
-  *(stage_buffer+index) = current_stage_data.strideY;
-  index += sizeof(current_stage_data.strideY);
-
-  *(stage_buffer+index) = current_stage_data.padX;
-  index += sizeof(current_stage_data.padX);
-  *(stage_buffer+index) = current_stage_data.padY;
-  index += sizeof(current_stage_data.padY);
-  *(stage_buffer+index) = current_stage_data.padStyle_value;
-  index += sizeof(current_stage_data.padStyle_value);
-
-  //  uint32_t inputDimX
-  *(stage_buffer+index++) = current_stage_data.inputDimX;
-  *(stage_buffer+index++) = current_stage_data.inputDimX >> 8;
-  *(stage_buffer+index++) = current_stage_data.inputDimX >> 16;
-  *(stage_buffer+index++) = current_stage_data.inputDimX >> 24;
-
-  //  uint32_t inputDimY
-  *(stage_buffer+index++) = current_stage_data.inputDimY;
-  *(stage_buffer+index++) = current_stage_data.inputDimY >> 8;
-  *(stage_buffer+index++) = current_stage_data.inputDimY >> 16;
-  *(stage_buffer+index++) = current_stage_data.inputDimY >> 24;
-
-  // uint32_t inputDimZ
-  *(stage_buffer+index++) = current_stage_data.inputDimZ;
-  *(stage_buffer+index++) = current_stage_data.inputDimZ >> 8;
-  *(stage_buffer+index++) = current_stage_data.inputDimZ >> 16;
-  *(stage_buffer+index++) = current_stage_data.inputDimZ >> 24;
-
-  //  uint32_t tapDimX
-  *(stage_buffer+index++) = current_stage_data.tapDimX;
-  *(stage_buffer+index++) = current_stage_data.tapDimX >> 8;
-  *(stage_buffer+index++) = current_stage_data.tapDimX >> 16;
-  *(stage_buffer+index++) = current_stage_data.tapDimX >> 24;
-
-  //  uint32_t tapDimY
-  *(stage_buffer+index++) = current_stage_data.tapDimY;
-  *(stage_buffer+index++) = current_stage_data.tapDimY >> 8;
-  *(stage_buffer+index++) = current_stage_data.tapDimY >> 16;
-  *(stage_buffer+index++) = current_stage_data.tapDimY >> 24;
-
-  //  uint32_t tapDimZ
-  *(stage_buffer+index++) = current_stage_data.tapDimZ;
-  *(stage_buffer+index++) = current_stage_data.tapDimZ >> 8;
-  *(stage_buffer+index++) = current_stage_data.tapDimZ >> 16;
-  *(stage_buffer+index++) = current_stage_data.tapDimZ >> 24;
-
-  //  uint32_t outputDimX
-  *(stage_buffer+index++) = current_stage_data.outputDimX;
-  *(stage_buffer+index++) = current_stage_data.outputDimX >> 8;
-  *(stage_buffer+index++) = current_stage_data.outputDimX >> 16;
-  *(stage_buffer+index++) = current_stage_data.outputDimX >> 24;
-
-  //  uint32_t outputDimY
-  *(stage_buffer+index++) = current_stage_data.outputDimY;
-  *(stage_buffer+index++) = current_stage_data.outputDimY >> 8;
-  *(stage_buffer+index++) = current_stage_data.outputDimY >> 16;
-  *(stage_buffer+index++) = current_stage_data.outputDimY >> 24;
-
-  //  uint32_t outputDimZ
-  *(stage_buffer+index++) = current_stage_data.outputDimZ;
-  *(stage_buffer+index++) = current_stage_data.outputDimZ >> 8;
-  *(stage_buffer+index++) = current_stage_data.outputDimZ >> 16;
-  *(stage_buffer+index++) = current_stage_data.outputDimZ >> 24;
-
-  //  uint32_t inputStrideX
-  *(stage_buffer+index++) = current_stage_data.inputStrideX;
-  *(stage_buffer+index++) = current_stage_data.inputStrideX >> 8;
-  *(stage_buffer+index++) = current_stage_data.inputStrideX >> 16;
-  *(stage_buffer+index++) = current_stage_data.inputStrideX >> 24;
-
-  //  uint32_t inputStrideY
-  *(stage_buffer+index++) = current_stage_data.inputStrideY;
-  *(stage_buffer+index++) = current_stage_data.inputStrideY >> 8;
-  *(stage_buffer+index++) = current_stage_data.inputStrideY >> 16;
-  *(stage_buffer+index++) = current_stage_data.inputStrideY >> 24;
-
-  //  uint32_t inputStrideZ
-  *(stage_buffer+index++) = current_stage_data.inputStrideZ;
-  *(stage_buffer+index++) = current_stage_data.inputStrideZ >> 8;
-  *(stage_buffer+index++) = current_stage_data.inputStrideZ >> 16;
-  *(stage_buffer+index++) = current_stage_data.inputStrideZ >> 24;
-
-  //  uint32_t tapStrideX
-  *(stage_buffer+index++) = current_stage_data.tapStrideX;
-  *(stage_buffer+index++) = current_stage_data.tapStrideX >> 8;
-  *(stage_buffer+index++) = current_stage_data.tapStrideX >> 16;
-  *(stage_buffer+index++) = current_stage_data.tapStrideX >> 24;
-
-  //  uint32_t tapStrideY
-  *(stage_buffer+index++) = current_stage_data.tapStrideY;
-  *(stage_buffer+index++) = current_stage_data.tapStrideY >> 8;
-  *(stage_buffer+index++) = current_stage_data.tapStrideY >> 16;
-  *(stage_buffer+index++) = current_stage_data.tapStrideY >> 24;
-
-  //  uint32_t tapStrideZ
-  *(stage_buffer+index++) = current_stage_data.tapStrideZ;
-  *(stage_buffer+index++) = current_stage_data.tapStrideZ >> 8;
-  *(stage_buffer+index++) = current_stage_data.tapStrideZ >> 16;
-  *(stage_buffer+index++) = current_stage_data.tapStrideZ >> 24;
-
-  //  uint32_t outputStrideX
-  *(stage_buffer+index++) = current_stage_data.outputStrideX;
-  *(stage_buffer+index++) = current_stage_data.outputStrideX >> 8;
-  *(stage_buffer+index++) = current_stage_data.outputStrideX >> 16;
-  *(stage_buffer+index++) = current_stage_data.outputStrideX >> 24;
-
-  //  uint32_t outputStrideY
-  *(stage_buffer+index++) = current_stage_data.outputStrideY;
-  *(stage_buffer+index++) = current_stage_data.outputStrideY >> 8;
-  *(stage_buffer+index++) = current_stage_data.outputStrideY >> 16;
-  *(stage_buffer+index++) = current_stage_data.outputStrideY >> 24;
-
-  //  uint32_t outputStrideZ
-  *(stage_buffer+index++) = current_stage_data.outputStrideZ;
-  *(stage_buffer+index++) = current_stage_data.outputStrideZ >> 8;
-  *(stage_buffer+index++) = current_stage_data.outputStrideZ >> 16;
-  *(stage_buffer+index++) = current_stage_data.outputStrideZ >> 24;
-
-  *(stage_buffer+index) = current_stage_data.datatype_value;
-  index += sizeof(current_stage_data.datatype_value);
-  *(stage_buffer+index) = current_stage_data.precision_value;
-  index += sizeof(current_stage_data.precision_value);
-  *(stage_buffer+index) = current_stage_data.storageOrder_value;
-  index += sizeof(current_stage_data.storageOrder_value);
-
-  *(stage_buffer+index++) = current_stage_data.data_Pointer;
-  *(stage_buffer+index++) = current_stage_data.data_Pointer >> 8;
-  *(stage_buffer+index++) = current_stage_data.data_Pointer >> 16;
-  *(stage_buffer+index++) = current_stage_data.data_Pointer >> 24;
-
-  *(stage_buffer+index++) = current_stage_data.data_Index;
-  *(stage_buffer+index++) = current_stage_data.data_Index >> 8;
-
-  *(stage_buffer+index++) = current_stage_data.taps_Pointer;
-  *(stage_buffer+index++) = current_stage_data.taps_Pointer >> 8;
-  *(stage_buffer+index++) = current_stage_data.taps_Pointer >> 16;
-  *(stage_buffer+index++) = current_stage_data.taps_Pointer >> 24;
-
-  *(stage_buffer+index++) = current_stage_data.taps_Index;
-  *(stage_buffer+index++) = current_stage_data.taps_Index >> 8;
-
-
-  *(stage_buffer+index++) = current_stage_data.bias_Pointer;
-  *(stage_buffer+index++) = current_stage_data.bias_Pointer >> 8;
-  *(stage_buffer+index++) = current_stage_data.bias_Pointer >> 16;
-  *(stage_buffer+index++) = current_stage_data.bias_Pointer >> 24;
-
-  *(stage_buffer+index++) = current_stage_data.bias_Index;
-  *(stage_buffer+index++) = current_stage_data.bias_Index >> 8;
-
-  *(stage_buffer+index++) = current_stage_data.opPrarams_Pointer;
-  *(stage_buffer+index++) = current_stage_data.opPrarams_Pointer >> 8;
-  *(stage_buffer+index++) = current_stage_data.opPrarams_Pointer >> 16;
-  *(stage_buffer+index++) = current_stage_data.opPrarams_Pointer >> 24;
-
-  *(stage_buffer+index++) = current_stage_data.opPrarams_Index;
-  *(stage_buffer+index++) = current_stage_data.opPrarams_Index >> 8;
-
-  *(stage_buffer+index++) = current_stage_data.output_Pointer;
-  *(stage_buffer+index++) = current_stage_data.output_Pointer >> 8;
-  *(stage_buffer+index++) = current_stage_data.output_Pointer >> 16;
-  *(stage_buffer+index++) = current_stage_data.output_Pointer >> 24;
-
-  *(stage_buffer+index++) = current_stage_data.output_Index;
-  *(stage_buffer+index++) = current_stage_data.output_Index >> 8;
-
-  *(stage_buffer+index) = current_stage_data.preOp_value;
-  index += sizeof(current_stage_data.preOp_value);
-  *(stage_buffer+index) = current_stage_data.postOp_value;
-  index += sizeof(current_stage_data.postOp_value);
-
-  *(stage_buffer+index++) = current_stage_data.post_param1[0];
-  *(stage_buffer+index++) = current_stage_data.post_param1[1];
-  *(stage_buffer+index++) = current_stage_data.post_param1[2];
-  *(stage_buffer+index++) = current_stage_data.post_param1[3];
-
-
-  *(stage_buffer+index) = current_stage_data.post_strideX;
-  index += sizeof(current_stage_data.post_strideX);
-  *(stage_buffer+index) = current_stage_data.post_strideY;
-  index += sizeof(current_stage_data.post_strideY);
-
-  if(DEBUG_get_stage_buffer){
-    ALOGD("current_stage_data.stage_name: %s",current_stage_data.stage_name.c_str());
-    ALOGD("current_stage_data.op_val: %d",current_stage_data.op_val);
-    ALOGD("current_stage_data.opt_mask: %lu",current_stage_data.opt_mask);
-    ALOGD("current_stage_data.radixX: %d",current_stage_data.radixX);
-    ALOGD("current_stage_data.radixY: %d",current_stage_data.radixY);
-    ALOGD("current_stage_data.strideX: %d",current_stage_data.strideX);
-    ALOGD("current_stage_data.strideY: %d",current_stage_data.strideY);
-    ALOGD("current_stage_data.padX: %d",current_stage_data.padX);
-    ALOGD("current_stage_data.padY: %d",current_stage_data.padY);
-    ALOGD("current_stage_data.padStyle_value: %d",current_stage_data.padStyle_value);
-
-    ALOGD("current_stage_data.inputDimX: %lu",current_stage_data.inputDimX);
-    ALOGD("current_stage_data.inputDimY: %lu",current_stage_data.inputDimY);
-    ALOGD("current_stage_data.inputDimZ: %lu",current_stage_data.inputDimZ);
-    ALOGD("current_stage_data.tapDimX: %lu",current_stage_data.tapDimX);
-    ALOGD("current_stage_data.tapDimY: %lu",current_stage_data.tapDimY);
-    ALOGD("current_stage_data.tapDimZ: %lu",current_stage_data.tapDimZ);
-    ALOGD("current_stage_data.outputDimX: %lu",current_stage_data.outputDimX);
-    ALOGD("current_stage_data.outputDimY: %lu",current_stage_data.outputDimY);
-    ALOGD("current_stage_data.outputDimZ: %lu",current_stage_data.outputDimZ);
-
-    ALOGD("current_stage_data.inputStrideX: %lu",current_stage_data.inputStrideX);
-    ALOGD("current_stage_data.inputStrideY: %lu",current_stage_data.inputStrideY);
-    ALOGD("current_stage_data.inputStrideZ: %lu",current_stage_data.inputStrideZ);
-    ALOGD("current_stage_data.tapStrideX: %lu",current_stage_data.tapStrideX);
-    ALOGD("current_stage_data.tapStrideY: %lu",current_stage_data.tapStrideY);
-    ALOGD("current_stage_data.tapStrideZ: %lu",current_stage_data.tapStrideZ);
-    ALOGD("current_stage_data.outputStrideX: %lu",current_stage_data.outputStrideX);
-    ALOGD("current_stage_data.outputStrideY: %lu",current_stage_data.outputStrideY);
-    ALOGD("current_stage_data.outputStrideZ: %lu",current_stage_data.outputStrideZ);
-
-    ALOGD("current_stage_data.datatype_value: %d",current_stage_data.datatype_value);
-    ALOGD("current_stage_data.precision_value: %d",current_stage_data.precision_value);
-    ALOGD("current_stage_data.storageOrder_value: %d",current_stage_data.storageOrder_value);
-
-    ALOGD("current_stage_data.data_Pointer: %u",current_stage_data.data_Pointer);
-    ALOGD("current_stage_data.data_Index: %u",current_stage_data.data_Index);
-
-    ALOGD("current_stage_data.taps_Pointer: %u",current_stage_data.taps_Pointer);
-    ALOGD("current_stage_data.taps_Index: %u",current_stage_data.taps_Index);
-
-    ALOGD("current_stage_data.bias_Pointer: %u",current_stage_data.bias_Pointer);
-    ALOGD("current_stage_data.bias_Index: %u",current_stage_data.bias_Index);
-
-    ALOGD("current_stage_data.opPrarams_Pointer: %u",current_stage_data.opPrarams_Pointer);
-    ALOGD("current_stage_data.opPrarams_Index: %u",current_stage_data.opPrarams_Index);
-
-    ALOGD("current_stage_data.output_Pointer: %u",current_stage_data.output_Pointer);
-    ALOGD("current_stage_data.output_Index: %u",current_stage_data.output_Index);
-
-    ALOGD("current_stage_data.preOp_value: %d",current_stage_data.preOp_value);
-    ALOGD("current_stage_data.postOp_value: %d",current_stage_data.postOp_value);
-
-    ALOGD("current_stage_data.post_param1[0]: %d",current_stage_data.post_param1[0]);
-    ALOGD("current_stage_data.post_param1[1]: %d",current_stage_data.post_param1[1]);
-    ALOGD("current_stage_data.post_param1[2]: %d",current_stage_data.post_param1[2]);
-    ALOGD("current_stage_data.post_param1[3]: %d",current_stage_data.post_param1[3]);
-
-    ALOGD("current_stage_data.post_strideX: %d",current_stage_data.post_strideX);
-    ALOGD("current_stage_data.post_strideY: %d",current_stage_data.post_strideY);
-  }
-
-}
-
-void get_first_stage_buffer(char *stage_buffer, NCSoperations curr_operation, unsigned int stage_size, Operation_inputs_info curr_stage_info){
-  unsigned int index = 0;
-  Blob_Stage_data current_stage_data;
-  ALOGD("Opertion Index is : %d", curr_operation);
-
-  switch (curr_operation) {
-    case LOGISTIC:  current_stage_data = get_LOGISTIC_stage_data(curr_stage_info); break;
-    case TANH : current_stage_data = get_TANH_stage_data(curr_stage_info); break;
-    case RELU : current_stage_data = get_RELU_stage_data(curr_stage_info); break;
-    case RELU1 : current_stage_data = get_RELU1_stage_data(curr_stage_info); break;
-    case RELU6 : current_stage_data = get_RELU6_stage_data(curr_stage_info); break;
-    case CONV_2D : current_stage_data = get_CONV_2D_stage_data(curr_stage_info); break;
-    case DEPTHWISE_CONV_2D : current_stage_data = get_DEPTHWISE_CONV_2D_stage_data(curr_stage_info); break;
-    case AVERAGE_POOL_2D : current_stage_data = get_AVG_POOL_stage_data(curr_stage_info); break;
-	case MAX_POOL_2D : current_stage_data = get_MAX_POOL_stage_data(curr_stage_info); break;
-    case RESHAPE : current_stage_data = get_Reshape_stage_data(curr_stage_info); break;
-    case SOFTMAX : current_stage_data = get_Softmax_stage_data(curr_stage_info); break;
-    default: break;
-  }
-
-  //TODO create the stage_buffer from current_stage_data variable;
-  //copy the stagename;
-  memset((stage_buffer+index),0,SIZE_OF_STAGE_NAME);
-  memcpy((stage_buffer+index),current_stage_data.stage_name.c_str(),current_stage_data.stage_name.length());
-  index += SIZE_OF_STAGE_NAME; // move the index pointer by SIZE_OF_STAGE_NAME
-
-  *(stage_buffer+index) = current_stage_data.op_val;
-  index += sizeof(current_stage_data.op_val);
-
-  //  uint32_t opt_mask
-  *(stage_buffer+index++) = current_stage_data.opt_mask;
-  *(stage_buffer+index++) = current_stage_data.opt_mask >> 8;
-  *(stage_buffer+index++) = current_stage_data.opt_mask >> 16;
-  *(stage_buffer+index++) = current_stage_data.opt_mask >> 24;
-
-  *(stage_buffer+index) = current_stage_data.radixX;
-  index += sizeof(current_stage_data.radixX);
-  *(stage_buffer+index) = current_stage_data.radixY;
-  index += sizeof(current_stage_data.radixY);
-
-  *(stage_buffer+index) = current_stage_data.strideX;
-  index += sizeof(current_stage_data.strideX);
-  *(stage_buffer+index) = current_stage_data.strideY;
-  index += sizeof(current_stage_data.strideY);
-
-  *(stage_buffer+index) = current_stage_data.padX;
-  index += sizeof(current_stage_data.padX);
-  *(stage_buffer+index) = current_stage_data.padY;
-  index += sizeof(current_stage_data.padY);
-  *(stage_buffer+index) = current_stage_data.padStyle_value;
-  index += sizeof(current_stage_data.padStyle_value);
-
-  //  uint32_t inputDimX
-  *(stage_buffer+index++) = current_stage_data.inputDimX;
-  *(stage_buffer+index++) = current_stage_data.inputDimX >> 8;
-  *(stage_buffer+index++) = current_stage_data.inputDimX >> 16;
-  *(stage_buffer+index++) = current_stage_data.inputDimX >> 24;
-
-  //  uint32_t inputDimY
-  *(stage_buffer+index++) = current_stage_data.inputDimY;
-  *(stage_buffer+index++) = current_stage_data.inputDimY >> 8;
-  *(stage_buffer+index++) = current_stage_data.inputDimY >> 16;
-  *(stage_buffer+index++) = current_stage_data.inputDimY >> 24;
-
-  // uint32_t inputDimZ
-  *(stage_buffer+index++) = current_stage_data.inputDimZ;
-  *(stage_buffer+index++) = current_stage_data.inputDimZ >> 8;
-  *(stage_buffer+index++) = current_stage_data.inputDimZ >> 16;
-  *(stage_buffer+index++) = current_stage_data.inputDimZ >> 24;
-
-  //  uint32_t tapDimX
-  *(stage_buffer+index++) = current_stage_data.tapDimX;
-  *(stage_buffer+index++) = current_stage_data.tapDimX >> 8;
-  *(stage_buffer+index++) = current_stage_data.tapDimX >> 16;
-  *(stage_buffer+index++) = current_stage_data.tapDimX >> 24;
-
-  //  uint32_t tapDimY
-  *(stage_buffer+index++) = current_stage_data.tapDimY;
-  *(stage_buffer+index++) = current_stage_data.tapDimY >> 8;
-  *(stage_buffer+index++) = current_stage_data.tapDimY >> 16;
-  *(stage_buffer+index++) = current_stage_data.tapDimY >> 24;
-
-  //  uint32_t tapDimZ
-  *(stage_buffer+index++) = current_stage_data.tapDimZ;
-  *(stage_buffer+index++) = current_stage_data.tapDimZ >> 8;
-  *(stage_buffer+index++) = current_stage_data.tapDimZ >> 16;
-  *(stage_buffer+index++) = current_stage_data.tapDimZ >> 24;
-
-  //  uint32_t outputDimX
-  *(stage_buffer+index++) = current_stage_data.outputDimX;
-  *(stage_buffer+index++) = current_stage_data.outputDimX >> 8;
-  *(stage_buffer+index++) = current_stage_data.outputDimX >> 16;
-  *(stage_buffer+index++) = current_stage_data.outputDimX >> 24;
-
-  //  uint32_t outputDimY
-  *(stage_buffer+index++) = current_stage_data.outputDimY;
-  *(stage_buffer+index++) = current_stage_data.outputDimY >> 8;
-  *(stage_buffer+index++) = current_stage_data.outputDimY >> 16;
-  *(stage_buffer+index++) = current_stage_data.outputDimY >> 24;
-
-  //  uint32_t outputDimZ
-  *(stage_buffer+index++) = current_stage_data.outputDimZ;
-  *(stage_buffer+index++) = current_stage_data.outputDimZ >> 8;
-  *(stage_buffer+index++) = current_stage_data.outputDimZ >> 16;
-  *(stage_buffer+index++) = current_stage_data.outputDimZ >> 24;
-
-  //  uint32_t inputStrideX
-  *(stage_buffer+index++) = current_stage_data.inputStrideX;
-  *(stage_buffer+index++) = current_stage_data.inputStrideX >> 8;
-  *(stage_buffer+index++) = current_stage_data.inputStrideX >> 16;
-  *(stage_buffer+index++) = current_stage_data.inputStrideX >> 24;
-
-  //  uint32_t inputStrideY
-  *(stage_buffer+index++) = current_stage_data.inputStrideY;
-  *(stage_buffer+index++) = current_stage_data.inputStrideY >> 8;
-  *(stage_buffer+index++) = current_stage_data.inputStrideY >> 16;
-  *(stage_buffer+index++) = current_stage_data.inputStrideY >> 24;
-
-  //  uint32_t inputStrideZ
-  *(stage_buffer+index++) = current_stage_data.inputStrideZ;
-  *(stage_buffer+index++) = current_stage_data.inputStrideZ >> 8;
-  *(stage_buffer+index++) = current_stage_data.inputStrideZ >> 16;
-  *(stage_buffer+index++) = current_stage_data.inputStrideZ >> 24;
-
-  //  uint32_t tapStrideX
-  *(stage_buffer+index++) = current_stage_data.tapStrideX;
-  *(stage_buffer+index++) = current_stage_data.tapStrideX >> 8;
-  *(stage_buffer+index++) = current_stage_data.tapStrideX >> 16;
-  *(stage_buffer+index++) = current_stage_data.tapStrideX >> 24;
-
-  //  uint32_t tapStrideY
-  *(stage_buffer+index++) = current_stage_data.tapStrideY;
-  *(stage_buffer+index++) = current_stage_data.tapStrideY >> 8;
-  *(stage_buffer+index++) = current_stage_data.tapStrideY >> 16;
-  *(stage_buffer+index++) = current_stage_data.tapStrideY >> 24;
-
-  //  uint32_t tapStrideZ
-  *(stage_buffer+index++) = current_stage_data.tapStrideZ;
-  *(stage_buffer+index++) = current_stage_data.tapStrideZ >> 8;
-  *(stage_buffer+index++) = current_stage_data.tapStrideZ >> 16;
-  *(stage_buffer+index++) = current_stage_data.tapStrideZ >> 24;
-
-  //  uint32_t outputStrideX
-  *(stage_buffer+index++) = current_stage_data.outputStrideX;
-  *(stage_buffer+index++) = current_stage_data.outputStrideX >> 8;
-  *(stage_buffer+index++) = current_stage_data.outputStrideX >> 16;
-  *(stage_buffer+index++) = current_stage_data.outputStrideX >> 24;
-
-  //  uint32_t outputStrideY
-  *(stage_buffer+index++) = current_stage_data.outputStrideY;
-  *(stage_buffer+index++) = current_stage_data.outputStrideY >> 8;
-  *(stage_buffer+index++) = current_stage_data.outputStrideY >> 16;
-  *(stage_buffer+index++) = current_stage_data.outputStrideY >> 24;
-
-  //  uint32_t outputStrideZ
-  *(stage_buffer+index++) = current_stage_data.outputStrideZ;
-  *(stage_buffer+index++) = current_stage_data.outputStrideZ >> 8;
-  *(stage_buffer+index++) = current_stage_data.outputStrideZ >> 16;
-  *(stage_buffer+index++) = current_stage_data.outputStrideZ >> 24;
-
-  *(stage_buffer+index) = current_stage_data.datatype_value;
-  index += sizeof(current_stage_data.datatype_value);
-  *(stage_buffer+index) = current_stage_data.precision_value;
-  index += sizeof(current_stage_data.precision_value);
-  *(stage_buffer+index) = current_stage_data.storageOrder_value;
-  index += sizeof(current_stage_data.storageOrder_value);
-
-  current_stage_data.data_Pointer = (uint32_t) FIRST_STAGE_DATA_POINTER;
-
-  *(stage_buffer+index++) = current_stage_data.data_Pointer;
-  *(stage_buffer+index++) = current_stage_data.data_Pointer >> 8;
-  *(stage_buffer+index++) = current_stage_data.data_Pointer >> 16;
-  *(stage_buffer+index++) = current_stage_data.data_Pointer >> 24;
-
-  current_stage_data.data_Index =(uint16_t) FIRST_STAGE_DATA_INDEX;
-
-  *(stage_buffer+index++) = current_stage_data.data_Index;
-  *(stage_buffer+index++) = current_stage_data.data_Index >> 8;
-
-  *(stage_buffer+index++) = current_stage_data.taps_Pointer;
-  *(stage_buffer+index++) = current_stage_data.taps_Pointer >> 8;
-  *(stage_buffer+index++) = current_stage_data.taps_Pointer >> 16;
-  *(stage_buffer+index++) = current_stage_data.taps_Pointer >> 24;
-
-  *(stage_buffer+index++) = current_stage_data.taps_Index;
-  *(stage_buffer+index++) = current_stage_data.taps_Index >> 8;
-
-
-  *(stage_buffer+index++) = current_stage_data.bias_Pointer;
-  *(stage_buffer+index++) = current_stage_data.bias_Pointer >> 8;
-  *(stage_buffer+index++) = current_stage_data.bias_Pointer >> 16;
-  *(stage_buffer+index++) = current_stage_data.bias_Pointer >> 24;
-
-  *(stage_buffer+index++) = current_stage_data.bias_Index;
-  *(stage_buffer+index++) = current_stage_data.bias_Index >> 8;
-
-  *(stage_buffer+index++) = current_stage_data.opPrarams_Pointer;
-  *(stage_buffer+index++) = current_stage_data.opPrarams_Pointer >> 8;
-  *(stage_buffer+index++) = current_stage_data.opPrarams_Pointer >> 16;
-  *(stage_buffer+index++) = current_stage_data.opPrarams_Pointer >> 24;
-
-  *(stage_buffer+index++) = current_stage_data.opPrarams_Index;
-  *(stage_buffer+index++) = current_stage_data.opPrarams_Index >> 8;
-
-  *(stage_buffer+index++) = current_stage_data.output_Pointer;
-  *(stage_buffer+index++) = current_stage_data.output_Pointer >> 8;
-  *(stage_buffer+index++) = current_stage_data.output_Pointer >> 16;
-  *(stage_buffer+index++) = current_stage_data.output_Pointer >> 24;
-
-  *(stage_buffer+index++) = current_stage_data.output_Index;
-  *(stage_buffer+index++) = current_stage_data.output_Index >> 8;
-
-  *(stage_buffer+index) = current_stage_data.preOp_value;
-  index += sizeof(current_stage_data.preOp_value);
-  *(stage_buffer+index) = current_stage_data.postOp_value;
-  index += sizeof(current_stage_data.postOp_value);
-
-  *(stage_buffer+index++) = current_stage_data.post_param1[0];
-  *(stage_buffer+index++) = current_stage_data.post_param1[1];
-  *(stage_buffer+index++) = current_stage_data.post_param1[2];
-  *(stage_buffer+index++) = current_stage_data.post_param1[3];
-
+bool is_network_tensor(const Network_Vector_Tensorinfo &tensors, uint32_t operand){
+  for(size_t i=0;i<tensors.size();i++)
+    if(tensors[i].operand == operand)
+      return true;
+  return false;
+}
 
-  *(stage_buffer+index) = current_stage_data.post_strideX;
-  index += sizeof(current_stage_data.post_strideX);
-  *(stage_buffer+index) = current_stage_data.post_strideY;
-  index += sizeof(current_stage_data.post_strideY);
+bool build_data_flow(Compile_context *ctx){
+  if(ctx->network.size() != ctx->stages_info.size() || ctx->stages_info.empty()){
+    ALOGE("network has %zu operations and %zu stages", ctx->network.size(), ctx->stages_info.size());
+    return false;
+  }
 
-  if(DEBUG_get_first_stage_buffer){
-    ALOGD("current_stage_data.stage_name: %s",current_stage_data.stage_name.c_str());
-    ALOGD("current_stage_data.op_val: %d",current_stage_data.op_val);
-    ALOGD("current_stage_data.opt_mask: %lu",current_stage_data.opt_mask);
-    ALOGD("current_stage_data.radixX: %d",current_stage_data.radixX);
-    ALOGD("current_stage_data.radixY: %d",current_stage_data.radixY);
-    ALOGD("current_stage_data.strideX: %d",current_stage_data.strideX);
-    ALOGD("current_stage_data.strideY: %d",current_stage_data.strideY);
-    ALOGD("current_stage_data.padX: %d",current_stage_data.padX);
-    ALOGD("current_stage_data.padY: %d",current_stage_data.padY);
-    ALOGD("current_stage_data.padStyle_value: %d",current_stage_data.padStyle_value);
+  //a chain, stage i reads operand i and writes operand i+1
+  if(ctx->inputs.empty()){
+    for(size_t i=0;i<ctx->stages_info.size();i++){
+      Operation_inputs_info &stage = ctx->stages_info.at(i);
+      stage.input_operands[0] = i;
+      stage.num_input_operands = 1;
+      stage.output_operand = i + 1;
+    }
+    Network_tensor_info input, output;
+    input.operand = 0;
+    memcpy(input.shape, ctx->stages_info.front().input_shape, sizeof(VpuShape));
+    output.operand = ctx->stages_info.size();
+    memcpy(output.shape, ctx->stages_info.back().output_shape, sizeof(VpuShape));
+    ctx->inputs.assign(1, input);
+    ctx->outputs.assign(1, output);
+    return true;
+  }
 
-    ALOGD("current_stage_data.inputDimX: %lu",current_stage_data.inputDimX);
-    ALOGD("current_stage_data.inputDimY: %lu",current_stage_data.inputDimY);
-    ALOGD("current_stage_data.inputDimZ: %lu",current_stage_data.inputDimZ);
-    ALOGD("current_stage_data.tapDimX: %lu",current_stage_data.tapDimX);
-    ALOGD("current_stage_data.tapDimY: %lu",current_stage_data.tapDimY);
-    ALOGD("current_stage_data.tapDimZ: %lu",current_stage_data.tapDimZ);
-    ALOGD("current_stage_data.outputDimX: %lu",current_stage_data.outputDimX);
-    ALOGD("current_stage_data.outputDimY: %lu",current_stage_data.outputDimY);
-    ALOGD("current_stage_data.outputDimZ: %lu",current_stage_data.outputDimZ);
+  std::map<uint32_t, bool> produced;
+  for(size_t i=0;i<ctx->inputs.size();i++)
+    produced[ctx->inputs[i].operand] = true;
+  for(size_t i=0;i<ctx->stages_info.size();i++){
+    const Operation_inputs_info &stage = ctx->stages_info.at(i);
+    unsigned int expected = (ctx->network.at(i) == ADD) ? 2 : 1;
+    if(stage.num_input_operands != expected){
+      ALOGE("stage %zu reads %u operands, expected %u", i, stage.num_input_operands, expected);
+      return false;
+    }
+    for(unsigned int k=0;k<stage.num_input_operands;k++){
+      if(produced.count(stage.input_operands[k]) == 0){
+        ALOGE("stage %zu reads operand %u before it is written", i, stage.input_operands[k]);
+        return false;
+      }
+    }
+    if(produced.count(stage.output_operand) > 0){
+      ALOGE("stage %zu writes operand %u written before", i, stage.output_operand);
+      return false;
+    }
+    produced[stage.output_operand] = true;
+  }
+  for(size_t i=0;i<ctx->outputs.size();i++){
+    if(produced.count(ctx->outputs[i].operand) == 0 || is_network_tensor(ctx->inputs, ctx->outputs[i].operand)){
+      ALOGE("network output operand %u is not written by a stage", ctx->outputs[i].operand);
+      return false;
+    }
+  }
+  return true;
+}
 
-    ALOGD("current_stage_data.inputStrideX: %lu",current_stage_data.inputStrideX);
-    ALOGD("current_stage_data.inputStrideY: %lu",current_stage_data.inputStrideY);
-    ALOGD("current_stage_data.inputStrideZ: %lu",current_stage_data.inputStrideZ);
-    ALOGD("current_stage_data.tapStrideX: %lu",current_stage_data.tapStrideX);
-    ALOGD("current_stage_data.tapStrideY: %lu",current_stage_data.tapStrideY);
-    ALOGD("current_stage_data.tapStrideZ: %lu",current_stage_data.tapStrideZ);
-    ALOGD("current_stage_data.outputStrideX: %lu",current_stage_data.outputStrideX);
-    ALOGD("current_stage_data.outputStrideY: %lu",current_stage_data.outputStrideY);
-    ALOGD("current_stage_data.outputStrideZ: %lu",current_stage_data.outputStrideZ);
+std::vector<NCSoperations> get_network_operations_details(Compile_context *ctx){
+  //update the global variable for network_operations_vector(ctx->network)
+  return ctx->network;
+}
 
-    ALOGD("current_stage_data.datatype_value: %d",current_stage_data.datatype_value);
-    ALOGD("current_stage_data.precision_value: %d",current_stage_data.precision_value);
-    ALOGD("current_stage_data.storageOrder_value: %d",current_stage_data.storageOrder_value);
+bool display(Operation_inputs_info cur_stage_android, int count){
 
-    ALOGD("current_stage_data.data_Pointer: %lu",current_stage_data.data_Pointer);
-    ALOGD("current_stage_data.data_Index: %u",current_stage_data.data_Index);
+  //ALOGD("Stage Count  : %d",count);
+  ALOGD("cur_stage_android.main_operation : %d",cur_stage_android.main_operation);
+  ALOGD("cur_stage_android.num_inputs : %d",cur_stage_android.num_inputs);
+  ALOGD("cur_stage_android.input_shape : (%d, %d, %d, %d)",cur_stage_android.input_shape[0],cur_stage_android.input_shape[1],cur_stage_android.input_shape[2],cur_stage_android.input_shape[3]);
 
-    ALOGD("current_stage_data.taps_Pointer: %lu",current_stage_data.taps_Pointer);
-    ALOGD("current_stage_data.taps_Index: %u",current_stage_data.taps_Index);
+  //if(cur_stage_android.main_operation == CONV_2D || cur_stage_android.main_operation ==  DEPTHWISE_CONV_2D || cur_stage_android.main_operation == AVERAGE_POOL_2D || cur_stage_android.main_operation == MAX_POOL_2D){
+  if(cur_stage_android.main_operation == CONV_2D || DEPTHWISE_CONV_2D ){
+    ALOGD("cur_stage_android.kernel_shape : (%d, %d, %d, %d) ",cur_stage_android.kernel_shape[0],cur_stage_android.kernel_shape[1],cur_stage_android.kernel_shape[2],cur_stage_android.kernel_shape[3]);
 
-    ALOGD("current_stage_data.bias_Pointer: %lu",current_stage_data.bias_Pointer);
-    ALOGD("current_stage_data.bias_Index: %u",current_stage_data.bias_Index);
+    uint32_t num_of_kernel_elements = cur_stage_android.kernel_shape[0] * cur_stage_android.kernel_shape[1] *
+                                      cur_stage_android.kernel_shape[2] * cur_stage_android.kernel_shape[3];
+    ALOGD("cur_stage_android.kernel_num of elements : %d",num_of_kernel_elements);
 
-    ALOGD("current_stage_data.opPrarams_Pointer: %lu",current_stage_data.opPrarams_Pointer);
-    ALOGD("current_stage_data.opPrarams_Index: %u",current_stage_data.opPrarams_Index);
+    if(cur_stage_android.main_operation == CONV_2D || cur_stage_android.main_operation ==  DEPTHWISE_CONV_2D){
+      ALOGD("cur_stage_android.bias_shape : (%d, %d, %d, %d) ",cur_stage_android.bias_shape[0],cur_stage_android.bias_shape[1],cur_stage_android.bias_shape[2],cur_stage_android.bias_shape[3]);
+    }
+    if(cur_stage_android.main_operation == DEPTHWISE_CONV_2D )
+    ALOGD("cur_stage_android.depth_multiplier : %d",cur_stage_android.depth_multiplier);
 
-    ALOGD("current_stage_data.output_Pointer: %lu",current_stage_data.output_Pointer);
-    ALOGD("current_stage_data.output_Index: %u",current_stage_data.output_Index);
+    ALOGD("cur_stage_android.output_shape : (%d, %d, %d, %d) ",cur_stage_android.output_shape[0],cur_stage_android.output_shape[1],cur_stage_android.output_shape[2],cur_stage_android.output_shape[3]);
 
-    ALOGD("current_stage_data.preOp_value: %d",current_stage_data.preOp_value);
-    ALOGD("current_stage_data.postOp_value: %d",current_stage_data.postOp_value);
 
-    ALOGD("current_stage_data.post_param1[0]: %d",current_stage_data.post_param1[0]);
-    ALOGD("current_stage_data.post_param1[1]: %d",current_stage_data.post_param1[1]);
-    ALOGD("current_stage_data.post_param1[2]: %d",current_stage_data.post_param1[2]);
-    ALOGD("current_stage_data.post_param1[3]: %d",current_stage_data.post_param1[3]);
+    ALOGD("cur_stage_android.padding_left : %d",cur_stage_android.padding_left);
+    ALOGD("cur_stage_android.padding_right : %d",cur_stage_android.padding_right);
+    ALOGD("cur_stage_android.padding_top : %d",cur_stage_android.padding_top);
+    ALOGD("cur_stage_android.padding_bottom : %d",cur_stage_android.padding_bottom);
 
-    ALOGD("current_stage_data.post_strideX: %d",current_stage_data.post_strideX);
-    ALOGD("current_stage_data.post_strideY: %d",current_stage_data.post_strideY);
+    ALOGD("cur_stage_android.stride_width : %d",cur_stage_android.stride_width);
+    ALOGD("cur_stage_android.stride_height : %d",cur_stage_android.stride_height);
   }
+  ALOGD("cur_stage_android.post_operation : %d",cur_stage_android.post_operation);
+  return true;
+}
 
+// Network Stage section begin
+bool parse_stage_from_android(Compile_context *ctx, Operation_inputs_info cur_stage_android){
+  bool success;
+  ctx->stages_info.push_back(cur_stage_android);
+  //TODO Fix me comment the debug
+
+  bool enable_debug = false;
+  if(ctx->stages_info.size() == ctx->network.size() && enable_debug){
+    ALOGD("Stage Count  : %d",ctx->stage_count);
+    for(int i=0;i<ctx->stages_info.size();i++){
+    success = display(ctx->stages_info.at(i), ctx->stage_count);
+    }
+
+  }
+  ctx->stage_count = ctx->stage_count+1;
+  return true;
 }
 
-void get_last_stage_buffer(char *stage_buffer, NCSoperations curr_operation, unsigned int stage_size, Operation_inputs_info curr_stage_info){
+
+//Handles only Input Stage
+
+void get_input_stage_buffer(char *stage_buffer, unsigned int stage_size, Operation_inputs_info curr_stage_info){
 
   unsigned int index = 0;
+
+  memset(stage_buffer,0,STAGE_SIZE);
   Blob_Stage_data current_stage_data;
 
-  ALOGD("Opertion Index is : %d", curr_operation);
 
-  switch (curr_operation) {
-    case LOGISTIC:  current_stage_data = get_LOGISTIC_stage_data(curr_stage_info); break;
-    case TANH : current_stage_data = get_TANH_stage_data(curr_stage_info); break;
-    case RELU : current_stage_data = get_RELU_stage_data(curr_stage_info); break;
-    case RELU1 : current_stage_data = get_RELU1_stage_data(curr_stage_info); break;
-    case RELU6 : current_stage_data = get_RELU6_stage_data(curr_stage_info); break;
-    case CONV_2D : current_stage_data = get_CONV_2D_stage_data(curr_stage_info); break;
-    case DEPTHWISE_CONV_2D : current_stage_data = get_DEPTHWISE_CONV_2D_stage_data(curr_stage_info); break;
-    case AVERAGE_POOL_2D : current_stage_data = get_AVG_POOL_stage_data(curr_stage_info); break;
-    case MAX_POOL_2D : current_stage_data = get_MAX_POOL_stage_data(curr_stage_info); break;
-	case RESHAPE : current_stage_data = get_Reshape_stage_data(curr_stage_info); break;
-    case SOFTMAX : current_stage_data = get_Softmax_stage_data(curr_stage_info); break;
-    default: break;
-  }
+  current_stage_data = get_input_stage_layer(curr_stage_info);
+
   //TODO create the stage_buffer from current_stage_data variable;
   //copy the stagename;
   memset((stage_buffer+index),0,SIZE_OF_STAGE_NAME);
@@ -1383,15 +589,11 @@ void get_last_stage_buffer(char *stage_buffer, NCSoperations curr_operation, uns
   *(stage_buffer+index++) = current_stage_data.opPrarams_Index;
   *(stage_buffer+index++) = current_stage_data.opPrarams_Index >> 8;
 
-  current_stage_data.output_Pointer = (uint32_t) LAST_STAGE_OUTPUT_POINTER;
-
-
   *(stage_buffer+index++) = current_stage_data.output_Pointer;
   *(stage_buffer+index++) = current_stage_data.output_Pointer >> 8;
   *(stage_buffer+index++) = current_stage_data.output_Pointer >> 16;
   *(stage_buffer+index++) = current_stage_data.output_Pointer >> 24;
 
-  current_stage_data.output_Index =(uint16_t) LAST_STAGE_OUTPUT_INDEX;
   *(stage_buffer+index++) = current_stage_data.output_Index;
   *(stage_buffer+index++) = current_stage_data.output_Index >> 8;
 
@@ -1411,7 +613,7 @@ void get_last_stage_buffer(char *stage_buffer, NCSoperations curr_operation, uns
   *(stage_buffer+index) = current_stage_data.post_strideY;
   index += sizeof(current_stage_data.post_strideY);
 
-  if(DEBUG_get_last_stage_buffer){
+  if(DEBUG_get_input_stage_buffer){
     ALOGD("current_stage_data.stage_name: %s",current_stage_data.stage_name.c_str());
     ALOGD("current_stage_data.op_val: %d",current_stage_data.op_val);
     ALOGD("current_stage_data.opt_mask: %u",current_stage_data.opt_mask);
@@ -1476,7 +678,12 @@ void get_last_stage_buffer(char *stage_buffer, NCSoperations curr_operation, uns
 }
 
 
-void get_one_stage_buffer(char *stage_buffer, NCSoperations curr_operation, unsigned int stage_size, Operation_inputs_info curr_stage_info){
+
+//writes the record of one stage. The stage reads inputs[0], and inputs[1] as
+//its taps for ADD. An output with index 0 is a work buffer of its own, it is
+//set to where the stage writes it.
+void get_stage_buffer(Compile_context *ctx, char *stage_buffer, NCSoperations curr_operation, unsigned int stage_size, Operation_inputs_info curr_stage_info,
+                      const Tensor_location *inputs, Tensor_location *output){
 
   unsigned int index = 0;
   Blob_Stage_data current_stage_data;
@@ -1484,19 +691,35 @@ void get_one_stage_buffer(char *stage_buffer, NCSoperations curr_operation, unsi
   ALOGD("Opertion Index is : %d", curr_operation);
 
   switch (curr_operation) {
-    case LOGISTIC:  current_stage_data = get_LOGISTIC_stage_data(curr_stage_info); break;
-    case TANH : current_stage_data = get_TANH_stage_data(curr_stage_info); break;
-    case RELU : current_stage_data = get_RELU_stage_data(curr_stage_info); break;
-    case RELU1 : current_stage_data = get_RELU1_stage_data(curr_stage_info); break;
-    case RELU6 : current_stage_data = get_RELU6_stage_data(curr_stage_info); break;
-    case CONV_2D : current_stage_data = get_CONV_2D_stage_data(curr_stage_info); break;
-    case DEPTHWISE_CONV_2D : current_stage_data = get_DEPTHWISE_CONV_2D_stage_data(curr_stage_info); break;
-    case AVERAGE_POOL_2D : current_stage_data = get_AVG_POOL_stage_data(curr_stage_info); break;
-	case MAX_POOL_2D : current_stage_data = get_MAX_POOL_stage_data(curr_stage_info); break;
-    case RESHAPE : current_stage_data = get_Reshape_stage_data(curr_stage_info); break;
-    case SOFTMAX : current_stage_data = get_Softmax_stage_data(curr_stage_info); break;
+    case LOGISTIC:  current_stage_data = get_LOGISTIC_stage_data(ctx, curr_stage_info); break;
+    case TANH : current_stage_data = get_TANH_stage_data(ctx, curr_stage_info); break;
+    case RELU : current_stage_data = get_RELU_stage_data(ctx, curr_stage_info); break;
+    case RELU1 : current_stage_data = get_RELU1_stage_data(ctx, curr_stage_info); break;
+    case RELU6 : current_stage_data = get_RELU6_stage_data(ctx, curr_stage_info); break;
+    case CONV_2D : current_stage_data = get_CONV_2D_stage_data(ctx, curr_stage_info); break;
+    case DEPTHWISE_CONV_2D : current_stage_data = get_DEPTHWISE_CONV_2D_stage_data(ctx, curr_stage_info); break;
+    case AVERAGE_POOL_2D : current_stage_data = get_AVG_POOL_stage_data(ctx, curr_stage_info); break;
+	case MAX_POOL_2D : current_stage_data = get_MAX_POOL_stage_data(ctx, curr_stage_info); break;
+    case RESHAPE : current_stage_data = get_Reshape_stage_data(ctx, curr_stage_info); break;
+    case SOFTMAX : current_stage_data = get_Softmax_stage_data(ctx, curr_stage_info); break;
+    case ADD : current_stage_data = get_ADD_stage_data(ctx, curr_stage_info); break;
     default: break;
   }
+
+  current_stage_data.data_Pointer = inputs[0].pointer;
+  current_stage_data.data_Index = inputs[0].index;
+  if(curr_operation == ADD){
+    current_stage_data.taps_Pointer = inputs[1].pointer;
+    current_stage_data.taps_Index = inputs[1].index;
+  }
+  if(output->index == 0){
+    output->pointer = current_stage_data.output_Pointer;
+    output->index = current_stage_data.output_Index;
+  }else{
+    current_stage_data.output_Pointer = output->pointer;
+    current_stage_data.output_Index = output->index;
+  }
+
   //TODO create the stage_buffer from current_stage_data variable;
   //copy the stagename;
   memset((stage_buffer+index),0,SIZE_OF_STAGE_NAME);
@@ -1644,15 +867,11 @@ void get_one_stage_buffer(char *stage_buffer, NCSoperations curr_operation, unsi
   *(stage_buffer+index) = current_stage_data.storageOrder_value;
   index += sizeof(current_stage_data.storageOrder_value);
 
-  current_stage_data.data_Pointer = (uint32_t) FIRST_STAGE_DATA_POINTER;
-
   *(stage_buffer+index++) = current_stage_data.data_Pointer;
   *(stage_buffer+index++) = current_stage_data.data_Pointer >> 8;
   *(stage_buffer+index++) = current_stage_data.data_Pointer >> 16;
   *(stage_buffer+index++) = current_stage_data.data_Pointer >> 24;
 
-  current_stage_data.data_Index = (uint16_t) FIRST_STAGE_DATA_INDEX;
-
   *(stage_buffer+index++) = current_stage_data.data_Index;
   *(stage_buffer+index++) = current_stage_data.data_Index >> 8;
 
@@ -1681,15 +900,11 @@ void get_one_stage_buffer(char *stage_buffer, NCSoperations curr_operation, unsi
   *(stage_buffer+index++) = current_stage_data.opPrarams_Index;
   *(stage_buffer+index++) = current_stage_data.opPrarams_Index >> 8;
 
-  current_stage_data.output_Pointer = (uint32_t) LAST_STAGE_OUTPUT_POINTER;
-
-
   *(stage_buffer+index++) = current_stage_data.output_Pointer;
   *(stage_buffer+index++) = current_stage_data.output_Pointer >> 8;
   *(stage_buffer+index++) = current_stage_data.output_Pointer >> 16;
   *(stage_buffer+index++) = current_stage_data.output_Pointer >> 24;
 
-  current_stage_data.output_Index =(uint16_t) LAST_STAGE_OUTPUT_INDEX;
   *(stage_buffer+index++) = current_stage_data.output_Index;
   *(stage_buffer+index++) = current_stage_data.output_Index >> 8;
 
@@ -1709,10 +924,10 @@ void get_one_stage_buffer(char *stage_buffer, NCSoperations curr_operation, unsi
   *(stage_buffer+index) = current_stage_data.post_strideY;
   index += sizeof(current_stage_data.post_strideY);
 
-  if(DEBUG_get_one_stage_buffer){
+  if(DEBUG_get_stage_buffer){
     ALOGD("current_stage_data.stage_name: %s",current_stage_data.stage_name.c_str());
     ALOGD("current_stage_data.op_val: %d",current_stage_data.op_val);
-    ALOGD("current_stage_data.opt_mask: %u",current_stage_data.opt_mask);
+    ALOGD("current_stage_data.opt_mask: %lu",current_stage_data.opt_mask);
     ALOGD("current_stage_data.radixX: %d",current_stage_data.radixX);
     ALOGD("current_stage_data.radixY: %d",current_stage_data.radixY);
     ALOGD("current_stage_data.strideX: %d",current_stage_data.strideX);
@@ -1721,25 +936,25 @@ void get_one_stage_buffer(char *stage_buffer, NCSoperations curr_operation, unsi
     ALOGD("current_stage_data.padY: %d",current_stage_data.padY);
     ALOGD("current_stage_data.padStyle_value: %d",current_stage_data.padStyle_value);
 
-    ALOGD("current_stage_data.inputDimX: %u",current_stage_data.inputDimX);
-    ALOGD("current_stage_data.inputDimY: %u",current_stage_data.inputDimY);
-    ALOGD("current_stage_data.inputDimZ: %u",current_stage_data.inputDimZ);
-    ALOGD("current_stage_data.tapDimX: %u",current_stage_data.tapDimX);
-    ALOGD("current_stage_data.tapDimY: %u",current_stage_data.tapDimY);
-    ALOGD("current_stage_data.tapDimZ: %u",current_stage_data.tapDimZ);
-    ALOGD("current_stage_data.outputDimX: %u",current_stage_data.outputDimX);
-    ALOGD("current_stage_data.outputDimY: %u",current_stage_data.outputDimY);
-    ALOGD("current_stage_data.outputDimZ: %u",current_stage_data.outputDimZ);
+    ALOGD("current_stage_data.inputDimX: %lu",current_stage_data.inputDimX);
+    ALOGD("current_stage_data.inputDimY: %lu",current_stage_data.inputDimY);
+    ALOGD("current_stage_data.inputDimZ: %lu",current_stage_data.inputDimZ);
+    ALOGD("current_stage_data.tapDimX: %lu",current_stage_data.tapDimX);
+    ALOGD("current_stage_data.tapDimY: %lu",current_stage_data.tapDimY);
+    ALOGD("current_stage_data.tapDimZ: %lu",current_stage_data.tapDimZ);
+    ALOGD("current_stage_data.outputDimX: %lu",current_stage_data.outputDimX);
+    ALOGD("current_stage_data.outputDimY: %lu",current_stage_data.outputDimY);
+    ALOGD("current_stage_data.outputDimZ: %lu",current_stage_data.outputDimZ);
 
-    ALOGD("current_stage_data.inputStrideX: %u",current_stage_data.inputStrideX);
-    ALOGD("current_stage_data.inputStrideY: %u",current_stage_data.inputStrideY);
-    ALOGD("current_stage_data.inputStrideZ: %u",current_stage_data.inputStrideZ);
-    ALOGD("current_stage_data.tapStrideX: %u",current_stage_data.tapStrideX);
-    ALOGD("current_stage_data.tapStrideY: %u",current_stage_data.tapStrideY);
-    ALOGD("current_stage_data.tapStrideZ: %u",current_stage_data.tapStrideZ);
-    ALOGD("current_stage_data.outputStrideX: %u",current_stage_data.outputStrideX);
-    ALOGD("current_stage_data.outputStrideY: %u",current_stage_data.outputStrideY);
-    ALOGD("current_stage_data.outputStrideZ: %u",current_stage_data.outputStrideZ);
+    ALOGD("current_stage_data.inputStrideX: %lu",current_stage_data.inputStrideX);
+    ALOGD("current_stage_data.inputStrideY: %lu",current_stage_data.inputStrideY);
+    ALOGD("current_stage_data.inputStrideZ: %lu",current_stage_data.inputStrideZ);
+    ALOGD("current_stage_data.tapStrideX: %lu",current_stage_data.tapStrideX);
+    ALOGD("current_stage_data.tapStrideY: %lu",current_stage_data.tapStrideY);
+    ALOGD("current_stage_data.tapStrideZ: %lu",current_stage_data.tapStrideZ);
+    ALOGD("current_stage_data.outputStrideX: %lu",current_stage_data.outputStrideX);
+    ALOGD("current_stage_data.outputStrideY: %lu",current_stage_data.outputStrideY);
+    ALOGD("current_stage_data.outputStrideZ: %lu",current_stage_data.outputStrideZ);
 
     ALOGD("current_stage_data.datatype_value: %d",current_stage_data.datatype_value);
     ALOGD("current_stage_data.precision_value: %d",current_stage_data.precision_value);
@@ -1771,106 +986,169 @@ void get_one_stage_buffer(char *stage_buffer, NCSoperations curr_operation, unsi
     ALOGD("current_stage_data.post_strideX: %d",current_stage_data.post_strideX);
     ALOGD("current_stage_data.post_strideY: %d",current_stage_data.post_strideY);
   }
+
+}
+
+bool blob_buffer_reserve(Blob_buffer *blob, uint32_t capacity){
+  if(capacity <= blob->capacity)
+    return true;
+  char *data = (char *)realloc(blob->data, capacity);
+  if(data == NULL){
+    ALOGE("unable to grow graph blob to %u bytes", capacity);
+    return false;
+  }
+  memset(data + blob->capacity, 0, capacity - blob->capacity);
+  blob->data = data;
+  blob->capacity = capacity;
+  return true;
+}
+
+bool blob_buffer_append(Blob_buffer *blob, const void *data, uint32_t size){
+  if(blob->size + size > blob->capacity){
+    //estimate_file_size(ctx) is expected to be exact, grow by half when it is not
+    ALOGD("graph blob grows beyond the estimated %u bytes", blob->capacity);
+    if(!blob_buffer_reserve(blob, std::max(blob->size + size, blob->capacity + blob->capacity/2)))
+      return false;
+  }
+  memcpy(blob->data + blob->size, data, size);
+  blob->size += size;
+  return true;
+}
+
+bool export_blob_to_file(const char *path, const Blob_buffer *blob){
+  FILE *fp = fopen(path,"wb");
+  if(fp == NULL){
+    ALOGE("unable to open file %s",path);
+    return false;
+  }
+  bool status = fwrite(blob->data,blob->size,1,fp) == 1;
+  fclose(fp);
+  if(!status){
+    ALOGE("unable to write graph blob to %s",path);
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(graph_file_names_lock);
+  graph_file_names_vector.push_back(path);
+  return true;
+}
+
+bool load_cached_blob(const char *path, uint64_t key, char **graph_blob, uint32_t *graph_blob_size){
+  FILE *fp = fopen(path,"rb");
+  if(fp == NULL)
+    return false;
+
+  Blob_cache_header header;
+  char *blob = NULL;
+  bool status = fread(&header,sizeof(header),1,fp) == 1 &&
+                header.magic == BLOB_CACHE_MAGIC &&
+                header.compiler_version == GRAPH_COMPILER_VERSION &&
+                header.key == key && header.blob_size > SIZE_HEADER;
+  if(status){
+    blob = (char *)malloc(header.blob_size);
+    status = blob != NULL && fread(blob,header.blob_size,1,fp) == 1;
+  }
+  fclose(fp);
+
+  //the file size in the blob header has to match as well, see get_header_buffer()
+  uint32_t filesize = 0;
+  if(status)
+    memcpy(&filesize, blob + (VCS_FIX ? 32 : 0), sizeof(filesize));
+  if(!status || filesize != header.blob_size){
+    ALOGE("ignoring invalid graph cache %s", path);
+    free(blob);
+    return false;
+  }
+  *graph_blob = blob;
+  *graph_blob_size = header.blob_size;
+  return true;
 }
 
+bool save_cached_blob(const char *path, uint64_t key, const char *graph_blob, uint32_t graph_blob_size){
+  Blob_cache_header header = {BLOB_CACHE_MAGIC, GRAPH_COMPILER_VERSION, key, graph_blob_size, 0};
+
+  //written aside and renamed, so that no prepare reads a partial file
+  std::string temp = std::string(path) + ".tmp" + std::to_string(getpid());
+  FILE *fp = fopen(temp.c_str(),"wb");
+  if(fp == NULL){
+    ALOGE("unable to create graph cache %s: %s", temp.c_str(), strerror(errno));
+    return false;
+  }
+  bool status = fwrite(&header,sizeof(header),1,fp) == 1 &&
+                fwrite(graph_blob,graph_blob_size,1,fp) == 1;
+  status = fclose(fp) == 0 && status;
+  if(!status || rename(temp.c_str(), path) != 0){
+    ALOGE("unable to write graph cache %s: %s", path, strerror(errno));
+    unlink(temp.c_str());
+    return false;
+  }
+  return true;
+}
 
-bool prepare_blob(std::string str,int graph_count){
+bool prepare_blob(Compile_context *ctx, std::string str,int graph_count,char **graph_blob,uint32_t *graph_blob_size){
 
   Blobconfig blob1;
   Myriadconfig mconfig;
   network_operations_vector network_operations;
 
-  network_operations = get_network_operations_details();
+  if(!build_data_flow(ctx))
+    return false;
+  if(ctx->optimize && !optimize_network(ctx))
+    return false;
+  network_operations = get_network_operations_details(ctx);
 
   blob1.version = 2;
   blob1.network_name = str;
   blob1.blob_report_dir = "";
   blob1.stage_count = network_operations.size()+1;
-  blob1.filesize = estimate_file_size(true, blob1.stage_count);
-  blob1.filesize_without_data = estimate_file_size(false, blob1.stage_count);
+  blob1.filesize = estimate_file_size(ctx, true, blob1.stage_count);
+  blob1.filesize_without_data = estimate_file_size(ctx, false, blob1.stage_count);
 
-  mconfig.firstShave = 0;
-  mconfig.lastShave = 11;
+  mconfig.firstShave = BLOB_FIRST_SHAVE;
+  mconfig.lastShave = BLOB_LAST_SHAVE;
   mconfig.leonMemLocation = 0;
   mconfig.leonMemSize = 0;
   mconfig.dmaAgent = 0;
 
   ALOGD("network_name: %s",blob1.network_name.c_str());
 
-  char* graph_buffer;
-
-  graph_buffer = (char*)malloc(blob1.filesize_without_data);
-  if(graph_buffer == NULL)
-  ALOGE("unable to allocate graph_buffer");
-  memset(graph_buffer,0,blob1.filesize_without_data);
-
-
-  graph_filename = "/data/ncs_graph"; //+std::to_string(graph_count);
-  graph_buffer = generate_graph(graph_buffer, blob1, mconfig);
-
-  FILE *fp;
-  fp=fopen(graph_filename.c_str(),"wb");
+  //the whole blob, stages and data, is built in one buffer handed to the device
+  Blob_buffer blob = {NULL, 0, 0};
+  if(!blob_buffer_reserve(&blob, blob1.filesize)){
+    ALOGE("unable to allocate graph_buffer");
+    return false;
+  }
 
-  if(fp == NULL)
-    {
-        ALOGE("unable to open file %s",graph_filename.c_str());
-        return false;
-    }
-  graph_file_names_vector.push_back(graph_filename);
-  fwrite(graph_buffer,blob1.filesize_without_data,1,fp);
-  fclose(fp);
+  generate_graph(ctx, blob.data, blob1, mconfig);
+  blob.size = blob1.filesize_without_data;
 
   bool status;
 
-  status = wrtie_post_stage_data(blob1, mconfig);
+  status = wrtie_post_stage_data(ctx, &blob, blob1, mconfig);
+  if(blob.size != blob1.filesize)
+    ALOGE("graph blob is %u bytes, its header says %u", blob.size, blob1.filesize);
+  if(DUMP_BLOB_TO_FILE)
+    export_blob_to_file(BLOB_DUMP_FILE, &blob);
 
   //free(stage_buffer);
   //free(post_data_buffer);
-  free(graph_buffer);
-  nwk_vector_stages_info.clear();
-  memset(&input_stage_data,0,sizeof(input_stage_data));
-  nwk_vector_stages_info.clear();
-  stage_count = 0;
-
-  uint32_t zero_data_offset_g = 0;
-  uint16_t buffer_index_g = 0;
-
-  uint32_t data_Pointer_g = 0;
-  uint16_t data_Index_g = 1;
-
-  uint32_t taps_Pointer_g = 0;
-  uint16_t taps_Index_g = 3;
-
-  uint32_t bias_Pointer_g = 0;
-  uint16_t bias_Index_g = 3;
-
-  uint32_t opPrarams_Pointer_g = 0;
-  uint16_t opPrarams_Index_g = 0;
-
-  uint32_t output_Pointer_g = 0;
-  uint16_t output_Index_g = 3;
-
-  uint32_t global_buffer_index =0;
-
-  if(update_taps_Pointer_g(taps_Pointer_g)!=true)
-    ALOGE("unable to update taps_Pointer global");
-
+  *graph_blob = blob.data;
+  *graph_blob_size = blob.size;
   return true;
 }
 
-bool wrtie_post_stage_data(Blobconfig blob_config, Myriadconfig mconfig){
+bool wrtie_post_stage_data(Compile_context *ctx, Blob_buffer *blob, Blobconfig blob_config, Myriadconfig mconfig){
   bool status = false;
-  for(int i=0;i<nwk_vector_stages_info.size();i++){
-    if(nwk_vector_stages_info.at(i).kernel_data == true || nwk_vector_stages_info.at(i).bias_data == true || nwk_vector_stages_info.at(i).op_params_data == true){
-      ALOGD("nwk_vector_stages_info.at(i).main_operation %d", nwk_vector_stages_info.at(i).main_operation);
-      status = write_kernel_bias_data_buffer_to_file(nwk_vector_stages_info.at(i));
+  for(int i=0;i<ctx->stages_info.size();i++){
+    if(ctx->stages_info.at(i).kernel_data == true || ctx->stages_info.at(i).bias_data == true || ctx->stages_info.at(i).op_params_data == true){
+      ALOGD("ctx->stages_info.at(i).main_operation %d", ctx->stages_info.at(i).main_operation);
+      status = append_kernel_bias_data_buffer(blob, ctx->stages_info.at(i));
     }
   //ALOGD("wrtie_post_stage_data status %d", status);
   }
   return status;
 }
 
-bool write_kernel_bias_data_buffer_to_file(Operation_inputs_info curr_stage_info){
+bool append_kernel_bias_data_buffer(Blob_buffer *blob, Operation_inputs_info curr_stage_info){
   float *kernel_data_buffer, *bias_data_buffer, *op_params_buffer,*final_float_data_buffer;
   float *kernel_data_buffer_android;
   uint32_t buf_index = 0, kenrel_data_size = 0, bias_data_size = 0;
@@ -1881,7 +1159,7 @@ bool write_kernel_bias_data_buffer_to_file(Operation_inputs_info curr_stage_info
 
   uint8_t dtype = 2; //FP16 only supported data size in Bytes
   uint8_t dtype_android = 4; //FP32 from Android data size in Bytes
-  FILE *fp;
+  bool status = true;
   half *buffer_fp16;
 
   if(curr_stage_info.kernel_data == true){
@@ -1938,14 +1216,10 @@ bool write_kernel_bias_data_buffer_to_file(Operation_inputs_info curr_stage_info
     ALOGD("buffer_fp16 allocation success");
     floattofp16((unsigned char *)buffer_fp16, kernel_data_buffer, kenrel_data_size_align/4);
 
-    fp = fopen(graph_filename.c_str(),"ab+");
-    if(fp == NULL)
-    ALOGE("unable to open ncs_graph file for kernel_data writing");
-    else
-    ALOGD("ncs_graph file is open for kernel_data writing");
-    fseek(fp,0,SEEK_END);
-    fwrite((unsigned char *)buffer_fp16,kenrel_data_size_align/2,1,fp);
-    fclose(fp);
+    if(!blob_buffer_append(blob,buffer_fp16,kenrel_data_size_align/2)){
+      ALOGE("unable to append kernel_data to graph blob");
+      status = false;
+    }
   ALOGD("copied kernel_data_buffer %u bytes....",kenrel_data_size_align/2);
   free(buffer_fp16);
   }
@@ -1981,14 +1255,10 @@ bool write_kernel_bias_data_buffer_to_file(Operation_inputs_info curr_stage_info
     ALOGD("buffer_fp16 allocation success");
     floattofp16((unsigned char *)buffer_fp16, bias_data_buffer, bias_data_size_align/4);
 
-    fp = fopen(graph_filename.c_str(),"ab+");
-    if(fp == NULL)
-    ALOGE("unable to open ncs_graph file for bias_data writing");
-    else
-    ALOGD("ncs_graph file is open for bias_data writing");
-    fseek(fp,0,SEEK_END);
-    fwrite((unsigned char *)buffer_fp16,bias_data_size_align/2,1,fp);
-    fclose(fp);
+    if(!blob_buffer_append(blob,buffer_fp16,bias_data_size_align/2)){
+      ALOGE("unable to append bias_data to graph blob");
+      status = false;
+    }
 
     ALOGD("copied bias_data_buffer %u bytes....",bias_data_size_align/2);
     free(buffer_fp16);
@@ -2017,14 +1287,10 @@ bool write_kernel_bias_data_buffer_to_file(Operation_inputs_info curr_stage_info
     memset(buffer_fp16,0,op_params_size_align/2);
     *buffer_fp16 = 1;
 
-    fp = fopen(graph_filename.c_str(),"ab+");
-    if(fp == NULL)
-    ALOGE("unable to open ncs_graph file for op_params_data writing");
-    else
-    ALOGD("ncs_graph file is open for op_params_data writing");
-    fseek(fp,0,SEEK_END);
-    fwrite((unsigned char *)buffer_fp16,op_params_size_align/2,1,fp);
-    fclose(fp);
+    if(!blob_buffer_append(blob,buffer_fp16,op_params_size_align/2)){
+      ALOGE("unable to append op_params_data to graph blob");
+      status = false;
+    }
 
     ALOGD("copied op_params_buffer %u bytes....",op_params_size_align/2);
     free(buffer_fp16);
@@ -2035,10 +1301,10 @@ bool write_kernel_bias_data_buffer_to_file(Operation_inputs_info curr_stage_info
   if(curr_stage_info.bias_data == true) free(bias_data_buffer);
   if(curr_stage_info.op_params_data == true) free(op_params_buffer);
 
-  return true;
+  return status;
 }
 
-uint32_t estimate_file_size(bool with_buf_size,uint32_t stage_count){
+uint32_t estimate_file_size(Compile_context *ctx, bool with_buf_size,uint32_t stage_count){
   Blobconfig blob1;
   Myriadconfig mconfig;
   Blob_Stage_data stage_data;
@@ -2069,20 +1335,20 @@ uint32_t estimate_file_size(bool with_buf_size,uint32_t stage_count){
   filesize += align_size(filesize,8); //Should be 8 bytes aligned
 
   if(with_buf_size){
-    filesize+= calculate_data_buffer_size(); //TODO calculate how to find databuf size
+    filesize+= calculate_data_buffer_size(ctx); //TODO calculate how to find databuf size
   }else
   filesize = filesize;
   return filesize;
 }
 
-uint32_t calculate_data_buffer_size(){
+uint32_t calculate_data_buffer_size(Compile_context *ctx){
 
   uint32_t data_buf_size=0;
   uint8_t dtype = 2; //FP16 only supported data size in Bytes
   uint8_t dtype_android = 4; //FP32 from Android data size in Bytes
 
-  for(int i=0;i<nwk_vector_stages_info.size();i++){
-    Operation_inputs_info curr_stage_info = nwk_vector_stages_info.at(i);
+  for(int i=0;i<ctx->stages_info.size();i++){
+    Operation_inputs_info curr_stage_info = ctx->stages_info.at(i);
     uint32_t buf_index = 0, kenrel_data_size = 0, bias_data_size = 0;
     uint32_t op_params_size = 0, final_data_size = 0;
     uint32_t kenrel_data_size_align = 0, bias_data_size_align = 0;
@@ -2157,7 +1423,7 @@ void get_header_buffer(char *buf_Herader, Blobconfig blob_config, Myriadconfig m
   *(buf_Herader+index) = blob_config.version;
   index += sizeof(blob_config.version);
   memset((buf_Herader+index),0,SIZE_OF_NETOWRK_NAME);
-  memcpy((buf_Herader+index),blob_config.network_name.c_str(),SIZE_OF_NETOWRK_NAME); //(buf_Herader+index++) = blob_config.network_name;
+  memcpy((buf_Herader+index),blob_config.network_name.c_str(),std::min(blob_config.network_name.length(),(size_t)SIZE_OF_NETOWRK_NAME)); //(buf_Herader+index++) = blob_config.network_name;
   index += SIZE_OF_NETOWRK_NAME; // move the index pointer by SIZE_OF_NETOWRK_NAME
   memset((buf_Herader+index),0,SIZE_OF_DIR_NAME);
 
@@ -2198,14 +1464,14 @@ void get_header_buffer(char *buf_Herader, Blobconfig blob_config, Myriadconfig m
 }
 
 
-char* generate_graph(char* graph_buf, Blobconfig blob_config, Myriadconfig mconfig){
+char* generate_graph(Compile_context *ctx, char* graph_buf, Blobconfig blob_config, Myriadconfig mconfig){
 
   unsigned int buf_index = 0;
 
   network_operations_vector network_operations;
   uint32_t nw_stage_count = blob_config.stage_count;
 
-  network_operations = get_network_operations_details();
+  network_operations = get_network_operations_details(ctx);
 
   //ALOGD("Netowrk Size: %d",network_operations.size());
   //for(int i=0; i<network_operations.size();i++)
@@ -2217,6 +1483,7 @@ char* generate_graph(char* graph_buf, Blobconfig blob_config, Myriadconfig mconf
   if(buf_Herader == NULL)
   ALOGE("Unable to allocate memory buffer for buf_Herader");
 
+  memset(buf_Herader,0,SIZE_HEADER); //fields are written one byte at a time
   get_header_buffer(buf_Herader, blob_config,mconfig);
   memcpy(graph_buf,buf_Herader,SIZE_HEADER);
   buf_index += SIZE_HEADER;
@@ -2230,59 +1497,66 @@ char* generate_graph(char* graph_buf, Blobconfig blob_config, Myriadconfig mconf
   if(stage_buffer == NULL)
   ALOGE("Unable to allocate memory buffer for stage_buffer");
 
+  //the input layer describes the input tensor, the model inputs one after another
+  Operation_inputs_info input_layer_info = ctx->stages_info.at(0);
+  if(ctx->inputs.size() == 1){
+    memcpy(input_layer_info.input_shape, ctx->inputs[0].shape, sizeof(VpuShape));
+  }else{
+    uint32_t input_elements = 0;
+    for(size_t i=0;i<ctx->inputs.size();i++)
+      input_elements += shape_elements(ctx->inputs[i].shape);
+    input_layer_info.input_shape[0] = 1;
+    input_layer_info.input_shape[1] = 1;
+    input_layer_info.input_shape[2] = 1;
+    input_layer_info.input_shape[3] = input_elements;
+  }
   memset(stage_buffer,0,STAGE_SIZE);
-  get_input_stage_buffer(stage_buffer, STAGE_SIZE,nwk_vector_stages_info.at(0));
+  get_input_stage_buffer(stage_buffer, STAGE_SIZE,input_layer_info);
   memcpy(graph_buf+buf_index,stage_buffer,STAGE_SIZE);
   buf_index += STAGE_SIZE;
   free(stage_buffer);
 
-  if(network_operations.size() > 1){
-    //copy each network stage data
-    stage_buffer = (char *)malloc(STAGE_SIZE);
-    if(stage_buffer == NULL)
-    ALOGE("Unable to allocate memory buffer for stage_buffer");
-    memset(stage_buffer,0,STAGE_SIZE);
-    get_first_stage_buffer(stage_buffer,network_operations.at(0),STAGE_SIZE,nwk_vector_stages_info.at(0));
-    memcpy(graph_buf+buf_index,stage_buffer,STAGE_SIZE);
-    buf_index += STAGE_SIZE;
-    free(stage_buffer);
+  //the model inputs and outputs are packed in the input and output buffers,
+  //in the order of the model. Every other tensor has a work buffer of its own.
+  std::map<uint32_t, Tensor_location> locations, output_locations;
+  uint32_t pointer = 0;
+  for(size_t i=0;i<ctx->inputs.size();i++){
+    Tensor_location location = {pointer, NETWORK_INPUT_BUFFER_INDEX};
+    locations[ctx->inputs[i].operand] = location;
+    pointer += 2 * shape_elements(ctx->inputs[i].shape);
+  }
+  pointer = 0;
+  for(size_t i=0;i<ctx->outputs.size();i++){
+    Tensor_location location = {pointer, NETWORK_OUTPUT_BUFFER_INDEX};
+    output_locations[ctx->outputs[i].operand] = location;
+    pointer += 2 * shape_elements(ctx->outputs[i].shape);
+  }
 
-    for(int i=1;i<network_operations.size()-1;i++){
-      stage_buffer = (char *)malloc(STAGE_SIZE);
-      if(stage_buffer == NULL)
-      ALOGE("Unable to allocate memory buffer for stage_buffer");
-      memset(stage_buffer,0,STAGE_SIZE);
-      get_stage_buffer(stage_buffer,network_operations.at(i),STAGE_SIZE,nwk_vector_stages_info.at(i));
-      memcpy(graph_buf+buf_index,stage_buffer,STAGE_SIZE);
-      buf_index += STAGE_SIZE;
-      free(stage_buffer);
-    }
+  for(size_t i=0;i<network_operations.size();i++){
+    const Operation_inputs_info &stage_info = ctx->stages_info.at(i);
+    Tensor_location inputs[2] = {{0, 0}, {0, 0}};
+    for(unsigned int k=0;k<stage_info.num_input_operands;k++)
+      inputs[k] = locations[stage_info.input_operands[k]];
+    Tensor_location output = {0, 0};
+    if(output_locations.count(stage_info.output_operand) > 0)
+      output = output_locations[stage_info.output_operand];
 
     stage_buffer = (char *)malloc(STAGE_SIZE);
     if(stage_buffer == NULL)
     ALOGE("Unable to allocate memory buffer for stage_buffer");
     memset(stage_buffer,0,STAGE_SIZE);
-    get_last_stage_buffer(stage_buffer,network_operations.at(network_operations.size()-1),STAGE_SIZE,nwk_vector_stages_info.at(network_operations.size()-1));
-    memcpy(graph_buf+buf_index,stage_buffer,STAGE_SIZE);
-    buf_index += STAGE_SIZE;
-    free(stage_buffer);
-  }
-  else{
-    stage_buffer = (char *)malloc(STAGE_SIZE);
-    if(stage_buffer == NULL)
-    ALOGE("Unable to allocate memory buffer for stage_buffer");
-    memset(stage_buffer,0,STAGE_SIZE);
-    get_one_stage_buffer(stage_buffer,network_operations.at(network_operations.size()-1),STAGE_SIZE,nwk_vector_stages_info.at(network_operations.size()-1));
+    get_stage_buffer(ctx, stage_buffer,network_operations.at(i),STAGE_SIZE,stage_info,inputs,&output);
     memcpy(graph_buf+buf_index,stage_buffer,STAGE_SIZE);
     buf_index += STAGE_SIZE;
     free(stage_buffer);
+    locations[stage_info.output_operand] = output;
   }
 
-
   return graph_buf;
 }
 
 bool delete_graphs(){
+  std::lock_guard<std::mutex> lock(graph_file_names_lock);
   int size = graph_file_names_vector.size();
   int perror;
   for(int i=0;i<size;i++){
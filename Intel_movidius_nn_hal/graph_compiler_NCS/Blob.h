@@ -29,11 +29,9 @@
 #define SIZE_OF_NETOWRK_NAME 100
 #define SIZE_OF_DIR_NAME 100
 
-#define FIRST_STAGE_DATA_POINTER 0
-#define FIRST_STAGE_DATA_INDEX 1
-
-#define LAST_STAGE_OUTPUT_POINTER 0
-#define LAST_STAGE_OUTPUT_INDEX 2
+//buffers holding the model inputs and outputs, packed in the order of the model
+#define NETWORK_INPUT_BUFFER_INDEX 1
+#define NETWORK_OUTPUT_BUFFER_INDEX 2
 
 #define LOG_TAG "NCS_GRAPH_COMPILER"
 #define VCS_FIX true
@@ -41,101 +39,190 @@
 #define DEBUG_get_stage_buffer false
 #define DEBUG_generate_graph false
 #define DEBUG_get_input_stage_buffer false
-#define DEBUG_get_last_stage_buffer false
-#define DEBUG_get_one_stage_buffer false
-#define DEBUG_get_first_stage_buffer false
+//graph blobs are handed to the device from memory, export them for debugging
+#define DUMP_BLOB_TO_FILE false
+#define BLOB_DUMP_FILE "/data/ncs_graph"
+
+//bump when a change of the compiler changes the blobs it generates,
+//cached blobs of another version are recompiled
+#define GRAPH_COMPILER_VERSION 3
+#define BLOB_FIRST_SHAVE 0
+#define BLOB_LAST_SHAVE 11
+#define BLOB_CACHE_MAGIC 0x424e434e //"NCNB"
 
 typedef unsigned short half;
 
+//where a stage reads or writes a tensor, an offset in one of the buffers of the blob
+typedef struct tensor_location {
+  uint32_t pointer;
+  uint16_t index;
+} Tensor_location;
+
+//graph blob built in memory, reserved from estimate_file_size(ctx) and grown on append
+typedef struct blob_buffer {
+  char *data;
+  uint32_t size;
+  uint32_t capacity;
+} Blob_buffer;
+
+bool blob_buffer_reserve(Blob_buffer *blob, uint32_t capacity);
+bool blob_buffer_append(Blob_buffer *blob, const void *data, uint32_t size);
+bool export_blob_to_file(const char *path, const Blob_buffer *blob);
+
+//compiled blob cached on disk, this header then the blob
+typedef struct blob_cache_header {
+  uint32_t magic;
+  uint32_t compiler_version;
+  uint64_t key;
+  uint32_t blob_size;
+  uint32_t reserved;
+} Blob_cache_header;
+
+//on success *graph_blob is a malloc'ed blob of *graph_blob_size bytes owned by the caller
+bool load_cached_blob(const char *path, uint64_t key, char **graph_blob, uint32_t *graph_blob_size);
+bool save_cached_blob(const char *path, uint64_t key, const char *graph_blob, uint32_t graph_blob_size);
+
+
+//state of one graph compilation, from get_nn_network_from_android() to prepare_blob().
+//Every compilation owns one, so that graphs may be compiled one after another or at
+//the same time in a process.
+typedef struct compile_context {
+  network_operations_vector network;
+  Network_Vector_Stageinfo stages_info;
+  unsigned int stage_count;
+
+  //model inputs and outputs, in the order the application passes them
+  Network_Vector_Tensorinfo inputs;
+  Network_Vector_Tensorinfo outputs;
+
+  uint32_t zero_data_offset;
+  uint16_t buffer_index;
+
+  uint32_t data_Pointer;
+  uint16_t data_Index;
+
+  uint32_t taps_Pointer;
+  uint16_t taps_Index;
+
+  uint32_t bias_Pointer;
+  uint16_t bias_Index;
+
+  uint32_t opPrarams_Pointer;
+  uint16_t opPrarams_Index;
+
+  uint32_t output_Pointer;
+  uint16_t output_Index;
+
+  uint32_t global_buffer_index;
+  float *post_data_buffer;
+
+  //prepare_blob() folds activations and removes identity stages first, true by default
+  bool optimize;
+} Compile_context;
+
+void init_compile_context(Compile_context *ctx);
+
+bool update_post_data_buffer(Compile_context *ctx, uint32_t size, float *buf);
+bool update_global_buffer_index(Compile_context *ctx, uint32_t value);
+uint32_t get_global_buffer_index(Compile_context *ctx);
+
+bool update_zero_data_offset_g(Compile_context *ctx, uint32_t value);
+uint32_t get_zero_data_offset_global(Compile_context *ctx);
+
+bool update_buffer_index_g(Compile_context *ctx, uint16_t value);
+uint16_t get_buffer_index_global(Compile_context *ctx);
 
-bool update_post_data_buffer(uint32_t size, float *buf);
-bool update_global_buffer_index(uint32_t value);
-uint32_t get_global_buffer_index();
+bool update_data_Pointer_g(Compile_context *ctx, uint32_t value);
+uint32_t get_data_Pointer_global(Compile_context *ctx);
 
-bool update_zero_data_offset_g(uint32_t value);
-uint32_t get_zero_data_offset_global();
 
-bool update_buffer_index_g(uint16_t value);
-uint16_t get_buffer_index_global();
+bool update_data_Index_g(Compile_context *ctx, uint16_t value);
+uint16_t get_data_Index_global(Compile_context *ctx);
 
-bool update_data_Pointer_g(uint32_t value);
-uint32_t get_data_Pointer_global();
+bool update_taps_Pointer_g(Compile_context *ctx, uint32_t value);
 
+uint32_t get_taps_Pointer_global(Compile_context *ctx);
 
-bool update_data_Index_g(uint16_t value);
-uint16_t get_data_Index_global();
+bool update_taps_Index_g(Compile_context *ctx, uint16_t value);
 
-bool update_taps_Pointer_g(uint32_t value);
+uint16_t get_taps_Index_global(Compile_context *ctx);
 
-uint32_t get_taps_Pointer_global();
+bool update_bias_Pointer_g(Compile_context *ctx, uint32_t value);
 
-bool update_taps_Index_g(uint16_t value);
+uint32_t get_bias_Pointer_global(Compile_context *ctx);
 
-uint16_t get_taps_Index_global();
+bool update_bias_Index_g(Compile_context *ctx, uint16_t value);
 
-bool update_bias_Pointer_g(uint32_t value);
+uint16_t get_bias_Index_global(Compile_context *ctx);
 
-uint32_t get_bias_Pointer_global();
+bool update_opPrarams_Pointer_g(Compile_context *ctx, uint32_t value);
 
-bool update_bias_Index_g(uint16_t value);
+uint32_t get_opPrarams_Pointer_global(Compile_context *ctx);
 
-uint16_t get_bias_Index_global();
+bool update_opPrarams_Index_g(Compile_context *ctx, uint16_t value);
 
-bool update_opPrarams_Pointer_g(uint32_t value);
+uint16_t get_opPrarams_Index_global(Compile_context *ctx);
 
-uint32_t get_opPrarams_Pointer_global();
+bool update_output_Pointer_g(Compile_context *ctx, uint32_t value);
 
-bool update_opPrarams_Index_g(uint16_t value);
+uint32_t get_output_Pointer_global(Compile_context *ctx);
 
-uint16_t get_opPrarams_Index_global();
+bool update_output_Index_g(Compile_context *ctx, uint16_t value);
 
-bool update_output_Pointer_g(uint32_t value);
+uint16_t get_output_Index_global(Compile_context *ctx);
 
-uint32_t get_output_Pointer_global();
+//checks that every stage reads model inputs or tensors of the stages before it,
+//networks given without operands are chained, stage i reading the output of stage i-1
+bool build_data_flow(Compile_context *ctx);
 
-bool update_output_Index_g(uint16_t value);
+//folds RELU/RELU1/RELU6 stages into the postOp of the conv, depthwise conv, pooling
+//or add stage producing their input and removes reshapes, which leave the tensor
+//unchanged on the device
+bool optimize_network(Compile_context *ctx);
 
-uint16_t get_output_Index_global();
+uint32_t shape_elements(const VpuShape shape);
+bool is_network_tensor(const Network_Vector_Tensorinfo &tensors, uint32_t operand);
 
-uint32_t estimate_file_size(bool with_buf_size,uint32_t stage_count);
+uint32_t estimate_file_size(Compile_context *ctx, bool with_buf_size,uint32_t stage_count);
 uint32_t align_size(uint32_t fsize, unsigned int align_to);
 
-bool prepare_blob(std::string str, int graph_count);//TODO update required
+//on success *graph_blob is a malloc'ed blob of *graph_blob_size bytes owned by the caller
+bool prepare_blob(Compile_context *ctx, std::string str, int graph_count, char **graph_blob, uint32_t *graph_blob_size);
 
-char* generate_graph(char *buf, Blobconfig blob_config, Myriadconfig mconfig);
+char* generate_graph(Compile_context *ctx, char *buf, Blobconfig blob_config, Myriadconfig mconfig);
 
-bool wrtie_post_stage_data(Blobconfig blob_config, Myriadconfig mconfig);
+bool wrtie_post_stage_data(Compile_context *ctx, Blob_buffer *blob, Blobconfig blob_config, Myriadconfig mconfig);
 
 
 void get_header_buffer(char *buf_Herader, Blobconfig blob_config, Myriadconfig mconfig);
 
-std::vector<NCSoperations> get_network_operations_details();
+std::vector<NCSoperations> get_network_operations_details(Compile_context *ctx);
 
 void get_input_stage_buffer(char *stage_buffer, NCSoperations curr_operation, unsigned int stage_size, Operation_inputs_info curr_stage_info);
-void get_stage_buffer(char *stage_buffer, NCSoperations curr_operation, unsigned int stage_size, Operation_inputs_info curr_stage_info);
-void get_last_stage_buffer(char *stage_buffer, NCSoperations curr_operation, unsigned int stage_size, Operation_inputs_info curr_stage_info);
-void get_one_stage_buffer(char *stage_buffer, NCSoperations curr_operation, unsigned int stage_size, Operation_inputs_info curr_stage_info);
+void get_stage_buffer(Compile_context *ctx, char *stage_buffer, NCSoperations curr_operation, unsigned int stage_size, Operation_inputs_info curr_stage_info,
+                      const Tensor_location *inputs, Tensor_location *output);
 void get_kernel_bias_data_buffer(half * buffer_fp16, Operation_inputs_info curr_stage_info,uint32_t *data_size_location);
-bool write_kernel_bias_data_buffer_to_file(Operation_inputs_info curr_stage_info);
+bool append_kernel_bias_data_buffer(Blob_buffer *blob, Operation_inputs_info curr_stage_info);
 
-uint32_t calculate_output_pointer(uint32_t X, uint32_t Y, uint32_t Z);
+uint32_t calculate_output_pointer(Compile_context *ctx, uint32_t X, uint32_t Y, uint32_t Z);
 uint32_t calculate_taps_pointer(uint32_t X, uint32_t Y, uint32_t Z, uint32_t W);
 uint32_t calculate_bias_Pointer(uint32_t X);
-uint32_t calculate_data_buffer_size();
+uint32_t calculate_data_buffer_size(Compile_context *ctx);
 
 Blob_Stage_data get_input_stage_layer(Operation_inputs_info curr_stage_info);
 
-Blob_Stage_data get_LOGISTIC_stage_data(Operation_inputs_info curr_stage_info);
-Blob_Stage_data get_TANH_stage_data(Operation_inputs_info curr_stage_info);
-Blob_Stage_data get_RELU_stage_data(Operation_inputs_info curr_stage_info);
-Blob_Stage_data get_RELU1_stage_data(Operation_inputs_info curr_stage_info);
-Blob_Stage_data get_RELU6_stage_data(Operation_inputs_info curr_stage_info);
-Blob_Stage_data get_CONV_2D_stage_data(Operation_inputs_info curr_stage_info);
-Blob_Stage_data get_DEPTHWISE_CONV_2D_stage_data(Operation_inputs_info curr_stage_info);
-Blob_Stage_data get_AVG_POOL_stage_data(Operation_inputs_info curr_stage_info);
-Blob_Stage_data get_MAX_POOL_stage_data(Operation_inputs_info curr_stage_info);
-Blob_Stage_data get_Softmax_stage_data(Operation_inputs_info curr_stage_info);
-Blob_Stage_data get_Reshape_stage_data(Operation_inputs_info curr_stage_info);
+Blob_Stage_data get_LOGISTIC_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info);
+Blob_Stage_data get_TANH_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info);
+Blob_Stage_data get_RELU_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info);
+Blob_Stage_data get_RELU1_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info);
+Blob_Stage_data get_RELU6_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info);
+Blob_Stage_data get_CONV_2D_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info);
+Blob_Stage_data get_DEPTHWISE_CONV_2D_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info);
+Blob_Stage_data get_AVG_POOL_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info);
+Blob_Stage_data get_MAX_POOL_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info);
+Blob_Stage_data get_Softmax_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info);
+Blob_Stage_data get_Reshape_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info);
+Blob_Stage_data get_ADD_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info);
 
 
 bool parse_logistic_from_android(Operation_inputs_info sig_stage_android);
@@ -149,6 +236,8 @@ Operation_inputs_info parse_relu6_stage_info();
 
 Operation_inputs_info parse_input_stage_info();
 
-bool get_nn_network_from_android(network_operations_vector nw_vector1);
-bool parse_stage_from_android(Operation_inputs_info cur_stage_android);
+bool get_nn_network_from_android(Compile_context *ctx, network_operations_vector nw_vector1);
+bool parse_stage_from_android(Compile_context *ctx, Operation_inputs_info cur_stage_android);
+//model inputs and outputs by operand, networks without them are compiled as a chain
+bool get_nn_network_io_from_android(Compile_context *ctx, Network_Vector_Tensorinfo inputs, Network_Vector_Tensorinfo outputs);
 #endif
@@ -82,10 +82,24 @@ typedef struct operation_inputs_info {
   bool bias_data = false;
   bool op_params_data = false;
   NCSoperations post_operation; //it is used for activation functions
+
+  //model operands of the tensors read and written by the stage, ADD reads two.
+  //Stages without input operands read the output of the stage before them.
+  uint32_t input_operands[2] = {0, 0};
+  unsigned int num_input_operands = 0;
+  uint32_t output_operand = 0;
 }Operation_inputs_info;
 
 typedef std::vector<Operation_inputs_info> Network_Vector_Stageinfo;
 
+//a model input or output of the network
+typedef struct network_tensor_info {
+  uint32_t operand;
+  VpuShape shape;
+}Network_tensor_info;
+
+typedef std::vector<Network_tensor_info> Network_Vector_Tensorinfo;
+
 typedef std::vector<NCSoperations> network_operations_vector;
 
 typedef struct myriadconfig {
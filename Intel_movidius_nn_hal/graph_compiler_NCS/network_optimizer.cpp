@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include<stdio.h>
+#include<stdint.h>
+#include <map>
+#include <log/log.h>
+#include "Blob.h"
+
+//Every stage reads its input from and writes its output to the device memory,
+//so each stage removed here saves a full round trip of a tensor. Stages are
+//linked by the model operands they read and write, a tensor read by several
+//stages or by the application is left as it is.
+
+//bytes of FP16 tensors read and written by the stages of the network
+static uint32_t network_traffic(const Network_Vector_Stageinfo &stages){
+  uint32_t bytes = 0;
+  for(size_t i=0;i<stages.size();i++)
+    bytes += 2 * (shape_elements(stages[i].input_shape) + shape_elements(stages[i].output_shape));
+  return bytes;
+}
+
+static bool is_activation(NCSoperations operation){
+  return operation == RELU || operation == RELU1 || operation == RELU6;
+}
+
+//stages whose stage data applies post_operation as the postOp of the stage,
+//a CONV_2D of a 1x1 input and kernel is emitted as a fully connected layer without one
+static bool has_post_operation(const Operation_inputs_info &stage){
+  switch(stage.main_operation){
+    case CONV_2D:
+      return !(stage.input_shape[1] == 1 && stage.input_shape[2] == 1 &&
+               stage.kernel_shape[0] == 1 && stage.kernel_shape[1] == 1);
+    case DEPTHWISE_CONV_2D:
+    case AVERAGE_POOL_2D:
+    case MAX_POOL_2D:
+    case ADD:
+      return true;
+    default:
+      return false;
+  }
+}
+
+//upper bound of the clamp of an activation, the stages clamp RELU1 to [0, 1]
+static float activation_limit(NCSoperations operation){
+  switch(operation){
+    case RELU1: return 1.0f;
+    case RELU6: return 6.0f;
+    default: return -1.0f; //unbounded
+  }
+}
+
+//activation equal to applying first then second, both clamp at 0 from below
+static NCSoperations combine_activations(NCSoperations first, NCSoperations second){
+  if(first == NONE)
+    return second;
+  float first_limit = activation_limit(first), second_limit = activation_limit(second);
+  if(first_limit < 0)
+    return second;
+  if(second_limit < 0 || first_limit < second_limit)
+    return first;
+  return second;
+}
+
+//the device reshape copies the tensor unchanged, the next stage reads it with its own dimensions
+static bool is_identity_reshape(const Operation_inputs_info &stage){
+  return stage.main_operation == RESHAPE && stage.post_operation == NONE &&
+         shape_elements(stage.input_shape) == shape_elements(stage.output_shape);
+}
+
+bool optimize_network(Compile_context *ctx){
+  if(ctx->network.size() != ctx->stages_info.size()){
+    ALOGE("network has %zu operations and %zu stages", ctx->network.size(), ctx->stages_info.size());
+    return false;
+  }
+
+  //stages reading each operand, network outputs are read by the application
+  std::map<uint32_t, unsigned int> consumers;
+  for(size_t i=0;i<ctx->stages_info.size();i++)
+    for(unsigned int k=0;k<ctx->stages_info[i].num_input_operands;k++)
+      consumers[ctx->stages_info[i].input_operands[k]]++;
+
+  network_operations_vector network;
+  Network_Vector_Stageinfo stages_info;
+  std::map<uint32_t, uint32_t> alias;     //removed reshape output -> its input
+  std::map<uint32_t, size_t> producer;    //operand -> stage of stages_info writing it
+  unsigned int fused = 0, removed = 0;
+
+  for(size_t i=0;i<ctx->stages_info.size();i++){
+    Operation_inputs_info stage = ctx->stages_info.at(i);
+    stage.main_operation = ctx->network.at(i);
+    for(unsigned int k=0;k<stage.num_input_operands;k++)
+      if(alias.count(stage.input_operands[k]) > 0)
+        stage.input_operands[k] = alias[stage.input_operands[k]];
+
+    uint32_t input = stage.input_operands[0];
+    bool single_use = consumers[input] == 1 && !is_network_tensor(ctx->outputs, input);
+    std::map<uint32_t, size_t>::iterator input_producer = producer.find(input);
+
+    if(is_activation(stage.main_operation) && single_use && input_producer != producer.end() &&
+       has_post_operation(stages_info[input_producer->second])){
+      Operation_inputs_info &previous = stages_info[input_producer->second];
+      previous.post_operation = combine_activations(previous.post_operation, stage.main_operation);
+      previous.output_operand = stage.output_operand;
+      producer[stage.output_operand] = input_producer->second;
+      producer.erase(input_producer);
+      fused++;
+      continue;
+    }
+
+    if(is_identity_reshape(stage)){
+      //the stages reading the reshape read its input instead
+      if(!is_network_tensor(ctx->outputs, stage.output_operand)){
+        alias[stage.output_operand] = input;
+        consumers[input] += consumers[stage.output_operand] - 1;
+        removed++;
+        continue;
+      }
+      //the stage producing the input writes the network output itself
+      if(single_use && input_producer != producer.end()){
+        stages_info[input_producer->second].output_operand = stage.output_operand;
+        producer[stage.output_operand] = input_producer->second;
+        producer.erase(input_producer);
+        removed++;
+        continue;
+      }
+    }
+
+    producer[stage.output_operand] = stages_info.size();
+    network.push_back(stage.main_operation);
+    stages_info.push_back(stage);
+  }
+  ALOGD("network optimized: %zu stages, %u bytes moved per inference -> %zu stages, %u bytes (%u activations fused, %u reshapes removed)",
+        ctx->stages_info.size(), network_traffic(ctx->stages_info),
+        stages_info.size(), network_traffic(stages_info), fused, removed);
+
+  ctx->network = network;
+  ctx->stages_info = stages_info;
+  ctx->stage_count = stages_info.size() + 1;
+  return true;
+}
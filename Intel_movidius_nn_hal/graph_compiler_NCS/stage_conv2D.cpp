@@ -22,9 +22,9 @@
 #include <log/log.h>
 #include "Blob.h"
 
-Blob_Stage_data get_CONV_1D_stage_data(Operation_inputs_info curr_stage_info);
+Blob_Stage_data get_CONV_1D_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info);
 
-Blob_Stage_data get_CONV_2D_stage_data(Operation_inputs_info curr_stage_info){
+Blob_Stage_data get_CONV_2D_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info){
 
   Blob_Stage_data stage_conv2d;
   Operation_inputs_info conv2d_stage_info;
@@ -57,7 +57,7 @@ Blob_Stage_data get_CONV_2D_stage_data(Operation_inputs_info curr_stage_info){
 
   if(conv2d_stage_info.input_shape[1] == 1 && conv2d_stage_info.input_shape[2] == 1 &&
     conv2d_stage_info.kernel_shape[0] == 1 && conv2d_stage_info.kernel_shape[1] == 1){
-      stage_conv2d = get_CONV_1D_stage_data(curr_stage_info);
+      stage_conv2d = get_CONV_1D_stage_data(ctx, curr_stage_info);
       return stage_conv2d;
     }
 
@@ -129,11 +129,11 @@ Blob_Stage_data get_CONV_2D_stage_data(Operation_inputs_info curr_stage_info){
   stage_conv2d.precision_value = 2;
   stage_conv2d.storageOrder_value = 2;
 
-  stage_conv2d.data_Pointer = get_output_Pointer_global();
-  stage_conv2d.data_Index = get_output_Index_global();
+  stage_conv2d.data_Pointer = get_output_Pointer_global(ctx);
+  stage_conv2d.data_Index = get_output_Index_global(ctx);
 
-  stage_conv2d.taps_Pointer = get_taps_Pointer_global();
-  stage_conv2d.taps_Index = get_taps_Index_global();
+  stage_conv2d.taps_Pointer = get_taps_Pointer_global(ctx);
+  stage_conv2d.taps_Index = get_taps_Index_global(ctx);
 
   uint32_t new_taps_Pointer= 0;
   new_taps_Pointer = calculate_taps_pointer(conv2d_stage_info.kernel_shape[0],conv2d_stage_info.kernel_shape[1],conv2d_stage_info.kernel_shape[2],conv2d_stage_info.kernel_shape[3]);
@@ -142,13 +142,13 @@ Blob_Stage_data get_CONV_2D_stage_data(Operation_inputs_info curr_stage_info){
 
   uint32_t new_bias_Pointer =0;
   new_bias_Pointer = stage_conv2d.bias_Pointer + calculate_bias_Pointer(conv2d_stage_info.bias_shape[0]);
-  stage_conv2d.bias_Index = get_bias_Index_global();
+  stage_conv2d.bias_Index = get_bias_Index_global(ctx);
 
   stage_conv2d.opPrarams_Pointer = 0;
   stage_conv2d.opPrarams_Index = 0;
 
-  stage_conv2d.output_Pointer = calculate_output_pointer(stage_conv2d.outputDimX,stage_conv2d.outputDimY,stage_conv2d.outputDimZ);
-  stage_conv2d.output_Index = get_output_Index_global()+1;
+  stage_conv2d.output_Pointer = calculate_output_pointer(ctx, stage_conv2d.outputDimX,stage_conv2d.outputDimY,stage_conv2d.outputDimZ);
+  stage_conv2d.output_Index = get_output_Index_global(ctx)+1;
 
   stage_conv2d.preOp_value = 5;
 
@@ -164,13 +164,13 @@ Blob_Stage_data get_CONV_2D_stage_data(Operation_inputs_info curr_stage_info){
   stage_conv2d.post_strideX = 0;
   stage_conv2d.post_strideY = 0;
 
-  if(update_taps_Pointer_g(new_bias_Pointer)!=true)
+  if(update_taps_Pointer_g(ctx, new_bias_Pointer)!=true)
     ALOGE("unable to update taps_Pointer global");
 
-  if(update_output_Pointer_g(stage_conv2d.output_Pointer)!=true)
+  if(update_output_Pointer_g(ctx, stage_conv2d.output_Pointer)!=true)
     ALOGE("unable to update output_Pointer global");
 
-  if(update_output_Index_g(stage_conv2d.output_Index)!=true)
+  if(update_output_Index_g(ctx, stage_conv2d.output_Index)!=true)
     ALOGE("unable to update output_Index global");
 
 
@@ -178,7 +178,7 @@ Blob_Stage_data get_CONV_2D_stage_data(Operation_inputs_info curr_stage_info){
 }
 
 
-Blob_Stage_data get_CONV_1D_stage_data(Operation_inputs_info curr_stage_info){
+Blob_Stage_data get_CONV_1D_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info){
 
     Blob_Stage_data stage_conv1d;
     Operation_inputs_info conv1d_stage_info;
@@ -240,11 +240,11 @@ Blob_Stage_data get_CONV_1D_stage_data(Operation_inputs_info curr_stage_info){
     stage_conv1d.precision_value = 2;
     stage_conv1d.storageOrder_value = 2;
 
-    stage_conv1d.data_Pointer = get_output_Pointer_global();
-    stage_conv1d.data_Index = get_output_Index_global();
+    stage_conv1d.data_Pointer = get_output_Pointer_global(ctx);
+    stage_conv1d.data_Index = get_output_Index_global(ctx);
 
-    stage_conv1d.taps_Pointer = get_taps_Pointer_global();
-    stage_conv1d.taps_Index = get_taps_Index_global();
+    stage_conv1d.taps_Pointer = get_taps_Pointer_global(ctx);
+    stage_conv1d.taps_Index = get_taps_Index_global(ctx);
 
     uint32_t new_taps_Pointer= 0;
     new_taps_Pointer = calculate_taps_pointer(conv1d_stage_info.kernel_shape[0],conv1d_stage_info.kernel_shape[1],conv1d_stage_info.kernel_shape[2],conv1d_stage_info.kernel_shape[3]);
@@ -253,13 +253,13 @@ Blob_Stage_data get_CONV_1D_stage_data(Operation_inputs_info curr_stage_info){
 
     uint32_t new_bias_Pointer =0;
     new_bias_Pointer = stage_conv1d.bias_Pointer + calculate_bias_Pointer(conv1d_stage_info.bias_shape[0]);
-    stage_conv1d.bias_Index = get_bias_Index_global();
+    stage_conv1d.bias_Index = get_bias_Index_global(ctx);
 
     stage_conv1d.opPrarams_Pointer = 0;
     stage_conv1d.opPrarams_Index = 0;
 
-    stage_conv1d.output_Pointer = calculate_output_pointer(stage_conv1d.outputDimX,stage_conv1d.outputDimY,stage_conv1d.outputDimZ);
-    stage_conv1d.output_Index = get_output_Index_global()+1;
+    stage_conv1d.output_Pointer = calculate_output_pointer(ctx, stage_conv1d.outputDimX,stage_conv1d.outputDimY,stage_conv1d.outputDimZ);
+    stage_conv1d.output_Index = get_output_Index_global(ctx)+1;
 
     stage_conv1d.preOp_value = 5;
     stage_conv1d.postOp_value = 5;
@@ -273,13 +273,13 @@ Blob_Stage_data get_CONV_1D_stage_data(Operation_inputs_info curr_stage_info){
     stage_conv1d.post_strideY = 0;
 
 
-    if(update_taps_Pointer_g(new_bias_Pointer)!=true)
+    if(update_taps_Pointer_g(ctx, new_bias_Pointer)!=true)
       ALOGE("unable to update taps_Pointer global");
 
-    if(update_output_Pointer_g(stage_conv1d.output_Pointer)!=true)
+    if(update_output_Pointer_g(ctx, stage_conv1d.output_Pointer)!=true)
       ALOGE("unable to update output_Pointer global");
 
-    if(update_output_Index_g(stage_conv1d.output_Index)!=true)
+    if(update_output_Index_g(ctx, stage_conv1d.output_Index)!=true)
       ALOGE("unable to update output_Index global");
 
 
@@ -22,7 +22,7 @@
 #include <log/log.h>
 #include "Blob.h"
 
-Blob_Stage_data get_DEPTHWISE_CONV_2D_stage_data(Operation_inputs_info curr_stage_info){
+Blob_Stage_data get_DEPTHWISE_CONV_2D_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info){
 
   Blob_Stage_data stage_depth_conv2d;
   Operation_inputs_info depth_conv2d_stage_info;
@@ -120,11 +120,11 @@ Blob_Stage_data get_DEPTHWISE_CONV_2D_stage_data(Operation_inputs_info curr_stag
   stage_depth_conv2d.precision_value = 2;
   stage_depth_conv2d.storageOrder_value = 2;
 
-  stage_depth_conv2d.data_Pointer = get_output_Pointer_global();
-  stage_depth_conv2d.data_Index = get_output_Index_global();
+  stage_depth_conv2d.data_Pointer = get_output_Pointer_global(ctx);
+  stage_depth_conv2d.data_Index = get_output_Index_global(ctx);
 
-  stage_depth_conv2d.taps_Pointer = get_taps_Pointer_global();
-  stage_depth_conv2d.taps_Index = get_taps_Index_global();
+  stage_depth_conv2d.taps_Pointer = get_taps_Pointer_global(ctx);
+  stage_depth_conv2d.taps_Index = get_taps_Index_global(ctx);
 
   uint32_t new_taps_Pointer= 0;
   new_taps_Pointer = calculate_taps_pointer(depth_conv2d_stage_info.kernel_shape[0],depth_conv2d_stage_info.kernel_shape[1],depth_conv2d_stage_info.kernel_shape[2],depth_conv2d_stage_info.kernel_shape[3]);
@@ -133,13 +133,13 @@ Blob_Stage_data get_DEPTHWISE_CONV_2D_stage_data(Operation_inputs_info curr_stag
 
   uint32_t new_bias_Pointer =0;
   new_bias_Pointer = stage_depth_conv2d.bias_Pointer + calculate_bias_Pointer(depth_conv2d_stage_info.bias_shape[0]);
-  stage_depth_conv2d.bias_Index = get_bias_Index_global();
+  stage_depth_conv2d.bias_Index = get_bias_Index_global(ctx);
 
   stage_depth_conv2d.opPrarams_Pointer = 0;
   stage_depth_conv2d.opPrarams_Index = 0;
 
-  stage_depth_conv2d.output_Pointer = calculate_output_pointer(stage_depth_conv2d.outputDimX,stage_depth_conv2d.outputDimY,stage_depth_conv2d.outputDimZ);
-  stage_depth_conv2d.output_Index = get_output_Index_global()+1;
+  stage_depth_conv2d.output_Pointer = calculate_output_pointer(ctx, stage_depth_conv2d.outputDimX,stage_depth_conv2d.outputDimY,stage_depth_conv2d.outputDimZ);
+  stage_depth_conv2d.output_Index = get_output_Index_global(ctx)+1;
 
   stage_depth_conv2d.preOp_value = 5;
 
@@ -155,13 +155,13 @@ Blob_Stage_data get_DEPTHWISE_CONV_2D_stage_data(Operation_inputs_info curr_stag
   stage_depth_conv2d.post_strideX = 0;
   stage_depth_conv2d.post_strideY = 0;
 
-  if(update_taps_Pointer_g(new_bias_Pointer)!=true)
+  if(update_taps_Pointer_g(ctx, new_bias_Pointer)!=true)
     ALOGE("unable to update taps_Pointer global");
 
-  if(update_output_Pointer_g(stage_depth_conv2d.output_Pointer)!=true)
+  if(update_output_Pointer_g(ctx, stage_depth_conv2d.output_Pointer)!=true)
     ALOGE("unable to update output_Pointer global");
 
-  if(update_output_Index_g(stage_depth_conv2d.output_Index)!=true)
+  if(update_output_Index_g(ctx, stage_depth_conv2d.output_Index)!=true)
     ALOGE("unable to update output_Index global");
 
 
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include<stdio.h>
+#include<string.h>
+#include<iostream>
+#include<vector>
+#include<stdint.h>
+#include <log/log.h>
+#include "Blob.h"
+
+//the second tensor is read as the taps of the stage, get_stage_buffer() sets
+//the data and taps locations from the operands of the stage
+Blob_Stage_data get_ADD_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info){
+
+  Blob_Stage_data stage_add;
+  Operation_inputs_info add_stage_info;
+
+  add_stage_info = curr_stage_info;
+
+  //initialize stage variables
+  stage_add.stage_name = "Elementwise Sum";
+  stage_add.op_val = 12;
+
+  stage_add.opt_mask = 0x80000000;
+
+  stage_add.radixX = 1;
+  stage_add.radixY = 1;
+
+  stage_add.strideX = 1;
+  stage_add.strideY = 1;
+
+  stage_add.padX =  0;
+  stage_add.padY =  0;
+  stage_add.padStyle_value = 2;
+
+  if(add_stage_info.input_shape[1]!=0)
+     stage_add.inputDimX = add_stage_info.input_shape[1];
+  else
+     stage_add.inputDimX = 1;
+
+  if(add_stage_info.input_shape[2]!=0)
+    stage_add.inputDimY = add_stage_info.input_shape[2];
+  else
+     stage_add.inputDimY = 1;
+
+  if(add_stage_info.input_shape[3]!=0)
+     stage_add.inputDimZ = add_stage_info.input_shape[3];
+  else
+    stage_add.inputDimZ = 1;
+
+  //both tensors have the same dimensions
+  stage_add.tapDimX = stage_add.inputDimX;
+  stage_add.tapDimY = stage_add.inputDimY;
+  stage_add.tapDimZ = stage_add.inputDimZ;
+
+  stage_add.outputDimX = stage_add.inputDimX;
+  stage_add.outputDimY = stage_add.inputDimY;
+  stage_add.outputDimZ = stage_add.inputDimZ;
+
+  stage_add.inputStrideX = 2 * stage_add.inputDimZ;
+  stage_add.inputStrideY = 2 * stage_add.inputDimX * stage_add.inputDimZ;
+  stage_add.inputStrideZ = 2;
+
+  stage_add.tapStrideX = stage_add.inputStrideX;
+  stage_add.tapStrideY = stage_add.inputStrideY;
+  stage_add.tapStrideZ = stage_add.inputStrideZ;
+
+  stage_add.outputStrideX = 2 * stage_add.outputDimZ;
+  stage_add.outputStrideY = 2 * stage_add.outputDimX * stage_add.outputDimZ;
+  stage_add.outputStrideZ = 2;
+
+  stage_add.datatype_value = 2;
+  stage_add.precision_value = 2;
+  stage_add.storageOrder_value = 2;
+
+  stage_add.data_Pointer = get_output_Pointer_global(ctx);
+  stage_add.data_Index = get_output_Index_global(ctx);
+
+  stage_add.taps_Pointer = 0;
+  stage_add.taps_Index = 0;
+
+  stage_add.bias_Pointer = 0;
+  stage_add.bias_Index = 0;
+
+  stage_add.opPrarams_Pointer = 0;
+  stage_add.opPrarams_Index = 0;
+
+  stage_add.output_Pointer = calculate_output_pointer(ctx, stage_add.outputDimX, stage_add.outputDimY, stage_add.outputDimZ);
+  stage_add.output_Index = get_output_Index_global(ctx)+1;
+
+  stage_add.preOp_value = 5;
+
+  switch (add_stage_info.post_operation) {
+    case RELU:{stage_add.postOp_value = 6; stage_add.post_param1[0] = 0x00; stage_add.post_param1[1] = 0x00;stage_add.post_param1[2] = 0x00;stage_add.post_param1[3] = 0x00;}break;
+    case RELU1:{stage_add.postOp_value = 7; stage_add.post_param1[0] = 0x00; stage_add.post_param1[1] = 0x00;stage_add.post_param1[2] = 0x80;stage_add.post_param1[3] = 0x3F;}break;
+    case RELU6:{stage_add.postOp_value = 7; stage_add.post_param1[0] = 0x00; stage_add.post_param1[1] = 0x00;stage_add.post_param1[2] = 0xC0;stage_add.post_param1[3] = 0x40;}break;
+    default: {stage_add.postOp_value = 5; stage_add.post_param1[0] = 0x00; stage_add.post_param1[1] = 0x00;stage_add.post_param1[2] = 0x00;stage_add.post_param1[3] = 0x00;}break;
+  }
+
+  stage_add.post_strideX = 0;
+  stage_add.post_strideY = 0;
+
+  if(update_output_Pointer_g(ctx, stage_add.output_Pointer)!=true)
+    ALOGE("unable to update output_Pointer global");
+
+  if(update_output_Index_g(ctx, stage_add.output_Index)!=true)
+    ALOGE("unable to update output_Index global");
+
+  return stage_add;
+}
@@ -21,7 +21,7 @@
 #include <log/log.h>
 #include "Blob.h"
 
-Blob_Stage_data get_LOGISTIC_stage_data(Operation_inputs_info curr_stage_info){
+Blob_Stage_data get_LOGISTIC_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info){
 
   Blob_Stage_data stage_sigmoid;
   Operation_inputs_info sigmoid_stage_info;
@@ -86,8 +86,8 @@ Blob_Stage_data get_LOGISTIC_stage_data(Operation_inputs_info curr_stage_info){
   stage_sigmoid.precision_value = 2;
   stage_sigmoid.storageOrder_value = 4;
 
-  stage_sigmoid.data_Pointer = get_output_Pointer_global();
-  stage_sigmoid.data_Index = get_output_Index_global();
+  stage_sigmoid.data_Pointer = get_output_Pointer_global(ctx);
+  stage_sigmoid.data_Index = get_output_Index_global(ctx);
 
   stage_sigmoid.taps_Pointer = 0;
   stage_sigmoid.taps_Index = 0;
@@ -98,8 +98,8 @@ Blob_Stage_data get_LOGISTIC_stage_data(Operation_inputs_info curr_stage_info){
   stage_sigmoid.opPrarams_Pointer = 0;
   stage_sigmoid.opPrarams_Index = 0;
 
-  stage_sigmoid.output_Pointer = calculate_output_pointer(stage_sigmoid.outputDimX,stage_sigmoid.outputDimY,stage_sigmoid.outputDimZ);
-  stage_sigmoid.output_Index = get_output_Index_global()+1;
+  stage_sigmoid.output_Pointer = calculate_output_pointer(ctx, stage_sigmoid.outputDimX,stage_sigmoid.outputDimY,stage_sigmoid.outputDimZ);
+  stage_sigmoid.output_Index = get_output_Index_global(ctx)+1;
 
   stage_sigmoid.preOp_value = 5;
   stage_sigmoid.postOp_value = 5;
@@ -112,10 +112,10 @@ Blob_Stage_data get_LOGISTIC_stage_data(Operation_inputs_info curr_stage_info){
   stage_sigmoid.post_strideX = 0;
   stage_sigmoid.post_strideY = 0;
 
-  if(update_output_Pointer_g(stage_sigmoid.output_Pointer)!=true)
+  if(update_output_Pointer_g(ctx, stage_sigmoid.output_Pointer)!=true)
     ALOGE("unable to update output_Pointer global");
 
-  if(update_output_Index_g(stage_sigmoid.output_Index)!=true)
+  if(update_output_Index_g(ctx, stage_sigmoid.output_Index)!=true)
     ALOGE("unable to update output_Index global");
 
   return stage_sigmoid;
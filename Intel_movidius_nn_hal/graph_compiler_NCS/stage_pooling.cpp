@@ -22,7 +22,7 @@
 #include <log/log.h>
 #include "Blob.h"
 
-Blob_Stage_data get_AVG_POOL_stage_data(Operation_inputs_info curr_stage_info){
+Blob_Stage_data get_AVG_POOL_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info){
 
   Blob_Stage_data stage_avg_pool;
   Operation_inputs_info avgpool_stage_info;
@@ -104,8 +104,8 @@ Blob_Stage_data get_AVG_POOL_stage_data(Operation_inputs_info curr_stage_info){
   stage_avg_pool.precision_value = 2;
   stage_avg_pool.storageOrder_value = 2;
 
-  stage_avg_pool.data_Pointer = get_output_Pointer_global();
-  stage_avg_pool.data_Index = get_output_Index_global();
+  stage_avg_pool.data_Pointer = get_output_Pointer_global(ctx);
+  stage_avg_pool.data_Index = get_output_Index_global(ctx);
 
   stage_avg_pool.taps_Pointer = 0;
   stage_avg_pool.taps_Index = 0;
@@ -116,8 +116,8 @@ Blob_Stage_data get_AVG_POOL_stage_data(Operation_inputs_info curr_stage_info){
   stage_avg_pool.opPrarams_Pointer = 0;
   stage_avg_pool.opPrarams_Index = 0;
 
-  stage_avg_pool.output_Pointer = calculate_output_pointer(stage_avg_pool.outputDimX,stage_avg_pool.outputDimY,stage_avg_pool.outputDimZ);
-  stage_avg_pool.output_Index = get_output_Index_global()+1;
+  stage_avg_pool.output_Pointer = calculate_output_pointer(ctx, stage_avg_pool.outputDimX,stage_avg_pool.outputDimY,stage_avg_pool.outputDimZ);
+  stage_avg_pool.output_Index = get_output_Index_global(ctx)+1;
 
   stage_avg_pool.preOp_value = 5;
 
@@ -134,10 +134,10 @@ Blob_Stage_data get_AVG_POOL_stage_data(Operation_inputs_info curr_stage_info){
   stage_avg_pool.post_strideY = 0;
 
 
-  if(update_output_Pointer_g(stage_avg_pool.output_Pointer)!=true)
+  if(update_output_Pointer_g(ctx, stage_avg_pool.output_Pointer)!=true)
     ALOGE("unable to update output_Pointer global");
 
-  if(update_output_Index_g(stage_avg_pool.output_Index)!=true)
+  if(update_output_Index_g(ctx, stage_avg_pool.output_Index)!=true)
     ALOGE("unable to update output_Index global");
 
 
@@ -145,7 +145,7 @@ Blob_Stage_data get_AVG_POOL_stage_data(Operation_inputs_info curr_stage_info){
 }
 
 
-Blob_Stage_data get_MAX_POOL_stage_data(Operation_inputs_info curr_stage_info){
+Blob_Stage_data get_MAX_POOL_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info){
 
   Blob_Stage_data stage_max_pool;
   Operation_inputs_info maxpool_stage_info;
@@ -227,8 +227,8 @@ Blob_Stage_data get_MAX_POOL_stage_data(Operation_inputs_info curr_stage_info){
   stage_max_pool.precision_value = 2;
   stage_max_pool.storageOrder_value = 2;
 
-  stage_max_pool.data_Pointer = get_output_Pointer_global();
-  stage_max_pool.data_Index = get_output_Index_global();
+  stage_max_pool.data_Pointer = get_output_Pointer_global(ctx);
+  stage_max_pool.data_Index = get_output_Index_global(ctx);
 
   stage_max_pool.taps_Pointer = 0;
   stage_max_pool.taps_Index = 0;
@@ -239,8 +239,8 @@ Blob_Stage_data get_MAX_POOL_stage_data(Operation_inputs_info curr_stage_info){
   stage_max_pool.opPrarams_Pointer = 0;
   stage_max_pool.opPrarams_Index = 0;
 
-  stage_max_pool.output_Pointer = calculate_output_pointer(stage_max_pool.outputDimX,stage_max_pool.outputDimY,stage_max_pool.outputDimZ);
-  stage_max_pool.output_Index = get_output_Index_global()+1;
+  stage_max_pool.output_Pointer = calculate_output_pointer(ctx, stage_max_pool.outputDimX,stage_max_pool.outputDimY,stage_max_pool.outputDimZ);
+  stage_max_pool.output_Index = get_output_Index_global(ctx)+1;
 
   stage_max_pool.preOp_value = 5;
 
@@ -257,10 +257,10 @@ Blob_Stage_data get_MAX_POOL_stage_data(Operation_inputs_info curr_stage_info){
   stage_max_pool.post_strideY = 0;
 
 
-  if(update_output_Pointer_g(stage_max_pool.output_Pointer)!=true)
+  if(update_output_Pointer_g(ctx, stage_max_pool.output_Pointer)!=true)
     ALOGE("unable to update output_Pointer global");
 
-  if(update_output_Index_g(stage_max_pool.output_Index)!=true)
+  if(update_output_Index_g(ctx, stage_max_pool.output_Index)!=true)
     ALOGE("unable to update output_Index global");
 
 
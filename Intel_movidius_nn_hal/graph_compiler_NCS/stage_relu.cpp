@@ -22,7 +22,7 @@
 #include "Blob.h"
 
 
-Blob_Stage_data get_RELU_stage_data(Operation_inputs_info curr_stage_info){
+Blob_Stage_data get_RELU_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info){
 
   Blob_Stage_data stage_relu;
   Operation_inputs_info relu_stage_info;
@@ -86,8 +86,8 @@ Blob_Stage_data get_RELU_stage_data(Operation_inputs_info curr_stage_info){
   stage_relu.precision_value = 2;
   stage_relu.storageOrder_value = 2;
 
-  stage_relu.data_Pointer = get_output_Pointer_global();
-  stage_relu.data_Index = get_output_Index_global();
+  stage_relu.data_Pointer = get_output_Pointer_global(ctx);
+  stage_relu.data_Index = get_output_Index_global(ctx);
 
   stage_relu.taps_Pointer = 0;
   stage_relu.taps_Index = 0;
@@ -98,8 +98,8 @@ Blob_Stage_data get_RELU_stage_data(Operation_inputs_info curr_stage_info){
   stage_relu.opPrarams_Pointer = 0;
   stage_relu.opPrarams_Index = 0;
 
-  stage_relu.output_Pointer = calculate_output_pointer(stage_relu.outputDimX, stage_relu.outputDimY, stage_relu.outputDimZ);
-  stage_relu.output_Index = get_output_Index_global()+1;
+  stage_relu.output_Pointer = calculate_output_pointer(ctx, stage_relu.outputDimX, stage_relu.outputDimY, stage_relu.outputDimZ);
+  stage_relu.output_Index = get_output_Index_global(ctx)+1;
 
   stage_relu.preOp_value = 5;
   stage_relu.postOp_value = 6;
@@ -114,17 +114,17 @@ Blob_Stage_data get_RELU_stage_data(Operation_inputs_info curr_stage_info){
   stage_relu.post_strideY = 0;
 
 
-  if(update_output_Pointer_g(stage_relu.output_Pointer)!=true)
+  if(update_output_Pointer_g(ctx, stage_relu.output_Pointer)!=true)
     ALOGE("unable to update output_Pointer global");
 
-  if(update_output_Index_g(stage_relu.output_Index)!=true)
+  if(update_output_Index_g(ctx, stage_relu.output_Index)!=true)
     ALOGE("unable to update output_Index global");
 
   return stage_relu;
 }
 
 
-Blob_Stage_data get_RELU1_stage_data(Operation_inputs_info curr_stage_info){
+Blob_Stage_data get_RELU1_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info){
 
   Blob_Stage_data stage_relu1;
   Operation_inputs_info relu1_stage_info;
@@ -190,8 +190,8 @@ Blob_Stage_data get_RELU1_stage_data(Operation_inputs_info curr_stage_info){
   stage_relu1.precision_value = 2;
   stage_relu1.storageOrder_value = 4;
 
-  stage_relu1.data_Pointer = get_output_Pointer_global();
-  stage_relu1.data_Index = get_output_Index_global();
+  stage_relu1.data_Pointer = get_output_Pointer_global(ctx);
+  stage_relu1.data_Index = get_output_Index_global(ctx);
 
   stage_relu1.taps_Pointer = 0;
   stage_relu1.taps_Index = 0;
@@ -202,8 +202,8 @@ Blob_Stage_data get_RELU1_stage_data(Operation_inputs_info curr_stage_info){
   stage_relu1.opPrarams_Pointer = 0;
   stage_relu1.opPrarams_Index = 0;
 
-  stage_relu1.output_Pointer = calculate_output_pointer(stage_relu1.outputDimX, stage_relu1.outputDimY, stage_relu1.outputDimZ);
-  stage_relu1.output_Index = get_output_Index_global()+1;
+  stage_relu1.output_Pointer = calculate_output_pointer(ctx, stage_relu1.outputDimX, stage_relu1.outputDimY, stage_relu1.outputDimZ);
+  stage_relu1.output_Index = get_output_Index_global(ctx)+1;
 
   stage_relu1.preOp_value = 5;
   stage_relu1.postOp_value = 7;
@@ -217,17 +217,17 @@ Blob_Stage_data get_RELU1_stage_data(Operation_inputs_info curr_stage_info){
   stage_relu1.post_strideY = 0;
 
 
-  if(update_output_Pointer_g(stage_relu1.output_Pointer)!=true)
+  if(update_output_Pointer_g(ctx, stage_relu1.output_Pointer)!=true)
     ALOGE("unable to update output_Pointer global");
 
-  if(update_output_Index_g(stage_relu1.output_Index)!=true)
+  if(update_output_Index_g(ctx, stage_relu1.output_Index)!=true)
     ALOGE("unable to update output_Index global");
 
   return stage_relu1;
 }
 
 
-Blob_Stage_data get_RELU6_stage_data(Operation_inputs_info curr_stage_info){
+Blob_Stage_data get_RELU6_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info){
 
   Blob_Stage_data stage_relu6;
   Operation_inputs_info relu6_stage_info;
@@ -293,8 +293,8 @@ Blob_Stage_data get_RELU6_stage_data(Operation_inputs_info curr_stage_info){
   stage_relu6.precision_value = 2;
   stage_relu6.storageOrder_value = 4;
 
-  stage_relu6.data_Pointer = get_output_Pointer_global();
-  stage_relu6.data_Index = get_output_Index_global()-1;
+  stage_relu6.data_Pointer = get_output_Pointer_global(ctx);
+  stage_relu6.data_Index = get_output_Index_global(ctx);
 
   stage_relu6.taps_Pointer = 0;
   stage_relu6.taps_Index = 0;
@@ -305,8 +305,8 @@ Blob_Stage_data get_RELU6_stage_data(Operation_inputs_info curr_stage_info){
   stage_relu6.opPrarams_Pointer = 0;
   stage_relu6.opPrarams_Index = 0;
 
-  stage_relu6.output_Pointer = calculate_output_pointer(stage_relu6.outputDimX, stage_relu6.outputDimY, stage_relu6.outputDimZ);
-  stage_relu6.output_Index = get_output_Index_global();
+  stage_relu6.output_Pointer = calculate_output_pointer(ctx, stage_relu6.outputDimX, stage_relu6.outputDimY, stage_relu6.outputDimZ);
+  stage_relu6.output_Index = get_output_Index_global(ctx)+1;
 
   stage_relu6.preOp_value = 5;
   stage_relu6.postOp_value = 7;
@@ -321,10 +321,10 @@ Blob_Stage_data get_RELU6_stage_data(Operation_inputs_info curr_stage_info){
 
 
 
-  if(update_output_Pointer_g(stage_relu6.output_Pointer)!=true)
+  if(update_output_Pointer_g(ctx, stage_relu6.output_Pointer)!=true)
     ALOGE("unable to update output_Pointer global");
 
-  if(update_output_Index_g(stage_relu6.output_Index)!=true)
+  if(update_output_Index_g(ctx, stage_relu6.output_Index)!=true)
     ALOGE("unable to update output_Index global");
 
   return stage_relu6;
@@ -21,7 +21,7 @@
 #include <log/log.h>
 #include "Blob.h"
 
-Blob_Stage_data get_Reshape_stage_data(Operation_inputs_info curr_stage_info){
+Blob_Stage_data get_Reshape_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info){
 
   Blob_Stage_data stage_reshape;
   Operation_inputs_info reshape_stage_info;
@@ -98,8 +98,8 @@ Blob_Stage_data get_Reshape_stage_data(Operation_inputs_info curr_stage_info){
   stage_reshape.precision_value = 2;
   stage_reshape.storageOrder_value = 2;
 
-  stage_reshape.data_Pointer = get_output_Pointer_global();
-  stage_reshape.data_Index = get_output_Index_global();
+  stage_reshape.data_Pointer = get_output_Pointer_global(ctx);
+  stage_reshape.data_Index = get_output_Index_global(ctx);
 
   stage_reshape.taps_Pointer = 0;
   stage_reshape.taps_Index = 0;
@@ -110,8 +110,8 @@ Blob_Stage_data get_Reshape_stage_data(Operation_inputs_info curr_stage_info){
   stage_reshape.opPrarams_Pointer = 0;
   stage_reshape.opPrarams_Index = 0;
 
-  stage_reshape.output_Pointer = calculate_output_pointer(stage_reshape.outputDimX,stage_reshape.outputDimY,stage_reshape.outputDimZ);
-  stage_reshape.output_Index = get_output_Index_global()+1;
+  stage_reshape.output_Pointer = calculate_output_pointer(ctx, stage_reshape.outputDimX,stage_reshape.outputDimY,stage_reshape.outputDimZ);
+  stage_reshape.output_Index = get_output_Index_global(ctx)+1;
 
   stage_reshape.preOp_value = 5;
   stage_reshape.postOp_value = 5;
@@ -125,10 +125,10 @@ Blob_Stage_data get_Reshape_stage_data(Operation_inputs_info curr_stage_info){
   stage_reshape.post_strideY = 0;
 
 
-  if(update_output_Pointer_g(stage_reshape.output_Pointer)!=true)
+  if(update_output_Pointer_g(ctx, stage_reshape.output_Pointer)!=true)
     ALOGE("unable to update output_Pointer global");
 
-  if(update_output_Index_g(stage_reshape.output_Index)!=true)
+  if(update_output_Index_g(ctx, stage_reshape.output_Index)!=true)
     ALOGE("unable to update output_Index global");
 
 
@@ -21,7 +21,7 @@
 #include <log/log.h>
 #include "Blob.h"
 
-Blob_Stage_data get_Softmax_stage_data(Operation_inputs_info curr_stage_info){
+Blob_Stage_data get_Softmax_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info){
 
   Blob_Stage_data stage_softmax;
   Operation_inputs_info softmax_stage_info;
@@ -94,8 +94,8 @@ Blob_Stage_data get_Softmax_stage_data(Operation_inputs_info curr_stage_info){
   stage_softmax.precision_value = 2;
   stage_softmax.storageOrder_value = 2;
 
-  stage_softmax.data_Pointer = get_output_Pointer_global();
-  stage_softmax.data_Index = get_output_Index_global();
+  stage_softmax.data_Pointer = get_output_Pointer_global(ctx);
+  stage_softmax.data_Index = get_output_Index_global(ctx);
 
   stage_softmax.taps_Pointer = 0;
   stage_softmax.taps_Index = 0;
@@ -103,11 +103,11 @@ Blob_Stage_data get_Softmax_stage_data(Operation_inputs_info curr_stage_info){
   stage_softmax.bias_Pointer = 0;
   stage_softmax.bias_Index = 0;
 
-  stage_softmax.opPrarams_Pointer = get_taps_Pointer_global();
-  stage_softmax.opPrarams_Index = get_taps_Index_global();
+  stage_softmax.opPrarams_Pointer = get_taps_Pointer_global(ctx);
+  stage_softmax.opPrarams_Index = get_taps_Index_global(ctx);
 
-  stage_softmax.output_Pointer = calculate_output_pointer(stage_softmax.outputDimX,stage_softmax.outputDimY,stage_softmax.outputDimZ);
-  stage_softmax.output_Index = get_output_Index_global()+1;
+  stage_softmax.output_Pointer = calculate_output_pointer(ctx, stage_softmax.outputDimX,stage_softmax.outputDimY,stage_softmax.outputDimZ);
+  stage_softmax.output_Index = get_output_Index_global(ctx)+1;
 
   stage_softmax.preOp_value = 5;
   stage_softmax.postOp_value = 5;
@@ -123,14 +123,14 @@ Blob_Stage_data get_Softmax_stage_data(Operation_inputs_info curr_stage_info){
   uint32_t new_bias_Pointer =0;
   new_bias_Pointer = stage_softmax.opPrarams_Pointer + 64; //TODO FIX the had code later
 
-  if(update_taps_Pointer_g(new_bias_Pointer)!=true)
+  if(update_taps_Pointer_g(ctx, new_bias_Pointer)!=true)
     ALOGE("unable to update taps_Pointer global");
 
 
-  if(update_output_Pointer_g(stage_softmax.output_Pointer)!=true)
+  if(update_output_Pointer_g(ctx, stage_softmax.output_Pointer)!=true)
     ALOGE("unable to update output_Pointer global");
 
-  if(update_output_Index_g(stage_softmax.output_Index)!=true)
+  if(update_output_Index_g(ctx, stage_softmax.output_Index)!=true)
     ALOGE("unable to update output_Index global");
 
 
@@ -21,7 +21,7 @@
 #include <log/log.h>
 #include "Blob.h"
 
-Blob_Stage_data get_TANH_stage_data(Operation_inputs_info curr_stage_info){
+Blob_Stage_data get_TANH_stage_data(Compile_context *ctx, Operation_inputs_info curr_stage_info){
 
   Blob_Stage_data stage_tanh;
   Operation_inputs_info tanh_stage_info;
@@ -87,8 +87,8 @@ Blob_Stage_data get_TANH_stage_data(Operation_inputs_info curr_stage_info){
   stage_tanh.precision_value = 2;
   stage_tanh.storageOrder_value = 2;
 
-  stage_tanh.data_Pointer = get_output_Pointer_global();
-  stage_tanh.data_Index = get_output_Index_global();
+  stage_tanh.data_Pointer = get_output_Pointer_global(ctx);
+  stage_tanh.data_Index = get_output_Index_global(ctx);
 
   stage_tanh.taps_Pointer = 0;
   stage_tanh.taps_Index = 0;
@@ -99,8 +99,8 @@ Blob_Stage_data get_TANH_stage_data(Operation_inputs_info curr_stage_info){
   stage_tanh.opPrarams_Pointer = 0;
   stage_tanh.opPrarams_Index = 0;
 
-  stage_tanh.output_Pointer = calculate_output_pointer(stage_tanh.outputDimX,stage_tanh.outputDimY,stage_tanh.outputDimZ);
-  stage_tanh.output_Index = get_output_Index_global()+1;
+  stage_tanh.output_Pointer = calculate_output_pointer(ctx, stage_tanh.outputDimX,stage_tanh.outputDimY,stage_tanh.outputDimZ);
+  stage_tanh.output_Index = get_output_Index_global(ctx)+1;
 
   stage_tanh.preOp_value = 5;
   stage_tanh.postOp_value = 5;
@@ -114,10 +114,10 @@ Blob_Stage_data get_TANH_stage_data(Operation_inputs_info curr_stage_info){
   stage_tanh.post_strideY = 0;
 
 
-  if(update_output_Pointer_g(stage_tanh.output_Pointer)!=true)
+  if(update_output_Pointer_g(ctx, stage_tanh.output_Pointer)!=true)
     ALOGE("unable to update output_Pointer global");
 
-  if(update_output_Index_g(stage_tanh.output_Index)!=true)
+  if(update_output_Index_g(ctx, stage_tanh.output_Index)!=true)
     ALOGE("unable to update output_Index global");
 
 
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compiles two different graphs back to back and at the same time in one
+// process, and checks every blob byte for byte against the blob of a compile
+// done alone in a fresh process.
+//
+// usage: test
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<unistd.h>
+#include<sys/wait.h>
+#include<thread>
+#include<vector>
+#include "Blob.h"
+
+typedef std::vector<char> Graph_blob;
+
+static std::vector<float> kernel_data(3 * 3 * 3 * 8, 0.25f);
+static std::vector<float> bias_data(8, 0.5f);
+
+static Operation_inputs_info conv_stage(NCSoperations post_operation){
+  Operation_inputs_info stage = Operation_inputs_info();
+  stage.main_operation = CONV_2D;
+  stage.num_inputs = 3;
+  stage.input_shape[0] = 1; stage.input_shape[1] = 16; stage.input_shape[2] = 16; stage.input_shape[3] = 3;
+  stage.kernel_shape[0] = 3; stage.kernel_shape[1] = 3; stage.kernel_shape[2] = 3; stage.kernel_shape[3] = 8;
+  stage.kernel_buffer = kernel_data.data();
+  stage.bias_shape[0] = 8;
+  stage.bias_buffer = bias_data.data();
+  stage.output_shape[0] = 1; stage.output_shape[1] = 16; stage.output_shape[2] = 16; stage.output_shape[3] = 8;
+  stage.padding_left = 1; stage.padding_right = 1; stage.padding_top = 1; stage.padding_bottom = 1;
+  stage.stride_width = 1;
+  stage.stride_height = 1;
+  stage.kernel_data = true;
+  stage.bias_data = true;
+  stage.post_operation = post_operation;
+  return stage;
+}
+
+static Operation_inputs_info activation_stage(NCSoperations operation){
+  Operation_inputs_info stage = Operation_inputs_info();
+  stage.main_operation = operation;
+  stage.num_inputs = 1;
+  stage.input_shape[0] = 1; stage.input_shape[1] = 16; stage.input_shape[2] = 16; stage.input_shape[3] = 8;
+  stage.output_shape[0] = 1; stage.output_shape[1] = 16; stage.output_shape[2] = 16; stage.output_shape[3] = 8;
+  stage.stride_width = 1;
+  stage.stride_height = 1;
+  stage.post_operation = NONE;
+  return stage;
+}
+
+static Network_Vector_Stageinfo get_network(int graph){
+  Network_Vector_Stageinfo stages;
+  if(graph == 0){
+    stages.push_back(conv_stage(RELU));
+    stages.push_back(activation_stage(TANH));
+  }else{
+    stages.push_back(activation_stage(RELU));
+    stages.push_back(activation_stage(LOGISTIC));
+    stages.push_back(conv_stage(NONE));
+  }
+  return stages;
+}
+
+static bool compile(int graph, Graph_blob *blob){
+  Compile_context ctx;
+  init_compile_context(&ctx);
+
+  Network_Vector_Stageinfo stages = get_network(graph);
+  network_operations_vector operations;
+  for(size_t i=0;i<stages.size();i++)
+    operations.push_back(stages[i].main_operation);
+  if(!get_nn_network_from_android(&ctx, operations))
+    return false;
+  for(size_t i=0;i<stages.size();i++){
+    if(!parse_stage_from_android(&ctx, stages[i]))
+      return false;
+  }
+
+  char *graph_blob = NULL;
+  uint32_t graph_blob_size = 0;
+  if(!prepare_blob(&ctx, "android-nn-model-" + std::to_string(graph), graph, &graph_blob, &graph_blob_size))
+    return false;
+  blob->assign(graph_blob, graph_blob + graph_blob_size);
+  free(graph_blob);
+  return true;
+}
+
+//compiles the graph in a child process, as the only compilation of that process
+static bool compile_in_fresh_process(int graph, Graph_blob *blob){
+  int fds[2];
+  if(pipe(fds) != 0)
+    return false;
+  pid_t pid = fork();
+  if(pid == 0){
+    close(fds[0]);
+    Graph_blob child_blob;
+    if(!compile(graph, &child_blob))
+      _exit(1);
+    size_t written = 0;
+    while(written < child_blob.size()){
+      ssize_t n = write(fds[1], child_blob.data() + written, child_blob.size() - written);
+      if(n <= 0)
+        _exit(1);
+      written += n;
+    }
+    _exit(0);
+  }
+  close(fds[1]);
+  char buf[4096];
+  ssize_t n;
+  blob->clear();
+  while((n = read(fds[0], buf, sizeof(buf))) > 0)
+    blob->insert(blob->end(), buf, buf + n);
+  close(fds[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0 && !blob->empty();
+}
+
+static bool check(const char *name, const Graph_blob &blob, const Graph_blob &reference){
+  bool same = blob == reference;
+  printf("%-32s %6zu bytes %s\n", name, blob.size(), same ? "PASS" : "FAIL");
+  return same;
+}
+
+int main(int argc, const char *argv[]){
+  Graph_blob reference[2];
+  for(int graph=0;graph<2;graph++){
+    if(!compile_in_fresh_process(graph, &reference[graph])){
+      printf("unable to compile graph %d in a fresh process\n", graph);
+      return 1;
+    }
+  }
+  if(reference[0] == reference[1]){
+    printf("both graphs compiled to the same blob\n");
+    return 1;
+  }
+
+  bool success = true;
+  Graph_blob blob[2];
+
+  //back to back, twice, so that each graph follows the other one
+  for(int round=0;round<2;round++){
+    for(int graph=0;graph<2;graph++){
+      std::string name = "sequential graph " + std::to_string(graph) + " round " + std::to_string(round);
+      success = compile(graph, &blob[graph]) && check(name.c_str(), blob[graph], reference[graph]) && success;
+    }
+  }
+
+  //at the same time
+  bool status[2];
+  std::vector<std::thread> threads;
+  for(int graph=0;graph<2;graph++)
+    threads.emplace_back([graph, &blob, &status]{ status[graph] = compile(graph, &blob[graph]); });
+  for(size_t i=0;i<threads.size();i++)
+    threads[i].join();
+  for(int graph=0;graph<2;graph++){
+    std::string name = "parallel graph " + std::to_string(graph);
+    success = status[graph] && check(name.c_str(), blob[graph], reference[graph]) && success;
+  }
+
+  printf("%s\n", success ? "PASS" : "FAIL");
+  return success ? 0 : 1;
+}
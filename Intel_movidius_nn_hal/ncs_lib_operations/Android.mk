@@ -22,9 +22,21 @@ LOCAL_SRC_FILES := fp.cpp ncs_lib.cpp
 LOCAL_C_INCLUDES += $(LOCAL_PATH)/../libncs/ncsdk-1.12.00.01/api/include \
                     $(LOCAL_PATH)/../graph_compiler_NCS \
                     $(LOCAL_PATH)
-LOCAL_SHARED_LIBRARIES := libncsdk liblog libutils
+LOCAL_SHARED_LIBRARIES := $(NCS_MVNC_LIBRARY) liblog libutils libcutils
 LOCAL_CPPFLAGS := -fexceptions -o3
 LOCAL_MODULE := libncs_nn_operation
 
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := ncs_bench.cpp
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../libncs/ncsdk-1.12.00.01/api/include \
+                    $(LOCAL_PATH)/../graph_compiler_NCS \
+                    $(LOCAL_PATH)
+LOCAL_SHARED_LIBRARIES := $(NCS_MVNC_LIBRARY) libncs_nn_operation libncs_graph_compiler liblog libutils
+LOCAL_CPPFLAGS := -fexceptions
+LOCAL_MODULE := ncs_bench
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Throughput of the ncs_lib device pool.
+// Compiles a CONV_2D+RELU graph and runs it from four clients per stick, each
+// executing the graph back to back. It prints the inferences per second with
+// the requests and utilization of every stick for a pool of 1 to N sticks,
+// then for the whole pool with 1 to 4 tensors in flight per graph.
+//
+// usage: ncs_bench [inferences per client]
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<chrono>
+#include<string>
+#include<thread>
+#include<vector>
+#include "Blob.h"
+#include "ncs_lib.h"
+
+#define INPUT_DIM 56
+#define CHANNELS 32
+#define CLIENTS_PER_DEVICE 4
+#define MAX_INFLIGHT 4
+
+static std::vector<float> kernel_data(3 * 3 * CHANNELS * CHANNELS, 0.01f);
+static std::vector<float> bias_data(CHANNELS, 0.5f);
+
+static bool compile_graph(char **graph_blob, uint32_t *graph_blob_size){
+  Compile_context ctx;
+  init_compile_context(&ctx);
+
+  Operation_inputs_info stage = Operation_inputs_info();
+  stage.main_operation = CONV_2D;
+  stage.num_inputs = 3;
+  stage.input_shape[0] = 1; stage.input_shape[1] = INPUT_DIM; stage.input_shape[2] = INPUT_DIM; stage.input_shape[3] = CHANNELS;
+  stage.kernel_shape[0] = 3; stage.kernel_shape[1] = 3; stage.kernel_shape[2] = CHANNELS; stage.kernel_shape[3] = CHANNELS;
+  stage.kernel_buffer = kernel_data.data();
+  stage.bias_shape[0] = CHANNELS;
+  stage.bias_buffer = bias_data.data();
+  stage.output_shape[0] = 1; stage.output_shape[1] = INPUT_DIM; stage.output_shape[2] = INPUT_DIM; stage.output_shape[3] = CHANNELS;
+  stage.padding_left = 1; stage.padding_right = 1; stage.padding_top = 1; stage.padding_bottom = 1;
+  stage.stride_width = 1;
+  stage.stride_height = 1;
+  stage.kernel_data = true;
+  stage.bias_data = true;
+  stage.post_operation = RELU;
+
+  network_operations_vector operations;
+  operations.push_back(CONV_2D);
+  if(!get_nn_network_from_android(&ctx, operations) || !parse_stage_from_android(&ctx, stage))
+    return false;
+  return prepare_blob(&ctx, "ncs-bench", 0, graph_blob, graph_blob_size);
+}
+
+//runs the pool with the given number of sticks and tensors in flight,
+//returns the inferences per second
+static double run_pool(int pool_devices, int inflight, int inferences){
+  ncs_set_pool_size(pool_devices);
+  ncs_set_inflight(inflight);
+  if(ncs_init() != 0)
+    return 0;
+
+  const uint32_t elements = INPUT_DIM * INPUT_DIM * CHANNELS;
+  char *graph_blob = NULL;
+  uint32_t graph_blob_size = 0;
+  int graph_id;
+  if(!compile_graph(&graph_blob, &graph_blob_size) ||
+     ncs_load_graph(graph_blob, graph_blob_size, elements, elements, &graph_id) != 0){
+    printf("unable to load the graph\n");
+    ncs_deinit();
+    return 0;
+  }
+
+  int clients = CLIENTS_PER_DEVICE * ncs_device_count();
+  std::vector<std::thread> threads;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(int c=0;c<clients;c++){
+    threads.emplace_back([graph_id, elements, inferences]{
+      std::vector<float> input(elements, 1.0f), output(elements);
+      for(int i=0;i<inferences;i++)
+        ncs_execute(graph_id, input.data(), elements, output.data(), elements);
+    });
+  }
+  for(size_t i=0;i<threads.size();i++)
+    threads[i].join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  double throughput = clients * inferences / seconds;
+
+  std::string inflight_name = inflight > 0 ? std::to_string(inflight) : "default";
+  printf("%7d %8s %12.1f\n", ncs_device_count(), inflight_name.c_str(), throughput);
+  for(int d=0;d<ncs_device_count();d++){
+    Ncs_device_stats stats;
+    if(ncs_get_device_stats(d, &stats) == 0)
+      printf("        device %d: %u requests, %.1f%% busy\n", d, stats.requests, 100.0 * stats.utilization);
+  }
+
+  ncs_unload_graph(graph_id);
+  ncs_deinit();
+  return throughput;
+}
+
+int main(int argc, const char *argv[]){
+  int inferences = argc > 1 ? atoi(argv[1]) : 50;
+
+  ncs_set_pool_size(0);
+  if(ncs_init() != 0){
+    printf("no NCS device found\n");
+    return 1;
+  }
+  int available = ncs_device_count();
+  ncs_deinit();
+
+  printf("%7s %8s %12s\n", "devices", "inflight", "inferences/s");
+  double single = 0;
+  for(int n=1;n<=available;n++){
+    double throughput = run_pool(n, 0, inferences);
+    if(n == 1)
+      single = throughput;
+    else if(single > 0)
+      printf("        scaling %.2fx\n", throughput / single);
+  }
+
+  double serial = 0;
+  for(int k=1;k<=MAX_INFLIGHT;k++){
+    double throughput = run_pool(0, k, inferences);
+    if(k == 1)
+      serial = throughput;
+    else if(serial > 0)
+      printf("        speedup %.2fx\n", throughput / serial);
+  }
+  return 0;
+}
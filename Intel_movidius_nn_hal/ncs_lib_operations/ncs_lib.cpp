@@ -15,209 +15,583 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <iostream>
+#include <map>
+#include <algorithm>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <atomic>
+#include <chrono>
 #include <mvnc.h>
 #include <log/log.h>
+#include <cutils/properties.h>
 #include "fp.h"
 #include "ncs_lib.h"
 
 // Global Variables
-#define NCS_NUM 0
 #define NAME_SIZE 100
 #define NCS_CHECK_TIMES 5
 
-//TODO Check what is needed
+//graphs kept allocated on a stick at the same time, nn.hal.vpu.resident_graphs overrides it
+#define NCS_MAX_RESIDENT_GRAPHS 4
 
-mvncStatus retCode;
-void *deviceHandle;
-void* graphHandle;
-void* graphFileBuf;
-bool device_online = false;
-bool graph_load = false;
-char devName[NAME_SIZE];
-unsigned int graphFileLen;
-
-
-void* resultData16;
-void* userParam;
-unsigned int lenResultData;
-
-unsigned int lenip1_fp16;
+//tensors queued per graph on a stick, nn.hal.vpu.inflight overrides it
+#define NCS_INFLIGHT_TENSORS 2
 
 // 16 bits.  will use this to store half precision floats since C++ has no
 // built in support for it.
 typedef unsigned short half;
-half *ip1_fp16;
-void *LoadgraphFile(const char *path, unsigned int *length);
+
+typedef std::chrono::steady_clock ncs_clock;
+
+//a graph loaded by a prepared model, placed on one or more sticks of the pool.
+//The blob stays on the host so that the graph can be allocated on a stick
+//again after it has been swapped out. The per stick fields are guarded by
+//the lock of that stick.
+typedef struct ncs_graph {
+  void *graph_buf;
+  unsigned int graph_len;
+  uint32_t input_num_of_elements;
+  uint32_t output_num_of_elements;
+  std::vector<half *> staging; //free FP16 input buffers, guarded by ncs_lock
+  int ref_count;
+  int device_count;
+  int devices[NCS_MAX_DEVICES];
+  void *graph_handle[NCS_MAX_DEVICES]; //NULL while the graph is swapped out
+  uint64_t last_use[NCS_MAX_DEVICES];
+  uint32_t allocations[NCS_MAX_DEVICES];
+  int inflight[NCS_MAX_DEVICES]; //tensors loaded and not yet returned, the graph stays resident
+} Ncs_graph;
+
+//an inference waiting on a stick, the tensor is loaded with it as userParam
+typedef struct ncs_request {
+  Ncs_graph *graph;
+  const Ncs_tensor *outputs; //packed one after another in the result
+  int output_count;
+  mvncStatus status;
+  bool done;
+} Ncs_request;
+
+typedef struct ncs_device {
+  char name[NAME_SIZE];
+  void *handle;
+  ncs_clock::time_point opened_at;
+  int graphs; //graphs placed on the stick, guarded by ncs_lock
+  std::atomic<int> queue_depth;
+
+  //guards the graphs of the stick and the requests queued on it
+  std::mutex lock;
+  std::condition_variable cv;
+  std::vector<Ncs_graph *> resident;
+  std::deque<Ncs_request *> pending; //tensors loaded on the stick, oldest first
+  std::thread result_thread;
+  bool stopping;
+  uint64_t use_clock;
+  uint32_t requests;
+  ncs_clock::time_point busy_since;
+  double busy_us;
+  uint32_t swap_ins;
+  uint32_t swap_outs;
+  double swap_in_us;
+  double max_swap_in_us;
+} Ncs_device;
+
+//ncs_lock guards the pool and the graph table, it is never taken while
+//holding the lock of a stick
+std::mutex ncs_lock;
+Ncs_device devices[NCS_MAX_DEVICES];
+int device_count = 0;
+int device_users = 0;
+int pool_size = 0; //0 opens every stick, see ncs_set_pool_size()
+int graph_devices = 0;
+int max_resident_graphs = NCS_MAX_RESIDENT_GRAPHS;
+int max_inflight = 0; //0 reads nn.hal.vpu.inflight, see ncs_set_inflight()
+
+std::map<int, Ncs_graph *> graphs;
+int next_graph_id = 0;
 
 //----------------------------------- Declaration is done
 
-//graph file loading
-void *LoadgraphFile(const char *path, unsigned int *length){
+static void log_device_stats(int d){
+  Ncs_device &device = devices[d];
+  double open_us = std::chrono::duration<double, std::micro>(ncs_clock::now() - device.opened_at).count();
+  ALOGD("NCS device %d (%s): %u requests, busy %.1f%%", d, device.name, device.requests,
+        open_us > 0 ? 100.0 * device.busy_us / open_us : 0.0);
+  if(device.swap_ins > 0)
+    ALOGD("NCS device %d graph swaps: %u in, %u out, swap in average %.1f us, max %.1f us",
+          d, device.swap_ins, device.swap_outs, device.swap_in_us / device.swap_ins, device.max_swap_in_us);
+}
 
-  FILE *fp;
-  char *buf;
-  fp = fopen(path, "rb");
-  if(fp == NULL)
-  {
-    ALOGE("unable to open graph file");
+//deallocates the graph from stick d, the blob stays with the entry
+static int swap_out_graph(int d, Ncs_graph *graph){
+  Ncs_device &device = devices[d];
+  mvncStatus retCode = mvncDeallocateGraph(graph->graph_handle[d]);
+  graph->graph_handle[d] = NULL;
+  for(size_t i=0;i<device.resident.size();i++){
+    if(device.resident[i] == graph){
+      device.resident.erase(device.resident.begin() + i);
+      break;
+    }
   }
-  fseek(fp, 0, SEEK_END);
-  *length = ftell(fp);
-  rewind(fp);
+  if (retCode != MVNC_OK){
+    ALOGE("NCS could not Deallocate Graph on device %d: %d", d, retCode);
+    return 6;
+  }
+  return 0;
+}
 
-  if(!(buf = (char*) malloc(*length)))
-  {
-    ALOGE("unable to create graph buffer");
+//swaps out the least recently used idle graph of stick d other than keep
+static bool evict_lru_graph(int d, Ncs_graph *keep){
+  Ncs_device &device = devices[d];
+  Ncs_graph *lru = NULL;
+  for(size_t i=0;i<device.resident.size();i++){
+    Ncs_graph *graph = device.resident[i];
+    if(graph != keep && graph->inflight[d] == 0 && (lru == NULL || graph->last_use[d] < lru->last_use[d]))
+      lru = graph;
   }
-  memset(buf, 0, *length);
-  if(fread(buf, 1, *length, fp) != *length)
-  {
-    fclose(fp);
-    free(buf);
+  if(lru == NULL)
+    return false;
+
+  ALOGD("swapping out a graph from device %d", d);
+  swap_out_graph(d, lru);
+  device.swap_outs++;
+  return true;
+}
+
+//allocates the graph on stick d, evicting least recently used graphs while
+//the stick is full. The lock of the stick must be held.
+static int make_resident(int d, Ncs_graph *graph){
+  Ncs_device &device = devices[d];
+  graph->last_use[d] = ++device.use_clock;
+  if(graph->graph_handle[d] != NULL)
+    return 0;
+
+  while((int)device.resident.size() >= max_resident_graphs && evict_lru_graph(d, graph));
+
+  ncs_clock::time_point start = ncs_clock::now();
+  mvncStatus retCode = mvncAllocateGraph(device.handle, &graph->graph_handle[d], graph->graph_buf, graph->graph_len);
+  while(retCode == MVNC_OUT_OF_MEMORY && evict_lru_graph(d, graph))
+    retCode = mvncAllocateGraph(device.handle, &graph->graph_handle[d], graph->graph_buf, graph->graph_len);
+  if (retCode != MVNC_OK){
+    ALOGE("Could not allocate graph on device %d: %d", d, retCode);
+    graph->graph_handle[d] = NULL;
+    return 6;
+  }
+  device.resident.push_back(graph);
+
+  //the first allocation happens at prepare time and is not a swap
+  if(graph->allocations[d]++ > 0){
+    double us = std::chrono::duration<double, std::micro>(ncs_clock::now() - start).count();
+    device.swap_ins++;
+    device.swap_in_us += us;
+    if(us > device.max_swap_in_us)
+      device.max_swap_in_us = us;
+    ALOGD("graph swapped in on device %d after %.1f us", d, us);
   }
-  fclose(fp);
-  return buf;
+  return 0;
 }
 
-//ncs_init() begin
-int ncs_init(){
+//collects the results of stick d. Results of a graph come back in the order
+//its tensors were loaded, the userParam of each result is its request.
+static void collect_results(int d){
+  Ncs_device &device = devices[d];
+  std::unique_lock<std::mutex> lock(device.lock);
+  while(!device.stopping){
+    if(device.pending.empty()){
+      device.cv.wait(lock);
+      continue;
+    }
+    Ncs_request *oldest = device.pending.front();
+    void *graph_handle = oldest->graph->graph_handle[d];
+    lock.unlock();
+
+    void *result_fp16;
+    unsigned int result_len;
+    void *user_param = NULL;
+    mvncStatus retCode = mvncGetResult(graph_handle, &result_fp16, &result_len, &user_param);
+    Ncs_request *request = retCode == MVNC_OK && user_param != NULL ? (Ncs_request *)user_param : oldest;
+    if (retCode != MVNC_OK){
+      ALOGE("NCS could not return result on device %d: %d", d, retCode);
+    }else{
+      //the result buffer belongs to the graph and is reused by its next
+      //result, it is converted straight into the request outputs
+      uint32_t available = std::min(result_len / (unsigned int)sizeof(half), request->graph->output_num_of_elements);
+      const half *result = (const half *)result_fp16;
+      for(int i=0;i<request->output_count && available > 0;i++){
+        uint32_t elements = std::min(request->outputs[i].num_of_elements, available);
+        fp16tofloat(request->outputs[i].data, (unsigned char*)result, elements);
+        result += elements;
+        available -= elements;
+      }
+    }
 
-  if(!device_online){
-    retCode = mvncGetDeviceName(NCS_NUM, devName, NAME_SIZE);
-    if (retCode != MVNC_OK)
-    {   // failed to get device name, maybe none plugged in.
-        ALOGE("Error- No NCS Device found ErrorCode: %d",retCode); //printf("Error - No NCS devices found.\n");
-        device_online = false;
-        return 6;
+    lock.lock();
+    for(size_t i=0;i<device.pending.size();i++){
+      if(device.pending[i] == request){
+        device.pending.erase(device.pending.begin() + i);
+        break;
+      }
     }
+    request->graph->inflight[d]--;
+    request->status = retCode;
+    request->done = true;
+    device.requests++;
+    if(device.pending.empty())
+      device.busy_us += std::chrono::duration<double, std::micro>(ncs_clock::now() - device.busy_since).count();
+    device.cv.notify_all();
+  }
+}
+
+static void release_graph(Ncs_graph *graph){
+  for(int i=0;i<graph->device_count;i++){
+    int d = graph->devices[i];
+    std::lock_guard<std::mutex> device_lock(devices[d].lock);
+    if(graph->graph_handle[d] != NULL)
+      swap_out_graph(d, graph);
+  }
+  for(size_t i=0;i<graph->staging.size();i++)
+    free(graph->staging[i]);
+  free(graph->graph_buf);
+  delete graph;
+}
 
-    retCode = mvncOpenDevice(devName, &deviceHandle);
+static int open_devices(){
+  int limit = NCS_MAX_DEVICES;
+  if(pool_size > 0 && pool_size < limit)
+    limit = pool_size;
 
+  for(int i=0;i<limit;i++){
+    Ncs_device &device = devices[device_count];
+    mvncStatus retCode = mvncGetDeviceName(i, device.name, NAME_SIZE);
     if (retCode != MVNC_OK)
-    {   // failed to open the device.
-        ALOGE("Error - Could not open NCS device ErrorCode: %d",retCode); //printf("Error - Could not open NCS device.\n");
-        device_online = false;
-        return 6;
+      break; // no more sticks plugged in
+
+    retCode = mvncOpenDevice(device.name, &device.handle);
+    if (retCode != MVNC_OK)
+    {   // failed to open the device, another process may own it
+        ALOGE("Error - Could not open NCS device %s ErrorCode: %d", device.name, retCode);
+        continue;
+    }
+    device.opened_at = ncs_clock::now();
+    device.graphs = 0;
+    device.queue_depth = 0;
+    device.resident.clear();
+    device.use_clock = 0;
+    device.requests = 0;
+    device.busy_us = 0;
+    device.swap_ins = 0;
+    device.swap_outs = 0;
+    device.swap_in_us = 0;
+    device.max_swap_in_us = 0;
+    device.pending.clear();
+    device.stopping = false;
+    device.result_thread = std::thread(collect_results, device_count);
+    ALOGD("NCS device %d is %s", device_count, device.name);
+    device_count++;
+  }
+  return device_count;
+}
+
+//ncs_init() begin
+int ncs_init(){
+  std::lock_guard<std::mutex> lock(ncs_lock);
+
+  if(device_count == 0){
+    if(open_devices() == 0){
+      // failed to get device name, maybe none plugged in.
+      ALOGE("Error- No NCS Device found"); //printf("Error - No NCS devices found.\n");
+      return 6;
     }
-    device_online = true;
+
+    max_resident_graphs = property_get_int32("nn.hal.vpu.resident_graphs", NCS_MAX_RESIDENT_GRAPHS);
+    if(max_resident_graphs < 1)
+      max_resident_graphs = 1;
+    graph_devices = property_get_int32("nn.hal.vpu.graph_devices", 0);
+    if(graph_devices < 1 || graph_devices > device_count)
+      graph_devices = device_count;
+    if(max_inflight < 1)
+      max_inflight = property_get_int32("nn.hal.vpu.inflight", NCS_INFLIGHT_TENSORS);
+    if(max_inflight < 1)
+      max_inflight = 1;
+    ALOGD("NCS pool of %d devices, %d per graph, %d tensors in flight", device_count, graph_devices, max_inflight);
   }
+  device_users++;
   return 0;
 }
 //ncs_init() end
 
+void ncs_set_pool_size(int pool_devices){
+  std::lock_guard<std::mutex> lock(ncs_lock);
+  pool_size = pool_devices;
+}
+
+void ncs_set_inflight(int tensors){
+  std::lock_guard<std::mutex> lock(ncs_lock);
+  max_inflight = tensors;
+}
 
-int ncs_load_graph(){
+int ncs_device_count(){
+  std::lock_guard<std::mutex> lock(ncs_lock);
+  return device_count;
+}
 
-  if(!graph_load){
-    char *path;
-    path="/data/ncs_graph";
-    graphFileBuf = LoadgraphFile(path, &graphFileLen);
+int ncs_get_device_stats(int d, Ncs_device_stats *stats){
+  std::lock_guard<std::mutex> lock(ncs_lock);
+  if(d < 0 || d >= device_count)
+    return 6;
 
-    // allocate the graph
-    retCode = mvncAllocateGraph(deviceHandle, &graphHandle, graphFileBuf, graphFileLen);
-    if (retCode != MVNC_OK){
-      ALOGE("Could not allocate graph for file: %d",retCode);
-      graph_load = false;
+  Ncs_device &device = devices[d];
+  std::lock_guard<std::mutex> device_lock(device.lock);
+  double open_us = std::chrono::duration<double, std::micro>(ncs_clock::now() - device.opened_at).count();
+  stats->requests = device.requests;
+  stats->queue_depth = device.queue_depth;
+  stats->busy_us = device.busy_us;
+  stats->utilization = open_us > 0 ? device.busy_us / open_us : 0;
+  stats->swap_ins = device.swap_ins;
+  return 0;
+}
+
+
+//takes ownership of graph_buf, a blob from the graph compiler, freed on unload.
+//A blob identical to one already loaded shares its graph on the sticks.
+int ncs_load_graph(void *graph_buf, unsigned int graph_len,
+                   uint32_t input_num_of_elements, uint32_t output_num_of_elements, int *graph_id){
+  std::unique_lock<std::mutex> lock(ncs_lock);
+
+  if(device_count == 0){
+    ALOGE("NCS device is not open");
+    free(graph_buf);
+    return 6;
+  }
+
+  for(std::map<int, Ncs_graph *>::iterator it = graphs.begin(); it != graphs.end(); ++it){
+    Ncs_graph *graph = it->second;
+    if(graph->graph_len == graph_len && memcmp(graph->graph_buf, graph_buf, graph_len) == 0){
+      graph->ref_count++;
+      *graph_id = it->first;
+      ALOGD("Graph %d already Allocated, %d users", it->first, graph->ref_count);
+      free(graph_buf);
+      return 0;
+    }
+  }
+
+  Ncs_graph *graph = new Ncs_graph();
+  graph->graph_buf = graph_buf;
+  graph->graph_len = graph_len;
+  graph->input_num_of_elements = input_num_of_elements;
+  graph->output_num_of_elements = output_num_of_elements;
+  graph->ref_count = 1;
+
+  //place the graph on the sticks holding the fewest graphs
+  for(int n=0;n<graph_devices;n++){
+    int best = -1;
+    for(int d=0;d<device_count;d++){
+      bool placed = false;
+      for(int i=0;i<graph->device_count;i++)
+        placed = placed || graph->devices[i] == d;
+      if(!placed && (best < 0 || devices[d].graphs < devices[best].graphs))
+        best = d;
+    }
+    graph->devices[graph->device_count++] = best;
+    devices[best].graphs++;
+  }
+
+  //one staging buffer per tensor in flight, more are added if the graph has
+  //more callers converting at the same time
+  int staging_count = graph->device_count * (max_inflight > 0 ? max_inflight : NCS_INFLIGHT_TENSORS);
+  bool staged = true;
+  for(int i=0;i<staging_count && staged;i++){
+    half *buffer = (half *)malloc(input_num_of_elements * sizeof(half));
+    staged = buffer != NULL;
+    if(staged)
+      graph->staging.push_back(buffer);
+  }
+
+  // allocate the graph on every stick it is placed on
+  for(int i=0;i<graph->device_count;i++){
+    int d = graph->devices[i];
+    std::lock_guard<std::mutex> device_lock(devices[d].lock);
+    if(!staged || make_resident(d, graph) != 0){
+      for(int j=0;j<graph->device_count;j++)
+        devices[graph->devices[j]].graphs--;
+      lock.unlock();
+      release_graph(graph);
       return 6;
     }
-    ALOGD("Graph Allocated successfully!");
-    graph_load = true;
-  }else{
-    ALOGD("Graph already Allocated");
   }
+
+  int id = next_graph_id++;
+  graphs[id] = graph;
+  ALOGD("Graph %d Allocated successfully on %d devices!", id, graph->device_count);
+  *graph_id = id;
   return 0;
 }
 
-mvncStatus ncs_rungraph(float *input_data, uint32_t input_num_of_elements,
-                    float *output_data, uint32_t output_num_of_elements)
-                    {
-
-                      //convert inputs from fp32 to fp16
-                      float *input_data_buffer = (float *)malloc(input_num_of_elements*sizeof(float));
-                      if(input_data_buffer==NULL){
-                        ALOGE("unable to allocate input_data_buffer");
-                        return MVNC_ERROR;
-                      }
-
-                      memset(input_data_buffer,0,input_num_of_elements*sizeof(float));
-                      memcpy(input_data_buffer,input_data,input_num_of_elements*sizeof(float));
-
-                      //allocate fp16 input1 with inpu1 shape
-                      ip1_fp16 = (half*) malloc(sizeof(*ip1_fp16) * input_num_of_elements);
-                      ALOGD("Converting input from Float to FP16 Begin");
-                      floattofp16((unsigned char *)ip1_fp16, input_data_buffer, input_num_of_elements);
-                      ALOGD("Converting input from Float to FP16 end");
-                      lenip1_fp16 = input_num_of_elements * sizeof(*ip1_fp16);
-
-                      // start the inference with mvncLoadTensor()
-                      retCode = mvncLoadTensor(graphHandle, ip1_fp16, lenip1_fp16, NULL);
-                      if (retCode != MVNC_OK){
-                        ALOGE("Could not LoadTensor into NCS: %d",retCode);
-                        return retCode;
-                      }
-                      ALOGD("Input Tensor Loaded successfully!");
-                      retCode = mvncGetResult(graphHandle, &resultData16, &lenResultData, &userParam);
-
-                      if (retCode != MVNC_OK){
-                        ALOGE("NCS could not return result %d",retCode);
-                        return retCode;
-                      }
-                      ALOGD("Got the Result");
-
-                      float *output_data_buffer = (float *)malloc(output_num_of_elements*sizeof(float));
-                      if(output_data_buffer==NULL){
-                        ALOGE("unable to allocate output_data_buffer");
-                        return MVNC_ERROR;
-                      }
-
-                      memset(output_data_buffer,0,output_num_of_elements*sizeof(float));
-                      ALOGD("Converting output from FP16 to Float Begin");
-                      fp16tofloat(output_data_buffer, (unsigned char*)resultData16, output_num_of_elements);
-                      ALOGD("Converting output from FP16 to Float end");
-                      memcpy(output_data,output_data_buffer,output_num_of_elements*sizeof(float));
-                      ALOGD("Output data is copied");
-
-                      free(input_data_buffer);
-                      free(output_data_buffer);
-                      free(ip1_fp16);
-                      ALOGD("Error code end of the rungraph is : %d",retCode);
-
-                      return retCode;
-                    }
-
-
-int ncs_execute(float *input_data, uint32_t input_num_of_elements,float *output_data, uint32_t output_num_of_elements){
-  retCode = ncs_rungraph(input_data, input_num_of_elements, output_data, output_num_of_elements);
-  if (retCode != MVNC_OK){
-    ALOGE("NCS unable to executeGraph with ErrorCode: %d",retCode);
+static uint32_t tensors_num_of_elements(const Ncs_tensor *tensors, int count){
+  uint32_t elements = 0;
+  for(int i=0;i<count;i++)
+    elements += tensors[i].num_of_elements;
+  return elements;
+}
+
+int ncs_execute(int graph_id, float *input_data, uint32_t input_num_of_elements,float *output_data, uint32_t output_num_of_elements){
+  Ncs_tensor input = {input_data, input_num_of_elements};
+  Ncs_tensor output = {output_data, output_num_of_elements};
+  return ncs_execute_tensors(graph_id, &input, 1, &output, 1);
+}
+
+int ncs_execute_tensors(int graph_id, const Ncs_tensor *inputs, int input_count, const Ncs_tensor *outputs, int output_count){
+  uint32_t input_num_of_elements = tensors_num_of_elements(inputs, input_count);
+  uint32_t output_num_of_elements = tensors_num_of_elements(outputs, output_count);
+  std::unique_lock<std::mutex> lock(ncs_lock);
+
+  std::map<int, Ncs_graph *>::iterator it = graphs.find(graph_id);
+  if(it == graphs.end()){
+    ALOGE("NCS graph %d is not loaded", graph_id);
     return 6;
   }
-  return 0;
+  Ncs_graph *graph = it->second;
+  if(input_num_of_elements != graph->input_num_of_elements || output_num_of_elements != graph->output_num_of_elements){
+    ALOGE("NCS graph %d takes %u inputs and %u outputs, not %u and %u", graph_id,
+          graph->input_num_of_elements, graph->output_num_of_elements, input_num_of_elements, output_num_of_elements);
+    return 6;
+  }
+
+  //dispatch to the stick of the graph with the shortest queue
+  int d = -1;
+  for(int i=0;i<graph->device_count;i++){
+    int candidate = graph->devices[i];
+    if(d < 0 || devices[candidate].queue_depth < devices[d].queue_depth)
+      d = candidate;
+  }
+  Ncs_device &device = devices[d];
+  int inflight_limit = max_inflight > 0 ? max_inflight : NCS_INFLIGHT_TENSORS;
+
+  unsigned int lenip1_fp16 = input_num_of_elements * sizeof(half);
+  half *ip1_fp16;
+  if(!graph->staging.empty()){
+    ip1_fp16 = graph->staging.back();
+    graph->staging.pop_back();
+  }else{
+    ip1_fp16 = (half*) malloc(lenip1_fp16);
+    if(ip1_fp16 == NULL){
+      ALOGE("unable to allocate fp16 staging buffer");
+      return 6;
+    }
+    ALOGD("NCS graph %d staging buffer added", graph_id);
+  }
+  device.queue_depth++;
+  lock.unlock();
+
+  //the inputs are converted on the calling thread, straight from the request
+  //memory, while the stick works on the tensors queued before this one
+  half *input_fp16 = ip1_fp16;
+  for(int i=0;i<input_count;i++){
+    floattofp16((unsigned char *)input_fp16, inputs[i].data, inputs[i].num_of_elements);
+    input_fp16 += inputs[i].num_of_elements;
+  }
+  Ncs_request request;
+  request.graph = graph;
+  request.outputs = outputs;
+  request.output_count = output_count;
+  request.status = MVNC_OK;
+  request.done = false;
+
+  std::unique_lock<std::mutex> device_lock(device.lock);
+  int val = 0;
+  device.cv.wait(device_lock, [&]{ return graph->inflight[d] < inflight_limit; });
+  mvncStatus retCode = MVNC_OK;
+  while((val = make_resident(d, graph)) == 0){
+    // start the inference with mvncLoadTensor()
+    retCode = mvncLoadTensor(graph->graph_handle[d], ip1_fp16, lenip1_fp16, &request);
+    if(retCode != MVNC_BUSY || graph->inflight[d] == 0)
+      break;
+    //the stick queues fewer tensors of a graph than nn.hal.vpu.inflight allows,
+    //load again once one of them is back
+    int inflight = graph->inflight[d];
+    device.cv.wait(device_lock, [&]{ return graph->inflight[d] < inflight; });
+  }
+  if(val == 0){
+    if (retCode != MVNC_OK){
+      ALOGE("Could not LoadTensor into NCS device %d: %d", d, retCode);
+      val = 6;
+    }else{
+      if(device.pending.empty())
+        device.busy_since = ncs_clock::now();
+      graph->inflight[d]++;
+      device.pending.push_back(&request);
+      device.cv.notify_all();
+      device.cv.wait(device_lock, [&]{ return request.done; });
+      if (request.status != MVNC_OK){
+        ALOGE("NCS unable to executeGraph on device %d with ErrorCode: %d", d, request.status);
+        val = 6;
+      }
+    }
+  }
+  device.queue_depth--;
+  device_lock.unlock();
+
+  lock.lock();
+  graph->staging.push_back(ip1_fp16);
+  return val;
 }
 
-int ncs_unload_graph(){
-  retCode = mvncDeallocateGraph(graphHandle);
-  if (retCode != MVNC_OK){
-    ALOGE("NCS could not Deallocate Graph %d",retCode);
+int ncs_unload_graph(int graph_id){
+  std::unique_lock<std::mutex> lock(ncs_lock);
+
+  std::map<int, Ncs_graph *>::iterator it = graphs.find(graph_id);
+  if(it == graphs.end()){
+    ALOGE("NCS graph %d is not loaded", graph_id);
     return 6;
   }
-  ALOGD("Graph Deallocated successfully!");
-  free(graphFileBuf);
-  graphHandle = NULL;
-  graph_load = false;
+  Ncs_graph *graph = it->second;
+  if(--graph->ref_count > 0)
+    return 0;
+
+  graphs.erase(it);
+  for(int i=0;i<graph->device_count;i++)
+    devices[graph->devices[i]].graphs--;
+  lock.unlock();
+
+  release_graph(graph);
+  ALOGD("Graph %d Deallocated successfully!", graph_id);
   return 0;
 }
 
 int ncs_deinit(){
-  retCode = mvncCloseDevice(deviceHandle);
-  if (retCode != MVNC_OK)
-  {
-      ALOGE("Error - Could not close NCS device ErrorCode: %d",retCode);
-      return 6;
+  std::lock_guard<std::mutex> lock(ncs_lock);
+
+  if(device_count == 0 || --device_users > 0)
+    return 0;
+
+  int val = 0;
+  for(int d=0;d<device_count;d++){
+    Ncs_device &device = devices[d];
+    {
+      std::lock_guard<std::mutex> device_lock(device.lock);
+      device.stopping = true;
+      device.cv.notify_all();
+    }
+    device.result_thread.join();
+
+    std::lock_guard<std::mutex> device_lock(device.lock);
+    while(!device.resident.empty())
+      swap_out_graph(d, device.resident.back());
+    log_device_stats(d);
+
+    mvncStatus retCode = mvncCloseDevice(device.handle);
+    if (retCode != MVNC_OK)
+    {
+        ALOGE("Error - Could not close NCS device %d ErrorCode: %d", d, retCode);
+        val = 6;
+    }
+    device.handle = NULL;
   }
-  deviceHandle = NULL;
-  ALOGD("NCS device closed");
-  device_online = false;
-  return 0;
+  device_count = 0;
+  ALOGD("NCS devices closed");
+  return val;
 }
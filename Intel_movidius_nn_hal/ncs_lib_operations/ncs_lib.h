@@ -35,20 +35,59 @@ BAD STATE - 6
 int ncs_register();
 int ncs_deregister();
 
+#define NCS_MAX_DEVICES 8
+
+typedef struct ncs_device_stats {
+  uint32_t requests;
+  int queue_depth; //requests dispatched to the stick and not completed yet
+  double busy_us;
+  double utilization; //busy time over the time since the stick was opened
+  uint32_t swap_ins;
+} Ncs_device_stats;
+
+//opens every stick plugged in for the first user, every successful call
+//needs a ncs_deinit()
 int ncs_init();
 
 int ncs_deinit();
 
-int ncs_load_graph();
+//limits the sticks opened by the next ncs_init() of the pool, 0 opens all
+void ncs_set_pool_size(int pool_devices);
+
+int ncs_device_count();
+
+int ncs_get_device_stats(int device, Ncs_device_stats *stats);
 
-int ncs_unload_graph();
+//graphs are identified by the graph_id set on load and are placed on
+//nn.hal.vpu.graph_devices sticks (all by default). Each execution goes to the
+//stick of the graph with the shortest queue. When more graphs are loaded than
+//fit on a stick the least recently used ones are swapped out and allocated
+//again on their next execution. The FP16 staging buffers of the graph input
+//are allocated here and reused by every execution.
+int ncs_load_graph(void *graph_buf, unsigned int graph_len,
+                   uint32_t input_num_of_elements, uint32_t output_num_of_elements, int *graph_id);
+
+int ncs_unload_graph(int graph_id);
 
 //void ncs_reset();
 
-mvncStatus ncs_rungraph(float *input_data, uint32_t input_num_of_elements,
-                    float *output_data, uint32_t output_num_of_elements);
+//tensors kept queued per graph on a stick, 0 reads nn.hal.vpu.inflight when
+//the pool is opened
+void ncs_set_inflight(int tensors);
+
+//blocks until the result is back; executions from several threads are
+//pipelined, the stick runs one tensor while the next ones are converted.
+//input_data and output_data are only read and written by the FP16 conversions.
+int ncs_execute(int graph_id, float *input_data, uint32_t input_num_of_elements,float *output_data, uint32_t output_num_of_elements);
+
+typedef struct ncs_tensor {
+  float *data;
+  uint32_t num_of_elements;
+} Ncs_tensor;
 
-int ncs_execute(float *input_data, uint32_t input_num_of_elements,float *output_data, uint32_t output_num_of_elements);
+//ncs_execute() of a graph with several inputs and outputs, they are packed one
+//after another in the graph input and output, in the order of the model
+int ncs_execute_tensors(int graph_id, const Ncs_tensor *inputs, int input_count, const Ncs_tensor *outputs, int output_count);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,971 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// mvnc API of the NCSDK without an NCS stick.
+// Graph blobs of graph_compiler_NCS are parsed and checked when they are
+// allocated: every stage record must be a supported FP16 operation and every
+// buffer it points to must lie inside its buffer, work buffers must be written
+// by an earlier stage before they are read. Tensors are then evaluated on the
+// host, stage by stage, with every stage output rounded to FP16 like on the
+// stick. The time of an inference is not the host time, it follows a model of
+// the stick set from the environment so that runs are reproducible:
+//
+//   MVNC_SIM_DEVICES      sticks reported by mvncGetDeviceName(), 1
+//   MVNC_SIM_GFLOPS       compute rate of a stick, 30
+//   MVNC_SIM_STAGE_US     fixed cost of every stage, 20
+//   MVNC_SIM_USB_MBPS     USB rate of tensors and graphs, 120
+//   MVNC_SIM_ALLOCATE_US  fixed cost of mvncAllocateGraph(), 5000
+//   MVNC_SIM_MEMORY_MB    graph memory of a stick, 500
+//   MVNC_SIM_FIFO         tensors queued per graph, 2, mvncLoadTensor() is BUSY beyond
+//   MVNC_SIM_EVALUATE     0 skips the evaluation, results are then zeros
+//
+// Every stick has one USB link and one compute engine. A tensor is sent on the
+// link when it is free, then waits for the engine, which also sends its result
+// back, so the inputs of the next tensors are sent while a stick computes.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <mvnc.h>
+#include "Blob.h"
+#undef LOG_TAG
+#define LOG_TAG "mvnc_sim"
+#include <log/log.h>
+#include "fp.h"
+
+#define SIM_MAX_DEVICES 8
+#define SIM_NAME_PREFIX "sim."
+#define SIM_DEBUG_INFO_SIZE 120
+
+//buffer indexes of the stage records
+#define SIM_NO_BUFFER 0
+#define SIM_INPUT_BUFFER 1
+#define SIM_OUTPUT_BUFFER 2
+#define SIM_BLOB_BUFFER 3
+#define SIM_FIRST_WORK_BUFFER 4
+
+#define SIM_FP16 2 //datatype and precision of the stage records
+
+typedef std::chrono::steady_clock sim_clock;
+
+typedef struct sim_config {
+  int devices;
+  double gflops;
+  double stage_us;
+  double usb_mbps;
+  double allocate_us;
+  uint64_t memory;
+  unsigned int fifo;
+  bool evaluate;
+} Sim_config;
+
+//a buffer of a stage record, pointer is a byte offset in the buffer of index
+typedef struct sim_buffer_ref {
+  uint32_t pointer;
+  uint16_t index;
+} Sim_buffer_ref;
+
+typedef struct sim_stage {
+  std::string name;
+  uint8_t op;
+  uint32_t opt_mask;
+  uint8_t radixX;
+  uint8_t radixY;
+  uint8_t strideX;
+  uint8_t strideY;
+  uint8_t padX;
+  uint8_t padY;
+  uint8_t pad_style;
+  uint32_t input_dim[3];
+  uint32_t tap_dim[3];
+  uint32_t output_dim[3];
+  uint32_t input_stride[3];
+  uint32_t tap_stride[3];
+  uint32_t output_stride[3];
+  uint8_t datatype;
+  uint8_t precision;
+  uint8_t storage_order;
+  Sim_buffer_ref data;
+  Sim_buffer_ref taps;
+  Sim_buffer_ref bias;
+  Sim_buffer_ref op_params;
+  Sim_buffer_ref output;
+  uint8_t pre_op;
+  uint8_t post_op;
+  float post_param;
+  double time_us; //modelled compute time on a stick
+} Sim_stage;
+
+typedef struct sim_request {
+  std::vector<half> input;
+  void *user_param;
+  sim_clock::time_point ready;
+  bool evaluated;
+} Sim_request;
+
+typedef struct sim_graph {
+  int device;
+  std::string name;
+  std::vector<Sim_stage> stages;
+  std::vector<float> blob_data; //data section of the blob, buffer 3
+  uint32_t input_size; //bytes
+  uint32_t output_size;
+  uint32_t work_size;
+  uint64_t memory;
+  double compute_us;
+  std::vector<half> work;
+  std::vector<half> output; //reused by every result of the graph
+  std::deque<Sim_request> fifo;
+  int iterations;
+  int throttle;
+  bool dont_block;
+  std::vector<float> time_taken; //ms per stage of the last result
+  char debug_info[SIM_DEBUG_INFO_SIZE];
+} Sim_graph;
+
+typedef struct sim_device {
+  bool open;
+  std::vector<Sim_graph *> graphs;
+  uint64_t memory_used;
+  sim_clock::time_point usb_free_at;
+  sim_clock::time_point engine_free_at;
+} Sim_device;
+
+static std::mutex sim_lock;
+static Sim_device sim_devices[SIM_MAX_DEVICES];
+static Sim_config sim_config;
+static bool sim_configured = false;
+static int sim_log_level = 0;
+
+static double sim_env(const char *name, double fallback){
+  const char *value = getenv(name);
+  if(value == NULL || *value == 0)
+    return fallback;
+  return atof(value);
+}
+
+//reads the model of the sticks once, sim_lock must be held
+static void sim_configure(){
+  if(sim_configured)
+    return;
+  sim_config.devices = std::min(std::max((int)sim_env("MVNC_SIM_DEVICES", 1), 0), SIM_MAX_DEVICES);
+  sim_config.gflops = std::max(sim_env("MVNC_SIM_GFLOPS", 30), 0.001);
+  sim_config.stage_us = std::max(sim_env("MVNC_SIM_STAGE_US", 20), 0.0);
+  sim_config.usb_mbps = std::max(sim_env("MVNC_SIM_USB_MBPS", 120), 0.001);
+  sim_config.allocate_us = std::max(sim_env("MVNC_SIM_ALLOCATE_US", 5000), 0.0);
+  sim_config.memory = (uint64_t)(std::max(sim_env("MVNC_SIM_MEMORY_MB", 500), 0.0) * 1024 * 1024);
+  sim_config.fifo = std::max((int)sim_env("MVNC_SIM_FIFO", 2), 1);
+  sim_config.evaluate = sim_env("MVNC_SIM_EVALUATE", 1) != 0;
+  sim_configured = true;
+  ALOGD("%d simulated sticks, %.1f GFLOPS, %.1f MB/s USB, %u tensors per graph", sim_config.devices,
+        sim_config.gflops, sim_config.usb_mbps, sim_config.fifo);
+}
+
+static sim_clock::duration sim_usb_time(uint64_t bytes){
+  return std::chrono::duration_cast<sim_clock::duration>(
+           std::chrono::duration<double, std::micro>(bytes / sim_config.usb_mbps));
+}
+
+static sim_clock::duration sim_us(double us){
+  return std::chrono::duration_cast<sim_clock::duration>(std::chrono::duration<double, std::micro>(us));
+}
+
+//finds an open stick or an allocated graph from its handle, sim_lock must be held
+static Sim_device *sim_find_device(void *handle){
+  for(int d=0;d<SIM_MAX_DEVICES;d++){
+    if(handle == &sim_devices[d] && sim_devices[d].open)
+      return &sim_devices[d];
+  }
+  return NULL;
+}
+
+static Sim_graph *sim_find_graph(void *handle){
+  for(int d=0;d<SIM_MAX_DEVICES;d++){
+    std::vector<Sim_graph *> &graphs = sim_devices[d].graphs;
+    if(std::find(graphs.begin(), graphs.end(), (Sim_graph *)handle) != graphs.end())
+      return (Sim_graph *)handle;
+  }
+  return NULL;
+}
+
+//----------------------------------- blob parsing
+
+static uint32_t read_u32(const unsigned char *p){
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t read_u16(const unsigned char *p){
+  return p[0] | (p[1] << 8);
+}
+
+static float half_to_float(half h){
+  float f;
+  fp16tofloat(&f, (unsigned char *)&h, 1);
+  return f;
+}
+
+static half float_to_half(float f){
+  half h;
+  floattofp16((unsigned char *)&h, &f, 1);
+  return h;
+}
+
+//reads a stage record, the layout is the one of get_stage_buffer()
+static Sim_stage parse_stage(const unsigned char *p){
+  Sim_stage stage;
+  unsigned int index = 0;
+  char name[SIZE_OF_STAGE_NAME + 1];
+  memcpy(name, p, SIZE_OF_STAGE_NAME);
+  name[SIZE_OF_STAGE_NAME] = 0;
+  stage.name = name;
+  index += SIZE_OF_STAGE_NAME;
+
+  stage.op = p[index++];
+  stage.opt_mask = read_u32(p + index); index += 4;
+  stage.radixX = p[index++];
+  stage.radixY = p[index++];
+  stage.strideX = p[index++];
+  stage.strideY = p[index++];
+  stage.padX = p[index++];
+  stage.padY = p[index++];
+  stage.pad_style = p[index++];
+
+  for(int i=0;i<3;i++,index+=4) stage.input_dim[i] = read_u32(p + index);
+  for(int i=0;i<3;i++,index+=4) stage.tap_dim[i] = read_u32(p + index);
+  for(int i=0;i<3;i++,index+=4) stage.output_dim[i] = read_u32(p + index);
+  for(int i=0;i<3;i++,index+=4) stage.input_stride[i] = read_u32(p + index);
+  for(int i=0;i<3;i++,index+=4) stage.tap_stride[i] = read_u32(p + index);
+  for(int i=0;i<3;i++,index+=4) stage.output_stride[i] = read_u32(p + index);
+
+  stage.datatype = p[index++];
+  stage.precision = p[index++];
+  stage.storage_order = p[index++];
+
+  Sim_buffer_ref *refs[] = {&stage.data, &stage.taps, &stage.bias, &stage.op_params, &stage.output};
+  for(int i=0;i<5;i++){
+    refs[i]->pointer = read_u32(p + index); index += 4;
+    refs[i]->index = read_u16(p + index); index += 2;
+  }
+
+  stage.pre_op = p[index++];
+  stage.post_op = p[index++];
+  memcpy(&stage.post_param, p + index, sizeof(float));
+  stage.time_us = 0;
+  return stage;
+}
+
+static uint64_t elements(const uint32_t *dim){
+  return (uint64_t)dim[0] * dim[1] * dim[2];
+}
+
+//bytes spanned by a tensor of the given dimensions and strides
+static uint64_t extent(const uint32_t *dim, const uint32_t *stride){
+  if(elements(dim) == 0)
+    return 0;
+  return (uint64_t)(dim[0] - 1) * stride[0] + (uint64_t)(dim[1] - 1) * stride[1] +
+         (uint64_t)(dim[2] - 1) * stride[2] + sizeof(half);
+}
+
+static bool is_supported_op(uint8_t op){
+  switch(op){
+    case Convolution: case MaxPooling: case Average_Pooling: case Softmax:
+    case Fully_Connected_Layer: case None: case DepthWise_Convolution:
+    case Copy: case Sigmoid: case TanH: case Reshape: case Elementwise_Sum:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static bool is_supported_post_op(uint8_t op){
+  return op == None || op == ReLU || op == ReLU_X || op == Sigmoid || op == TanH;
+}
+
+//padding before the first row and column of a stage
+static void get_padding(const Sim_stage &stage, int *pad_x, int *pad_y){
+  *pad_x = 0;
+  *pad_y = 0;
+  if(stage.pad_style == tfsame){
+    int total_x = ((int)stage.output_dim[0] - 1) * stage.strideX + stage.radixX - (int)stage.input_dim[0];
+    int total_y = ((int)stage.output_dim[1] - 1) * stage.strideY + stage.radixY - (int)stage.input_dim[1];
+    *pad_x = std::max(total_x, 0) / 2;
+    *pad_y = std::max(total_y, 0) / 2;
+  }else if(stage.pad_style == caffe){
+    *pad_x = stage.padX;
+    *pad_y = stage.padY;
+  }
+}
+
+//output columns or rows of a window of radix, stride and padding over input
+static uint32_t windows(uint32_t input, uint8_t radix, uint8_t stride, uint8_t pad_style, uint8_t pad){
+  switch(pad_style){
+    case tfvalid: return input >= radix ? (input - radix + stride) / stride : 0;
+    case tfsame: return (input + stride - 1) / stride;
+    case caffe: return input + 2 * pad >= radix ? (input + 2 * pad - radix) / stride + 1 : 0;
+    default: return input;
+  }
+}
+
+//work buffer written by an earlier stage
+typedef struct sim_written_buffer {
+  Sim_buffer_ref ref;
+  uint64_t bytes;
+} Sim_written_buffer;
+
+//checks that a stage reads the network input or a tensor written by an earlier stage
+static bool check_read(Sim_graph *graph, const Sim_buffer_ref &ref, const uint32_t *dim, const uint32_t *stride,
+                       int s, const std::vector<Sim_written_buffer> &written){
+  char *why = graph->debug_info;
+  uint64_t bytes = extent(dim, stride);
+  if(ref.pointer % sizeof(half) != 0 || stride[0] % sizeof(half) != 0 ||
+     stride[1] % sizeof(half) != 0 || stride[2] % sizeof(half) != 0){
+    snprintf(why, SIM_DEBUG_INFO_SIZE, "stage %d: input is not FP16 aligned", s);
+    return false;
+  }
+  if(ref.index == SIM_INPUT_BUFFER){
+    graph->input_size = std::max(graph->input_size, (uint32_t)(ref.pointer + bytes));
+    return true;
+  }
+  for(size_t i=0;i<written.size();i++){
+    if(written[i].ref.index == ref.index && written[i].ref.pointer == ref.pointer && written[i].bytes >= bytes)
+      return true;
+  }
+  snprintf(why, SIM_DEBUG_INFO_SIZE, "stage %d: reads %u bytes at %u of buffer %u before they are written",
+           s, (uint32_t)bytes, ref.pointer, ref.index);
+  return false;
+}
+
+//checks one stage, fills the buffer sizes of the graph and the modelled time of the stage.
+//On error the reason is left in graph->debug_info.
+static bool check_stage(Sim_graph *graph, Sim_stage &stage, int s, uint32_t data_size,
+                        std::vector<Sim_written_buffer> &written){
+  char *why = graph->debug_info;
+  if(!is_supported_op(stage.op) || stage.pre_op != None || !is_supported_post_op(stage.post_op)){
+    snprintf(why, SIM_DEBUG_INFO_SIZE, "stage %d: unsupported operation %u pre %u post %u", s, stage.op, stage.pre_op, stage.post_op);
+    return false;
+  }
+  if(stage.datatype != SIM_FP16 || stage.precision != SIM_FP16){
+    snprintf(why, SIM_DEBUG_INFO_SIZE, "stage %d: data type %u precision %u is not FP16", s, stage.datatype, stage.precision);
+    return false;
+  }
+  if(elements(stage.input_dim) == 0 || elements(stage.output_dim) == 0){
+    snprintf(why, SIM_DEBUG_INFO_SIZE, "stage %d: empty input or output", s);
+    return false;
+  }
+
+  //the input layer is a None stage, the stick skips it
+  if(stage.op == None){
+    if(stage.data.index != SIM_INPUT_BUFFER){
+      snprintf(why, SIM_DEBUG_INFO_SIZE, "stage %d: input layer does not read the input", s);
+      return false;
+    }
+    return true;
+  }
+
+  //the data, and the second tensor of a sum: the network input or a buffer written by an earlier stage
+  uint64_t input_bytes = extent(stage.input_dim, stage.input_stride);
+  if(!check_read(graph, stage.data, stage.input_dim, stage.input_stride, s, written))
+    return false;
+  bool tensor_taps = stage.op == Elementwise_Sum;
+  if(tensor_taps && !check_read(graph, stage.taps, stage.tap_dim, stage.tap_stride, s, written))
+    return false;
+
+  //the output: the network output or a work buffer
+  uint64_t output_bytes = extent(stage.output_dim, stage.output_stride);
+  if(stage.output.index != SIM_OUTPUT_BUFFER && stage.output.index < SIM_FIRST_WORK_BUFFER){
+    snprintf(why, SIM_DEBUG_INFO_SIZE, "stage %d: writes buffer %u", s, stage.output.index);
+    return false;
+  }
+  if(stage.output.pointer % sizeof(half) != 0 || stage.output_stride[0] % sizeof(half) != 0 ||
+     stage.output_stride[1] % sizeof(half) != 0 || stage.output_stride[2] % sizeof(half) != 0){
+    snprintf(why, SIM_DEBUG_INFO_SIZE, "stage %d: output is not FP16 aligned", s);
+    return false;
+  }
+  if(stage.output.index == stage.data.index &&
+     stage.output.pointer < stage.data.pointer + input_bytes && stage.data.pointer < stage.output.pointer + output_bytes){
+    snprintf(why, SIM_DEBUG_INFO_SIZE, "stage %d: output overlaps its input", s);
+    return false;
+  }
+  if(stage.output.index == SIM_OUTPUT_BUFFER)
+    graph->output_size = std::max(graph->output_size, (uint32_t)(stage.output.pointer + output_bytes));
+  else
+    graph->work_size = std::max(graph->work_size, (uint32_t)(stage.output.pointer + output_bytes));
+  Sim_written_buffer out = {stage.output, output_bytes};
+  written.push_back(out);
+
+  //operation specific shapes, and taps, bias and parameters in the data of the blob
+  const uint32_t *in = stage.input_dim;
+  const uint32_t *o = stage.output_dim;
+  uint64_t taps = 0, ops = elements(o);
+  bool shape_ok = true;
+  switch(stage.op){
+    case Convolution:
+    case DepthWise_Convolution:
+    case MaxPooling:
+    case Average_Pooling:
+      shape_ok = stage.radixX > 0 && stage.radixY > 0 && stage.strideX > 0 && stage.strideY > 0 &&
+                 o[0] == windows(in[0], stage.radixX, stage.strideX, stage.pad_style, stage.padX) &&
+                 o[1] == windows(in[1], stage.radixY, stage.strideY, stage.pad_style, stage.padY);
+      if(stage.op == Convolution){
+        shape_ok = shape_ok && stage.tap_dim[0] == (uint32_t)stage.radixX * stage.radixY &&
+                   stage.tap_dim[1] == in[2] && stage.tap_dim[2] == o[2];
+        taps = (uint64_t)stage.radixX * stage.radixY * in[2] * o[2];
+        ops = 2 * elements(o) * stage.radixX * stage.radixY * in[2];
+      }else if(stage.op == DepthWise_Convolution){
+        shape_ok = shape_ok && o[2] % in[2] == 0;
+        taps = (uint64_t)stage.radixX * stage.radixY * o[2];
+        ops = 2 * elements(o) * stage.radixX * stage.radixY;
+      }else{
+        shape_ok = shape_ok && o[2] == in[2];
+        ops = elements(o) * stage.radixX * stage.radixY;
+      }
+      break;
+    case Fully_Connected_Layer:
+      shape_ok = (uint64_t)stage.tap_dim[0] * stage.tap_dim[1] == elements(in) && o[2] == elements(o);
+      taps = elements(in) * o[2];
+      ops = 2 * taps;
+      break;
+    case Reshape:
+      shape_ok = elements(in) == elements(o);
+      break;
+    case Softmax:
+      shape_ok = in[0] == o[0] && in[1] == o[1] && in[2] == o[2];
+      ops = 3 * elements(o);
+      break;
+    case Elementwise_Sum:
+      shape_ok = in[0] == o[0] && in[1] == o[1] && in[2] == o[2] &&
+                 stage.tap_dim[0] == o[0] && stage.tap_dim[1] == o[1] && stage.tap_dim[2] == o[2];
+      break;
+    default:
+      shape_ok = in[0] == o[0] && in[1] == o[1] && in[2] == o[2];
+      break;
+  }
+  if(!shape_ok){
+    snprintf(why, SIM_DEBUG_INFO_SIZE, "stage %d: %ux%ux%u to %ux%ux%u does not match operation %u",
+             s, in[0], in[1], in[2], o[0], o[1], o[2], stage.op);
+    return false;
+  }
+
+  Sim_buffer_ref *refs[] = {&stage.taps, &stage.bias, &stage.op_params};
+  uint64_t sizes[] = {taps * sizeof(half), (uint64_t)o[2] * sizeof(half), sizeof(half)};
+  const char *names[] = {"taps", "bias", "parameters"};
+  for(int i=tensor_taps ? 1 : 0;i<3;i++){
+    if(refs[i]->index == SIM_NO_BUFFER){
+      if(i == 0 && taps > 0){
+        snprintf(why, SIM_DEBUG_INFO_SIZE, "stage %d: has no taps", s);
+        return false;
+      }
+      continue;
+    }
+    if(refs[i]->index != SIM_BLOB_BUFFER || refs[i]->pointer % sizeof(half) != 0 ||
+       refs[i]->pointer + sizes[i] > data_size){
+      snprintf(why, SIM_DEBUG_INFO_SIZE, "stage %d: %s at %u of buffer %u are outside the %u bytes of blob data",
+               s, names[i], refs[i]->pointer, refs[i]->index, data_size);
+      return false;
+    }
+  }
+
+  stage.time_us = sim_config.stage_us + ops / (sim_config.gflops * 1e3);
+  return true;
+}
+
+//parses and checks a graph blob, see prepare_blob() for its layout
+static bool parse_blob(Sim_graph *graph, const unsigned char *blob, unsigned int length){
+  char *why = graph->debug_info;
+  unsigned int index = VCS_FIX ? 32 : 0;
+  if(length < SIZE_HEADER){
+    snprintf(why, SIM_DEBUG_INFO_SIZE, "blob of %u bytes has no header", length);
+    return false;
+  }
+  uint32_t filesize = read_u32(blob + index); index += 4;
+  uint32_t version = read_u32(blob + index); index += 4;
+  char name[SIZE_OF_NETOWRK_NAME + 1];
+  memcpy(name, blob + index, SIZE_OF_NETOWRK_NAME);
+  name[SIZE_OF_NETOWRK_NAME] = 0;
+  graph->name = name;
+  index += SIZE_OF_NETOWRK_NAME + SIZE_OF_DIR_NAME;
+  uint32_t stage_count = read_u32(blob + index); index += 4;
+  uint32_t filesize_without_data = read_u32(blob + index);
+
+  if(filesize != length || version != 2){
+    snprintf(why, SIM_DEBUG_INFO_SIZE, "blob version %u of %u bytes, %u bytes loaded", version, filesize, length);
+    return false;
+  }
+  if(stage_count == 0 || filesize_without_data > length ||
+     (uint64_t)SIZE_HEADER + (uint64_t)stage_count * STAGE_SIZE > filesize_without_data){
+    snprintf(why, SIM_DEBUG_INFO_SIZE, "%u stages do not fit the %u bytes before the data", stage_count, filesize_without_data);
+    return false;
+  }
+
+  uint32_t data_size = length - filesize_without_data;
+  graph->blob_data.resize(data_size / sizeof(half));
+  fp16tofloat(graph->blob_data.data(), (unsigned char *)(blob + filesize_without_data), data_size / sizeof(half));
+
+  std::vector<Sim_written_buffer> written;
+  graph->input_size = 0;
+  graph->output_size = 0;
+  graph->work_size = 0;
+  graph->compute_us = 0;
+  for(uint32_t s=0;s<stage_count;s++){
+    Sim_stage stage = parse_stage(blob + SIZE_HEADER + s * STAGE_SIZE);
+    if(!check_stage(graph, stage, s, data_size, written))
+      return false;
+    graph->compute_us += stage.time_us;
+    graph->stages.push_back(stage);
+  }
+  if(graph->input_size == 0 || graph->output_size == 0){
+    snprintf(why, SIM_DEBUG_INFO_SIZE, "graph does not read the input or write the output");
+    return false;
+  }
+  graph->memory = (uint64_t)length + graph->work_size + graph->input_size + graph->output_size;
+  return true;
+}
+
+//----------------------------------- evaluation
+
+//reads a tensor into floats, rows then columns then channels
+static void load_tensor(const half *base, const uint32_t *dim, const uint32_t *stride, std::vector<float> &dst){
+  dst.resize(elements(dim));
+  const char *bytes = (const char *)base;
+  size_t i = 0;
+  for(uint32_t y=0;y<dim[1];y++)
+    for(uint32_t x=0;x<dim[0];x++)
+      for(uint32_t z=0;z<dim[2];z++)
+        dst[i++] = half_to_float(*(const half *)(bytes + x * stride[0] + y * stride[1] + z * stride[2]));
+}
+
+static float post_operation(const Sim_stage &stage, float value){
+  switch(stage.post_op){
+    case ReLU: return value < 0 ? value * stage.post_param : value;
+    case ReLU_X: return std::min(std::max(value, 0.0f), stage.post_param);
+    case Sigmoid: return 1.0f / (1.0f + expf(-value));
+    case TanH: return tanhf(value);
+    default: return value;
+  }
+}
+
+//applies the post operation and rounds the stage output to FP16
+static void store_tensor(const Sim_stage &stage, half *base, const std::vector<float> &src){
+  const uint32_t *dim = stage.output_dim;
+  const uint32_t *stride = stage.output_stride;
+  char *bytes = (char *)base;
+  size_t i = 0;
+  for(uint32_t y=0;y<dim[1];y++)
+    for(uint32_t x=0;x<dim[0];x++)
+      for(uint32_t z=0;z<dim[2];z++)
+        *(half *)(bytes + x * stride[0] + y * stride[1] + z * stride[2]) = float_to_half(post_operation(stage, src[i++]));
+}
+
+//runs one stage, in and out are dense, rows then columns then channels. Sums are
+//kept in FP32, as on the stick. addend is the second tensor of a sum.
+static void run_stage(const Sim_graph *graph, const Sim_stage &stage, const std::vector<float> &in,
+                      const std::vector<float> &addend, std::vector<float> &out){
+  const uint32_t IX = stage.input_dim[0], IY = stage.input_dim[1], IZ = stage.input_dim[2];
+  const uint32_t OX = stage.output_dim[0], OY = stage.output_dim[1], OZ = stage.output_dim[2];
+  const float *taps = stage.taps.index == SIM_BLOB_BUFFER ? graph->blob_data.data() + stage.taps.pointer / sizeof(half) : NULL;
+  const float *bias = stage.bias.index == SIM_BLOB_BUFFER ? graph->blob_data.data() + stage.bias.pointer / sizeof(half) : NULL;
+  int pad_x, pad_y;
+  get_padding(stage, &pad_x, &pad_y);
+  out.assign(elements(stage.output_dim), 0.0f);
+
+  switch(stage.op){
+    case Convolution:
+    case DepthWise_Convolution:{
+      uint32_t multiplier = OZ / IZ;
+      for(uint32_t oy=0;oy<OY;oy++){
+        for(uint32_t ox=0;ox<OX;ox++){
+          float *acc = &out[(oy * OX + ox) * OZ];
+          for(uint32_t oz=0;oz<OZ;oz++)
+            acc[oz] = bias != NULL ? bias[oz] : 0.0f;
+          for(int ky=0;ky<stage.radixY;ky++){
+            int iy = (int)oy * stage.strideY - pad_y + ky;
+            if(iy < 0 || iy >= (int)IY) continue;
+            for(int kx=0;kx<stage.radixX;kx++){
+              int ix = (int)ox * stage.strideX - pad_x + kx;
+              if(ix < 0 || ix >= (int)IX) continue;
+              const float *pixel = &in[(iy * IX + ix) * IZ];
+              if(stage.op == Convolution){
+                //taps are (ky, kx, input channel) rows of output channels
+                for(uint32_t iz=0;iz<IZ;iz++){
+                  const float *row = taps + ((ky * stage.radixX + kx) * IZ + iz) * OZ;
+                  for(uint32_t oz=0;oz<OZ;oz++)
+                    acc[oz] += pixel[iz] * row[oz];
+                }
+              }else{
+                const float *row = taps + (ky * stage.radixX + kx) * OZ;
+                for(uint32_t oz=0;oz<OZ;oz++)
+                  acc[oz] += pixel[oz / multiplier] * row[oz];
+              }
+            }
+          }
+        }
+      }
+    }break;
+    case Fully_Connected_Layer:{
+      for(uint32_t oz=0;oz<OZ;oz++)
+        out[oz] = bias != NULL ? bias[oz] : 0.0f;
+      for(size_t i=0;i<in.size();i++)
+        for(uint32_t oz=0;oz<OZ;oz++)
+          out[oz] += in[i] * taps[i * OZ + oz];
+    }break;
+    case MaxPooling:
+    case Average_Pooling:{
+      for(uint32_t oy=0;oy<OY;oy++){
+        for(uint32_t ox=0;ox<OX;ox++){
+          for(uint32_t z=0;z<OZ;z++){
+            float value = stage.op == MaxPooling ? -INFINITY : 0.0f;
+            int count = 0;
+            for(int ky=0;ky<stage.radixY;ky++){
+              int iy = (int)oy * stage.strideY - pad_y + ky;
+              if(iy < 0 || iy >= (int)IY) continue;
+              for(int kx=0;kx<stage.radixX;kx++){
+                int ix = (int)ox * stage.strideX - pad_x + kx;
+                if(ix < 0 || ix >= (int)IX) continue;
+                float v = in[(iy * IX + ix) * IZ + z];
+                value = stage.op == MaxPooling ? std::max(value, v) : value + v;
+                count++;
+              }
+            }
+            //padding is not counted in the average
+            out[(oy * OX + ox) * OZ + z] = stage.op == MaxPooling ? value : (count > 0 ? value / count : 0.0f);
+          }
+        }
+      }
+    }break;
+    case Softmax:{
+      for(size_t p=0;p<in.size();p+=IZ){
+        float max_value = *std::max_element(in.begin() + p, in.begin() + p + IZ);
+        float sum = 0;
+        for(uint32_t z=0;z<IZ;z++){
+          out[p + z] = expf(in[p + z] - max_value);
+          sum += out[p + z];
+        }
+        for(uint32_t z=0;z<IZ;z++)
+          out[p + z] /= sum;
+      }
+    }break;
+    case Elementwise_Sum:
+      for(size_t i=0;i<in.size();i++) out[i] = in[i] + addend[i];
+      break;
+    case Sigmoid:
+      for(size_t i=0;i<in.size();i++) out[i] = 1.0f / (1.0f + expf(-in[i]));
+      break;
+    case TanH:
+      for(size_t i=0;i<in.size();i++) out[i] = tanhf(in[i]);
+      break;
+    default: //Copy and Reshape, elements keep their order
+      out = in;
+      break;
+  }
+}
+
+static half *buffer_of(Sim_graph *graph, std::vector<half> &input, const Sim_buffer_ref &ref){
+  switch(ref.index){
+    case SIM_INPUT_BUFFER: return input.data() + ref.pointer / sizeof(half);
+    case SIM_OUTPUT_BUFFER: return graph->output.data() + ref.pointer / sizeof(half);
+    default: return graph->work.data() + ref.pointer / sizeof(half);
+  }
+}
+
+static void run_graph(Sim_graph *graph, std::vector<half> &input){
+  std::vector<float> in, addend, out;
+  for(size_t s=0;s<graph->stages.size();s++){
+    const Sim_stage &stage = graph->stages[s];
+    if(stage.op == None)
+      continue;
+    load_tensor(buffer_of(graph, input, stage.data), stage.input_dim, stage.input_stride, in);
+    if(stage.op == Elementwise_Sum)
+      load_tensor(buffer_of(graph, input, stage.taps), stage.tap_dim, stage.tap_stride, addend);
+    run_stage(graph, stage, in, addend, out);
+    store_tensor(stage, buffer_of(graph, input, stage.output), out);
+  }
+}
+
+//----------------------------------- mvnc API
+
+mvncStatus mvncGetDeviceName(int index, char *name, unsigned int nameSize){
+  std::lock_guard<std::mutex> lock(sim_lock);
+  sim_configure();
+  if(name == NULL || index < 0)
+    return MVNC_INVALID_PARAMETERS;
+  if(index >= sim_config.devices)
+    return MVNC_DEVICE_NOT_FOUND;
+  if(snprintf(name, nameSize, SIM_NAME_PREFIX "%d", index) >= (int)nameSize)
+    return MVNC_INVALID_PARAMETERS;
+  return MVNC_OK;
+}
+
+mvncStatus mvncOpenDevice(const char *name, void **deviceHandle){
+  std::lock_guard<std::mutex> lock(sim_lock);
+  sim_configure();
+  if(name == NULL || deviceHandle == NULL || strncmp(name, SIM_NAME_PREFIX, strlen(SIM_NAME_PREFIX)) != 0)
+    return MVNC_INVALID_PARAMETERS;
+  int d = atoi(name + strlen(SIM_NAME_PREFIX));
+  if(d < 0 || d >= sim_config.devices)
+    return MVNC_DEVICE_NOT_FOUND;
+  Sim_device &device = sim_devices[d];
+  if(device.open)
+    return MVNC_BUSY;
+  device.open = true;
+  device.graphs.clear();
+  device.memory_used = 0;
+  device.usb_free_at = sim_clock::now();
+  device.engine_free_at = device.usb_free_at;
+  *deviceHandle = &device;
+  return MVNC_OK;
+}
+
+mvncStatus mvncCloseDevice(void *deviceHandle){
+  std::lock_guard<std::mutex> lock(sim_lock);
+  Sim_device *device = sim_find_device(deviceHandle);
+  if(device == NULL)
+    return MVNC_INVALID_PARAMETERS;
+  for(size_t i=0;i<device->graphs.size();i++)
+    delete device->graphs[i];
+  device->graphs.clear();
+  device->open = false;
+  return MVNC_OK;
+}
+
+mvncStatus mvncAllocateGraph(void *deviceHandle, void **graphHandle, const void *graphFile, unsigned int graphFileLength){
+  if(graphHandle == NULL || graphFile == NULL)
+    return MVNC_INVALID_PARAMETERS;
+  Sim_graph *graph = new Sim_graph();
+  graph->iterations = 1;
+  graph->throttle = 0;
+  graph->dont_block = false;
+  graph->debug_info[0] = 0;
+  //the blob is parsed before taking the lock, sim_config is set once a stick is open
+  {
+    std::lock_guard<std::mutex> lock(sim_lock);
+    if(sim_find_device(deviceHandle) == NULL){
+      delete graph;
+      return MVNC_INVALID_PARAMETERS;
+    }
+  }
+  if(!parse_blob(graph, (const unsigned char *)graphFile, graphFileLength)){
+    ALOGE("graph blob rejected: %s", graph->debug_info);
+    delete graph;
+    return MVNC_UNSUPPORTED_GRAPH_FILE;
+  }
+  graph->work.assign(graph->work_size / sizeof(half), 0);
+  graph->output.assign(graph->output_size / sizeof(half), 0);
+  graph->time_taken.assign(graph->stages.size(), 0.0f);
+
+  sim_clock::time_point done;
+  {
+    std::lock_guard<std::mutex> lock(sim_lock);
+    Sim_device *device = sim_find_device(deviceHandle);
+    if(device == NULL){
+      delete graph;
+      return MVNC_INVALID_PARAMETERS;
+    }
+    if(device->memory_used + graph->memory > sim_config.memory){
+      ALOGD("%s needs %llu bytes, %llu of %llu are used", graph->name.c_str(), (unsigned long long)graph->memory,
+            (unsigned long long)device->memory_used, (unsigned long long)sim_config.memory);
+      delete graph;
+      return MVNC_OUT_OF_MEMORY;
+    }
+    graph->device = device - sim_devices;
+    device->memory_used += graph->memory;
+    device->graphs.push_back(graph);
+
+    //the blob is sent once the link is idle, the graph is then set up
+    sim_clock::time_point start = std::max(sim_clock::now(), device->usb_free_at);
+    done = start + sim_usb_time(graphFileLength) + sim_us(sim_config.allocate_us);
+    device->usb_free_at = done;
+  }
+  std::this_thread::sleep_until(done);
+  ALOGD("graph %s allocated, %zu stages, %.1f us per inference", graph->name.c_str(), graph->stages.size(), graph->compute_us);
+  *graphHandle = graph;
+  return MVNC_OK;
+}
+
+mvncStatus mvncDeallocateGraph(void *graphHandle){
+  std::lock_guard<std::mutex> lock(sim_lock);
+  Sim_graph *graph = sim_find_graph(graphHandle);
+  if(graph == NULL)
+    return MVNC_INVALID_PARAMETERS;
+  Sim_device &device = sim_devices[graph->device];
+  device.graphs.erase(std::find(device.graphs.begin(), device.graphs.end(), graph));
+  device.memory_used -= graph->memory;
+  delete graph;
+  return MVNC_OK;
+}
+
+mvncStatus mvncSetGlobalOption(int option, const void *data, unsigned int dataLength){
+  if(option != MVNC_LOG_LEVEL || data == NULL || dataLength != sizeof(int))
+    return MVNC_INVALID_PARAMETERS;
+  std::lock_guard<std::mutex> lock(sim_lock);
+  sim_log_level = *(const int *)data;
+  return MVNC_OK;
+}
+
+mvncStatus mvncGetGlobalOption(int option, void *data, unsigned int *dataLength){
+  if(option != MVNC_LOG_LEVEL || data == NULL || dataLength == NULL || *dataLength < sizeof(int))
+    return MVNC_INVALID_PARAMETERS;
+  std::lock_guard<std::mutex> lock(sim_lock);
+  *(int *)data = sim_log_level;
+  *dataLength = sizeof(int);
+  return MVNC_OK;
+}
+
+mvncStatus mvncSetGraphOption(void *graphHandle, int option, const void *data, unsigned int dataLength){
+  std::lock_guard<std::mutex> lock(sim_lock);
+  Sim_graph *graph = sim_find_graph(graphHandle);
+  if(graph == NULL || data == NULL || dataLength != sizeof(int))
+    return MVNC_INVALID_PARAMETERS;
+  int value = *(const int *)data;
+  switch(option){
+    case MVNC_ITERATIONS:
+      if(value < 1)
+        return MVNC_INVALID_PARAMETERS;
+      graph->iterations = value;
+      break;
+    case MVNC_NETWORK_THROTTLE: graph->throttle = value; break;
+    case MVNC_DONT_BLOCK: graph->dont_block = value != 0; break;
+    default: return MVNC_INVALID_PARAMETERS;
+  }
+  return MVNC_OK;
+}
+
+mvncStatus mvncGetGraphOption(void *graphHandle, int option, void *data, unsigned int *dataLength){
+  std::lock_guard<std::mutex> lock(sim_lock);
+  Sim_graph *graph = sim_find_graph(graphHandle);
+  if(graph == NULL || data == NULL || dataLength == NULL)
+    return MVNC_INVALID_PARAMETERS;
+  int value;
+  switch(option){
+    case MVNC_ITERATIONS: value = graph->iterations; break;
+    case MVNC_NETWORK_THROTTLE: value = graph->throttle; break;
+    case MVNC_DONT_BLOCK: value = graph->dont_block; break;
+    case MVNC_TIME_TAKEN:{
+      unsigned int size = graph->time_taken.size() * sizeof(float);
+      if(*dataLength < size)
+        return MVNC_INVALID_PARAMETERS;
+      memcpy(data, graph->time_taken.data(), size);
+      *dataLength = size;
+      return MVNC_OK;
+    }
+    case MVNC_DEBUG_INFO:
+      if(*dataLength < SIM_DEBUG_INFO_SIZE)
+        return MVNC_INVALID_PARAMETERS;
+      memcpy(data, graph->debug_info, SIM_DEBUG_INFO_SIZE);
+      *dataLength = SIM_DEBUG_INFO_SIZE;
+      return MVNC_OK;
+    default: return MVNC_INVALID_PARAMETERS;
+  }
+  if(*dataLength < sizeof(int))
+    return MVNC_INVALID_PARAMETERS;
+  *(int *)data = value;
+  *dataLength = sizeof(int);
+  return MVNC_OK;
+}
+
+mvncStatus mvncSetDeviceOption(void *deviceHandle, int option, const void *data, unsigned int dataLength){
+  std::lock_guard<std::mutex> lock(sim_lock);
+  if(sim_find_device(deviceHandle) == NULL || data == NULL || dataLength < sizeof(int))
+    return MVNC_INVALID_PARAMETERS;
+  //thermal limits have no effect on the simulated sticks
+  if(option >= MVNC_TEMP_LIM_LOWER && option <= MVNC_TEMPERATURE_DEBUG)
+    return MVNC_OK;
+  return MVNC_INVALID_PARAMETERS;
+}
+
+mvncStatus mvncGetDeviceOption(void *deviceHandle, int option, void *data, unsigned int *dataLength){
+  std::lock_guard<std::mutex> lock(sim_lock);
+  if(sim_find_device(deviceHandle) == NULL || data == NULL || dataLength == NULL)
+    return MVNC_INVALID_PARAMETERS;
+  if(option != MVNC_THERMAL_THROTTLING_LEVEL || *dataLength < sizeof(int))
+    return MVNC_INVALID_PARAMETERS;
+  *(int *)data = 0; //never throttled
+  *dataLength = sizeof(int);
+  return MVNC_OK;
+}
+
+mvncStatus mvncLoadTensor(void *graphHandle, const void *inputTensor, unsigned int inputTensorLength, void *userParam){
+  std::unique_lock<std::mutex> lock(sim_lock);
+  Sim_graph *graph = sim_find_graph(graphHandle);
+  if(graph == NULL || inputTensor == NULL)
+    return MVNC_INVALID_PARAMETERS;
+  if(inputTensorLength != graph->input_size){
+    ALOGE("graph %s takes %u input bytes, not %u", graph->name.c_str(), graph->input_size, inputTensorLength);
+    return MVNC_INVALID_PARAMETERS;
+  }
+  //as on a stick, a full queue is not waited for whether or not the graph blocks
+  if(graph->fifo.size() >= sim_config.fifo)
+    return MVNC_BUSY;
+
+  Sim_device &device = sim_devices[graph->device];
+  Sim_request request;
+  request.input.assign((const half *)inputTensor, (const half *)inputTensor + inputTensorLength / sizeof(half));
+  request.user_param = userParam;
+  request.evaluated = false;
+
+  sim_clock::time_point sent = std::max(sim_clock::now(), device.usb_free_at) + sim_usb_time(inputTensorLength);
+  device.usb_free_at = sent;
+  sim_clock::time_point start = std::max(sent, device.engine_free_at);
+  request.ready = start + sim_us(graph->compute_us * graph->iterations) + sim_usb_time(graph->output_size);
+  device.engine_free_at = request.ready;
+  graph->fifo.push_back(request);
+  lock.unlock();
+
+  //returns once the tensor is on the stick
+  std::this_thread::sleep_until(sent);
+  return MVNC_OK;
+}
+
+mvncStatus mvncGetResult(void *graphHandle, void **outputData, unsigned int *outputDataLength, void **userParam){
+  std::unique_lock<std::mutex> lock(sim_lock);
+  Sim_graph *graph = sim_find_graph(graphHandle);
+  if(graph == NULL || outputData == NULL || outputDataLength == NULL || userParam == NULL)
+    return MVNC_INVALID_PARAMETERS;
+  if(graph->fifo.empty())
+    return MVNC_NO_DATA;
+  if(graph->dont_block && sim_clock::now() < graph->fifo.front().ready)
+    return MVNC_NO_DATA;
+
+  //results of a graph are taken by one thread at a time, as with a stick,
+  //the graph is evaluated into its own buffers without the lock
+  Sim_request &request = graph->fifo.front();
+  sim_clock::time_point ready = request.ready;
+  if(!request.evaluated){
+    request.evaluated = true;
+    lock.unlock();
+    if(sim_config.evaluate)
+      run_graph(graph, request.input);
+    std::this_thread::sleep_until(ready);
+    lock.lock();
+    if(sim_find_graph(graphHandle) == NULL)
+      return MVNC_GONE;
+  }
+
+  *userParam = graph->fifo.front().user_param;
+  graph->fifo.pop_front();
+  for(size_t s=0;s<graph->stages.size();s++)
+    graph->time_taken[s] = graph->stages[s].time_us * graph->iterations / 1000.0f;
+  *outputData = graph->output.data();
+  *outputDataLength = graph->output_size;
+  return MVNC_OK;
+}
@@ -0,0 +1,550 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs graphs of graph_compiler_NCS on the simulated stick and checks their
+// results against a FP32 reference of the Android operations, then checks
+// that broken blobs are rejected and that the tensor queue of a graph behaves
+// like the one of a stick. Prints the stages and device time of a graph
+// compiled without and with the network optimizations, then runs a graph
+// with two inputs and two outputs.
+//
+// usage: test
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<math.h>
+#include<algorithm>
+#include<functional>
+#include<vector>
+#include<mvnc.h>
+#include "Blob.h"
+#include "fp.h"
+
+typedef std::vector<char> Graph_blob;
+typedef std::vector<float> Tensor;
+
+//NHWC shape of a tensor
+typedef struct shape {
+  int h, w, c;
+} Shape;
+
+static Tensor ramp(size_t n, float scale){
+  Tensor t(n);
+  for(size_t i=0;i<n;i++)
+    t[i] = scale * ((float)((i * 7) % 23) / 11.0f - 1.0f);
+  return t;
+}
+
+static Tensor conv_kernel = ramp(8 * 3 * 3 * 3, 0.3f);      //[out][h][w][in]
+static Tensor conv_bias = ramp(8, 0.5f);
+static Tensor depthwise_kernel = ramp(3 * 3 * 8, 0.4f);     //[1][h][w][in * multiplier]
+static Tensor depthwise_bias = ramp(8, 0.2f);
+
+static void set_shape(VpuShape shape, int n, int h, int w, int c){
+  shape[0] = n; shape[1] = h; shape[2] = w; shape[3] = c;
+}
+
+static Operation_inputs_info new_stage(NCSoperations operation, Shape in, Shape out){
+  Operation_inputs_info stage = Operation_inputs_info();
+  stage.main_operation = operation;
+  stage.num_inputs = 1;
+  set_shape(stage.input_shape, 1, in.h, in.w, in.c);
+  set_shape(stage.output_shape, 1, out.h, out.w, out.c);
+  stage.stride_width = 1;
+  stage.stride_height = 1;
+  stage.post_operation = NONE;
+  return stage;
+}
+
+static Operation_inputs_info window_stage(NCSoperations operation, Shape in, Shape out, int size, int stride, int pad){
+  Operation_inputs_info stage = new_stage(operation, in, out);
+  stage.padding_left = pad; stage.padding_right = pad; stage.padding_top = pad; stage.padding_bottom = pad;
+  stage.stride_width = stride;
+  stage.stride_height = stride;
+  set_shape(stage.kernel_shape, size, size, 1, 1);
+  return stage;
+}
+
+//----------------------------------- FP32 reference of the Android operations
+
+static float activation(NCSoperations operation, float v){
+  switch(operation){
+    case RELU: return std::max(v, 0.0f);
+    case RELU6: return std::min(std::max(v, 0.0f), 6.0f);
+    case TANH: return tanhf(v);
+    case LOGISTIC: return 1.0f / (1.0f + expf(-v));
+    default: return v;
+  }
+}
+
+//SAME padding with a 3x3 window and stride 1, or VALID padding
+static Tensor ref_window(Shape o, int size, int stride, int pad,
+                         std::function<float(int oc, const std::vector<int> &iy, const std::vector<int> &ix)> f){
+  Tensor out(o.h * o.w * o.c);
+  for(int oy=0;oy<o.h;oy++)
+    for(int ox=0;ox<o.w;ox++)
+      for(int oc=0;oc<o.c;oc++){
+        std::vector<int> iy, ix;
+        for(int k=0;k<size;k++){
+          iy.push_back(oy * stride - pad + k);
+          ix.push_back(ox * stride - pad + k);
+        }
+        out[(oy * o.w + ox) * o.c + oc] = f(oc, iy, ix);
+      }
+  return out;
+}
+
+static Tensor ref_conv(const Tensor &in, Shape s, Shape o, NCSoperations post){
+  return ref_window(o, 3, 1, 1, [&](int oc, const std::vector<int> &iy, const std::vector<int> &ix){
+    float acc = conv_bias[oc];
+    for(int ky=0;ky<3;ky++)
+      for(int kx=0;kx<3;kx++){
+        if(iy[ky] < 0 || iy[ky] >= s.h || ix[kx] < 0 || ix[kx] >= s.w) continue;
+        for(int ic=0;ic<s.c;ic++)
+          acc += in[(iy[ky] * s.w + ix[kx]) * s.c + ic] * conv_kernel[((oc * 3 + ky) * 3 + kx) * s.c + ic];
+      }
+    return activation(post, acc);
+  });
+}
+
+static Tensor ref_depthwise(const Tensor &in, Shape s, Shape o, NCSoperations post){
+  int multiplier = o.c / s.c;
+  return ref_window(o, 3, 1, 1, [&](int oc, const std::vector<int> &iy, const std::vector<int> &ix){
+    float acc = depthwise_bias[oc];
+    for(int ky=0;ky<3;ky++)
+      for(int kx=0;kx<3;kx++){
+        if(iy[ky] < 0 || iy[ky] >= s.h || ix[kx] < 0 || ix[kx] >= s.w) continue;
+        acc += in[(iy[ky] * s.w + ix[kx]) * s.c + oc / multiplier] * depthwise_kernel[(ky * 3 + kx) * o.c + oc];
+      }
+    return activation(post, acc);
+  });
+}
+
+static Tensor ref_pool(const Tensor &in, Shape s, Shape o, bool max, int size, int stride, int pad){
+  return ref_window(o, size, stride, pad, [&](int oc, const std::vector<int> &iy, const std::vector<int> &ix){
+    float value = max ? -INFINITY : 0.0f;
+    int count = 0;
+    for(int ky=0;ky<size;ky++)
+      for(int kx=0;kx<size;kx++){
+        if(iy[ky] < 0 || iy[ky] >= s.h || ix[kx] < 0 || ix[kx] >= s.w) continue;
+        float v = in[(iy[ky] * s.w + ix[kx]) * s.c + oc];
+        value = max ? std::max(value, v) : value + v;
+        count++;
+      }
+    return max ? value : value / count;
+  });
+}
+
+static Tensor ref_activation(const Tensor &in, NCSoperations operation){
+  Tensor out(in.size());
+  for(size_t i=0;i<in.size();i++)
+    out[i] = activation(operation, in[i]);
+  return out;
+}
+
+static Tensor ref_softmax(const Tensor &in){
+  Tensor out(in.size());
+  float max_value = *std::max_element(in.begin(), in.end()), sum = 0;
+  for(size_t i=0;i<in.size();i++)
+    sum += out[i] = expf(in[i] - max_value);
+  for(size_t i=0;i<in.size();i++)
+    out[i] /= sum;
+  return out;
+}
+
+//----------------------------------- test graphs
+
+typedef struct test_graph {
+  const char *name;
+  Network_Vector_Stageinfo stages;
+  Shape input;
+  Tensor reference;
+  //model inputs and outputs by operand, empty for a chain
+  Network_Vector_Tensorinfo inputs, outputs;
+} Test_graph;
+
+static Test_graph get_graph(int graph){
+  Test_graph g;
+  if(graph == 0){
+    //CONV_2D with RELU6 then TANH
+    Shape in = {16, 16, 3}, out = {16, 16, 8};
+    Operation_inputs_info conv = window_stage(CONV_2D, in, out, 3, 1, 1);
+    conv.num_inputs = 3;
+    set_shape(conv.kernel_shape, 3, 3, 3, 8);
+    conv.kernel_buffer = conv_kernel.data();
+    set_shape(conv.bias_shape, 8, 1, 1, 1);
+    conv.bias_buffer = conv_bias.data();
+    conv.kernel_data = true;
+    conv.bias_data = true;
+    conv.post_operation = RELU6;
+    g.name = "conv relu6 tanh";
+    g.stages.push_back(conv);
+    g.stages.push_back(new_stage(TANH, out, out));
+    g.input = in;
+    Tensor input = ramp(in.h * in.w * in.c, 2.0f);
+    g.reference = ref_activation(ref_conv(input, in, out, RELU6), TANH);
+  }else if(graph == 1){
+    //DEPTHWISE_CONV_2D with RELU, MAX_POOL_2D, AVERAGE_POOL_2D then LOGISTIC
+    Shape in = {8, 8, 4}, dw = {8, 8, 8}, max_pool = {4, 4, 8};
+    Operation_inputs_info depthwise = window_stage(DEPTHWISE_CONV_2D, in, dw, 3, 1, 1);
+    depthwise.num_inputs = 3;
+    set_shape(depthwise.kernel_shape, 3, 3, 8, 1);
+    depthwise.kernel_buffer = depthwise_kernel.data();
+    set_shape(depthwise.bias_shape, 8, 1, 1, 1);
+    depthwise.bias_buffer = depthwise_bias.data();
+    depthwise.depth_multiplier = 2;
+    depthwise.kernel_data = true;
+    depthwise.bias_data = true;
+    depthwise.post_operation = RELU;
+    g.name = "depthwise max avg logistic";
+    g.stages.push_back(depthwise);
+    g.stages.push_back(window_stage(MAX_POOL_2D, dw, max_pool, 2, 2, 0));
+    g.stages.push_back(window_stage(AVERAGE_POOL_2D, max_pool, max_pool, 3, 1, 1));
+    g.stages.push_back(new_stage(LOGISTIC, max_pool, max_pool));
+    g.input = in;
+    Tensor input = ramp(in.h * in.w * in.c, 1.5f);
+    Tensor t = ref_depthwise(input, in, dw, RELU);
+    t = ref_pool(t, dw, max_pool, true, 2, 2, 0);
+    t = ref_pool(t, max_pool, max_pool, false, 3, 1, 1);
+    g.reference = ref_activation(t, LOGISTIC);
+  }else if(graph == 2){
+    //RELU, RESHAPE to a vector then SOFTMAX
+    Shape in = {4, 4, 8}, flat = {1, 1, 128};
+    Operation_inputs_info softmax = new_stage(SOFTMAX, flat, flat);
+    softmax.beta = 1.0f;
+    softmax.op_params_data = true;
+    g.name = "relu reshape softmax";
+    g.stages.push_back(new_stage(RELU, in, in));
+    g.stages.push_back(new_stage(RESHAPE, in, flat));
+    g.stages.push_back(softmax);
+    g.input = in;
+    Tensor input = ramp(in.h * in.w * in.c, 3.0f);
+    g.reference = ref_softmax(ref_activation(input, RELU));
+  }else{
+    //CONV_2D, RELU, MAX_POOL_2D, RELU6, RESHAPE to a vector then SOFTMAX,
+    //the activations fold into the stage before them and the reshape goes
+    Shape in = {16, 16, 3}, out = {16, 16, 8}, max_pool = {8, 8, 8}, flat = {1, 1, 512};
+    Operation_inputs_info conv = window_stage(CONV_2D, in, out, 3, 1, 1);
+    conv.num_inputs = 3;
+    set_shape(conv.kernel_shape, 3, 3, 3, 8);
+    conv.kernel_buffer = conv_kernel.data();
+    set_shape(conv.bias_shape, 8, 1, 1, 1);
+    conv.bias_buffer = conv_bias.data();
+    conv.kernel_data = true;
+    conv.bias_data = true;
+    Operation_inputs_info softmax = new_stage(SOFTMAX, flat, flat);
+    softmax.beta = 1.0f;
+    softmax.op_params_data = true;
+    g.name = "conv relu max relu6 reshape softmax";
+    g.stages.push_back(conv);
+    g.stages.push_back(new_stage(RELU, out, out));
+    g.stages.push_back(window_stage(MAX_POOL_2D, out, max_pool, 2, 2, 0));
+    g.stages.push_back(new_stage(RELU6, max_pool, max_pool));
+    g.stages.push_back(new_stage(RESHAPE, max_pool, flat));
+    g.stages.push_back(softmax);
+    g.input = in;
+    Tensor input = ramp(in.h * in.w * in.c, 2.0f);
+    Tensor t = ref_activation(ref_conv(input, in, out, NONE), RELU);
+    t = ref_activation(ref_pool(t, out, max_pool, true, 2, 2, 0), RELU6);
+    g.reference = ref_softmax(t);
+  }
+  return g;
+}
+
+static bool compile(const Test_graph &g, Graph_blob *blob, bool optimize = true){
+  Compile_context ctx;
+  init_compile_context(&ctx);
+  ctx.optimize = optimize;
+  network_operations_vector operations;
+  for(size_t i=0;i<g.stages.size();i++)
+    operations.push_back(g.stages[i].main_operation);
+  if(!get_nn_network_from_android(&ctx, operations))
+    return false;
+  if(!g.inputs.empty() && !get_nn_network_io_from_android(&ctx, g.inputs, g.outputs))
+    return false;
+  for(size_t i=0;i<g.stages.size();i++){
+    if(!parse_stage_from_android(&ctx, g.stages[i]))
+      return false;
+  }
+  char *graph_blob = NULL;
+  uint32_t graph_blob_size = 0;
+  if(!prepare_blob(&ctx, g.name, 0, &graph_blob, &graph_blob_size))
+    return false;
+  blob->assign(graph_blob, graph_blob + graph_blob_size);
+  free(graph_blob);
+  return true;
+}
+
+static std::vector<half> fp16_input(const Test_graph &g, float scale){
+  Tensor input = ramp(g.input.h * g.input.w * g.input.c, scale);
+  std::vector<half> input_fp16(input.size());
+  floattofp16((unsigned char *)input_fp16.data(), input.data(), input.size());
+  return input_fp16;
+}
+
+static bool check(const char *name, bool success){
+  printf("%-40s %s\n", name, success ? "PASS" : "FAIL");
+  return success;
+}
+
+//runs the graph once and compares its result with the reference
+static bool check_result(void *device, const Test_graph &g, float scale){
+  Graph_blob blob;
+  void *graph = NULL;
+  if(!compile(g, &blob) || mvncAllocateGraph(device, &graph, blob.data(), blob.size()) != MVNC_OK)
+    return check(g.name, false);
+
+  std::vector<half> input = fp16_input(g, scale);
+  void *result = NULL, *user_param = NULL;
+  unsigned int result_len = 0;
+  bool success = mvncLoadTensor(graph, input.data(), input.size() * sizeof(half), (void *)&g) == MVNC_OK &&
+                 mvncGetResult(graph, &result, &result_len, &user_param) == MVNC_OK &&
+                 user_param == (void *)&g && result_len == g.reference.size() * sizeof(half);
+  float max_error = 0;
+  if(success){
+    Tensor output(g.reference.size());
+    fp16tofloat(output.data(), (unsigned char *)result, output.size());
+    for(size_t i=0;i<output.size();i++){
+      float error = fabsf(output[i] - g.reference[i]);
+      max_error = std::max(max_error, error);
+      success = success && error <= 0.01f + 0.01f * fabsf(g.reference[i]);
+    }
+  }
+  mvncDeallocateGraph(graph);
+  printf("%-40s max error %g\n", g.name, max_error);
+  return check(g.name, success);
+}
+
+//the blob of graph 0 with one byte of a stage record changed
+static bool check_rejected(void *device, const char *name, int stage, int offset, uint8_t value){
+  Graph_blob blob;
+  if(!compile(get_graph(0), &blob))
+    return check(name, false);
+  blob[SIZE_HEADER + stage * STAGE_SIZE + offset] = value;
+  void *graph = NULL;
+  mvncStatus status = mvncAllocateGraph(device, &graph, blob.data(), blob.size());
+  if(status == MVNC_OK)
+    mvncDeallocateGraph(graph);
+  return check(name, status == MVNC_UNSUPPORTED_GRAPH_FILE);
+}
+
+//a graph holds MVNC_SIM_FIFO tensors and returns them in order
+static bool check_queue(void *device){
+  Test_graph g = get_graph(2);
+  Graph_blob blob;
+  void *graph = NULL;
+  if(!compile(g, &blob) || mvncAllocateGraph(device, &graph, blob.data(), blob.size()) != MVNC_OK)
+    return check("tensor queue", false);
+
+  int dont_block = 1;
+  bool success = mvncSetGraphOption(graph, MVNC_DONT_BLOCK, &dont_block, sizeof(dont_block)) == MVNC_OK;
+  std::vector<half> input = fp16_input(g, 3.0f);
+  long tags[] = {1, 2, 3};
+  success = success && mvncLoadTensor(graph, input.data(), input.size() * sizeof(half), &tags[0]) == MVNC_OK;
+  success = success && mvncLoadTensor(graph, input.data(), input.size() * sizeof(half), &tags[1]) == MVNC_OK;
+  success = success && mvncLoadTensor(graph, input.data(), input.size() * sizeof(half), &tags[2]) == MVNC_BUSY;
+  for(int i=0;i<2 && success;i++){
+    void *result, *user_param = NULL;
+    unsigned int result_len;
+    mvncStatus status;
+    while((status = mvncGetResult(graph, &result, &result_len, &user_param)) == MVNC_NO_DATA);
+    success = status == MVNC_OK && user_param == &tags[i];
+  }
+
+  std::vector<float> time_taken(64);
+  unsigned int length = time_taken.size() * sizeof(float);
+  success = success && mvncGetGraphOption(graph, MVNC_TIME_TAKEN, time_taken.data(), &length) == MVNC_OK &&
+            length > 0 && length % sizeof(float) == 0 && time_taken[length / sizeof(float) - 1] > 0;
+  mvncDeallocateGraph(graph);
+  return check("tensor queue", success);
+}
+
+//runs the graph once, returns its output, stages and device time in ms
+static bool run_graph(void *device, const Test_graph &g, float scale, bool optimize,
+                      std::vector<half> *output, unsigned int *stages, float *device_ms){
+  Graph_blob blob;
+  void *graph = NULL;
+  if(!compile(g, &blob, optimize) || mvncAllocateGraph(device, &graph, blob.data(), blob.size()) != MVNC_OK)
+    return false;
+
+  std::vector<half> input = fp16_input(g, scale);
+  void *result = NULL, *user_param = NULL;
+  unsigned int result_len = 0;
+  std::vector<float> time_taken(64);
+  unsigned int length = time_taken.size() * sizeof(float);
+  bool success = mvncLoadTensor(graph, input.data(), input.size() * sizeof(half), NULL) == MVNC_OK &&
+                 mvncGetResult(graph, &result, &result_len, &user_param) == MVNC_OK &&
+                 mvncGetGraphOption(graph, MVNC_TIME_TAKEN, time_taken.data(), &length) == MVNC_OK;
+  if(success){
+    output->assign((half *)result, (half *)result + result_len / sizeof(half));
+    //without the input layer
+    *stages = length / sizeof(float) - 1;
+    *device_ms = 0;
+    for(unsigned int i=0;i<length / sizeof(float);i++)
+      *device_ms += time_taken[i];
+  }
+  mvncDeallocateGraph(graph);
+  return success;
+}
+
+//the optimized graph gives the same result with fewer stages in less device time
+static bool check_optimization(void *device){
+  Test_graph g = get_graph(3);
+  std::vector<half> output[2];
+  unsigned int stages[2];
+  float device_ms[2];
+  for(int optimize=0;optimize<2;optimize++){
+    if(!run_graph(device, g, 2.0f, optimize, &output[optimize], &stages[optimize], &device_ms[optimize]))
+      return check("network optimization", false);
+    printf("%-40s %u stages, %.3f ms\n", optimize ? "optimized" : "not optimized", stages[optimize], device_ms[optimize]);
+  }
+  return check("network optimization", output[0] == output[1] &&
+               stages[1] == 3 && stages[0] == g.stages.size() && device_ms[1] < device_ms[0]);
+}
+
+static Network_tensor_info tensor_info(uint32_t operand, Shape s){
+  Network_tensor_info tensor;
+  tensor.operand = operand;
+  set_shape(tensor.shape, 1, s.h, s.w, s.c);
+  return tensor;
+}
+
+static void set_operands(Operation_inputs_info *stage, uint32_t input, uint32_t output){
+  stage->input_operands[0] = input;
+  stage->num_input_operands = 1;
+  stage->output_operand = output;
+}
+
+//a residual block with two inputs and two outputs, given to the compiler in
+//another order than the one of the stages:
+//  t1 = CONV_2D(a), out2 = MAX_POOL_2D(t1), out1 = RELU6(RELU(t1) + b)
+//t1 is read twice, so only RELU6 folds into the ADD
+static bool check_branches(void *device){
+  enum { T1 = 1, T2, T3, B = 10, A, OUT1 = 20, OUT2 };
+  Shape in = {16, 16, 3}, out = {16, 16, 8}, max_pool = {8, 8, 8};
+  Test_graph g;
+  g.name = "conv relu add relu6, max pool";
+  Operation_inputs_info conv = window_stage(CONV_2D, in, out, 3, 1, 1);
+  conv.num_inputs = 3;
+  set_shape(conv.kernel_shape, 3, 3, 3, 8);
+  conv.kernel_buffer = conv_kernel.data();
+  set_shape(conv.bias_shape, 8, 1, 1, 1);
+  conv.bias_buffer = conv_bias.data();
+  conv.kernel_data = true;
+  conv.bias_data = true;
+  set_operands(&conv, A, T1);
+  Operation_inputs_info relu = new_stage(RELU, out, out);
+  set_operands(&relu, T1, T2);
+  Operation_inputs_info add = new_stage(ADD, out, out);
+  add.num_inputs = 2;
+  set_operands(&add, T2, T3);
+  add.input_operands[1] = B;
+  add.num_input_operands = 2;
+  Operation_inputs_info pool = window_stage(MAX_POOL_2D, out, max_pool, 2, 2, 0);
+  set_operands(&pool, T1, OUT2);
+  Operation_inputs_info relu6 = new_stage(RELU6, out, out);
+  set_operands(&relu6, T3, OUT1);
+  g.stages.push_back(conv);
+  g.stages.push_back(relu);
+  g.stages.push_back(add);
+  g.stages.push_back(pool);
+  g.stages.push_back(relu6);
+  g.input = in;
+  g.inputs.push_back(tensor_info(B, out));
+  g.inputs.push_back(tensor_info(A, in));
+  g.outputs.push_back(tensor_info(OUT1, out));
+  g.outputs.push_back(tensor_info(OUT2, max_pool));
+
+  Tensor a = ramp(in.h * in.w * in.c, 2.0f), b = ramp(out.h * out.w * out.c, 1.0f);
+  Tensor t1 = ref_conv(a, in, out, NONE), t3 = ref_activation(t1, RELU);
+  for(size_t i=0;i<t3.size();i++)
+    t3[i] += b[i];
+  Tensor out1 = ref_activation(t3, RELU6), out2 = ref_pool(t1, out, max_pool, true, 2, 2, 0);
+  Tensor reference(out1);
+  reference.insert(reference.end(), out2.begin(), out2.end());
+
+  //the inputs one after another, in the order of the model
+  Tensor input(b);
+  input.insert(input.end(), a.begin(), a.end());
+  std::vector<half> input_fp16(input.size());
+  floattofp16((unsigned char *)input_fp16.data(), input.data(), input.size());
+
+  bool success = true;
+  for(int optimize=0;optimize<2 && success;optimize++){
+    Graph_blob blob;
+    void *graph = NULL;
+    if(!compile(g, &blob, optimize) || mvncAllocateGraph(device, &graph, blob.data(), blob.size()) != MVNC_OK)
+      return check(g.name, false);
+    void *result = NULL, *user_param = NULL;
+    unsigned int result_len = 0;
+    std::vector<float> time_taken(64);
+    unsigned int length = time_taken.size() * sizeof(float);
+    success = mvncLoadTensor(graph, input_fp16.data(), input_fp16.size() * sizeof(half), NULL) == MVNC_OK &&
+              mvncGetResult(graph, &result, &result_len, &user_param) == MVNC_OK &&
+              mvncGetGraphOption(graph, MVNC_TIME_TAKEN, time_taken.data(), &length) == MVNC_OK &&
+              result_len == reference.size() * sizeof(half);
+    float max_error = 0;
+    if(success){
+      Tensor output(reference.size());
+      fp16tofloat(output.data(), (unsigned char *)result, output.size());
+      for(size_t i=0;i<output.size();i++){
+        float error = fabsf(output[i] - reference[i]);
+        max_error = std::max(max_error, error);
+        success = success && error <= 0.01f + 0.01f * fabsf(reference[i]);
+      }
+      //without the input layer
+      unsigned int stages = length / sizeof(float) - 1;
+      success = success && stages == (optimize ? 4 : g.stages.size());
+      printf("%-40s max error %g, %u stages\n", optimize ? "optimized" : "not optimized", max_error, stages);
+    }
+    mvncDeallocateGraph(graph);
+  }
+  return check(g.name, success);
+}
+
+int main(){
+  setenv("MVNC_SIM_DEVICES", "1", 1);
+  setenv("MVNC_SIM_FIFO", "2", 1);
+
+  char name[100];
+  void *device = NULL;
+  if(mvncGetDeviceName(0, name, sizeof(name)) != MVNC_OK || mvncOpenDevice(name, &device) != MVNC_OK){
+    printf("unable to open the simulated stick\n");
+    return 1;
+  }
+
+  bool success = true;
+  success = check_result(device, get_graph(0), 2.0f) && success;
+  success = check_result(device, get_graph(1), 1.5f) && success;
+  success = check_result(device, get_graph(2), 3.0f) && success;
+  success = check_result(device, get_graph(3), 2.0f) && success;
+
+  //stage 1 is the convolution, stage 2 the tanh reading its output
+  success = check_rejected(device, "unsupported operation", 1, 100, 99) && success;
+  success = check_rejected(device, "FP32 stage", 1, 184, 1) && success;
+  success = check_rejected(device, "taps outside the blob data", 1, 196, 0x10) && success;
+  success = check_rejected(device, "read before written", 2, 187, 0x02) && success;
+  success = check_rejected(device, "output into the blob data", 1, 215, 3) && success;
+
+  success = check_queue(device) && success;
+  success = check_optimization(device) && success;
+  success = check_branches(device) && success;
+
+  mvncCloseDevice(device);
+  printf("%s\n", success ? "PASS" : "FAIL");
+  return success ? 0 : 1;
+}
@@ -40,6 +40,12 @@ LOCAL_C_INCLUDES += \
 
 LOCAL_CFLAGS += -fexceptions
 
+#ADD and models with several inputs or outputs are only accepted when
+#running on the simulator, they have not been checked on a stick
+ifeq ($(NCS_SIMULATOR),true)
+LOCAL_CFLAGS += -DNCS_SIMULATOR
+endif
+
 LOCAL_SHARED_LIBRARIES := \
                     libhidlbase \
                     libhidltransport \
@@ -92,9 +92,10 @@ public:
     // The model must outlive the executor.  We prevent it from being modified
     // while this is executing.
 
+    // graph_id is the graph of the model loaded in ncs_lib.
     int run(const Model& model, const Request& request,
             const std::vector<RunTimePoolInfo>& modelPoolInfos,
-            const std::vector<RunTimePoolInfo>& requestPoolInfos);
+            const std::vector<RunTimePoolInfo>& requestPoolInfos, int graph_id);
 
 private:
 
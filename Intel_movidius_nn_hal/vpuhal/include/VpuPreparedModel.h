@@ -30,6 +30,7 @@
 #include <sys/mman.h>
 #include <string>
 #include <iostream>
+#include <atomic>
 
 #include "HalInterfaces.h"
 #include "NeuralNetworks.h"
@@ -48,7 +49,7 @@ namespace vpu_driver {
 class VpuPreparedModel : public IPreparedModel {
 
   public:
-      static int network_count_ex;
+      static std::atomic<int> network_count_ex;
       VpuPreparedModel(const Model& model)
             : // Make a copy of the model, as we need to preserve it.
               mModel(model) {network_count_ex++;}
@@ -62,11 +63,16 @@ class VpuPreparedModel : public IPreparedModel {
 
 private:
         void deinitialize();
+        std::string getBlobCachePath(const Model& model, uint64_t* key);
+        bool compileModel(const Model& model, char **graph_blob, uint32_t *graph_blob_size);
         Operation_inputs_info get_operation_operands_info_model(const Model& model, const Operation& operation);
+        Network_tensor_info get_network_tensor_info(const Model& model, uint32_t index);
         void asyncExecute(const Request& request, const sp<IExecutionCallback>& callback);
 
         Model mModel;
         std::vector<RunTimePoolInfo> mPoolInfos;
+        bool mDeviceOpen = false;
+        int mGraphId = -1; //graph of this model in ncs_lib, -1 until loaded
 };
 
 
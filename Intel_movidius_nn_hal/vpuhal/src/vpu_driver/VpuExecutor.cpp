@@ -162,7 +162,7 @@ static bool setInfoAndAllocateIfNeeded(RunTimeOperandInfo* info, const Shape& sh
 // by the caller.
 int VpuExecutor::run(const Model& model, const Request& request,
                      const std::vector<RunTimePoolInfo>& modelPoolInfos,
-                     const std::vector<RunTimePoolInfo>& requestPoolInfos) {
+                     const std::vector<RunTimePoolInfo>& requestPoolInfos, int graph_id) {
     VLOG(VPUEXE) << "VpuExecutor::run()";
     VLOG(VPUEXE) << "model: " << toString(model);
     VLOG(VPUEXE) << "request: " << toString(request);
@@ -172,53 +172,36 @@ int VpuExecutor::run(const Model& model, const Request& request,
 
     initializeRunTimeInfo(modelPoolInfos, requestPoolInfos);
 
-    Oertaion_vector nn_ops_vectors;
-    for (const auto& operation : model.operations) {
-      nn_ops_vectors.push_back(operation.type);
-    }
-
-    const hidl_vec<uint32_t>& network_inputs = model.operations[0].inputs;
-    const RunTimeOperandInfo& network_input = mOperands[network_inputs[0]];
-    Shape nw_input_shape = network_input.shape();
-    uint32_t input_num_elements = getNumberOfElements(nw_input_shape);
-    VLOG(VPUEXE) << "Input Num of Elements: " << input_num_elements;
-
-    float *network_input_buffer;
-    network_input_buffer = (float *)malloc(sizeof(float) * input_num_elements);
-    if(network_input_buffer == NULL)
-    LOG(ERROR) << "Unable to allocate network_input_buffer";
-    memset(network_input_buffer, 0, sizeof(float) * input_num_elements);
-    memcpy(network_input_buffer,reinterpret_cast<float*>(network_input.buffer), sizeof(float) * input_num_elements);
-
-    const hidl_vec<uint32_t>& network_outputs = model.operations[nn_ops_vectors.size()-1].outputs;
-    RunTimeOperandInfo& network_output = mOperands[network_outputs[0]];
-    Shape nw_output_shape = network_output.shape();
-    uint32_t output_num_elements = getNumberOfElements(nw_output_shape);
-    float *network_output_buffer;
-    network_output_buffer = (float *)malloc(sizeof(float) * output_num_elements);
-    if(network_output_buffer == NULL)
-    LOG(ERROR) << "Unable to allocate network_output_buffer";
-    memset(network_output_buffer,0,sizeof(float) * output_num_elements);
-
-    VLOG(VPUEXE) << "Output Num of Elements: " << output_num_elements;
+    //the graph takes the model inputs and gives the model outputs one after
+    //another, in the order of the model
+    auto getTensors = [this](const hidl_vec<uint32_t>& indexes, std::vector<Ncs_tensor>* tensors) -> bool {
+        for (auto index : indexes) {
+            const RunTimeOperandInfo& operand = mOperands[index];
+            if (operand.buffer == nullptr) {
+                LOG(ERROR) << "operand " << index << " of the request has no buffer";
+                return false;
+            }
+            Ncs_tensor tensor = {reinterpret_cast<float*>(operand.buffer), getNumberOfElements(operand.shape())};
+            tensors->push_back(tensor);
+        }
+        return true;
+    };
+    std::vector<Ncs_tensor> network_inputs, network_outputs;
+    if (!getTensors(model.inputIndexes, &network_inputs) || !getTensors(model.outputIndexes, &network_outputs))
+        return ANEURALNETWORKS_BAD_DATA;
+    VLOG(VPUEXE) << "Inputs: " << network_inputs.size() << " Outputs: " << network_outputs.size();
 
     VLOG(VPUEXE) << "Got the input data request Starting to execute on VPU!";
 
-    int val = ncs_execute((float*)network_input_buffer,input_num_elements,network_output_buffer, output_num_elements);
+    //ncs_lib converts the request pools to and from FP16 in place, no copy is made here
+    int val = ncs_execute_tensors(graph_id, network_inputs.data(), network_inputs.size(),
+                                  network_outputs.data(), network_outputs.size());
 
     if(val != 0)
       return ANEURALNETWORKS_OP_FAILED;
 
-
-    memcpy(reinterpret_cast<float*>(network_output.buffer),network_output_buffer,output_num_elements*sizeof(float));
     VLOG(VPUEXE) << "Got the output result fro VPU!";
 
-    free(network_input_buffer);
-    free(network_output_buffer);
-    nn_ops_vectors.clear();
-
-    
-
     for (auto runtimeInfo : modelPoolInfos) {
         runtimeInfo.update();
     }
@@ -26,6 +26,7 @@
 #include <thread>
 #include <iostream>
 #include <stdio.h>
+#include <cutils/properties.h>
 
 #include "ncs_lib.h"
 
@@ -77,27 +78,119 @@ int VpuPreparedModel::get_network_count(){
 
 */
 // initialize() function
-int VpuPreparedModel::network_count_ex =0;
+std::atomic<int> VpuPreparedModel::network_count_ex(0);
+
+#define DEFAULT_BLOB_CACHE_DIR "/data/vendor/vpu"
+
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    return hash;
+}
+
+template <typename T>
+static uint64_t hashVector(uint64_t hash, const hidl_vec<T>& values)
+{
+    uint64_t size = values.size();
+    hash = hashBytes(hash, &size, sizeof(size));
+    return hashBytes(hash, values.data(), size * sizeof(T));
+}
+
+//path of the cached blob of the model, keyed by its operations, operands and
+//constant data, the compiler version and the shave range. Empty when the cache
+//is disabled with nn.hal.vpu.cache=0, nn.hal.vpu.cache_dir moves it.
+std::string VpuPreparedModel::getBlobCachePath(const Model& model, uint64_t* key)
+{
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("nn.hal.vpu.cache", value, "") > 0 && atoi(value) == 0)
+        return "";
+    property_get("nn.hal.vpu.cache_dir", value, DEFAULT_BLOB_CACHE_DIR);
+
+    const uint32_t config[] = {GRAPH_COMPILER_VERSION, BLOB_FIRST_SHAVE, BLOB_LAST_SHAVE};
+    uint64_t hash = hashBytes(0xcbf29ce484222325ULL, config, sizeof(config));
+    for (const auto& operation : model.operations) {
+        hash = hashBytes(hash, &operation.type, sizeof(operation.type));
+        hash = hashVector(hash, operation.inputs);
+        hash = hashVector(hash, operation.outputs);
+    }
+    for (const auto& operand : model.operands) {
+        hash = hashBytes(hash, &operand.type, sizeof(operand.type));
+        hash = hashVector(hash, operand.dimensions);
+        hash = hashBytes(hash, &operand.scale, sizeof(operand.scale));
+        hash = hashBytes(hash, &operand.zeroPoint, sizeof(operand.zeroPoint));
+        hash = hashBytes(hash, &operand.lifetime, sizeof(operand.lifetime));
+        hash = hashBytes(hash, &operand.location, sizeof(operand.location));
+        if (operand.lifetime == OperandLifeTime::CONSTANT_REFERENCE &&
+            operand.location.poolIndex < mPoolInfos.size())
+            hash = hashBytes(hash, mPoolInfos[operand.location.poolIndex].buffer + operand.location.offset,
+                             operand.location.length);
+    }
+    hash = hashVector(hash, model.inputIndexes);
+    hash = hashVector(hash, model.outputIndexes);
+    hash = hashVector(hash, model.operandValues);
+
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.ncsblob", static_cast<unsigned long long>(hash));
+    *key = hash;
+    return std::string(value) + name;
+}
 
 bool VpuPreparedModel::initialize(const Model& model) {
     VLOG(MODEL)<<"VpuPreparedModel::initialize()";
     bool success = false;
 
 
-    if(VpuPreparedModel::network_count_ex>1){
-      VLOG(MODEL) << "More than one graph is required to generate for given model, Model count is " << VpuPreparedModel::network_count_ex;
-      VpuPreparedModel::network_count_ex =0;
+    success = setRunTimePoolInfosFromHidlMemories(&mPoolInfos, mModel.pools);
+
+    if (!success) {
+      LOG(ERROR)<<"setRunTimePoolInfosFromHidlMemories failed.";
       return false;
     }
 
+    //a warm prepare takes the blob from the cache and skips the compiler
+    char *graph_blob = NULL;
+    uint32_t graph_blob_size = 0;
+    uint64_t cache_key = 0;
+    std::string cache_path = getBlobCachePath(model, &cache_key);
+    if (!cache_path.empty() && load_cached_blob(cache_path.c_str(), cache_key, &graph_blob, &graph_blob_size)) {
+      VLOG(MODEL) << "NCS graph loaded from " << cache_path;
+    } else {
+      if (!compileModel(model, &graph_blob, &graph_blob_size))
+        return false;
+      if (!cache_path.empty())
+        save_cached_blob(cache_path.c_str(), cache_key, graph_blob, graph_blob_size);
+    }
 
-    success = setRunTimePoolInfosFromHidlMemories(&mPoolInfos, mModel.pools);
+    int val;
+    val = ncs_init();
+    if (val!=0){
+      LOG(ERROR) << "unable to initialize NCS device";
+      free(graph_blob);
+      return false;
+    }
+    mDeviceOpen = true;
 
-    if (!success) {
-      LOG(ERROR)<<"setRunTimePoolInfosFromHidlMemories failed.";
+    //sizes the FP16 staging buffers of the graph, the model inputs and outputs
+    //are packed one after another, see VpuExecutor::run()
+    uint32_t input_num_elements = 0, output_num_elements = 0;
+    for (auto index : model.inputIndexes)
+      input_num_elements += shape_elements(get_network_tensor_info(model, index).shape);
+    for (auto index : model.outputIndexes)
+      output_num_elements += shape_elements(get_network_tensor_info(model, index).shape);
+
+    val = ncs_load_graph(graph_blob, graph_blob_size, input_num_elements, output_num_elements, &mGraphId);
+    if (val!=0){
+      mGraphId = -1;
+      LOG(ERROR) << "unable to Load graph into NCS device";
       return false;
     }
 
+    return true;
+  }
+
+bool VpuPreparedModel::compileModel(const Model& model, char **graph_blob, uint32_t *graph_blob_size) {
     // code begin for understand model
     VLOG(MODEL) << "Model Compiling for VPU Driver begin ";
     Oertaion_vector nn_ops_vectors;
@@ -126,17 +219,35 @@ bool VpuPreparedModel::initialize(const Model& model) {
         case OperationType::SOFTMAX: nn_ncs_operation = SOFTMAX;break;
         case OperationType::FULLY_CONNECTED: nn_ncs_operation = FULLY_CONNECTED;break;
         case OperationType::RESHAPE: nn_ncs_operation = RESHAPE;break;
+        case OperationType::ADD: nn_ncs_operation = ADD;break;
         default: nn_ncs_operation = NONE;break;
       }
       nn_ncs_network.push_back(nn_ncs_operation);
       nn_ops_vectors.push_back(operation.type);
     }
 
+    Compile_context compile_context;
+    init_compile_context(&compile_context);
+
     bool status;
-    status = get_nn_network_from_android(nn_ncs_network);
+    status = get_nn_network_from_android(&compile_context, nn_ncs_network);
     if(!status)
       return false;
 
+#ifdef NCS_SIMULATOR
+    //the stages are linked by the operands of the model
+    Network_Vector_Tensorinfo network_inputs, network_outputs;
+    for (auto index : model.inputIndexes)
+      network_inputs.push_back(get_network_tensor_info(model, index));
+    for (auto index : model.outputIndexes)
+      network_outputs.push_back(get_network_tensor_info(model, index));
+    status = get_nn_network_io_from_android(&compile_context, network_inputs, network_outputs);
+    if(!status)
+      return false;
+#endif
+    //without network inputs the compiler chains stage i to stage i+1 as it
+    //always did, the only data flow that has been run on a stick
+
     Operation_inputs_info operation_operand_info;
 
     int count = model.operations.size();
@@ -144,7 +255,7 @@ bool VpuPreparedModel::initialize(const Model& model) {
       const auto operation = model.operations[m];
       VLOG(MODEL)<<"Operation: "<<toString(operation);
       operation_operand_info = get_operation_operands_info_model(model, operation);
-      bool status = parse_stage_from_android(operation_operand_info);
+      bool status = parse_stage_from_android(&compile_context, operation_operand_info);
       VLOG(MODEL) << "Status " << status;
       if(!status){
         return false;
@@ -154,10 +265,11 @@ bool VpuPreparedModel::initialize(const Model& model) {
     //VpuPreparedModel::network_count = VpuPreparedModel::network_count + 1;
     std::string network_name = "android-nn-model-";
     std::string network_name_final;
-    network_name_final = network_name + std::to_string(network_count_ex);
-    VLOG(MODEL) << "Current Network Count is " << network_count_ex << "Model Name is " << network_name_final;
+    int network_count = network_count_ex;
+    network_name_final = network_name + std::to_string(network_count);
+    VLOG(MODEL) << "Current Network Count is " << network_count << "Model Name is " << network_name_final;
 
-    status = prepare_blob(network_name_final,network_count_ex);
+    status = prepare_blob(&compile_context,network_name_final,network_count,graph_blob,graph_blob_size);
     if(!status){
       VLOG(MODEL) << "Unable to prepare NCS graph";
       return false;
@@ -168,24 +280,19 @@ bool VpuPreparedModel::initialize(const Model& model) {
     nn_ops_vectors.clear();
     nn_ncs_network.clear();
 
-
-    int val;
-    val = ncs_init();
-    if (val!=0){
-      LOG(ERROR) << "unable to initialize NCS device";
-      return false;
-    }
-
-    val = ncs_load_graph();
-    if (val!=0){
-      LOG(ERROR) << "unable to Load graph into NCS device";
-      return false;
-    }
-
     return true;
   }
 
 
+Network_tensor_info VpuPreparedModel::get_network_tensor_info(const Model& model, uint32_t index){
+  Network_tensor_info tensor_info;
+  tensor_info.operand = index;
+  const auto& dimensions = model.operands[index].dimensions;
+  for (size_t i = 0; i < SIZE; i++)
+    tensor_info.shape[i] = i < dimensions.size() ? dimensions[i] : 0;
+  return tensor_info;
+}
+
 Operation_inputs_info VpuPreparedModel::get_operation_operands_info_model(const Model& model, const Operation& operation){
   Operation_inputs_info stage_info;
   const hidl_vec<uint32_t>& ins = operation.inputs;
@@ -1291,7 +1398,43 @@ Operation_inputs_info VpuPreparedModel::get_operation_operands_info_model(const
 			      VLOG(MODEL) << " RESHAPE output_shape[" << i << "]: " << stage_info.output_shape[i];
         }
       } break; //RESHAPE_END
+      case OperationType::ADD: {//ADD begin
+        VLOG(MODEL) << toString(operation);
+
+        //isOperationSupported() only accepts two tensors of the same dimensions
+        const auto input = model.operands[operation.inputs[0]];
+        auto output = model.operands[operation.outputs[0]];
+        int32_t activation = getOperandConstVal<int32_t>(model,model.operands[operation.inputs[2]]);
+
+        stage_info.main_operation = ADD;
+        stage_info.num_inputs = 2;
+        for(int i=0; i<input.dimensions.size();i++)
+        stage_info.input_shape[i] = input.dimensions[i];
+
+        for(int i=0; i<output.dimensions.size();i++)
+        stage_info.output_shape[i] = output.dimensions[i];
+
+        switch (activation) {
+          case 0: stage_info.post_operation = NONE; break;
+          case 1: stage_info.post_operation = RELU; break;
+          case 2: stage_info.post_operation = RELU1; break;
+          case 3: stage_info.post_operation = RELU6; break;
+          default: stage_info.post_operation = NONE; break;
+        }
+        stage_info.kernel_data = false;
+        stage_info.bias_data = false;
+        stage_info.op_params_data = false;
+      } break; //ADD_END
     }
+
+  //the operands linking the stage to the others, ADD reads two tensors
+  stage_info.input_operands[0] = operation.inputs[0];
+  stage_info.num_input_operands = 1;
+  if(operation.type == OperationType::ADD){
+    stage_info.input_operands[1] = operation.inputs[1];
+    stage_info.num_input_operands = 2;
+  }
+  stage_info.output_operand = operation.outputs[0];
   return stage_info;
 }
 
@@ -1332,6 +1475,28 @@ bool VpuPreparedModel::isOperationSupported(const Operation& operation, const Mo
     }
 #endif
 
+#ifndef NCS_SIMULATOR
+    //several model inputs or outputs are packed into the graph tensors the
+    //way the simulator does it, which has not been checked on a stick
+    if (model.inputIndexes.size() != 1 || model.outputIndexes.size() != 1) {
+      VLOG(MODEL) << "models with several inputs or outputs only run on the NCS simulator";
+      return false;
+    }
+    //the graph compiler chains the stages in operation order on a stick
+    uint32_t chained = model.inputIndexes[0];
+    for (const auto& op : model.operations) {
+      if (op.inputs.empty() || op.inputs[0] != chained || op.outputs.size() != 1) {
+        VLOG(MODEL) << "models that are not a chain of operations only run on the NCS simulator";
+        return false;
+      }
+      chained = op.outputs[0];
+    }
+    if (chained != model.outputIndexes[0]) {
+      VLOG(MODEL) << "models that are not a chain of operations only run on the NCS simulator";
+      return false;
+    }
+#endif
+
     switch(operation.type) {
 
         case OperationType::RELU:
@@ -1424,6 +1589,27 @@ bool VpuPreparedModel::isOperationSupported(const Operation& operation, const Mo
           VLOG(MODEL) << "RESHAPE is supported operation "; //ANEURALNETWOKRS_RESHAPE
           break;
         }
+        case OperationType::ADD:
+        {
+          //the stick sums two tensors computed on it or given by the application,
+          //without broadcasting
+          const auto input1 = model.operands[operation.inputs[1]];
+          auto isConstant = [](const Operand& operand) {
+            return operand.lifetime == OperandLifeTime::CONSTANT_COPY ||
+                   operand.lifetime == OperandLifeTime::CONSTANT_REFERENCE;
+          };
+          if(isConstant(input) || isConstant(input1) || input.dimensions != input1.dimensions){
+            VLOG(MODEL) << "ADD of constant or broadcast operands is not supported operation ";
+            return false;
+          }
+#ifndef NCS_SIMULATOR
+          //the Elementwise Sum stage has only been run on the simulator
+          VLOG(MODEL) << "ADD only runs on the NCS simulator";
+          return false;
+#endif
+          VLOG(MODEL) << "ADD is supported operation ";
+          break;
+        }
 
         default:
            VLOG(MODEL) << getOperationName(operation.type) << " Operation not supported on VPU";
@@ -1565,13 +1751,19 @@ void VpuPreparedModel::deinitialize()
 {
     VLOG(MODEL) << "deinitialize";
     int val;
-    val = ncs_unload_graph();
-    if (val != 0)
-    VLOG(MODEL) << "unable to unload graph from NCS";
+    if(mGraphId >= 0){
+      val = ncs_unload_graph(mGraphId);
+      if (val != 0)
+      VLOG(MODEL) << "unable to unload graph from NCS";
+      mGraphId = -1;
+    }
 
-    val = ncs_deinit();
-    if (val != 0)
-    VLOG(MODEL) << "unable to deinitialize NCS device";
+    if(mDeviceOpen){
+      val = ncs_deinit();
+      if (val != 0)
+      VLOG(MODEL) << "unable to deinitialize NCS device";
+      mDeviceOpen = false;
+    }
 }
 
 void VpuPreparedModel::asyncExecute(const Request& request,
@@ -1583,14 +1775,13 @@ void VpuPreparedModel::asyncExecute(const Request& request,
     }
 
     VpuExecutor executor;
-    int n = executor.run(mModel, request, mPoolInfos, requestPoolInfos);
+    int n = executor.run(mModel, request, mPoolInfos, requestPoolInfos, mGraphId);
     ErrorStatus executionStatus =
             n == ANEURALNETWORKS_NO_ERROR ? ErrorStatus::NONE : ErrorStatus::GENERAL_FAILURE;
     Return<void> returned = callback->notify(executionStatus);
     if (!returned.isOk()) {
         LOG(ERROR) << " hidl callback failed to return properly: " << returned.description();
     }
-    VpuPreparedModel::network_count_ex = 0;
 }
 
 }  // namespace vpu_driver
@@ -17,7 +17,8 @@ LOCAL_SRC_FILES := \
 
 LOCAL_C_INCLUDES += \
 	$(LOCAL_PATH) \
-	$(LOCAL_PATH)/graphAPI
+	$(LOCAL_PATH)/graphAPI \
+	$(LOCAL_PATH)/cpuExtension
 
 LOCAL_C_INCLUDES += \
 	$(LOCAL_PATH)/../../dldt/inference-engine/thirdparty/pugixml/src \
@@ -77,7 +78,7 @@ LOCAL_SHARED_LIBRARIES := \
 	android.hidl.memory@1.0 \
 	libinference_engine
 
-LOCAL_STATIC_LIBRARIES := libgraphAPI libpugixml libneuralnetworks_common
+LOCAL_STATIC_LIBRARIES := libgraphAPI libhalCpuExtension libpugixml libneuralnetworks_common
 
 include $(BUILD_SHARED_LIBRARY)
 ###############################################################
@@ -114,6 +115,7 @@ ZPATH := $(LOCAL_PATH)
 include $(CLEAR_VARS)
 
 include $(ZPATH)/graphAPI/graphAPI.mk
+include $(ZPATH)/cpuExtension/cpuExtension.mk
 include $(ZPATH)/graphTests/graphTests.mk
 include $(ZPATH)/dl/Android.mk
 #include $(ZPATH)/ncsdk2/api/src/Android.mk
@@ -136,9 +136,10 @@ Return<void> Driver::getSupportedOperations(const Model& model, getSupportedOper
     }
 
 #ifndef AT_RUNTIME
+    TargetDevice device = mName.compare("CPU") == 0 ? TargetDevice::eCPU : TargetDevice::eMYRIAD;
     for (int i = 0; i < count; i++) {
         const auto& operation = model.operations[i];
-        supported[i] = PreparedModel::isOperationSupported(operation, model);
+        supported[i] = PreparedModel::isOperationSupported(operation, model, device);
     }
 #else
     for (int i = 0; i < count; i++) {
@@ -20,8 +20,12 @@
 #include <android-base/logging.h>
 #include <android/log.h>
 #include <log/log.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <fstream>
 #include <thread>
+#include <cutils/properties.h>
 #include "ValidateHal.h"
 
 #define DISABLE_ALL_QUANT
@@ -689,6 +693,83 @@ IRBlob::Ptr Permute(IRBlob::Ptr ptr, const vec<unsigned int>& order) {
     return ptr;
 }
 
+// Constant blob in the network precision built from host float data
+IRBlob::Ptr createFloatBlob(const TensorDims& dims, const std::vector<float>& data) {
+    TensorDesc td(IRBuilder::g_layer_precision, dims, Layout::ANY);
+    if (IRBuilder::g_layer_precision == InferenceEngine::Precision::FP16) {
+        InferenceEngine::TBlob<short>::Ptr blob =
+            std::make_shared<InferenceEngine::TBlob<short>>(td);
+        blob->allocate();
+        short* dst = blob->buffer().as<short*>();
+        for (size_t i = 0; i < blob->size(); i++) dst[i] = f32tof16(data[i]);
+        return blob;
+    }
+    InferenceEngine::TBlob<float>::Ptr blob = std::make_shared<InferenceEngine::TBlob<float>>(td);
+    blob->allocate();
+    std::copy(data.begin(), data.begin() + blob->size(), blob->buffer().as<float*>());
+    return blob;
+}
+
+// Constant blob in the network precision with every element set to value
+IRBlob::Ptr createConstBlob(const TensorDims& dims, float value) {
+    return createFloatBlob(dims, std::vector<float>(sizeOf(dims), value));
+}
+
+// Wraps an 8-bit model input as a U8 blob; 4-D NHWC data is reordered to NCHW
+// in bytes so the request is never widened to float on the host.
+Blob::Ptr createU8InputBlob(RunTimeOperandInfo& op, const uint8_t* buf, uint32_t& len) {
+    vec<unsigned int> order;
+    Layout layout;
+    if (op.dimensions.size() == 4) {
+        order = {0, 3, 1, 2};  // nhwc -> nchw
+        layout = Layout::NCHW;
+    } else if (op.dimensions.size() == 2) {
+        order = {0, 1};
+        layout = Layout::NC;
+    } else {
+        order = {0};
+        layout = Layout::C;
+    }
+
+    auto inputDims = toDims(op.dimensions);
+    TensorDesc td(InferenceEngine::Precision::U8, permuteDims(inputDims, order), layout);
+
+    if (buf == nullptr) {
+        VLOG(L1, "MODEL_INPUT buf is NULL !!!!!!!!!!!!!!!");
+        InferenceEngine::TBlob<uint8_t>::Ptr blob =
+            std::make_shared<InferenceEngine::TBlob<uint8_t>>(td);
+        blob->allocate();
+        return blob;
+    }
+    if (inputDims.size() != 4) {
+        return std::make_shared<InferenceEngine::TBlob<uint8_t>>(td, const_cast<uint8_t*>(buf),
+                                                                 len);
+    }
+
+    InferenceEngine::TBlob<uint8_t>::Ptr blob =
+        std::make_shared<InferenceEngine::TBlob<uint8_t>>(td);
+    blob->allocate();
+
+    size_t batch = inputDims[0];
+    size_t height = inputDims[1];
+    size_t width = inputDims[2];
+    size_t in_depth = inputDims[3];
+    uint8_t* dst = blob->buffer().as<uint8_t*>();
+    size_t offset = 0;
+    for (size_t b = 0; b < batch; b++) {
+        for (size_t i = 0; i < in_depth; i++) {
+            for (size_t h = 0; h < height; h++) {
+                for (size_t w = 0; w < width; w++) {
+                    size_t offset_nhwc =
+                        b * height * width * in_depth + h * width * in_depth + w * in_depth + i;
+                    dst[offset++] = buf[offset_nhwc];
+                }
+            }
+        }
+    }
+    return blob;
+}
+
 #define PARAM_I32(i) ParseOperationInput<int32_t>(mModel, operation, i)
 #define PARAM_FP(i) ParseOperationInput<float>(mModel, operation, i)
 
@@ -843,6 +924,93 @@ Blob::Ptr PreparedModel::GetInOutOperandAsBlob(RunTimeOperandInfo& op, const uin
     return nullptr;
 }
 
+// number of threads for convertConstOperands(), "nn.hal.prepare_threads" overrides the core count
+static size_t getPrepareThreadCount() {
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("nn.hal.prepare_threads", value, "") > 0) {
+        int n = atoi(value);
+        if (n > 0) return n;
+    }
+    unsigned int n = std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+bool PreparedModel::convertConstOperands() {
+    // one task per Get*AsTensor call the operation converters make, so every
+    // converter still gets a blob of its own as when converting inline
+    std::vector<std::pair<uint32_t, ConstOperandKind>> tasks;
+    for (const auto& operation : mModel.operations) {
+        switch (operation.type) {
+            case OperationType::CONV_2D:
+            case OperationType::FULLY_CONNECTED:
+                tasks.push_back(std::make_pair(operation.inputs[1], CONST_TENSOR));
+                tasks.push_back(std::make_pair(operation.inputs[2], CONST_TENSOR));
+                break;
+            case OperationType::DEPTHWISE_CONV_2D:
+                tasks.push_back(std::make_pair(operation.inputs[1], CONST_WEIGHTS));
+                tasks.push_back(std::make_pair(operation.inputs[2], CONST_TENSOR));
+                break;
+            case OperationType::ADD:
+                if (isConst(operation.inputs[0]))
+                    tasks.push_back(std::make_pair(operation.inputs[0], CONST_TENSOR));
+                else if (isConst(operation.inputs[1]))
+                    tasks.push_back(std::make_pair(operation.inputs[1], CONST_TENSOR));
+                break;
+            default:
+                break;
+        }
+    }
+    if (tasks.empty()) return true;
+
+    std::vector<Blob::Ptr> blobs(tasks.size());
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    auto worker = [&]() {
+        for (size_t i = next++; i < tasks.size(); i = next++) {
+            try {
+                blobs[i] = tasks[i].second == CONST_WEIGHTS
+                               ? GetConstWeightsOperandAsTensor(tasks[i].first)
+                               : GetConstOperandAsTensor(tasks[i].first);
+            } catch (const std::exception& ex) {
+                ALOGE("failed to convert const operand %u: %s", tasks[i].first, ex.what());
+                failed = true;
+            }
+        }
+    };
+
+    const size_t numThreads = std::min(getPrepareThreadCount(), tasks.size());
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < numThreads; t++) threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads) t.join();
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+
+    if (failed) return false;
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < tasks.size(); i++) {
+        if (blobs[i]) bytes += blobs[i]->byteSize();
+        mConstBlobs[std::make_pair(tasks[i].first, static_cast<int>(tasks[i].second))].push_back(
+            blobs[i]);
+    }
+    ALOGI("converted %zu const operands (%zu bytes) in %.1f ms on %zu threads", tasks.size(),
+          bytes, elapsed.count(), numThreads);
+    return true;
+}
+
+Blob::Ptr PreparedModel::takeConstOperand(uint32_t index, ConstOperandKind kind) {
+    auto it = mConstBlobs.find(std::make_pair(index, static_cast<int>(kind)));
+    if (it == mConstBlobs.end() || it->second.empty()) {
+        VLOG(L1, "const operand %d was not prepared, converting inline", index);
+        return kind == CONST_WEIGHTS ? GetConstWeightsOperandAsTensor(index)
+                                     : GetConstOperandAsTensor(index);
+    }
+    auto blob = it->second.back();
+    it->second.pop_back();
+    return blob;
+}
+
 OutputPort PreparedModel::getPort(int index) {
     VLOG(L1, "getPort\n");
     if (isConst(index)) {
@@ -866,6 +1034,8 @@ OutputPort PreparedModel::getPort(int index) {
         auto operandInfo = mNet.createInput(
             operandName.str(), permuteDims(toDims(op.dimensions), order));  // NHWC -> NCHW
         // auto operandInfo = mNet.createInput(operandName.str(), toDims(op.dimensions)); // NHWC
+        if (op.type == OperandType::TENSOR_QUANT8_ASYMM)
+            operandInfo->setInputPrecision(InferenceEngine::Precision::U8);
         mPorts[index] = operandInfo->getInputData();
         // mPorts[index]->setLayout(NHWC); // mPorts[i]->name
         // mPorts[index]->setPrecision(InferenceEngine::Precision::FP16);
@@ -946,7 +1116,9 @@ bool PreparedModel::initializeRunTimeOperandInfo() {
         }
 
         to.scale = from.scale;
-        nnAssert(from.zeroPoint == 0);
+        to.zeroPoint = from.zeroPoint;
+        // only 8-bit model inputs (folded into DEQUANTIZE) carry a zero point
+        nnAssert(from.zeroPoint == 0 || from.type == OperandType::TENSOR_QUANT8_ASYMM);
         switch (from.type) {
             case OperandType::TENSOR_FLOAT32:
             case OperandType::FLOAT32:
@@ -966,9 +1138,9 @@ bool PreparedModel::initializeRunTimeOperandInfo() {
                 VLOG(L1, "OperandType::TENSOR_INT32 and operand scale value = %.1f", to.scale);
                 break;
             case OperandType::TENSOR_QUANT8_ASYMM:
-                ALOGE("OperandType::TENSOR_QUANT8_ASYMM is not supported");
+                // passed to the plugin as U8, see operationDequantize()
                 nnAssert(to.scale != 0);
-                // to.type = VpuDataType::U8;
+                to.type = OperandType::TENSOR_QUANT8_ASYMM;
                 break;
             default:
                 ALOGE("wrong operand type %d", from.type);
@@ -1017,7 +1189,7 @@ bool PreparedModel::initialize() {
 
     // Check operation supoorted or not, user may not call getOpertionSupported()
     for (const auto& operation : mModel.operations) {
-        success = isOperationSupported(operation, mModel);
+        success = isOperationSupported(operation, mModel, mTargetDevice);
         dumpOperationSupport(operation, success);
         if (!success) {
             VLOG(L1, "get unsupported operation in initialize()");
@@ -1038,6 +1210,12 @@ bool PreparedModel::initialize() {
         return false;
     }
 
+    success = convertConstOperands();
+    if (!success) {
+        VLOG(L1, "convertConstOperands failed.");
+        return false;
+    }
+
     for (const auto& operation : mModel.operations) {
         VLOG(L1, "get operation %d ready to add", operation.type);
         dumpOperation(operation);
@@ -1084,12 +1262,33 @@ bool PreparedModel::initialize() {
             case OperationType::L2_NORMALIZATION:
                 success = operationL2Normalization(operation);
                 break;
+            case OperationType::LSTM:
+                success = operationLSTM(operation);
+                break;
             case OperationType::RESHAPE:
                 success = operationReshape(operation);
                 break;
             case OperationType::ADD:
                 success = operationAdd(operation);
                 break;
+            case OperationType::MUL:
+                success = operationMUL(operation);
+                break;
+            case OperationType::RESIZE_BILINEAR:
+                success = operationResizeBilinear(operation);
+                break;
+            case OperationType::DEPTH_TO_SPACE:
+                success = operationDepthToSpace(operation);
+                break;
+            case OperationType::SPACE_TO_DEPTH:
+                success = operationSpaceToDepth(operation);
+                break;
+            case OperationType::L2_POOL_2D:
+                success = operationL2Pool2D(operation);
+                break;
+            case OperationType::DEQUANTIZE:
+                success = operationDequantize(operation);
+                break;
             default:
                 VLOG(L1, "unsupported operation %d", operation.type);
                 return false;
@@ -1100,6 +1299,7 @@ bool PreparedModel::initialize() {
         }
         VLOG(L1, "convert operation %d success", operation.type);
     }
+    mConstBlobs.clear();
 
     initializeInput();
     finalizeOutput();
@@ -1190,6 +1390,11 @@ void PreparedModel::asyncExecute(const Request& request, const sp<IExecutionCall
         return;
     }
 
+    // the delay layers advance once per inference, so executions of a
+    // stateful model run one at a time from input binding to output copy
+    std::unique_lock<std::mutex> executionLock(mExecutionLock, std::defer_lock);
+    if (mStateful) executionLock.lock();
+
     // std::vector<IRBlob::Ptr> input;
     // std::vector<TBlob<float>::Ptr> output;
     auto inOutData = [this, &requestPoolInfos](const std::vector<uint32_t>& indexes,
@@ -1198,6 +1403,8 @@ void PreparedModel::asyncExecute(const Request& request, const sp<IExecutionCall
                                                std::vector<OutputPort> mPorts) {
         // do memcpy for input data
         for (size_t i = 0; i < indexes.size(); i++) {
+            // not bound to the network, e.g. recurrent state kept in delay layers
+            if (!mPorts[indexes[i]]) continue;
             RunTimeOperandInfo& operand = mOperands[indexes[i]];
             const RequestArgument& arg = arguments[i];
             auto poolIndex = arg.location.poolIndex;
@@ -1298,7 +1505,8 @@ void PreparedModel::asyncExecute(const Request& request, const sp<IExecutionCall
         const RunTimeOperandInfo& input = mOperands[mModel.inputIndexes[0]];
         InferenceEngine::TBlob<float>::Ptr inBlob =
             enginePtr->getBlob(mPorts[mModel.inputIndexes[0]]->name);
-        nelem = (inBlob->size() > 20 ? 20 : inBlob->size());
+        // U8 inputs are not float blobs
+        nelem = (inBlob == nullptr ? 0 : (inBlob->size() > 20 ? 20 : inBlob->size()));
         for (int i = 0; i < nelem; i++) {
             VLOG(L1, "inBlob elements %d = %f", i, inBlob->readOnly()[i]);
         }
@@ -1366,7 +1574,14 @@ T getOperandConstVal(const Model& model, const Operand& operand) {
     return data[0];
 }
 
-bool PreparedModel::isOperationSupported(const Operation& operation, const Model& model) {
+// highest rank the Reshape, Permute and Tile layers of the plugin accept,
+// the MYRIAD plugin handles 4-D tensors only
+static size_t maxLayerRank(TargetDevice device) {
+    return device == TargetDevice::eCPU ? 6 : 4;
+}
+
+bool PreparedModel::isOperationSupported(const Operation& operation, const Model& model,
+                                         TargetDevice device) {
     VLOG(L1, "Check operation %d", operation.type);
 
 #define VLOG_CHECKFAIL(fail) VLOG(L1, "Check failed: %s", fail)
@@ -1374,6 +1589,10 @@ bool PreparedModel::isOperationSupported(const Operation& operation, const Model
 #ifdef DISABLE_ALL_QUANT
     for (auto i : operation.inputs) {
         const auto input = model.operands[i];
+        // 8-bit model inputs are fed as U8 and dequantized inside the network
+        if (operation.type == OperationType::DEQUANTIZE &&
+            input.lifetime == OperandLifeTime::MODEL_INPUT)
+            continue;
         if (input.type == OperandType::TENSOR_QUANT8_ASYMM) {
             VLOG_CHECKFAIL("input quant");
             return false;
@@ -1474,9 +1693,18 @@ bool PreparedModel::isOperationSupported(const Operation& operation, const Model
         case OperationType::LOCAL_RESPONSE_NORMALIZATION:
         case OperationType::CONCATENATION:
         case OperationType::L2_NORMALIZATION:
-        case OperationType::RESHAPE:
             break;
 
+        case OperationType::RESHAPE: {
+            const auto& output = model.operands[operation.outputs[0]];
+            if (input0.dimensions.size() > maxLayerRank(device) ||
+                output.dimensions.size() > maxLayerRank(device)) {
+                VLOG_CHECKFAIL("reshape rank");
+                return false;
+            }
+            break;
+        }
+
         case OperationType::ADD: {
             const auto& input1 = model.operands[operation.inputs[1]];
             if (input0.dimensions != input1.dimensions) {
@@ -1489,6 +1717,159 @@ bool PreparedModel::isOperationSupported(const Operation& operation, const Model
             }
             break;
         }
+
+        case OperationType::MUL: {
+            const auto& input1 = model.operands[operation.inputs[1]];
+            auto isConstOperand = [](const Operand& operand) {
+                return operand.lifetime == OperandLifeTime::CONSTANT_COPY ||
+                       operand.lifetime == OperandLifeTime::CONSTANT_REFERENCE;
+            };
+            bool isIn0Const = isConstOperand(input0);
+            bool isIn1Const = isConstOperand(input1);
+            if (isIn0Const && isIn1Const) {
+                VLOG_CHECKFAIL("both mul inputs are const");
+                return false;
+            }
+            if (isIn0Const || isIn1Const) {
+                // scalar or one value per channel (last NHWC dim) of the other input
+                const auto& k = isIn0Const ? input0 : input1;
+                const auto& other = isIn0Const ? input1 : input0;
+                if (other.dimensions.size() == 3 || other.dimensions.size() > 4) {
+                    VLOG_CHECKFAIL("mul input rank");
+                    return false;
+                }
+                uint32_t nelem = 1;
+                for (auto d : k.dimensions) nelem *= d;
+                if (nelem != 1 && (nelem != other.dimensions.back() ||
+                                   k.dimensions.back() != other.dimensions.back())) {
+                    VLOG_CHECKFAIL("mul const is not scalar or per channel");
+                    return false;
+                }
+            } else {
+                if (input0.dimensions.size() != input1.dimensions.size()) {
+                    VLOG_CHECKFAIL("mul ranks not match");
+                    return false;
+                }
+                if (input0.dimensions.size() > maxLayerRank(device)) {
+                    VLOG_CHECKFAIL("mul rank");
+                    return false;
+                }
+                for (size_t i = 0; i < input0.dimensions.size(); i++) {
+                    uint32_t d0 = input0.dimensions[i], d1 = input1.dimensions[i];
+                    if (d0 != d1 && d0 != 1 && d1 != 1) {
+                        VLOG_CHECKFAIL("mul dims not broadcastable");
+                        return false;
+                    }
+                }
+            }
+            if (activationPass(inputn) == false) {
+                return false;
+            }
+            break;
+        }
+
+        case OperationType::RESIZE_BILINEAR: {
+            if (input0.dimensions.size() != 4) {
+                VLOG_CHECKFAIL("resize input must be 4-D");
+                return false;
+            }
+            break;
+        }
+
+        case OperationType::DEPTH_TO_SPACE:
+        case OperationType::SPACE_TO_DEPTH: {
+            if (input0.dimensions.size() != 4) {
+                VLOG_CHECKFAIL("input must be 4-D");
+                return false;
+            }
+            // lowered to a 6-D reshape and permute
+            if (maxLayerRank(device) < 6) {
+                VLOG_CHECKFAIL("6-D permute not supported by the device");
+                return false;
+            }
+            int32_t block = getOperandConstVal<int32_t>(model, model.operands[operation.inputs[1]]);
+            if (block < 1) {
+                VLOG_CHECKFAIL("block size");
+                return false;
+            }
+            if (operation.type == OperationType::DEPTH_TO_SPACE) {
+                if (input0.dimensions[3] % (block * block) != 0) {
+                    VLOG_CHECKFAIL("depth not divisible by block_size^2");
+                    return false;
+                }
+            } else if (input0.dimensions[1] % block != 0 || input0.dimensions[2] % block != 0) {
+                VLOG_CHECKFAIL("height/width not divisible by block_size");
+                return false;
+            }
+            break;
+        }
+
+        case OperationType::L2_POOL_2D: {
+            if (input0.dimensions.size() != 4) {
+                VLOG_CHECKFAIL("l2 pool input must be 4-D");
+                return false;
+            }
+            if (activationPass(inputn) == false) {
+                return false;
+            }
+            break;
+        }
+
+        case OperationType::LSTM: {
+            if (operation.inputs.size() != 23 || operation.outputs.size() != 4) {
+                VLOG_CHECKFAIL("lstm operand count");
+                return false;
+            }
+            if (input0.dimensions.size() != 2) {
+                VLOG_CHECKFAIL("lstm input must be 2-D");
+                return false;
+            }
+            // peephole connections are not mapped
+            for (int i = 9; i <= 11; i++) {
+                if (model.operands[operation.inputs[i]].lifetime != OperandLifeTime::NO_VALUE) {
+                    VLOG_CHECKFAIL("lstm peephole");
+                    return false;
+                }
+            }
+            // weights and biases are folded into the network at prepare time
+            for (int i = 1; i <= 17; i++) {
+                const auto& operand = model.operands[operation.inputs[i]];
+                if (operand.lifetime != OperandLifeTime::NO_VALUE &&
+                    operand.lifetime != OperandLifeTime::CONSTANT_COPY &&
+                    operand.lifetime != OperandLifeTime::CONSTANT_REFERENCE) {
+                    VLOG_CHECKFAIL("lstm weights not const");
+                    return false;
+                }
+            }
+            // the state lives in delay layers, it can only be replaced if nobody computes it
+            for (int i = 18; i <= 19; i++) {
+                if (model.operands[operation.inputs[i]].lifetime != OperandLifeTime::MODEL_INPUT) {
+                    VLOG_CHECKFAIL("lstm state is not a model input");
+                    return false;
+                }
+            }
+            const auto& activation = model.operands[operation.inputs[20]];
+            int32_t act = getOperandConstVal<int32_t>(model, activation);
+            if (act != 1 && act != 3 && act != 4 && act != 6) {
+                VLOG_CHECKFAIL("lstm activation");
+                return false;
+            }
+            break;
+        }
+
+        case OperationType::DEQUANTIZE: {
+            // only the U8 input path, dequantize of intermediate tensors is not mapped
+            if (input0.type != OperandType::TENSOR_QUANT8_ASYMM ||
+                input0.lifetime != OperandLifeTime::MODEL_INPUT) {
+                VLOG_CHECKFAIL("dequantize input is not a quant8 model input");
+                return false;
+            }
+            if (input0.dimensions.size() != 4 && input0.dimensions.size() != 2) {
+                VLOG_CHECKFAIL("dequantize input rank");
+                return false;
+            }
+            break;
+        }
         default:
             VLOG(L1, "unsupport opration %d", operation.type);
             return false;
@@ -1524,10 +1905,10 @@ bool PreparedModel::operationAdd(const Operation& operation) {
         // this will use ScaleShift
         if (isIn0Const)  // if op.inputs[1] is a Model input
             out = AddConst(mNet, getPort(operation.inputs[1]),
-                           GetConstOperandAsTensor(operation.inputs[0]));
+                           takeConstOperand(operation.inputs[0], CONST_TENSOR));
         else  // isIn1Const is const //op.inputs[0] is a Model input
             out = AddConst(mNet, getPort(operation.inputs[0]),
-                           GetConstOperandAsTensor(operation.inputs[1]));
+                           takeConstOperand(operation.inputs[1], CONST_TENSOR));
     } else {  // both inputs[0] & inputs[1] are model inputs
         out = getPort(operation.inputs[0]) + getPort(operation.inputs[1]);
     }
@@ -1905,9 +2286,9 @@ bool PreparedModel::operationConv2D(const Operation& operation) {
     ***/
 
     auto input = getPort(operation.inputs[0]);
-    auto filter = GetConstOperandAsTensor(operation.inputs[1]);  // OIHW
+    auto filter = takeConstOperand(operation.inputs[1], CONST_TENSOR);  // OIHW
     // auto filter = GetConstWeightsOperandAsTensor(operation.inputs[1]);
-    auto bias = GetConstOperandAsTensor(operation.inputs[2]);
+    auto bias = takeConstOperand(operation.inputs[2], CONST_TENSOR);
 
     const auto inputDims = input->getTensorDesc().getDims();
     const auto filterDims = filter->getTensorDesc().getDims();
@@ -2171,9 +2552,9 @@ bool PreparedModel::operationDepthwiseConv2D(const Operation& operation) {
     auto input = getPort(operation.inputs[0]);
     // auto filter = GetConstOperandAsTensor(operation.inputs[1]); //NCHW [1, depth_out,
     // filter_height, filter_width]
-    auto filter = GetConstWeightsOperandAsTensor(
-        operation.inputs[1]);  //[depth_out, 1, filter_height, filter_width] OIHW
-    auto bias = GetConstOperandAsTensor(operation.inputs[2]);
+    auto filter = takeConstOperand(
+        operation.inputs[1], CONST_WEIGHTS);  //[depth_out, 1, filter_height, filter_width] OIHW
+    auto bias = takeConstOperand(operation.inputs[2], CONST_TENSOR);
 
     const auto inputDims = input->getTensorDesc().getDims();
     const auto filterDims = filter->getTensorDesc().getDims();
@@ -2396,8 +2777,8 @@ bool PreparedModel::operationFullyConnected(const Operation& operation) {
      */
 
     auto input = getPort(operation.inputs[0]);
-    auto weights = GetConstOperandAsTensor(operation.inputs[1]);
-    auto bias = GetConstOperandAsTensor(operation.inputs[2]);
+    auto weights = takeConstOperand(operation.inputs[1], CONST_TENSOR);
+    auto bias = takeConstOperand(operation.inputs[2], CONST_TENSOR);
 
     auto inputDims = input->getTensorDesc().getDims();
     for (auto i = 0; i < inputDims.size(); i++) VLOG(L1, "input dims[%d] = %d ", i, inputDims[i]);
@@ -2558,18 +2939,315 @@ bool PreparedModel::operationLogisticSigmoid(const Operation& operation) {
 
     return true;
 }
-/*
-bool PreparedModel::operationLSTM(const Operation& operation)
-{
-    VLOG("operation type LSTM is supported, but not yet in this implementation");
-    nnAssert(true);
+bool PreparedModel::operationLSTM(const Operation& operation) {
+    VLOG(L1, "OperationType::LSTM");
+
+    /*
+     * Inputs:
+     * 0: input, [batch_size, input_size]
+     * 1-4: input_to_{input, forget, cell, output}_weights, [num_units, input_size],
+     *      input_to_input_weights is optional (CIFG)
+     * 5-8: recurrent_to_{input, forget, cell, output}_weights, [num_units, output_size]
+     * 9-11: cell_to_{input, forget, output}_weights, peephole, not supported
+     * 12-15: {input_gate, forget_gate, cell, output_gate}_bias, [num_units]
+     * 16: projection_weights, optional, [output_size, num_units]
+     * 17: projection_bias, optional, [output_size]
+     * 18: output_state_in, [batch_size, output_size]
+     * 19: cell_state_in, [batch_size, num_units]
+     * 20: activation, 21: cell_clip, 22: proj_clip
+     *
+     * Outputs:
+     * 0: scratch_buffer, 1: output_state_out, 2: cell_state_out, 3: output
+     *
+     * The recurrent state is kept on the device in a pair of delay (Memory)
+     * layers, so output_state_in/cell_state_in are never bound to the request:
+     * the state starts at zero when the model is prepared and carries over
+     * from one execution to the next. Executions of such a model are
+     * serialized, so the state advances once per execution whatever the
+     * number of callers. The four gates are computed by a single
+     * FullyConnected over [input, output_state] and split afterwards.
+     */
+    const auto& ins = operation.inputs;
+    const auto& outs = operation.outputs;
+
+    bool cifg = mOperands[ins[1]].lifetime == OperandLifeTime::NO_VALUE;
+    uint32_t batch = mOperands[ins[0]].dimensions[0];
+    uint32_t input_size = mOperands[ins[0]].dimensions[1];
+    uint32_t num_units = mOperands[ins[2]].dimensions[0];
+    uint32_t output_size = mOperands[ins[6]].dimensions[1];
+    int32_t activation = PARAM_I32(20);
+    float cell_clip = PARAM_FP(21);
+    float proj_clip = PARAM_FP(22);
+
+    VLOG(L1, "batch %d input_size %d num_units %d output_size %d cifg %d", batch, input_size,
+         num_units, output_size, cifg);
+
+    // input weights, recurrent weights and bias of each gate, in the order of the split below
+    struct Gate {
+        uint32_t input, recurrent, bias;
+    };
+    std::vector<Gate> gates;
+    if (!cifg) gates.push_back({1, 5, 12});
+    gates.push_back({2, 6, 13});
+    gates.push_back({3, 7, 14});
+    gates.push_back({4, 8, 15});
+
+    const size_t row = input_size + output_size;
+    std::vector<float> weights(gates.size() * num_units * row);
+    std::vector<float> bias(gates.size() * num_units);
+    for (size_t g = 0; g < gates.size(); g++) {
+        const float* wx = reinterpret_cast<const float*>(mOperands[ins[gates[g].input]].buffer);
+        const float* wh =
+            reinterpret_cast<const float*>(mOperands[ins[gates[g].recurrent]].buffer);
+        const float* b = reinterpret_cast<const float*>(mOperands[ins[gates[g].bias]].buffer);
+        for (size_t u = 0; u < num_units; u++) {
+            float* dst = &weights[(g * num_units + u) * row];
+            std::copy(wx + u * input_size, wx + (u + 1) * input_size, dst);
+            std::copy(wh + u * output_size, wh + (u + 1) * output_size, dst + input_size);
+        }
+        std::copy(b, b + num_units, &bias[g * num_units]);
+    }
+
+    auto activate = [&activation](const OutputPort& in) -> OutputPort {
+        switch (activation) {
+            case 1:
+                return ReLU(in);
+            case 3:
+                return Clamp(in, 0, 6);
+            case 4:
+                return Tanh(in);
+            case 6:
+                return Sigmoid(in);
+            default:
+                return in;
+        }
+    };
+
+    std::ostringstream stateName;
+    stateName << "lstm" << outs[0];
+    auto delayH = mNet.createDelay(stateName.str() + "-h", {batch, output_size});
+    auto delayC = mNet.createDelay(stateName.str() + "-c", {batch, num_units});
+    auto hPrev = output(delayH.out_t_1);
+    auto cPrev = output(delayC.out_t_1);
+    mStateful = true;
+
+    TensorDims weightsDims = {gates.size() * num_units, row};
+    TensorDims biasDims = {gates.size() * num_units};
+    auto fused = createFloatBlob(weightsDims, weights) * Concat({getPort(ins[0]), hPrev}, 1) +
+                 createFloatBlob(biasDims, bias);
+    auto split = Split(fused, gates.size(), 1);
+
+    size_t k = 0;
+    OutputPort inputGate = cifg ? nullptr : Sigmoid(split[k++]);
+    auto forgetGate = Sigmoid(split[k++]);
+    auto cellGate = activate(split[k++]);
+    auto outputGate = Sigmoid(split[k++]);
+    if (cifg) {
+        // input_gate = 1 - forget_gate
+        inputGate = ScaleShiftNode(forgetGate, createConstBlob({num_units}, -1.0f),
+                                   createConstBlob({num_units}, 1.0f));
+    }
+
+    auto cell = forgetGate * cPrev + inputGate * cellGate;
+    if (cell_clip > 0) cell = Clamp(cell, -cell_clip, cell_clip);
+
+    auto out = outputGate * activate(cell);
+    if (mOperands[ins[16]].lifetime != OperandLifeTime::NO_VALUE) {
+        const float* wp = reinterpret_cast<const float*>(mOperands[ins[16]].buffer);
+        std::vector<float> projection(wp, wp + output_size * num_units);
+        out = createFloatBlob({output_size, num_units}, projection) * out;
+        if (mOperands[ins[17]].lifetime != OperandLifeTime::NO_VALUE) {
+            const float* bp = reinterpret_cast<const float*>(mOperands[ins[17]].buffer);
+            out = out + createFloatBlob({output_size}, std::vector<float>(bp, bp + output_size));
+        }
+        if (proj_clip > 0) out = Clamp(out, -proj_clip, proj_clip);
+    }
+
+    cell >> delayC.in_t;
+    out >> delayH.in_t;
+
+    mPorts[outs[2]] = cell;
+    mPorts[outs[3]] = out;
+    // output_state_out equals output, but a model output needs a port of its own
+    if (mOperands[outs[1]].lifetime == OperandLifeTime::MODEL_OUTPUT)
+        mPorts[outs[1]] = ScaleShiftNode(out, createConstBlob({output_size}, 1.0f),
+                                         createConstBlob({output_size}, 0.0f));
+    else
+        mPorts[outs[1]] = out;
+    // the scratch buffer (outs[0]) is internal to the network and left unbound
 
-    //return true;
+    return true;
 }
-*/
+
 bool PreparedModel::operationMUL(const Operation& operation) {
-    mPorts[operation.outputs[0]] =
-        handleFusion(getPort(operation.inputs[0]) * getPort(operation.inputs[1]), PARAM_I32(2));
+    VLOG(L1, "OperationType::MUL");
+
+    /*
+     * Inputs:
+     * 0: A tensor.
+     * 1: A tensor of the same type, and compatible dimensions as input0.
+     * 2: An INT32 value, and has to be one of the {@link FusedActivationFunc} values.
+     *    Specifies the activation to invoke on the result of each multiplication.
+     *
+     * A constant operand (scalar or one value per channel) becomes a ScaleShift,
+     * two tensors are tiled along their size 1 axes and multiplied elementwise.
+     */
+    OutputPort out;
+    bool isIn0Const = isConst(operation.inputs[0]);
+    bool isIn1Const = isConst(operation.inputs[1]);
+    VLOG(L1, "isIn0Const = %d isIn1Const = %d \n", isIn0Const, isIn1Const);
+    if (isIn0Const || isIn1Const) {
+        uint32_t constIndex = isIn0Const ? operation.inputs[0] : operation.inputs[1];
+        auto input = getPort(isIn0Const ? operation.inputs[1] : operation.inputs[0]);
+        auto inDims = input->getTensorDesc().getDims();
+        size_t channels = inDims.size() > 1 ? inDims[1] : inDims[0];
+
+        uint32_t len;
+        const float* buf =
+            reinterpret_cast<const float*>(GetOperandMemory(mModel, constIndex, len));
+        uint32_t nelem = getNumberOfElements(mModel.operands[constIndex].dimensions);
+        std::vector<float> scale(channels);
+        for (size_t c = 0; c < channels; c++) scale[c] = buf[nelem == 1 ? 0 : c];
+        out = ScaleShiftNode(input, createFloatBlob({channels}, scale), nullptr);
+    } else {
+        out = BroadcastMul(getPort(operation.inputs[0]), getPort(operation.inputs[1]));
+    }
+    mPorts[operation.outputs[0]] = handleFusion(out, PARAM_I32(2));
+    return true;
+}
+
+bool PreparedModel::operationResizeBilinear(const Operation& operation) {
+    VLOG(L1, "OperationType::RESIZE_BILINEAR");
+
+    /*
+     * Inputs:
+     * 0: A 4-D tensor, of shape [batches, height, width, depth], specifying the input.
+     * 1: An INT32 value, specifying the output width of the output tensor.
+     * 2: An INT32 value, specifying the output height of the output tensor.
+     *
+     * Outputs:
+     * 0: The output 4-D tensor, of shape [batches, new_height, new_width, depth].
+     */
+    int32_t width = PARAM_I32(1);
+    int32_t height = PARAM_I32(2);
+    mPorts[operation.outputs[0]] = Interp(getPort(operation.inputs[0]), height, width);
+    return true;
+}
+
+bool PreparedModel::operationDepthToSpace(const Operation& operation) {
+    VLOG(L1, "OperationType::DEPTH_TO_SPACE");
+
+    /*
+     * Inputs:
+     * 0: A 4-D tensor, of shape [batches, height, width, depth_in], specifying the input.
+     * 1: An INT32 value, specifying the block_size. depth_in must be divisible by
+     *    block_size * block_size.
+     *
+     * Outputs:
+     * 0: The output 4-D tensor, of shape [batch, height*block_size, width*block_size,
+     *    depth/(block_size*block_size)].
+     */
+    mPorts[operation.outputs[0]] = DepthToSpace(getPort(operation.inputs[0]), PARAM_I32(1));
+    return true;
+}
+
+bool PreparedModel::operationSpaceToDepth(const Operation& operation) {
+    VLOG(L1, "OperationType::SPACE_TO_DEPTH");
+
+    /*
+     * Inputs:
+     * 0: A 4-D tensor, of shape [batches, height, width, depth_in], specifying the input.
+     * 1: An INT32 value, specifying the block_size. height and width must be divisible
+     *    by block_size.
+     *
+     * Outputs:
+     * 0: The output 4-D tensor, of shape [batch, height/block_size, width/block_size,
+     *    depth*block_size*block_size].
+     */
+    mPorts[operation.outputs[0]] = SpaceToDepth(getPort(operation.inputs[0]), PARAM_I32(1));
+    return true;
+}
+
+bool PreparedModel::operationL2Pool2D(const Operation& operation) {
+    VLOG(L1, "OperationType::L2_POOL_2D");
+
+    /*
+     * Same inputs as AVERAGE_POOL_2D, explicit (10 inputs) or implicit (7 inputs)
+     * padding, the last input is the fused activation.
+     */
+    auto input = getPort(operation.inputs[0]);
+    const auto indims = input->getTensorDesc().getDims();
+
+    Point2D pad_start;
+    Point2D pad_end;
+    Point2D stride;
+    Point2D kernel;
+    std::string padType;
+    int fusion_index = -1;
+
+    if (operation.inputs.size() == 10) {
+        padType = "explicit";
+        pad_start = {PARAM_I32(1), PARAM_I32(3)};
+        pad_end = {PARAM_I32(2), PARAM_I32(4)};
+        stride = {PARAM_I32(5), PARAM_I32(6)};
+        kernel = {PARAM_I32(7), PARAM_I32(8)};
+        fusion_index = 9;
+    } else if (operation.inputs.size() == 7) {  // implicit padding
+        const auto pad_type = PARAM_I32(1);
+        int stride_width = PARAM_I32(2);
+        int stride_height = PARAM_I32(3);
+        int filter_width = PARAM_I32(4);
+        int filter_height = PARAM_I32(5);
+        fusion_index = 6;
+        stride = {stride_width, stride_height};
+        kernel = {filter_width, filter_height};
+
+        if (pad_type == kPaddingSame) {
+            int padding_left, padding_right;
+            int padding_top, padding_bottom;
+            calculateExplicitPadding(indims[3], stride_width, filter_width, pad_type,
+                                     &padding_left, &padding_right);
+            calculateExplicitPadding(indims[2], stride_height, filter_height, pad_type,
+                                     &padding_top, &padding_bottom);
+            pad_start = {padding_left, padding_top};
+            pad_end = {padding_right, padding_bottom};
+            padType = "same_upper";
+        } else if (pad_type == kPaddingValid) {
+            pad_start = {0, 0};
+            pad_end = {0, 0};
+            padType = "valid";
+        }
+    }
+
+    auto out = L2Pooling(input, kernel, stride, pad_start, pad_end, padType);
+    mPorts[operation.outputs[0]] = handleFusion(out, PARAM_I32(fusion_index));
+    return true;
+}
+
+bool PreparedModel::operationDequantize(const Operation& operation) {
+    VLOG(L1, "OperationType::DEQUANTIZE");
+
+    /*
+     * Inputs:
+     * 0: A tensor of {@link OperandType::TENSOR_QUANT8_ASYMM}, the U8 model input.
+     *
+     * Outputs:
+     * 0: The output tensor of same shape as input0, but with type
+     *    {@link OperandType::TENSOR_FLOAT32}.
+     *
+     * output = (input - zeroPoint) * scale is folded into a ScaleShift that
+     * follows the U8 input, the same mean/scale normalization an image
+     * pipeline would do on the host.
+     */
+    const auto& quant = mOperands[operation.inputs[0]];
+    auto input = getPort(operation.inputs[0]);
+    auto inDims = input->getTensorDesc().getDims();
+    TensorDims channels = {inDims.size() > 1 ? inDims[1] : inDims[0]};
+
+    VLOG(L1, "dequantize scale %f zeroPoint %d", quant.scale, quant.zeroPoint);
+    auto scale = createConstBlob(channels, quant.scale);
+    auto shift = createConstBlob(channels, -quant.scale * quant.zeroPoint);
+    mPorts[operation.outputs[0]] = ScaleShiftNode(input, scale, shift);
     return true;
 }
 
@@ -2785,6 +3463,8 @@ bool PreparedModel::operationTANH(const Operation& operation) {
 void PreparedModel::initializeInput() {
     VLOG(L1, "initialize Input");
     for (auto i : mModel.inputIndexes) {
+        // inputs replaced by network state (LSTM) have no port
+        if (!mPorts[i]) continue;
         int dims_size = mOperands[i].dimensions.size();
 
         /*
@@ -2832,6 +3512,8 @@ void PreparedModel::initializeInput() {
 void PreparedModel::finalizeOutput(/*RunTimeOperandInfo* output */) {
     VLOG(L1, "finalize Output");
     for (auto i : mModel.outputIndexes) {
+        // scratch outputs (LSTM) are not produced by the network
+        if (!mPorts[i]) continue;
         int dims_size = mOperands[i].dimensions.size();
 
         /*
@@ -3142,6 +3824,12 @@ IRBlob::Ptr VpuPreparedModel::GetConstOperandAsTensor(uint32_t index) {
 
 Blob::Ptr VpuPreparedModel::GetInOutOperandAsBlob(RunTimeOperandInfo& op, const uint8_t* buf,
                                                   uint32_t& len) {
+    if (op.type == OperandType::TENSOR_QUANT8_ASYMM &&
+        op.lifetime == OperandLifeTime::MODEL_INPUT) {
+        VLOG(L1, "Create U8 input blob");
+        return createU8InputBlob(op, buf, len);
+    }
+
     // const auto op = model.operands[index];
     // uint32_t len;
     // const uint8_t *buf = GetOperandMemory(model, index, len);
@@ -3536,6 +4224,12 @@ IRBlob::Ptr CpuPreparedModel::GetConstOperandAsTensor(uint32_t index) {
 
 Blob::Ptr CpuPreparedModel::GetInOutOperandAsBlob(RunTimeOperandInfo& op, const uint8_t* buf,
                                                   uint32_t& len) {
+    if (op.type == OperandType::TENSOR_QUANT8_ASYMM &&
+        op.lifetime == OperandLifeTime::MODEL_INPUT) {
+        VLOG(L1, "Create U8 input blob");
+        return createU8InputBlob(op, buf, len);
+    }
+
     if (op.type == OperandType::TENSOR_FLOAT32 || op.type == OperandType::FLOAT32) {
         if (op.lifetime == OperandLifeTime::MODEL_INPUT) {
             VLOG(L1, "Create input blob !!!!");
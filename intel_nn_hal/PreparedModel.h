@@ -24,6 +24,8 @@
 #include <sys/mman.h>
 #include <string>
 #include <fstream>
+#include <map>
+#include <mutex>
 
 #include "IENetwork.h"
 
@@ -109,12 +111,12 @@ bool setRunTimePoolInfosFromHidlMemories(std::vector<RunTimePoolInfo>* poolInfos
 class PreparedModel : public IPreparedModel {
 public:
     PreparedModel(const Model& model)
-          :mTargetDevice(TargetDevice::eMYRIAD), mModel(model), mNet("nnNet"), enginePtr(nullptr) {
+          :mTargetDevice(TargetDevice::eMYRIAD), mModel(model), mNet("nnNet"), enginePtr(nullptr), mStateful(false) {
         IRBuilder::g_layer_precision = InferenceEngine::Precision::FP16;
     }
 
     PreparedModel(const TargetDevice device, const Model& model)
-          :mTargetDevice(device), mModel(model), mNet("nnNet"), enginePtr(nullptr) {
+          :mTargetDevice(device), mModel(model), mNet("nnNet"), enginePtr(nullptr), mStateful(false) {
         if (mTargetDevice == TargetDevice::eCPU)
            IRBuilder::g_layer_precision = InferenceEngine::Precision::FP32;
            //using type = typename InferenceEngine::PrecisionTrait<IRBuilder::g_layer_precision>::value_type;
@@ -128,7 +130,8 @@ public:
     bool initialize();
     Return<ErrorStatus> execute(const Request& request,
                                 const sp<IExecutionCallback>& callback) override;
-    static bool isOperationSupported(const Operation& operation, const Model& model);
+    static bool isOperationSupported(const Operation& operation, const Model& model,
+                                     TargetDevice device = TargetDevice::eMYRIAD);
 
 protected:
     void deinitialize();
@@ -139,19 +142,24 @@ protected:
     bool operationAveragePool2D(const Operation& operation);
     bool operationConCat(const Operation& operation);
     bool operationConv2D(const Operation& operation);
+    bool operationDepthToSpace(const Operation& operation);
     bool operationDepthwiseConv2D(const Operation& operation);
+    bool operationDequantize(const Operation& operation);
     bool operationFullyConnected(const Operation& operation);
     bool operationL2Normalization(const Operation& operation);
+    bool operationL2Pool2D(const Operation& operation);
     bool operationLRN(const Operation& operation);
     bool operationMaxPool2D(const Operation& operation);
     bool operationLogisticSigmoid(const Operation& operation);
-    //bool operationLSTM(const Operation& operation);
+    bool operationLSTM(const Operation& operation);
     bool operationMUL(const Operation& operation);
     bool operationRELU(const Operation& operation);
     bool operationRELU1(const Operation& operation);
     bool operationRELU6(const Operation& operation);
     bool operationReshape(const Operation& operation);
+    bool operationResizeBilinear(const Operation& operation);
     bool operationSoftmax(const Operation& operation);
+    bool operationSpaceToDepth(const Operation& operation);
     bool operationTANH(const Operation& operation);
 
     void initializeInput();
@@ -172,6 +180,11 @@ protected:
     virtual Blob::Ptr GetConstOperandAsTensor(uint32_t index);
     virtual Blob::Ptr GetInOutOperandAsBlob(RunTimeOperandInfo& op, const uint8_t *buf, uint32_t& len);
     virtual Blob::Ptr GetConstWeightsOperandAsTensor(uint32_t index);
+    // const weights/biases are converted on a thread pool before the IR is assembled,
+    // the operation converters take the prepared blobs instead of converting inline
+    enum ConstOperandKind { CONST_TENSOR, CONST_WEIGHTS };
+    bool convertConstOperands();
+    Blob::Ptr takeConstOperand(uint32_t index, ConstOperandKind kind);
     void SetOperandMemory(const Model &model, uint32_t index, uint32_t &len_out, const uint8_t *buf);
     void SetOperandFromTensor(uint8_t* buf, uint32_t &length, Blob::Ptr infOutput);
     bool isConst(int index);
@@ -183,7 +196,12 @@ protected:
     std::vector<RunTimePoolInfo> mPoolInfos;
     IRDocument mNet;
     std::vector<OutputPort> mPorts;  //typedef std::shared_ptr<Data> DataPtr;
+    std::map<std::pair<uint32_t, int>, std::vector<Blob::Ptr>> mConstBlobs;
     ExecuteNetwork* enginePtr;
+    // set when the network keeps state in delay layers; executions of such
+    // a model must not interleave on the shared infer request
+    bool mStateful;
+    std::mutex mExecutionLock;
 
 };
 
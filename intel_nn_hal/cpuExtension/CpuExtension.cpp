@@ -0,0 +1,502 @@
+// Copyright (c) 2017-2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#define LOG_TAG "CpuExtension"
+
+#include "CpuExtension.h"
+
+#include <ie_layers.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <sstream>
+
+#include <cutils/properties.h>
+#include <log/log.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace InferenceEngine {
+namespace Extensions {
+namespace Hal {
+
+namespace {
+
+const char *kLayerTypesProperty = "nn.hal.cpu_extension";
+
+void setError(ResponseDesc *resp, const std::string &msg) {
+    ALOGE("%s", msg.c_str());
+    if (resp) {
+        std::strncpy(resp->msg, msg.c_str(), sizeof(resp->msg) - 1);
+        resp->msg[sizeof(resp->msg) - 1] = 0;
+    }
+}
+
+size_t product(const SizeVector &dims, size_t begin, size_t end) {
+    size_t n = 1;
+    for (size_t i = begin; i < end && i < dims.size(); i++) n *= dims[i];
+    return n;
+}
+
+bool isFP32(const Blob::Ptr &blob) {
+    return blob && blob->precision() == Precision::FP32;
+}
+
+// y = min(max(x, lo), hi) over a contiguous range, src and dst may alias
+void clampKernel(const float *src, float *dst, size_t n, float lo, float hi) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 vlo = _mm_set1_ps(lo);
+    const __m128 vhi = _mm_set1_ps(hi);
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(src + i);
+        _mm_storeu_ps(dst + i, _mm_min_ps(_mm_max_ps(v, vlo), vhi));
+    }
+#endif
+    for (; i < n; i++) dst[i] = std::min(std::max(src[i], lo), hi);
+}
+
+// y = x * scale + shift over a contiguous range, src and dst may alias
+void scaleShiftKernel(const float *src, float *dst, size_t n, float scale, float shift) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 vs = _mm_set1_ps(scale);
+    const __m128 vb = _mm_set1_ps(shift);
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(src + i);
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_mul_ps(v, vs), vb));
+    }
+#endif
+    for (; i < n; i++) dst[i] = src[i] * scale + shift;
+}
+
+// acc[i] += x[i] * x[i]
+void accumulateSquares(const float *src, float *acc, size_t n) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(src + i);
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(v, v)));
+    }
+#endif
+    for (; i < n; i++) acc[i] += src[i] * src[i];
+}
+
+// sum of x[i] * x[i]
+float sumSquares(const float *src, size_t n) {
+    size_t i = 0;
+    float sum = 0.f;
+#if defined(__SSE2__)
+    __m128 vacc = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(src + i);
+        vacc = _mm_add_ps(vacc, _mm_mul_ps(v, v));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, vacc);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; i < n; i++) sum += src[i] * src[i];
+    return sum;
+}
+
+// dst[i] = src[i] * norm[i] * scale
+void mulKernel(const float *src, const float *norm, float *dst, size_t n, float scale) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 vs = _mm_set1_ps(scale);
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(src + i), _mm_loadu_ps(norm + i));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(v, vs));
+    }
+#endif
+    for (; i < n; i++) dst[i] = src[i] * norm[i] * scale;
+}
+
+/**
+ * Common part of the kernels: FP32 planar in/out configuration. A kernel that
+ * finds the layer unsupported sets _error, the factory then declines the layer
+ * and the plugin keeps its own implementation.
+ */
+class HalKernel : public ILayerExecImpl {
+public:
+    explicit HalKernel(const CNNLayer *layer) : _layer(layer) {}
+
+    const std::string &error() const { return _error; }
+
+    StatusCode getSupportedConfigurations(std::vector<LayerConfig> &conf,
+                                          ResponseDesc *resp) noexcept override {
+        if (!_error.empty()) {
+            setError(resp, _error);
+            return GENERAL_ERROR;
+        }
+        LayerConfig config;
+        config.dynBatchSupport = false;
+        for (auto &in : _layer->insData) {
+            DataConfig dataConfig;
+            auto dims = in.lock()->getTensorDesc().getDims();
+            dataConfig.desc = TensorDesc(Precision::FP32, dims, TensorDesc::getLayoutByDims(dims));
+            config.inConfs.push_back(dataConfig);
+        }
+        for (auto &out : _layer->outData) {
+            DataConfig dataConfig;
+            auto dims = out->getTensorDesc().getDims();
+            dataConfig.inPlace = _inPlace ? 0 : -1;
+            dataConfig.desc = TensorDesc(Precision::FP32, dims, TensorDesc::getLayoutByDims(dims));
+            config.outConfs.push_back(dataConfig);
+        }
+        conf.push_back(config);
+        return OK;
+    }
+
+    StatusCode init(LayerConfig &config, ResponseDesc *resp) noexcept override {
+        for (auto &in : config.inConfs) {
+            if (in.desc.getPrecision() != Precision::FP32) {
+                setError(resp, _layer->name + ": only FP32 inputs are supported");
+                return GENERAL_ERROR;
+            }
+        }
+        return OK;
+    }
+
+protected:
+    const CNNLayer *_layer;
+    std::string _error;
+    bool _inPlace = false;
+};
+
+class ClampKernel : public HalKernel {
+public:
+    explicit ClampKernel(const CNNLayer *layer) : HalKernel(layer) {
+        _inPlace = true;
+        _min = layer->GetParamAsFloat("min");
+        _max = layer->GetParamAsFloat("max");
+        if (_min > _max) _error = layer->name + ": Clamp min > max";
+    }
+
+    StatusCode execute(std::vector<Blob::Ptr> &inputs, std::vector<Blob::Ptr> &outputs,
+                       ResponseDesc *resp) noexcept override {
+        const float *src = inputs[0]->cbuffer().as<const float *>() +
+                           inputs[0]->getTensorDesc().getBlockingDesc().getOffsetPadding();
+        float *dst = outputs[0]->buffer().as<float *>() +
+                     outputs[0]->getTensorDesc().getBlockingDesc().getOffsetPadding();
+        clampKernel(src, dst, outputs[0]->size(), _min, _max);
+        return OK;
+    }
+
+private:
+    float _min = 0.f;
+    float _max = 0.f;
+};
+
+/**
+ * SSD style Normalize (L2 normalization), NCHW/NC input.
+ * across_spatial: one norm per batch item, otherwise one norm per position
+ * computed across channels. Missing weights mean a scale of 1.
+ */
+class NormalizeKernel : public HalKernel {
+public:
+    explicit NormalizeKernel(const CNNLayer *layer) : HalKernel(layer) {
+        _acrossSpatial = layer->GetParamAsBool("across_spatial", false);
+        _channelShared = layer->GetParamAsBool("channel_shared", false);
+        _eps = layer->GetParamAsFloat("eps", 1e-10f);
+
+        auto it = layer->blobs.find("weights");
+        if (it != layer->blobs.end() && it->second) {
+            if (!isFP32(it->second)) {
+                _error = layer->name + ": Normalize weights must be FP32";
+                return;
+            }
+            const float *w = it->second->cbuffer().as<const float *>();
+            _weights.assign(w, w + it->second->size());
+        }
+        auto dims = layer->insData[0].lock()->getTensorDesc().getDims();
+        if (dims.size() < 2) _error = layer->name + ": Normalize needs at least NC input";
+        else if (!_weights.empty() && !_channelShared && _weights.size() != dims[1])
+            _error = layer->name + ": Normalize weights do not match channels";
+    }
+
+    StatusCode execute(std::vector<Blob::Ptr> &inputs, std::vector<Blob::Ptr> &outputs,
+                       ResponseDesc *resp) noexcept override {
+        const float *src = inputs[0]->cbuffer().as<const float *>() +
+                           inputs[0]->getTensorDesc().getBlockingDesc().getOffsetPadding();
+        float *dst = outputs[0]->buffer().as<float *>() +
+                     outputs[0]->getTensorDesc().getBlockingDesc().getOffsetPadding();
+
+        auto dims = inputs[0]->getTensorDesc().getDims();
+        const size_t N = dims[0];
+        const size_t C = dims[1];
+        const size_t HW = product(dims, 2, dims.size());
+
+        for (size_t n = 0; n < N; n++) {
+            const float *s = src + n * C * HW;
+            float *d = dst + n * C * HW;
+            if (_acrossSpatial) {
+                float norm = 1.f / std::sqrt(sumSquares(s, C * HW) + _eps);
+                for (size_t c = 0; c < C; c++)
+                    scaleShiftKernel(s + c * HW, d + c * HW, HW, norm * weight(c), 0.f);
+            } else {
+                _norm.assign(HW, 0.f);
+                for (size_t c = 0; c < C; c++) accumulateSquares(s + c * HW, _norm.data(), HW);
+                for (size_t i = 0; i < HW; i++) _norm[i] = 1.f / std::sqrt(_norm[i] + _eps);
+                for (size_t c = 0; c < C; c++)
+                    mulKernel(s + c * HW, _norm.data(), d + c * HW, HW, weight(c));
+            }
+        }
+        return OK;
+    }
+
+private:
+    float weight(size_t c) const {
+        if (_weights.empty()) return 1.f;
+        return _channelShared ? _weights[0] : _weights[c];
+    }
+
+    bool _acrossSpatial = false;
+    bool _channelShared = false;
+    float _eps = 1e-10f;
+    std::vector<float> _weights;
+    std::vector<float> _norm;
+};
+
+/**
+ * Gather along an axis of the dictionary (input 0) with indices (input 1),
+ * out = dict[:axis] x indices x dict[axis + 1:]. Every index copies one
+ * contiguous block, out of range indices produce zeros.
+ */
+class GatherKernel : public HalKernel {
+public:
+    explicit GatherKernel(const CNNLayer *layer) : HalKernel(layer) {
+        if (layer->insData.size() != 2) {
+            _error = layer->name + ": Gather needs dictionary and indices inputs";
+            return;
+        }
+        auto dims = layer->insData[0].lock()->getTensorDesc().getDims();
+        int axis = layer->GetParamAsInt("axis", 0);
+        if (axis < 0) axis += static_cast<int>(dims.size());
+        if (axis < 0 || axis >= static_cast<int>(dims.size())) {
+            _error = layer->name + ": Gather axis is out of range";
+            return;
+        }
+        _axis = static_cast<size_t>(axis);
+    }
+
+    StatusCode execute(std::vector<Blob::Ptr> &inputs, std::vector<Blob::Ptr> &outputs,
+                       ResponseDesc *resp) noexcept override {
+        const float *dict = inputs[0]->cbuffer().as<const float *>() +
+                            inputs[0]->getTensorDesc().getBlockingDesc().getOffsetPadding();
+        const float *idx = inputs[1]->cbuffer().as<const float *>() +
+                           inputs[1]->getTensorDesc().getBlockingDesc().getOffsetPadding();
+        float *dst = outputs[0]->buffer().as<float *>() +
+                     outputs[0]->getTensorDesc().getBlockingDesc().getOffsetPadding();
+
+        auto dims = inputs[0]->getTensorDesc().getDims();
+        const size_t outer = product(dims, 0, _axis);
+        const size_t axisLen = dims[_axis];
+        const size_t inner = product(dims, _axis + 1, dims.size());
+        const size_t count = inputs[1]->size();
+
+        if (outer * count * inner != outputs[0]->size()) {
+            setError(resp, _layer->name + ": Gather output size mismatch");
+            return GENERAL_ERROR;
+        }
+
+        for (size_t o = 0; o < outer; o++) {
+            for (size_t i = 0; i < count; i++) {
+                float *d = dst + (o * count + i) * inner;
+                int index = static_cast<int>(idx[i]);
+                if (index < 0) index += static_cast<int>(axisLen);
+                if (index < 0 || index >= static_cast<int>(axisLen)) {
+                    std::memset(d, 0, inner * sizeof(float));
+                    continue;
+                }
+                std::memcpy(d, dict + (o * axisLen + index) * inner, inner * sizeof(float));
+            }
+        }
+        return OK;
+    }
+
+private:
+    size_t _axis = 0;
+};
+
+/**
+ * ScaleShift with per channel or single element (broadcast) weights/biases,
+ * either of which may be absent. The stock node expands the broadcast case
+ * into a full per channel blob and a depthwise convolution.
+ */
+class ScaleShiftKernel : public HalKernel {
+public:
+    explicit ScaleShiftKernel(const CNNLayer *layer) : HalKernel(layer) {
+        _inPlace = true;
+        auto ss = dynamic_cast<const ScaleShiftLayer *>(layer);
+        if (!ss) {
+            _error = layer->name + ": not a ScaleShift layer";
+            return;
+        }
+        auto dims = layer->insData[0].lock()->getTensorDesc().getDims();
+        const size_t C = dims.size() > 1 ? dims[1] : dims[0];
+        if (!copyParam(ss->_weights, C, _scale, 1.f) || !copyParam(ss->_biases, C, _shift, 0.f))
+            _error = layer->name + ": ScaleShift weights/biases must be FP32 of size 1 or C";
+    }
+
+    StatusCode execute(std::vector<Blob::Ptr> &inputs, std::vector<Blob::Ptr> &outputs,
+                       ResponseDesc *resp) noexcept override {
+        const float *src = inputs[0]->cbuffer().as<const float *>() +
+                           inputs[0]->getTensorDesc().getBlockingDesc().getOffsetPadding();
+        float *dst = outputs[0]->buffer().as<float *>() +
+                     outputs[0]->getTensorDesc().getBlockingDesc().getOffsetPadding();
+
+        auto dims = inputs[0]->getTensorDesc().getDims();
+        const size_t N = dims.size() > 1 ? dims[0] : 1;
+        const size_t C = dims.size() > 1 ? dims[1] : dims[0];
+        const size_t HW = product(dims, 2, dims.size());
+
+        for (size_t n = 0; n < N; n++) {
+            for (size_t c = 0; c < C; c++) {
+                const size_t off = (n * C + c) * HW;
+                scaleShiftKernel(src + off, dst + off, HW, _scale[_scale.size() > 1 ? c : 0],
+                                 _shift[_shift.size() > 1 ? c : 0]);
+            }
+        }
+        return OK;
+    }
+
+private:
+    static bool copyParam(const Blob::Ptr &blob, size_t C, std::vector<float> &out, float def) {
+        if (!blob) {
+            out.assign(1, def);
+            return true;
+        }
+        if (!isFP32(blob) || (blob->size() != 1 && blob->size() != C)) return false;
+        const float *p = blob->cbuffer().as<const float *>();
+        out.assign(p, p + blob->size());
+        return true;
+    }
+
+    std::vector<float> _scale;
+    std::vector<float> _shift;
+};
+
+template <class Kernel>
+class HalKernelFactory : public ILayerImplFactory {
+public:
+    explicit HalKernelFactory(const CNNLayer *layer) : _layer(layer) {}
+
+    // layers the kernel cannot run (FP16 blobs, odd weights) are left to the plugin
+    static ILayerImplFactory *create(const CNNLayer *layer) {
+        try {
+            Kernel probe(layer);
+            if (!probe.error().empty()) {
+                ALOGD("%s", probe.error().c_str());
+                return nullptr;
+            }
+        } catch (const std::exception &ex) {
+            ALOGD("%s: %s", layer->name.c_str(), ex.what());
+            return nullptr;
+        }
+        return new HalKernelFactory<Kernel>(layer);
+    }
+
+    StatusCode getImplementations(std::vector<ILayerImpl::Ptr> &impls,
+                                  ResponseDesc *resp) noexcept override {
+        try {
+            impls.push_back(ILayerImpl::Ptr(new Kernel(_layer)));
+        } catch (const std::exception &ex) {
+            setError(resp, ex.what());
+            return GENERAL_ERROR;
+        }
+        return OK;
+    }
+
+private:
+    const CNNLayer *_layer;
+};
+
+}  // namespace
+
+CpuExtension::CpuExtension(const std::vector<std::string> &layerTypes) {
+    auto &supported = supportedLayerTypes();
+    for (auto &type : layerTypes) {
+        if (std::find(supported.begin(), supported.end(), type) == supported.end()) {
+            ALOGE("no HAL CPU kernel for layer type %s, using plugin implementation",
+                  type.c_str());
+            continue;
+        }
+        _layerTypes.push_back(type);
+    }
+}
+
+const std::vector<std::string> &CpuExtension::supportedLayerTypes() {
+    static const std::vector<std::string> types = {"Clamp", "Normalize", "Gather", "ScaleShift"};
+    return types;
+}
+
+std::vector<std::string> CpuExtension::defaultLayerTypes() {
+    char value[PROPERTY_VALUE_MAX];
+    std::vector<std::string> types;
+    if (property_get(kLayerTypesProperty, value, "") <= 0) return types;
+
+    std::string list(value);
+    if (list == "none") return types;
+
+    std::stringstream ss(list);
+    std::string type;
+    while (std::getline(ss, type, ',')) {
+        if (!type.empty()) types.push_back(type);
+    }
+    return types;
+}
+
+StatusCode CpuExtension::getFactoryFor(ILayerImplFactory *&factory, const CNNLayer *cnnLayer,
+                                       ResponseDesc *resp) noexcept {
+    factory = nullptr;
+    if (std::find(_layerTypes.begin(), _layerTypes.end(), cnnLayer->type) == _layerTypes.end())
+        return NOT_FOUND;
+
+    if (cnnLayer->type == "Clamp")
+        factory = HalKernelFactory<ClampKernel>::create(cnnLayer);
+    else if (cnnLayer->type == "Normalize")
+        factory = HalKernelFactory<NormalizeKernel>::create(cnnLayer);
+    else if (cnnLayer->type == "Gather")
+        factory = HalKernelFactory<GatherKernel>::create(cnnLayer);
+    else if (cnnLayer->type == "ScaleShift")
+        factory = HalKernelFactory<ScaleShiftKernel>::create(cnnLayer);
+
+    return factory ? OK : NOT_FOUND;
+}
+
+StatusCode CpuExtension::getPrimitiveTypes(char **&types, unsigned int &size,
+                                           ResponseDesc *resp) noexcept {
+    size = static_cast<unsigned int>(_layerTypes.size());
+    types = new char *[size];
+    for (unsigned int i = 0; i < size; i++) {
+        types[i] = new char[_layerTypes[i].size() + 1];
+        std::copy(_layerTypes[i].begin(), _layerTypes[i].end(), types[i]);
+        types[i][_layerTypes[i].size()] = '\0';
+    }
+    return OK;
+}
+
+void CpuExtension::GetVersion(const Version *&versionInfo) const noexcept {
+    static const Version version = {{1, 0}, "1.0", "nn-hal-cpu-extension"};
+    versionInfo = &version;
+}
+
+}  // namespace Hal
+}  // namespace Extensions
+}  // namespace InferenceEngine
@@ -0,0 +1,63 @@
+// Copyright (c) 2017-2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/**
+ * @brief HAL owned CPU plugin extension, kernels for the layers IRBuilder emits
+ * that the stock MKLDNN plugin runs as generic, unvectorized code.
+ *
+ * Supported layer types: Clamp, Normalize, Gather, ScaleShift.
+ * The extension only claims the types it was created with. No kernel is used
+ * unless it is listed in the "nn.hal.cpu_extension" property, until each one
+ * has been measured against the stock implementation with graphbench_cpu.
+ * The kernels need SSE2 only, the module is built with -msse2.
+ *
+ * @file CpuExtension.h
+ */
+
+#pragma once
+
+#include <ie_iextension.h>
+#include <string>
+#include <vector>
+
+namespace InferenceEngine {
+namespace Extensions {
+namespace Hal {
+
+class CpuExtension : public IExtension {
+public:
+    explicit CpuExtension(const std::vector<std::string> &layerTypes);
+
+    // layer types listed in the "nn.hal.cpu_extension" property (comma
+    // separated), none when the property is unset
+    static std::vector<std::string> defaultLayerTypes();
+    // every layer type this extension has a kernel for
+    static const std::vector<std::string> &supportedLayerTypes();
+
+    StatusCode getFactoryFor(ILayerImplFactory *&factory, const CNNLayer *cnnLayer,
+                             ResponseDesc *resp) noexcept override;
+    StatusCode getPrimitiveTypes(char **&types, unsigned int &size,
+                                 ResponseDesc *resp) noexcept override;
+    void GetVersion(const Version *&versionInfo) const noexcept override;
+    void SetLogCallback(IErrorListener &listener) noexcept override {}
+    void Unload() noexcept override {}
+    void Release() noexcept override { delete this; }
+
+private:
+    std::vector<std::string> _layerTypes;
+};
+
+}  // namespace Hal
+}  // namespace Extensions
+}  // namespace InferenceEngine
@@ -0,0 +1,41 @@
+LOCAL_PATH := $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := libhalCpuExtension
+LOCAL_PROPRIETARY_MODULE := true
+LOCAL_MODULE_OWNER := intel
+#LOCAL_MULTILIB := both
+LOCAL_MULTILIB := 64
+
+LOCAL_SRC_FILES := \
+	CpuExtension.cpp
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH) \
+	$(LOCAL_PATH)/../../../dldt/inference-engine/include \
+	$(LOCAL_PATH)/../../../dldt/inference-engine/src/inference_engine
+
+LOCAL_CFLAGS += \
+	-std=c++11 \
+	-fPIC \
+	-fPIE \
+	-O3 \
+	-msse2 \
+	-Wall \
+	-Wno-unused-variable \
+	-Wno-unused-parameter \
+	-Wno-non-virtual-dtor \
+	-Wno-missing-field-initializers \
+	-frtti \
+	-Wno-error \
+	-D_FORTIFY_SOURCE=2 \
+	-fvisibility=default \
+	-fexceptions
+
+LOCAL_CFLAGS += \
+	-D__ANDROID__ \
+	-DIMPLEMENT_INFERENCE_ENGINE_API
+
+LOCAL_SHARED_LIBRARIES := liblog libcutils
+
+include $(BUILD_STATIC_LIBRARY)
@@ -33,6 +33,7 @@
 #include "ie_plugin_cpp.hpp"
 #include "ie_exception_conversion.hpp"
 #include "debug.h"
+#include "CpuExtension.h"
 #include <fstream>
 
 #include <android/log.h>
@@ -113,10 +114,13 @@ class ExecuteNetwork
     IInferRequest::Ptr req;
     InferRequest inferRequest;
     ResponseDesc resp;
+    TargetDevice targetDevice = TargetDevice::eCPU;
+    //layer types run by the HAL cpu extension kernels instead of the plugin ones
+    std::vector<std::string> cpuExtensionLayers = Extensions::Hal::CpuExtension::defaultLayerTypes();
 
 public:
     ExecuteNetwork() : network(nullptr){}
-    ExecuteNetwork(IRDocument &doc, TargetDevice target = TargetDevice::eCPU) : network(nullptr)
+    ExecuteNetwork(IRDocument &doc, TargetDevice target = TargetDevice::eCPU) : network(nullptr), targetDevice(target)
     {
         InferenceEngine::PluginDispatcher dispatcher({"/vendor/lib64","/vendor/lib","/system/lib64","/system/lib","","./"});
         enginePtr = dispatcher.getSuitablePlugin(target);
@@ -141,6 +145,12 @@ public:
     }
 
     //~ExecuteNetwork(){ }
+    //empty list keeps every layer on the stock plugin kernels, call before loadNetwork()
+    void setCpuExtensionLayers(const std::vector<std::string> &layers)
+    {
+        cpuExtensionLayers = layers;
+    }
+
     void loadNetwork()
     {
 
@@ -148,6 +158,12 @@ public:
         setConfig(networkConfig);
 
         InferencePlugin plugin(enginePtr);
+        if (targetDevice == TargetDevice::eCPU && !cpuExtensionLayers.empty()) {
+            plugin.AddExtension(std::make_shared<Extensions::Hal::CpuExtension>(cpuExtensionLayers));
+            #ifdef NNLOG
+            ALOGI("HAL cpu extension added for %d layer types", cpuExtensionLayers.size());
+            #endif
+        }
         executable_network = plugin.LoadNetwork(*network, networkConfig);
         //std::cout << "Network loaded" << std::endl;
 	 ALOGI("Network loaded");
@@ -161,17 +177,19 @@ public:
 	  #ifdef NNLOG
       ALOGI("Prepare input blob");
 	  #endif
-      Precision inputPrecision = Precision::FP32;
-      inputInfo.begin()->second->setPrecision(inputPrecision);
-      //inputInfo.begin()->second->setPrecision(Precision::U8);
-
-      auto inputDims = inputInfo.begin()->second->getTensorDesc().getDims();
-      if (inputDims.size() == 4)
-      inputInfo.begin()->second->setLayout(Layout::NCHW);
-      else if (inputDims.size() == 2)
-      inputInfo.begin()->second->setLayout(Layout::NC);
-      else
-      inputInfo.begin()->second->setLayout(Layout::C);
+      for (auto &item : inputInfo) {
+          //8-bit inputs stay U8, the network dequantizes them in its first ScaleShift
+          if (item.second->getPrecision() != Precision::U8)
+              item.second->setPrecision(Precision::FP32);
+
+          auto inputDims = item.second->getTensorDesc().getDims();
+          if (inputDims.size() == 4)
+          item.second->setLayout(Layout::NCHW);
+          else if (inputDims.size() == 2)
+          item.second->setLayout(Layout::NC);
+          else
+          item.second->setLayout(Layout::C);
+      }
 
 
       //inputInfo.begin()->second->setPrecision(Precision::U8);
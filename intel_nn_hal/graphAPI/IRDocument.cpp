@@ -153,6 +153,33 @@ void IRDocument::build() {
     _processed = true;
 }
 
+/**
+ * \brief create a pair of Memory layers sharing one state id
+ * \param id unique state id
+ * \param dims state dims
+ * out_t_1 outputs the value that was fed to in_t on the previous inference,
+ * zero on the first one. Both layers have no connection to the network inputs,
+ * so they are added here rather than found by build().
+ */
+DelayObj IRDocument::createDelay(const std::string &id, const TensorDims &dims) {
+    DelayObj delay;
+
+    delay.in_t = Generic("Memory");
+    addAttr(delay.in_t, "id", id);
+    addAttr(delay.in_t, "index", 0);
+    addAttr(delay.in_t, "size", 2);
+
+    delay.out_t_1 = Generic("Memory");
+    addAttr(delay.out_t_1, "id", id);
+    addAttr(delay.out_t_1, "index", 1);
+    addAttr(delay.out_t_1, "size", 2);
+    addOutput(delay.out_t_1, dims);
+
+    add(delay.in_t);
+    add(delay.out_t_1);
+    return delay;
+}
+
 InferenceEngine::ICNNNetwork *IRDocument::buildNetwork() {
     build();
     return network;
@@ -77,6 +77,12 @@ inline OutputPort addOutput(const IRLayer &layer, const InferenceEngine::SizeVec
         data = std::make_shared<InferenceEngine::Data>(d_name, td);
 
     }
+    else if(dims.size() > 4)
+    {
+        // intermediate of DepthToSpace/SpaceToDepth, no named layout
+        InferenceEngine::TensorDesc td(g_layer_precision, dims, InferenceEngine::Layout::ANY);
+        data = std::make_shared<InferenceEngine::Data>(d_name, td);
+    }
     else {
         std::cout << "addOutput dims size "<< dims.size()<<std::endl;
         //InferenceEngine::TensorDesc td(g_layer_precision, dims, InferenceEngine::Layout::ANY);
@@ -249,7 +255,8 @@ static OutputPort ScaleShiftNode(const OutputPort &src, const IRBlob::Ptr &scale
     l->_weights = scale;
     l->_broadcast = false;
     l->_biases = bias;
-    l->blobs["biases"] = bias;
+    if (scale) l->blobs["weights"] = scale;
+    if (bias) l->blobs["biases"] = bias;
     return addOutput(l, src->getTensorDesc().getDims());
 }
 
@@ -1090,6 +1097,149 @@ inline OutputPort Gather(const std::vector<OutputPort> inputs, int axis = 1)
     return output(ret);
 }
 
+inline OutputPort Power(const OutputPort &src, float power, float scale = 1, float shift = 0)
+{
+    std::string name = "Power-"; // todo: make it unique
+    name = name << layer_name_count++;
+    InferenceEngine::LayerParams prm;
+    prm.precision = g_layer_precision;
+    prm.name = name;
+    auto l = std::make_shared<InferenceEngine::PowerLayer>(prm);
+    l->type = "Power";
+    l->power = power;
+    l->scale = scale;
+    l->offset = shift;
+    l->params["power"] = std::to_string(power);
+    l->params["scale"] = std::to_string(scale);
+    l->params["shift"] = std::to_string(shift);
+    src >> l;
+    addOutput(l, src->getTensorDesc().getDims());
+    return output(l);
+}
+
+inline OutputPort Permute(const OutputPort &src, const std::vector<int> &order)
+{
+    std::string name = "Permute-"; // todo: make it unique
+    name = name << layer_name_count++;
+    InferenceEngine::LayerParams prm;
+    prm.precision = g_layer_precision;
+    prm.name = name;
+    auto l = std::make_shared<InferenceEngine::GenericLayer>(prm);
+    l->type = "Permute";
+    std::string orderStr;
+    for (auto o : order) orderStr += (orderStr.empty() ? "" : ",") + std::to_string(o);
+    l->params["order"] = orderStr;
+    src >> l;
+    auto inDims = src->getTensorDesc().getDims();
+    IR_ASSERT(inDims.size() == order.size());
+    TensorDims outDims;
+    for (auto o : order) outDims.push_back(inDims[o]);
+    addOutput(l, outDims);
+    return output(l);
+}
+
+inline OutputPort Tile(const OutputPort &src, int axis, int tiles)
+{
+    std::string name = "Tile-"; // todo: make it unique
+    name = name << layer_name_count++;
+    InferenceEngine::LayerParams prm;
+    prm.precision = g_layer_precision;
+    prm.name = name;
+    auto l = std::make_shared<InferenceEngine::TileLayer>(prm);
+    l->type = "Tile";
+    l->axis = axis;
+    l->tiles = tiles;
+    addAttr(l, "axis", axis);
+    addAttr(l, "tiles", tiles);
+    src >> l;
+    auto outDims = src->getTensorDesc().getDims();
+    outDims[axis] *= tiles;
+    addOutput(l, outDims);
+    return output(l);
+}
+
+/*
+* @brief bilinear resize of a NCHW tensor, corners are not aligned
+*/
+inline OutputPort Interp(const OutputPort &src, int height, int width)
+{
+    std::string name = "Interp-"; // todo: make it unique
+    name = name << layer_name_count++;
+    InferenceEngine::LayerParams prm;
+    prm.precision = g_layer_precision;
+    prm.name = name;
+    auto l = std::make_shared<InferenceEngine::GenericLayer>(prm);
+    l->type = "Interp";
+    addAttr(l, "height", height);
+    addAttr(l, "width", width);
+    addAttr(l, "align_corners", 0);
+    addAttr(l, "pad_beg", 0);
+    addAttr(l, "pad_end", 0);
+    src >> l;
+    auto inDims = src->getTensorDesc().getDims();
+    addOutput(l, {inDims[0], inDims[1], (size_t) height, (size_t) width});
+    return output(l);
+}
+
+/*
+* @brief NCHW DepthToSpace as reshape -> permute -> reshape,
+* channel (i * block + j) * C' + c moves to spatial offset (i, j)
+*/
+inline OutputPort DepthToSpace(const OutputPort &src, int block)
+{
+    auto inDims = src->getTensorDesc().getDims();
+    size_t b = block;
+    size_t n = inDims[0], c = inDims[1] / (b * b), h = inDims[2], w = inDims[3];
+    IR_ASSERT(c * b * b == inDims[1]);
+    auto blocks = Reshape({n, b, b, c, h, w}, src);
+    auto moved = Permute(blocks, {0, 3, 4, 1, 5, 2});
+    return Reshape({n, c, h * b, w * b}, moved);
+}
+
+inline OutputPort SpaceToDepth(const OutputPort &src, int block)
+{
+    auto inDims = src->getTensorDesc().getDims();
+    size_t b = block;
+    size_t n = inDims[0], c = inDims[1], h = inDims[2] / b, w = inDims[3] / b;
+    IR_ASSERT(h * b == inDims[2] && w * b == inDims[3]);
+    auto blocks = Reshape({n, c, h, b, w, b}, src);
+    auto moved = Permute(blocks, {0, 3, 5, 1, 2, 4});
+    return Reshape({n, b * b * c, h, w}, moved);
+}
+
+/*
+* @brief elementwise multiply, an input of size 1 along an axis is tiled to the other
+*/
+inline OutputPort BroadcastMul(const OutputPort &a, const OutputPort &b)
+{
+    auto aDims = a->getTensorDesc().getDims();
+    auto bDims = b->getTensorDesc().getDims();
+    IR_ASSERT(aDims.size() == bDims.size());
+    OutputPort lhs = a, rhs = b;
+    for (int i = 0; i < aDims.size(); i++) {
+        if (aDims[i] == bDims[i]) continue;
+        if (aDims[i] == 1) lhs = Tile(lhs, i, bDims[i]);
+        else if (bDims[i] == 1) rhs = Tile(rhs, i, aDims[i]);
+        else THROW("input sizes for broadcast Mul do not match");
+    }
+    return lhs * rhs;
+}
+
+/*
+* @brief L2 pooling, sqrt(avg(x^2)) over the valid part of each window
+*/
+inline OutputPort L2Pooling(const OutputPort &src,
+                            const Point2D &kernel,
+                            const Point2D &stride,
+                            const Point2D &pad_start,
+                            const Point2D &pad_end,
+                            std::string padType)
+{
+    auto squared = Power(src, 2);
+    auto mean = Pooling(squared, kernel, stride, pad_start, pad_end, padType,
+                        InferenceEngine::PoolingLayer::PoolType::AVG);
+    return Power(mean, 0.5f);
+}
 
 inline OutputPort operator+(const OutputPort &a, const OutputPort &b)
 {
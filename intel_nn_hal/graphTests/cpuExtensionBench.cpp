@@ -0,0 +1,149 @@
+// Micro-benchmark for the HAL cpu extension kernels.
+// Every case builds a single layer network (a chain of two for Clamp), runs it
+// on the CPU plugin with and without the extension and prints the mean latency
+// and the largest difference between both outputs. Normalize and Gather are
+// not MKLDNN plugin nodes, their stock implementation is libcpu_extension.so,
+// which is loaded for the reference run when it can be found.
+//
+// usage: graphbench_cpu [iterations]
+
+#include <chrono>
+#include <functional>
+#include "CpuExtension.h"
+#include "helpers-test.hpp"
+
+#include <android/log.h>
+#include <log/log.h>
+
+using namespace IRBuilder;
+
+struct BenchCase {
+    std::string layerType;
+    std::function<void(IRDocument &)> build;
+    // fills the input named by the first argument
+    std::function<void(const std::string &, float *, size_t)> fill;
+};
+
+static TBlob<float>::Ptr floatBlob(const vec<uint32_t> &dims, float value) {
+    TensorDesc td(InferenceEngine::Precision::FP32, toDims(dims), Layout::ANY);
+    auto blob = std::make_shared<InferenceEngine::TBlob<float>>(td);
+    blob->allocate();
+    for (size_t i = 0; i < blob->size(); i++) blob->data()[i] = value + 0.01f * i;
+    return blob;
+}
+
+static void fillRamp(const std::string &, float *data, size_t n) {
+    for (size_t i = 0; i < n; i++) data[i] = static_cast<float>(i % 97) / 16.0f - 3.0f;
+}
+
+// runs doc for the given number of iterations, returns the mean latency in us
+static double runCase(const BenchCase &bc, bool useExtension, int iterations,
+                      std::vector<float> &result) {
+    IRDocument doc(bc.layerType + "Bench");
+    bc.build(doc);
+    doc.buildNetwork();
+
+    ICNNNetwork *network = doc.getNetwork();
+    InputsDataMap inputInfo;
+    OutputsDataMap outputInfo;
+    network->getInputsInfo(inputInfo);
+    network->getOutputsInfo(outputInfo);
+    for (auto &in : inputInfo) in.second->setPrecision(Precision::FP32);
+    for (auto &out : outputInfo) out.second->setPrecision(Precision::FP32);
+
+    InferenceEngine::PluginDispatcher dispatcher(
+        {"/vendor/lib64", "/vendor/lib", "/system/lib64", "/system/lib", "", "./"});
+    InferencePlugin plugin(dispatcher.getSuitablePlugin(TargetDevice::eCPU));
+    if (useExtension) {
+        plugin.AddExtension(
+            std::make_shared<Extensions::Hal::CpuExtension>(std::vector<std::string>{bc.layerType}));
+    } else {
+        try {
+            plugin.AddExtension(std::make_shared<Extension>("libcpu_extension.so"));
+        } catch (const std::exception &ex) {
+            ALOGI("libcpu_extension.so not loaded: %s", ex.what());
+        }
+    }
+
+    std::map<std::string, std::string> networkConfig;
+    auto executableNet = plugin.LoadNetwork(*network, networkConfig);
+    auto request = executableNet.CreateInferRequest();
+
+    for (auto &in : inputInfo) {
+        auto blob = request.GetBlob(in.first);
+        bc.fill(in.first, blob->buffer().as<float *>(), blob->size());
+    }
+
+    request.Infer();  // warm up
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) request.Infer();
+    auto end = std::chrono::steady_clock::now();
+
+    auto out = request.GetBlob(outputInfo.begin()->first);
+    const float *od = out->cbuffer().as<const float *>();
+    result.assign(od, od + out->size());
+
+    return std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+}
+
+int main(int argc, const char *argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 100;
+    IRBuilder::g_layer_precision = InferenceEngine::Precision::FP32;
+
+    const vec<uint32_t> dims = {1, 64, 56, 56};
+    std::vector<BenchCase> cases = {
+        {"Clamp",
+         [&](IRDocument &doc) {
+             auto input = doc.createInput("input", toDims(dims));
+             doc.addOutput(Clamp(Clamp(input->getInputData(), -2.0f, 2.0f), 0.0f, 1.0f));
+         },
+         fillRamp},
+        {"Normalize",
+         [&](IRDocument &doc) {
+             auto input = doc.createInput("input", toDims(dims));
+             doc.addOutput(L2Normalization(input->getInputData(), false, false));
+         },
+         fillRamp},
+        {"Gather",
+         [&](IRDocument &doc) {
+             auto dict = doc.createInput("dict", toDims({1000, 256}));
+             auto idx = doc.createInput("idx", toDims({1, 512}));
+             doc.addOutput(Gather({dict->getInputData(), idx->getInputData()}, 0));
+         },
+         [](const std::string &name, float *data, size_t n) {
+             if (name == "idx")
+                 for (size_t i = 0; i < n; i++) data[i] = static_cast<float>((i * 37) % 1000);
+             else
+                 fillRamp(name, data, n);
+         }},
+        {"ScaleShift",
+         [&](IRDocument &doc) {
+             auto input = doc.createInput("input", toDims(dims));
+             doc.addOutput(ScaleShiftNode(input->getInputData(), floatBlob({dims[1]}, 0.5f),
+                                          floatBlob({dims[1]}, 1.0f)));
+         },
+         fillRamp},
+    };
+
+    printf("%-12s %12s %12s %10s %12s\n", "layer", "stock(us)", "hal(us)", "speedup",
+           "max|diff|");
+    for (auto &bc : cases) {
+        try {
+            std::vector<float> stockOut, halOut;
+            double stock = runCase(bc, false, iterations, stockOut);
+            double hal = runCase(bc, true, iterations, halOut);
+
+            float maxDiff = stockOut.size() == halOut.size() ? 0.0f : INFINITY;
+            for (size_t i = 0; i < stockOut.size() && i < halOut.size(); i++)
+                maxDiff = std::max(maxDiff, fabsf(stockOut[i] - halOut[i]));
+
+            printf("%-12s %12.1f %12.1f %9.2fx %12g\n", bc.layerType.c_str(), stock, hal,
+                   stock / hal, maxDiff);
+            ALOGI("%s stock %.1f us hal %.1f us max diff %g", bc.layerType.c_str(), stock, hal,
+                  maxDiff);
+        } catch (const std::exception &ex) {
+            printf("%-12s exception: %s\n", bc.layerType.c_str(), ex.what());
+        }
+    }
+    return 0;
+}
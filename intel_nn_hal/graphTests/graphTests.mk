@@ -49,3 +49,46 @@ LOCAL_STATIC_LIBRARIES := libgraphAPI libpugixml
 LOCAL_SHARED_LIBRARIES := libinference_engine liblog
 
 include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := graphbench_cpu
+LOCAL_PROPRIETARY_MODULE := true
+LOCAL_MODULE_OWNER := intel
+
+LOCAL_SRC_FILES := \
+	cpuExtensionBench.cpp
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH) \
+	$(LOCAL_PATH)/../graphAPI \
+	$(LOCAL_PATH)/../cpuExtension \
+	$(LOCAL_PATH)/../../../dldt/inference-engine/include \
+	$(LOCAL_PATH)/../../../dldt/inference-engine/include/cpp \
+	$(LOCAL_PATH)/../../../dldt/inference-engine/include/details \
+	$(LOCAL_PATH)/../../../dldt/inference-engine/src/inference_engine \
+	$(LOCAL_PATH)/../../../dldt/inference-engine/src/inference_engine/cpp_interfaces \
+	$(LOCAL_PATH)/../../../dldt/inference-engine/thirdparty/pugixml/src
+
+LOCAL_CFLAGS += \
+	-std=c++11 \
+	-Wall \
+	-fPIC \
+	-fPIE \
+	-Wno-unused-variable \
+	-Wno-unused-parameter \
+	-Wno-non-virtual-dtor \
+	-Wno-missing-field-initializers \
+	-fexceptions \
+	-frtti \
+	-Wno-error \
+	-D_FORTIFY_SOURCE=2
+
+LOCAL_CFLAGS += \
+	-DENABLE_MKLDNN \
+	-DIMPLEMENT_INFERENCE_ENGINE_API
+
+LOCAL_STATIC_LIBRARIES := libgraphAPI libhalCpuExtension libpugixml
+LOCAL_SHARED_LIBRARIES := libinference_engine liblog libcutils
+
+include $(BUILD_EXECUTABLE)
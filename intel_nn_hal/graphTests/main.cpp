@@ -372,6 +372,165 @@ bool testAffineLayer() {
     }
 }
 
+// runs a document with its inputs set by name and returns its FP32 output,
+// 4-D outputs are read back in NHWC order (see ExecuteNetwork::prepareOutput)
+TBlob<float>::Ptr runDocument(IRDocument &doc, const std::vector<std::string> &names,
+                              const std::vector<std::vector<float>> &invalues,
+                              const std::vector<vec<uint32_t>> &indims) {
+    doc.buildNetwork();
+
+#ifdef ENABLE_MYRIAD
+    ExecuteNetwork executeNet(doc, TargetDevice::eMYRIAD);
+#elif ENABLE_MKLDNN
+    ExecuteNetwork executeNet(doc, TargetDevice::eCPU);
+#endif
+    executeNet.prepareInput();
+    executeNet.prepareOutput();
+    executeNet.loadNetwork();
+
+    for (size_t n = 0; n < names.size(); n++) {
+        Layout layout = indims[n].size() == 4 ? Layout::NCHW
+                                              : indims[n].size() == 2 ? Layout::NC : Layout::C;
+        TensorDesc intd(InferenceEngine::Precision::FP32, toDims(indims[n]), layout);
+        InferenceEngine::TBlob<float>::Ptr inData =
+            std::make_shared<InferenceEngine::TBlob<float>>(intd);
+        inData->allocate();
+        for (size_t i = 0; i < invalues[n].size(); i++) {
+            inData->data()[i] = invalues[n].at(i);
+        }
+        executeNet.setBlob(names[n], inData);
+    }
+    executeNet.Infer();
+
+    OutputsDataMap outputs;
+    doc.getNetwork()->getOutputsInfo(outputs);
+    return executeNet.getBlob(outputs.begin()->first);
+}
+
+TBlob<float>::Ptr runDocument(IRDocument &doc, const std::vector<float> &invalue,
+                              const vec<uint32_t> &indims) {
+    return runDocument(doc, {"input"}, {invalue}, {indims});
+}
+
+// 1-D constant blob in the precision of the layers
+IRBlob::Ptr constBlob(std::vector<float> data) {
+    vec<uint32_t> dims = {static_cast<uint32_t>(data.size())};
+#ifdef ENABLE_MYRIAD
+    TensorDesc td(InferenceEngine::Precision::FP16, toDims(dims), Layout::C);
+    InferenceEngine::TBlob<short>::Ptr blob = std::make_shared<InferenceEngine::TBlob<short>>(td);
+    blob->allocate();
+    uint32_t nelem = data.size();
+    f32tof16Arrays(blob->data().as<short *>(), data.data(), nelem);
+#elif ENABLE_MKLDNN
+    TensorDesc td(InferenceEngine::Precision::FP32, toDims(dims), Layout::C);
+    InferenceEngine::TBlob<float>::Ptr blob = std::make_shared<InferenceEngine::TBlob<float>>(td);
+    blob->set(data);
+#endif
+    return blob;
+}
+
+bool checkOutput(const char *name, const TBlob<float>::Ptr &ob,
+                 const std::vector<float> &expected) {
+    for (size_t i = 0; i < expected.size(); i++) {
+        if (fabsf(ob->readOnly()[i] - expected[i]) > 1E-2) {
+            printf("%s FAILED at %zu: expected %f got %f\n", name, i, expected[i],
+                   ob->readOnly()[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool testSpatialLayers() {
+    try {
+        bool ok = true;
+
+        // NCHW 1x4x2x2 holding its own indexes, channel i * 2 + j goes to offset (i, j)
+        // of every 2x2 block of the 1x1x4x4 output
+        {
+            IRDocument doc("DepthToSpaceNet");
+            vec<uint32_t> indims = {1, 4, 2, 2};
+            auto input = doc.createInput("input", toDims(indims));
+            doc.addOutput(DepthToSpace(input->getInputData(), 2));
+
+            std::vector<float> invalue(16);
+            for (size_t i = 0; i < invalue.size(); i++) invalue[i] = static_cast<float>(i);
+            auto ob = runDocument(doc, invalue, indims);
+            ok &= checkOutput("DepthToSpace", ob,
+                              {0, 4, 1, 5, 8, 12, 9, 13, 2, 6, 3, 7, 10, 14, 11, 15});
+        }
+
+        // and back, the 1x4x2x2 output is read in NHWC order
+        {
+            IRDocument doc("SpaceToDepthNet");
+            vec<uint32_t> indims = {1, 1, 4, 4};
+            auto input = doc.createInput("input", toDims(indims));
+            doc.addOutput(SpaceToDepth(input->getInputData(), 2));
+
+            auto ob = runDocument(doc, {0, 4, 1, 5, 8, 12, 9, 13, 2, 6, 3, 7, 10, 14, 11, 15},
+                                  indims);
+            ok &= checkOutput("SpaceToDepth", ob,
+                              {0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15});
+        }
+
+        // L2 pooling over the whole 2x2 plane: sqrt((9 + 16 + 0 + 0) / 4) = 2.5
+        {
+            IRDocument doc("L2PoolNet");
+            vec<uint32_t> indims = {1, 1, 2, 2};
+            auto input = doc.createInput("input", toDims(indims));
+            doc.addOutput(L2Pooling(input->getInputData(), {2, 2}, {1, 1}, {0, 0}, {0, 0},
+                                    "valid"));
+
+            auto ob = runDocument(doc, {3.0f, 4.0f, 0.0f, 0.0f}, indims);
+            ok &= checkOutput("L2Pooling", ob, {2.5f});
+        }
+
+        // MUL by a per channel constant: a ScaleShift without biases
+        {
+            IRDocument doc("MulConstNet");
+            vec<uint32_t> indims = {1, 2, 1, 2};
+            auto input = doc.createInput("input", toDims(indims));
+            doc.addOutput(ScaleShiftNode(input->getInputData(), constBlob({2.0f, -1.0f}), nullptr));
+
+            auto ob = runDocument(doc, {1, 2, 3, 4}, indims);
+            ok &= checkOutput("ScaleShift MUL", ob, {2, -3, 4, -4});
+        }
+
+        // MUL of 1x2x1x2 by 1x1x1x2, the second input is tiled along the channels
+        {
+            IRDocument doc("BroadcastMulNet");
+            vec<uint32_t> adims = {1, 2, 1, 2}, bdims = {1, 1, 1, 2};
+            auto a = doc.createInput("a", toDims(adims));
+            auto b = doc.createInput("b", toDims(bdims));
+            doc.addOutput(BroadcastMul(a->getInputData(), b->getInputData()));
+
+            auto ob = runDocument(doc, {"a", "b"}, {{1, 2, 3, 4}, {10, 100}}, {adims, bdims});
+            ok &= checkOutput("BroadcastMul", ob, {10, 30, 200, 400});
+        }
+
+        // RESIZE_BILINEAR 2x2 -> 4x4 samples rows and columns 0, 0.5, 1 and 1.5, the
+        // last one clamped to 1. The input is linear, so is the output: 2 * y + x
+        {
+            IRDocument doc("InterpNet");
+            vec<uint32_t> indims = {1, 1, 2, 2};
+            auto input = doc.createInput("input", toDims(indims));
+            doc.addOutput(Interp(input->getInputData(), 4, 4));
+
+            auto ob = runDocument(doc, {0, 1, 2, 3}, indims);
+            ok &= checkOutput("Interp", ob,
+                              {0, 0.5f, 1, 1, 1, 1.5f, 2, 2, 2, 2.5f, 3, 3, 2, 2.5f, 3, 3});
+        }
+
+        std::cout << (ok ? "TEST OK!" : "TEST FAILED!") << std::endl;
+        ALOGI("testSpatialLayers %s", ok ? "OK" : "FAILED");
+        return ok;
+    } catch (const std::exception &ex) {
+        printf("exception\n");
+        std::cerr << ex.what();
+        return false;
+    }
+}
+
 template <typename T>
 bool testMKLBug() {
     std::string tmpStr;
@@ -453,6 +612,7 @@ int main(int argc, const char *argv[]) {
 #endif
 
     testAffineLayer();
+    testSpatialLayers();
 
     prompt("enter string to exit\n");
     return 0;